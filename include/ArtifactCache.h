@@ -0,0 +1,145 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Read-only view of an artifact file's payload. Memory-mapped where the
+// platform allows it, otherwise read into memory. Unmapped on destruction.
+class MappedArtifact {
+private:
+    void* base = nullptr;           // start of the mapping (or buffer)
+    size_t mappedSize = 0;
+    std::vector<unsigned char> buffer;
+    const unsigned char* payload = nullptr;
+    size_t payloadSize = 0;
+
+    friend class ArtifactCache;
+
+public:
+    MappedArtifact() = default;
+    ~MappedArtifact();
+    MappedArtifact(const MappedArtifact&) = delete;
+    MappedArtifact& operator=(const MappedArtifact&) = delete;
+
+    const unsigned char* data() const { return payload; }
+    size_t size() const { return payloadSize; }
+};
+
+// Versioned cache of precomputed artifacts (routing indexes, labels, tables)
+// stored as <dataDir>/cache/<name>-<hash>.bin. The hash is FNV-1a 64 over
+// stations.txt, connections.txt and a caller-supplied parameter string (e.g.
+// the walking radius), so edited inputs never match an old file. Each file
+// starts with a header (magic, format version, artifact version, input hash,
+// payload size). Files are written to a temporary name and renamed into
+// place, so readers never see a partial artifact.
+class ArtifactCache {
+private:
+    std::string directory;
+    uint64_t hash = 0;
+    std::mutex writersMutex;
+    std::vector<std::thread> writers;
+
+    std::string pathFor(const std::string& name) const;
+
+public:
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    // Hashes the inputs in dataDir; params distinguishes builds of the same
+    // files with different settings
+    ArtifactCache(const std::string& dataDir, const std::string& params = "");
+    ~ArtifactCache();   // waits for background writes
+
+    uint64_t inputHash() const { return hash; }
+    const std::string& cacheDirectory() const { return directory; }
+
+    // Map a valid artifact (matching name, version and input hash), or return
+    // nullptr. Counts Counter::CacheHits / CacheMisses.
+    std::unique_ptr<MappedArtifact> open(const std::string& name, uint32_t version) const;
+
+    // Write an artifact now; removes stale files of the same name. Returns
+    // false (with a message on stderr) if the cache directory is not writable.
+    bool write(const std::string& name, uint32_t version, const std::string& payload) const;
+
+    // Run build() on a background thread and write its result. build must
+    // only touch state that stays valid and unchanged until it finishes.
+    void writeAsync(const std::string& name, uint32_t version, std::function<std::string()> build);
+
+    // Wait for all background writes started so far
+    void wait();
+
+    // FNV-1a 64 over bytes, continuing from seed
+    static uint64_t fnv1a(const void* data, size_t size, uint64_t seed = 1469598103934665603ULL);
+};
+
+// Append-only payload encoder (host byte order; the header records it)
+class ArtifactWriter {
+private:
+    std::string out;
+
+public:
+    template <typename T>
+    void put(const T& value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void putArray(const std::vector<T>& values) {
+        put(static_cast<uint64_t>(values.size()));
+        out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void putString(const std::string& value) {
+        put(static_cast<uint32_t>(value.size()));
+        out.append(value);
+    }
+
+    std::string& str() { return out; }
+};
+
+// Bounds-checked payload decoder; every get returns false once the payload
+// is exhausted or malformed, so callers can check once at the end
+class ArtifactReader {
+private:
+    const unsigned char* pos;
+    const unsigned char* end;
+    bool good = true;
+
+    bool take(void* dst, size_t bytes) {
+        if (!good || static_cast<size_t>(end - pos) < bytes) return good = false;
+        if (bytes > 0) std::memcpy(dst, pos, bytes);
+        pos += bytes;
+        return true;
+    }
+
+public:
+    ArtifactReader(const unsigned char* data, size_t size) : pos(data), end(data + size) {}
+
+    template <typename T>
+    bool get(T& value) {
+        return take(&value, sizeof(T));
+    }
+
+    template <typename T>
+    bool getArray(std::vector<T>& values) {
+        uint64_t count = 0;
+        if (!get(count) || count > static_cast<uint64_t>(end - pos) / sizeof(T)) return good = false;
+        values.resize(count);
+        return take(values.data(), count * sizeof(T));
+    }
+
+    bool getString(std::string& value) {
+        uint32_t length = 0;
+        if (!get(length) || length > static_cast<size_t>(end - pos)) return good = false;
+        value.assign(reinterpret_cast<const char*>(pos), length);
+        pos += length;
+        return true;
+    }
+
+    bool ok() const { return good; }
+    bool atEnd() const { return good && pos == end; }
+};
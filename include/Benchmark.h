@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Latency samples for one benchmark and the summary reported for it
+struct BenchResult {
+    std::string name;
+    std::string topology;
+    int stations = 0;
+    size_t samples = 0;
+    double p50Us = 0, p90Us = 0, p99Us = 0, p999Us = 0, maxUs = 0, meanUs = 0;
+    double throughputPerSec = 0;    // operations per second of wall time
+    int threads = 1;
+    double cacheMissesPerOp = -1;   // hardware cache misses (single-threaded runs); -1 = not measured
+    std::vector<std::pair<std::string, double>> extra;     // benchmark-specific values, e.g. locality scores
+};
+
+// Hardware cache-miss counter of the calling thread (Linux perf events).
+// Without perf access (other platforms, containers, perf_event_paranoid)
+// available() is false and read() returns 0.
+class CacheMissCounter {
+private:
+    int fd = -1;
+
+public:
+    CacheMissCounter();
+    ~CacheMissCounter();
+    CacheMissCounter(const CacheMissCounter&) = delete;
+    CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+    bool available() const { return fd >= 0; }
+    void start();       // reset and enable
+    uint64_t read();    // disable and return the misses since start()
+};
+
+class Benchmark {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Time op(i) for i in [0, iterations) on the calling thread; also
+    // counts cache misses when CacheMissCounter is available
+    static BenchResult run(const std::string& name, size_t iterations,
+                           const std::function<void(size_t)>& op);
+
+    // Time op(i) for i in [0, iterations) spread over `threads` threads;
+    // latencies are per operation, throughput is over total wall time
+    static BenchResult runParallel(const std::string& name, size_t iterations, int threads,
+                                   const std::function<void(size_t)>& op);
+
+    // Fill percentiles from raw nanosecond samples
+    static void summarize(std::vector<uint64_t>& samplesNs, double wallSeconds, BenchResult& result);
+
+    // One JSON object per line, for scripts and regression tracking
+    static void writeJson(std::ostream& out, const BenchResult& result);
+};
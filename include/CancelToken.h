@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+
+// Cooperative cancellation for long searches: a deadline plus a cancel flag.
+//
+// A query runs with its token installed for the calling thread
+// (CancelToken::Scope). Search loops call CancelToken::poll(ticks) once per
+// settled station; it looks at the token only every 256 calls, so an
+// unscheduled search pays one counter increment. When poll() returns true
+// the loop stops and reports "not found"; the caller that installed the
+// token checks stopped() to tell that apart from a real miss.
+class CancelToken {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    std::atomic<bool> cancelled{false};
+    Clock::time_point deadline = Clock::time_point::max();
+
+    static thread_local CancelToken* active;
+
+public:
+    CancelToken() = default;
+    explicit CancelToken(Clock::time_point deadline) : deadline(deadline) {}
+
+    CancelToken(const CancelToken&) = delete;
+    CancelToken& operator=(const CancelToken&) = delete;
+
+    // Safe from any thread
+    void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+    // Cancelled, or past the deadline (which then also cancels)
+    bool stopped();
+    bool expired() const { return Clock::now() >= deadline; }
+    Clock::time_point getDeadline() const { return deadline; }
+
+    // Installs a token for the calling thread for the scope's lifetime
+    class Scope {
+    private:
+        CancelToken* previous;
+
+    public:
+        explicit Scope(CancelToken* token) : previous(active) { active = token; }
+        ~Scope() { active = previous; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // Token of the calling thread, nullptr outside a scheduled query
+    static CancelToken* current() { return active; }
+
+    // For search loops: true when the current query should stop
+    static bool poll(unsigned& ticks) {
+        return (++ticks & 255u) == 0 && active != nullptr && active->stopped();
+    }
+};
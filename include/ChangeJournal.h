@@ -0,0 +1,138 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Graph.h"
+
+// Kinds of admin edits recorded in the journal
+enum class ChangeType : uint8_t {
+    AddStation = 1,
+    AddConnection = 2,      // Graph::addEdge semantics (ride or transfer by line)
+    RemoveStation = 3,
+    RemoveConnection = 4
+};
+
+// One admin edit. Applying a change is idempotent (adding what exists or
+// removing what is gone is a no-op), so replaying a journal over a snapshot
+// that already contains some of its changes gives the same network.
+struct Change {
+    ChangeType type;
+    std::string station;    // station name / first station
+    std::string other;      // line (AddStation) or second station
+    int zone = 0;
+    double latitude = 0;
+    double longitude = 0;
+    double km = 0;
+
+    static Change addStation(const std::string& name, const std::string& line, int zone,
+                             double lat, double lon);
+    static Change addConnection(const std::string& a, const std::string& b, double km);
+    static Change removeStation(const std::string& name);
+    static Change removeConnection(const std::string& a, const std::string& b);
+
+    // Apply to graph; false if it changed nothing
+    bool apply(Graph& graph) const;
+};
+
+// Append-only write-ahead journal of admin edits at <dataDir>/journal.bin,
+// on top of the stations.txt / connections.txt snapshot.
+//
+// append() only queues the encoded record (microseconds); a writer thread
+// gathers everything queued within the group-commit window into one write
+// and one fsync. waitDurable() blocks until a record is on disk, and
+// reports false if its write or sync failed. A failed write may leave a torn
+// record that ends replay, so every later record reports failure as well.
+//
+// Records are length-prefixed and checksummed; replay stops at the first
+// torn or corrupt record, and opening the journal for writing truncates such
+// a tail. Once the journal holds compactRecords records, a background
+// compactor loads the snapshot, replays the records written so far, rewrites
+// the text files and starts a new journal with only the later records. A
+// crash in between leaves records that are already in the snapshot; since
+// changes are idempotent, replaying them again is harmless.
+class ChangeJournal {
+public:
+    struct Options {
+        unsigned groupCommitMicros = 2000;  // how long the writer waits to batch records
+        size_t compactRecords = 1000;       // fold into the snapshot at this many records (0 = never)
+        bool sync = true;                   // fsync each group (off for tests/benchmarks)
+    };
+
+private:
+    std::string dataDir;
+    std::string path;
+    Options options;
+
+    // Queue shared by append() and the writer thread
+    std::mutex pendingMutex;
+    std::condition_variable pendingReady;
+    std::condition_variable durable;
+    std::string pending;
+    size_t pendingRecords = 0;
+    uint64_t appendedSeq = 0;
+    uint64_t durableSeq = 0;        // records written (or failed) so far
+    uint64_t failedSeq = 0;         // first record of the first failed write (0 = none)
+    bool stopping = false;
+
+    // Journal file and its record count; held while writing or swapping files
+    std::mutex fileMutex;
+    std::FILE* file = nullptr;
+    size_t fileRecords = 0;
+
+    std::thread writer;
+    bool compacting = false;        // guarded by pendingMutex
+    std::condition_variable compacted;
+
+    // The compaction thread; started by the writer or compactNow(), joined by
+    // the next start or waitCompaction()
+    std::mutex compactorMutex;
+    std::thread compactor;
+
+    void writerLoop();
+    void launchCompaction();
+    void compact();
+    bool openForAppend();
+
+public:
+    explicit ChangeJournal(const std::string& dataDir);
+    ChangeJournal(const std::string& dataDir, const Options& options);
+    ~ChangeJournal();       // writes everything queued and waits for compaction
+
+    ChangeJournal(const ChangeJournal&) = delete;
+    ChangeJournal& operator=(const ChangeJournal&) = delete;
+
+    // Queue a change; returns its sequence number for waitDurable()
+    uint64_t append(const Change& change);
+
+    // Block until change seq (and all before it) is written; false if it
+    // did not reach the disk
+    bool waitDurable(uint64_t seq);
+
+    // Write everything queued so far and wait for it; false if any of it
+    // did not reach the disk
+    bool flush();
+
+    // Fold the journal into the text snapshot now, on the background thread
+    void compactNow();
+
+    // Wait for a running compaction. After flush(), this includes any
+    // compaction that the flushed records started.
+    void waitCompaction();
+
+    // Records currently in the journal file (written, not yet compacted)
+    size_t size();
+
+    // Journal file for a data directory
+    static std::string pathFor(const std::string& dataDir);
+
+    // Apply the journal in dataDir to graph (loaded from the snapshot);
+    // returns the number of records read. Missing journal = 0.
+    static size_t replay(const std::string& dataDir, Graph& graph);
+
+    // ArtifactCache parameter covering the journal contents ("" if empty),
+    // so cached indexes are rebuilt after edits
+    static std::string cacheKey(const std::string& dataDir);
+};
@@ -0,0 +1,184 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <memory>
+#include "Graph.h"
+#include "StationOrder.h"
+#include "CompressedAdjacency.h"
+
+// Read-only snapshot of a Graph with dense station IDs (0..size()-1) and
+// CSR adjacency. Station IDs follow sorted station names by default, or a
+// locality-preserving StationOrder (StationOrder.h); either way they are
+// stable for a given dataset. Build once after loading; safe to query from
+// many threads.
+//
+// Each station's edges are grouped by type: rides, then transfers, then walks.
+// Cost models that treat the types differently run one tight loop per group
+// instead of switching on the type of every edge.
+//
+// compressed() gives a copy with the same IDs whose edges are packed
+// (CompressedAdjacency.h) for very large networks. Every accessor works on
+// either; traversals should read a station at a time through EdgeCursor,
+// since a single edgeTarget() on a compressed snapshot decodes its station.
+class CompactGraph {
+private:
+    std::vector<std::string> names;
+    std::unordered_map<std::string, int> ids;
+    std::vector<int> offsets;        // size() + 1 entries into the edge arrays
+    std::vector<int> rideEnd;        // end of station u's ride group
+    std::vector<int> transferEnd;    // end of station u's transfer group (walks follow)
+    std::vector<int> targets;
+    std::vector<double> weights;
+    std::vector<uint32_t> meters;        // weights rounded to whole meters
+    std::vector<unsigned char> types;    // EdgeType per edge
+    std::vector<int> edgeLines;          // line ID for rides, -1 otherwise
+    std::vector<std::string> lineNames;
+    std::vector<int> zones;
+    std::vector<double> latitudes;
+    std::vector<double> longitudes;
+    StationOrder order = StationOrder::Name;
+
+    // Set in compressed snapshots; the per-edge arrays and group ends above
+    // are then empty (offsets stay)
+    std::shared_ptr<const CompressedAdjacency> packed;
+
+    // Arrival states for line-aware searches (RouteKernel.h): per station,
+    // one for each line its rides arrive on and one for arriving over a
+    // transfer or walk edge. Derived from the edges, not serialized.
+    std::vector<int> arrivalStates;     // per edge: state at its target
+    std::vector<int> stateStations;     // per state
+    std::vector<int> stateLines;        // per state: line, -1 after a transfer / walk
+
+    int stationOfEdge(int e) const;
+    int packedTarget(int e) const;
+    void buildArrivalStates();
+
+public:
+    CompactGraph() = default;
+    explicit CompactGraph(const Graph& graph, StationOrder order = StationOrder::Name);
+
+    // Cache artifact (ArtifactCache) name, payload version and codec;
+    // deserialize returns nullptr for a malformed payload (sizes, edge group
+    // bounds, edge types and line IDs are checked)
+    static constexpr const char* ARTIFACT_NAME = "routing-index";
+    static constexpr uint32_t ARTIFACT_VERSION = 2;
+    std::string serialize() const;
+    static std::shared_ptr<const CompactGraph> deserialize(const unsigned char* data, size_t size);
+
+    // Same snapshot with packed edges (nullptr if it cannot be packed)
+    std::shared_ptr<const CompactGraph> compressed() const;
+    bool isCompressed() const { return packed != nullptr; }
+
+    int size() const { return static_cast<int>(names.size()); }
+    int getEdgeCount() const { return offsets.empty() ? 0 : offsets.back(); }
+    StationOrder getOrder() const { return order; }
+
+    // Station lookup (-1 when the station is unknown)
+    int idOf(const std::string& name) const;
+    const std::string& nameOf(int id) const { return names[id]; }
+
+    // Outgoing edges of u are [edgeBegin(u), edgeEnd(u))
+    int edgeBegin(int u) const { return offsets[u]; }
+    int edgeEnd(int u) const { return offsets[u + 1]; }
+    int edgeTarget(int e) const { return packed ? packedTarget(e) : targets[e]; }
+    // km; from the quantized length when compressed
+    double edgeWeight(int e) const { return packed ? packed->meters(e) / 1000.0 : weights[e]; }
+    uint32_t edgeMeters(int e) const { return packed ? packed->meters(e) : meters[e]; }
+    EdgeType edgeType(int e) const { return packed ? packed->type(e) : static_cast<EdgeType>(types[e]); }
+    int edgeLine(int e) const { return packed ? packed->line(e) : edgeLines[e]; }
+
+    // Type groups: rides [edgeBegin, rideEnd), transfers [rideEnd, transferEnd),
+    // walks [transferEnd, edgeEnd)
+    int rideEndOf(int u) const;
+    int transferEndOf(int u) const;
+
+    // One station's edges for traversal loops, from either encoding. The
+    // cursor owns the decode buffers; keep one per thread (the workspaces do)
+    class EdgeCursor {
+    private:
+        std::vector<int> targetBuffer;
+        std::vector<uint32_t> meterBuffer;
+        const int* targetRow = nullptr;
+        const uint32_t* meterRow = nullptr;
+
+        void loadPacked(const CompactGraph& graph, int u);
+
+    public:
+        int begin = 0, rideEnd = 0, transferEnd = 0, end = 0;  // edge IDs, as edgeBegin() etc.
+
+        void load(const CompactGraph& graph, int u) {
+            begin = graph.offsets[u];
+            end = graph.offsets[u + 1];
+            if (graph.packed) {
+                loadPacked(graph, u);
+                return;
+            }
+            rideEnd = graph.rideEnd[u];
+            transferEnd = graph.transferEnd[u];
+            targetRow = graph.targets.data() + begin;
+            meterRow = graph.meters.data() + begin;
+        }
+        int target(int e) const { return targetRow[e - begin]; }
+        uint32_t meters(int e) const { return meterRow[e - begin]; }
+    };
+
+    int lineCount() const { return static_cast<int>(lineNames.size()); }
+    const std::string& lineName(int line) const { return lineNames[line]; }
+
+    // Approximate heap bytes held by the snapshot, and by its adjacency
+    // alone (offsets, group ends and per-edge data)
+    size_t memoryBytes() const;
+    size_t adjacencyBytes() const;
+
+    // Cheapest edge u -> v, or -1
+    int findEdge(int u, int v) const;
+
+    // Arrival states: the state reached over edge e, and each state's
+    // station and line (-1 when reached over a transfer or walk edge)
+    int stateCount() const { return static_cast<int>(stateStations.size()); }
+    int arrivalState(int e) const { return arrivalStates[e]; }
+    int stationOfState(int state) const { return stateStations[state]; }
+    int lineOfState(int state) const { return stateLines[state]; }
+
+    int zoneOf(int id) const { return zones[id]; }
+    double latitudeOf(int id) const { return latitudes[id]; }
+    double longitudeOf(int id) const { return longitudes[id]; }
+};
+
+// Per-thread scratch space for Dijkstra-style searches over a CompactGraph.
+// Arrays are sized once; between queries only the entries touched by the
+// previous query are reset, so a query costs O(settled) instead of O(V).
+struct SearchWorkspace {
+    static constexpr double UNREACHED = 1e18;
+
+    std::vector<double> dist;
+    std::vector<int> parent;
+    std::vector<char> settled;
+    std::vector<int> touched;
+    std::vector<std::pair<double, int>> heap;   // min-heap via std::push_heap/greater
+    CompactGraph::EdgeCursor edges;
+
+    // Per-station value written when a station is settled (e.g. max zone so
+    // far along the tree path); only meaningful for settled stations.
+    std::vector<int> aux;
+
+    // Scratch marks for callers (e.g. "is a target"); a mark is set when
+    // tags[v] == tag, so starting a fresh set is just newTag().
+    std::vector<unsigned> tags;
+    unsigned tag = 0;
+
+    // Size for a graph of n stations and clear the previous query's state
+    void prepare(int n);
+
+    // Set dist[v] = d, parent[v] = p and queue v (records v as touched)
+    void push(int v, double d, int p);
+
+    // Start a new, empty mark set
+    void newTag();
+
+    // Pop the closest unsettled station, or -1 when the heap is exhausted
+    int popMin();
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Graph.h"
+
+class CompactGraph;
+
+// Packed edge storage for a compressed CompactGraph (CompactGraph::compressed).
+// Station and edge IDs stay the same; only the encoding changes:
+//
+// - Targets: one block per station. A header byte holds the ride and
+//   transfer counts (4 bits each, 15 = varints follow), then the targets as
+//   zigzag deltas (from the station itself, then from the previous target)
+//   in Stream VByte form: 2-bit lengths, four per control byte, then the
+//   value bytes. Locality orders (StationOrder.h) keep most deltas to one
+//   byte. Blocks are decoded with SimdKernels::decodeStreamVByte.
+// - Lengths: 16-bit fixed point, meters >> shift, with the smallest shift
+//   that fits the longest edge (0, i.e. whole meters, on metro networks).
+// - Type and line: one 16-bit tag per edge, the line ID for rides.
+//
+// Per-edge length, type and line are O(1); a single target needs its
+// station's block decoded, so traversals read whole stations with
+// CompactGraph::EdgeCursor.
+class CompressedAdjacency {
+public:
+    static constexpr uint16_t TRANSFER = 0xFFFF;
+    static constexpr uint16_t WALK = 0xFFFE;
+    static constexpr int MAX_LINES = 0xFFFE;    // rides need a line ID below the tags
+    static constexpr size_t PADDING = 16;       // readable bytes after the last block
+
+private:
+    std::vector<uint32_t> blockOffsets;     // size() + 1 byte offsets into bytes
+    std::vector<uint8_t> bytes;
+    std::vector<uint16_t> lengths;          // per edge, meters >> shift
+    std::vector<uint16_t> tags;             // per edge: line ID, TRANSFER or WALK
+    unsigned shift = 0;
+
+    // Position of station u's Stream VByte controls; writes its group counts
+    const uint8_t* header(int u, int& rides, int& transfers) const;
+
+public:
+    // Encode the adjacency of a flat snapshot; nullptr if it has more lines
+    // than the tags can hold
+    static std::shared_ptr<const CompressedAdjacency> build(const CompactGraph& graph);
+
+    uint32_t meters(int e) const { return static_cast<uint32_t>(lengths[e]) << shift; }
+    EdgeType type(int e) const {
+        return tags[e] == TRANSFER ? EdgeType::Transfer : tags[e] == WALK ? EdgeType::Walk : EdgeType::Ride;
+    }
+    int line(int e) const { return tags[e] >= WALK ? -1 : tags[e]; }
+    unsigned getShift() const { return shift; }
+
+    // Rides and transfers leaving u (walks are the rest of its edges)
+    void groups(int u, int& rides, int& transfers) const { header(u, rides, transfers); }
+
+    // Decode the degree targets of station u into out (room for degree
+    // rounded up to 4), and their lengths into lengthsOut when given
+    void decode(int u, int degree, int firstEdge, int* out, uint32_t* lengthsOut) const;
+
+    // Target k of station u (decodes the block)
+    int target(int u, int degree, int k) const;
+
+    size_t memoryBytes() const;
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include "Graph.h"
+#include "ArtifactCache.h"
+
+// File loaders for data/stations.txt and data/connections.txt.
+// verbose prints progress to stdout (interactive mode); headless modes pass
+// false so stdout only carries query answers. Errors always go to stderr.
+bool loadStationsFromFile(Graph& graph, const std::string& filename, bool verbose = true);
+bool loadConnectionsFromFile(Graph& graph, const std::string& filename, bool verbose = true);
+
+// Load stations.txt, connections.txt and (optionally) fares.txt from dataDir
+bool loadNetwork(Graph& graph, const std::string& dataDir, bool verbose = true);
+
+// Write graph as stations.txt / connections.txt in dataDir (temporary files
+// renamed into place). Two-way links are written once; other links carry
+// their type and "oneway". Pass a graph without generated walking links, or
+// they become part of the data.
+bool saveNetwork(const Graph& graph, const std::string& dataDir);
+
+// Install graph's routing index (CompactGraph) from the artifact cache, or
+// build it now and let cache write it back on a background thread. Call once
+// the network is complete (walking links included). Returns true on a hit.
+bool loadRoutingIndex(Graph& graph, ArtifactCache& cache);
+
+// Install hub labels (HubLabels.h) from the cache, or build them now (slow
+// on large networks) and write them back in the background. Call after
+// loadRoutingIndex; labels in the cache match the cached routing index.
+bool loadHubLabels(Graph& graph, ArtifactCache& cache);
+
+// Parameter string for ArtifactCache covering settings that change the graph
+// or its routing index (the default order adds nothing, keeping older keys)
+std::string artifactParams(double walkKm, StationOrder order = StationOrder::Name);
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+#include "CompactGraph.h"
+
+class ThreadPool;
+
+// Batch shortest-path distances over a CompactGraph.
+// One-to-many runs a single Dijkstra per source and stops as soon as every
+// requested target is settled; many-to-many fans sources out over a ThreadPool
+// with one SearchWorkspace per worker. Unreachable pairs are reported as -1,
+// matching PathInfo::totalDistance.
+class DistanceMatrix {
+private:
+    std::vector<int> sources;
+    std::vector<int> targets;
+    std::vector<double> values;      // row-major: sources.size() x targets.size()
+
+public:
+    DistanceMatrix() = default;
+
+    // Distances from one source to each target (in target order)
+    static std::vector<double> oneToMany(const CompactGraph& graph, int source,
+                                         const std::vector<int>& targets,
+                                         SearchWorkspace& workspace);
+
+    // Dense sources x targets table, one Dijkstra per source run in parallel.
+    // Unknown station IDs (-1) produce rows/columns of -1.
+    static DistanceMatrix manyToMany(const CompactGraph& graph,
+                                     const std::vector<int>& sources,
+                                     const std::vector<int>& targets,
+                                     ThreadPool& pool);
+
+    // Convenience overload resolving station names through the graph
+    static DistanceMatrix manyToMany(const CompactGraph& graph,
+                                     const std::vector<std::string>& sourceNames,
+                                     const std::vector<std::string>& targetNames,
+                                     ThreadPool& pool);
+
+    size_t rows() const { return sources.size(); }
+    size_t cols() const { return targets.size(); }
+    double at(size_t row, size_t col) const { return values[row * targets.size() + col]; }
+    const std::vector<double>& data() const { return values; }
+
+    // CSV with a header row of target names and one row per source
+    void writeCSV(std::ostream& out, const CompactGraph& graph) const;
+
+    // Binary layout (little-endian host order):
+    //   "MRFDM1\0\0" | uint32 rows | uint32 cols | int32 sourceIds[rows] |
+    //   int32 targetIds[cols] | float64 values[rows*cols]
+    void writeBinary(std::ostream& out) const;
+};
@@ -1,25 +1,44 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <cstddef>
 
+// Single fare engine used by routing, the UI and batch jobs.
+// fare = base + distance * perKm + zoneCharge(maxZone), rounded to the rupee.
+// Rules default to the built-in tariff and can be replaced from data/fares.txt.
 class FareCalculator {
 private:
-    static constexpr double BASE_FARE = 5.0;        // Initial fare in rupees
-    static constexpr double COST_PER_KM = 0.8;      // Cost per km
-    static constexpr double ZONE_SURCHARGE = 3.0;   // Extra per zone crossed
+    double baseFare = 5.0;          // Initial fare in rupees
+    double costPerKm = 0.8;         // Cost per km
+    double zoneSurcharge = 3.0;     // Extra per zone, unless overridden below
+    std::vector<double> zoneCharges; // zoneCharges[z] = surcharge when max zone is z (from file)
 
 public:
     FareCalculator() = default;
-    
+
+    // Load fare rules (see data/DATA_INFO.md); keeps defaults for missing keys
+    bool loadFromFile(const std::string& filename);
+
+    // Rule accessors
+    double getBaseFare() const { return baseFare; }
+    double getCostPerKm() const { return costPerKm; }
+    double getZoneCharge(int maxZone) const;
+
     // Calculate fare based on distance and zones
     // Distance in km, maxZone is highest zone number in path
     int calculateFare(double distance, int maxZone) const;
-    
+
+    // Batch form over plain arrays (struct-of-arrays trip data):
+    // fares[i] = calculateFare(distances[i], maxZones[i]) for i in [0, count)
+    void calculateFares(const double* distances, const int* maxZones,
+                        int* fares, size_t count) const;
+
     // Get detailed fare breakdown
     std::string getFareBreakdown(double distance, int maxZone) const;
-    
+
     // Get round-trip fare
     int getRoundTripFare(double distance, int maxZone) const;
-    
+
     // Get fare category
     std::string getFareCategory(int fare) const;
 };
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Graph.h"
+#include "CompactGraph.h"
+
+class ThreadPool;
+
+// One origin-destination cell of a demand matrix (relative trip volume)
+struct DemandPair {
+    int origin;         // routing-index station IDs
+    int destination;
+    double weight;
+};
+
+// Totals of one simulation run. Flows are indexed by routing-index IDs.
+struct FlowReport {
+    uint64_t trips = 0;             // trips sampled
+    uint64_t routed = 0;            // trips with a route
+    double totalKm = 0;
+    double totalMinutes = 0;
+    uint64_t totalTransfers = 0;
+    double seconds = 0;             // wall time of the run
+
+    std::vector<uint64_t> edgeFlow;         // trips over each edge
+    std::vector<uint64_t> boardings;        // trips starting at each station
+    std::vector<uint64_t> alightings;       // trips ending at each station
+    std::vector<uint64_t> transfers;        // changes made at each station
+    std::vector<uint64_t> throughput;       // trips passing through, start and end included
+};
+
+// Monte Carlo load simulation on the routing engine: samples trips from a
+// demand matrix, routes each one with Graph::findRoute and adds up per-edge
+// and per-station flows. Trips are split into fixed chunks with their own
+// seeded generator, so results do not depend on the thread count; each pool
+// worker counts into its own arrays, merged once at the end.
+class FlowSimulator {
+public:
+    struct Options {
+        uint64_t trips = 1000000;
+        RouteCriterion criterion = RouteCriterion::Time;
+        uint64_t seed = 42;
+        size_t chunk = 4096;        // trips per task
+    };
+
+private:
+    const Graph& graph;
+    std::shared_ptr<const CompactGraph> index;
+    std::vector<DemandPair> demand;
+    std::vector<double> cumulative;     // running sum of demand weights (pair sampling)
+    std::vector<double> stationCumulative;  // gravity sampling when there is no matrix
+
+public:
+    explicit FlowSimulator(const Graph& graph);
+
+    // Replace the demand matrix (pairs with unknown stations or weight <= 0
+    // are dropped). Without one, origins and destinations are drawn
+    // independently in proportion to each station's edge count (a gravity
+    // model that loads interchanges more heavily).
+    void setDemand(const std::vector<DemandPair>& pairs);
+    size_t demandSize() const { return demand.size(); }
+
+    // Read "Origin,Destination,Trips" lines ('#' comments) into pairs;
+    // returns false if the file cannot be opened. Unknown stations are
+    // skipped with a warning on stderr.
+    bool loadDemand(const std::string& path, std::vector<DemandPair>& pairs) const;
+
+    FlowReport run(const Options& options, ThreadPool& pool) const;
+
+    const CompactGraph& getIndex() const { return *index; }
+
+    // Summary plus the top busiest segments and stations, as aligned text
+    void writeReport(std::ostream& out, const FlowReport& report, size_t top) const;
+
+    // Every edge with flow: "from,to,type,line,km,trips"
+    void writeEdgeCSV(std::ostream& out, const FlowReport& report) const;
+};
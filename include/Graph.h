@@ -4,28 +4,123 @@
 #include <unordered_map>
 #include <queue>
 #include <climits>
+#include <memory>
 #include "Station.h"
+#include "FareCalculator.h"
+#include "StationOrder.h"
+
+class CompactGraph;
+struct RouteResult;
+class HubLabels;
+class WeightOverlay;
+class HopGraph;
+class LineIndex;
+class MultiLevelOverlay;
+class ThreadPool;
+struct OverlayCustomization;
 
 // Forward declaration for helper functions
 inline void printHeader(const std::string& title);
 
+// Kind of link between two stations
+enum class EdgeType : unsigned char {
+    Ride,       // travel on a specific metro line
+    Transfer,   // in-station / interchange passage between lines
+    Walk        // street-level walk between nearby stations
+};
+
+// Directed adjacency record (from-station is the adjacency key)
+struct Edge {
+    std::string to;
+    double weight;          // km
+    EdgeType type;
+    const std::string* line;    // line ridden (pooled); "" for transfers and walks
+
+    const std::string& lineName() const { return *line; }
+};
+
+// What a route is optimized for (Graph::findRoute)
+enum class RouteCriterion {
+    Distance,   // km along the track
+    Time,       // train time + dwell + transfer penalties + walking time
+    Fare,       // rupees, same rules as Graph::findCheapestPath
+    Transfers,  // fewest changes, then shortest distance
+    Weighted    // perKm * km + perMinute * minutes + perTransfer * changes
+};
+
+// Parameters of the time and weighted cost models
+struct CostModel {
+    double rideKmh = 32.0;          // average train speed between stations
+    double dwellSeconds = 20.0;     // stop time added to every ride edge
+    double walkKmh = 4.5;           // walking speed on walk edges
+    double transferSeconds = 180.0; // penalty per transfer (waiting, stairs): a change of
+                                    // line, or a run of transfer / walk edges
+
+    double perKm = 1.0;             // weighted cost terms
+    double perMinute = 0.5;
+    double perTransfer = 5.0;
+
+    // Minutes spent on one edge of the given type and length, without the
+    // transfer penalty (routes add it once per transfer)
+    double edgeMinutes(EdgeType type, double km) const;
+};
+
 struct PathInfo {
     std::vector<std::string> path;
     std::vector<std::string> metroLines;
     double totalDistance;
     int estimatedFare;
     int transferPoints;
+    double travelMinutes = 0;   // CostModel estimate along the path
 };
 
 class Graph {
 private:
-    std::unordered_map<std::string, std::vector<std::pair<std::string, double>>> adjList;
+    std::unordered_map<std::string, std::vector<Edge>> adjList;
     std::unordered_map<std::string, Station> stations;
+    FareCalculator fareCalc;
+    CostModel costModel;
+
+    // CompactGraph snapshot for findRoute, built on first use and dropped
+    // whenever the network changes
+    mutable std::shared_ptr<const CompactGraph> routingIndex;
+
+    // Optional distance labels over routingIndex (HubLabels.h); installed by
+    // the caller, dropped with the routing index
+    std::shared_ptr<const HubLabels> hubLabels;
+
+    // Hop-count view of routingIndex (HopReachability.h), built on first use
+    mutable std::shared_ptr<const HopGraph> hopGraph;
+
+    // Line sequences of routingIndex (LineIndex.h), built on first use
+    mutable std::shared_ptr<const LineIndex> lineIndex;
+
+    // Cell overlays over routingIndex (MultiLevelOverlay.h), installed by
+    // the caller and dropped with it; one customized metric per criterion,
+    // redone by customizeOverlay, never by a query
+    std::shared_ptr<const MultiLevelOverlay> multiLevelOverlay;
+    mutable std::shared_ptr<const OverlayCustomization> overlayMetrics[5];
+
+    // Station numbering of routingIndex
+    StationOrder stationOrder = StationOrder::Name;
+
+    // Keep routingIndex with packed edges (CompactGraph::compressed)
+    bool compressedRouting = false;
+
+    // Live delays and closures read by findRoute (WeightOverlay.h), kept
+    // bound to the current routing index
+    std::shared_ptr<WeightOverlay> weightOverlay;
     
-    // Helper for Dijkstra
+    // Helpers for Dijkstra
+    double runDijkstra(const std::string& source, const std::string& destination, int zoneCap,
+                       std::unordered_map<std::string, std::string>& parent) const;
+    int maxZoneOnPath(const std::vector<std::string>& path) const;
     void reconstructPath(const std::unordered_map<std::string, std::string>& parent, 
-                        const std::string& destination, PathInfo& result);
-    std::string getCurrentLine(const std::string& from, const std::string& to);
+                        const std::string& destination, PathInfo& result) const;
+    void describePath(PathInfo& result) const;
+    bool hasEdgeTo(const std::string& from, const std::string& to) const;
+    void invalidateIndexes();
+    void dropOverlayMetrics() const;
 
 public:
     Graph() = default;
@@ -33,14 +128,109 @@ public:
     // Build graph
     void addStation(const std::string& name, const std::string& line, 
                    int zone, double lat = 0.0, double lon = 0.0);
+    // Undirected connection. Same-line stations get a Ride edge on that line;
+    // stations on different lines get a Transfer edge (an interchange link).
     void addEdge(const std::string& station1, const std::string& station2, double distance);
 
+    // One directed, typed edge (line is the line ridden, for Ride edges)
+    void addDirectedEdge(const std::string& from, const std::string& to, double distance,
+                         EdgeType type, const std::string& line = "");
+
+    // Undirected in-station transfer between two stations
+    void addTransfer(const std::string& station1, const std::string& station2, double distance);
+
+    // Add Walk edges (both directions) between stations within maxKm of each
+    // other that are not already connected; returns the number of pairs linked
+    int generateWalkingLinks(double maxKm);
+
     // Remove station and edge
     bool removeStation(const std::string& name);
     bool removeEdge(const std::string& station1, const std::string& station2);
     
     // Dijkstra's Algorithm - O((V+E)log V)
-    PathInfo findShortestPath(const std::string& source, const std::string& destination);
+    PathInfo findShortestPath(const std::string& source, const std::string& destination) const;
+
+    // Cheapest route by fare: per-km fare as edge cost, one Dijkstra per zone cap
+    PathInfo findCheapestPath(const std::string& source, const std::string& destination) const;
+
+    // Best route for a criterion, using the integer routing kernels
+    // (RouteKernel.h) over the CompactGraph snapshot
+    PathInfo findRoute(const std::string& source, const std::string& destination,
+                       RouteCriterion criterion) const;
+
+    // Same search into a caller-owned RouteResult (RouteResult.h), reusing its
+    // buffers; false when either station is unknown or there is no route
+    bool findRoute(const std::string& source, const std::string& destination,
+                   RouteCriterion criterion, RouteResult& result) const;
+
+    // By routing-index IDs; index must be getRoutingIndex() (or an equal
+    // snapshot) so the result's IDs can be resolved against it
+    bool findRoute(int source, int destination, RouteCriterion criterion,
+                   const CompactGraph& index, RouteResult& result) const;
+
+    // Speeds and weights for the time / weighted criteria and travelMinutes
+    void setCostModel(const CostModel& model);
+    const CostModel& getCostModel() const { return costModel; }
+
+    // Snapshot used by findRoute (built now if the network changed)
+    std::shared_ptr<const CompactGraph> getRoutingIndex() const;
+
+    // Install a prebuilt snapshot (e.g. from the artifact cache); it must
+    // describe this graph as it is now
+    void setRoutingIndex(std::shared_ptr<const CompactGraph> index);
+
+    // Station numbering for the routing index (StationOrder.h); changing it
+    // drops the current index and labels
+    void setStationOrder(StationOrder order);
+    StationOrder getStationOrder() const { return stationOrder; }
+
+    // Hold the routing index compressed (CompressedAdjacency.h): several
+    // times smaller edges for very large networks, decoded per station
+    // during searches. Changing it drops the current index and labels.
+    void setCompressedRouting(bool compressed);
+    bool isCompressedRouting() const { return compressedRouting; }
+
+    // Hub labels built from the routing index; once installed, findRoute by
+    // distance reads routes from the labels instead of searching
+    void setHubLabels(std::shared_ptr<const HubLabels> labels);
+    std::shared_ptr<const HubLabels> getHubLabels() const;   // nullptr if none
+
+    // Multi-level overlay built from the routing index; once installed,
+    // findRoute searches its cell cliques for a criterion once
+    // customizeOverlay has customized that metric (hub labels still answer
+    // distance first, line sequences transfers). Call it again, partition
+    // unchanged, after each batch of live conditions
+    // (WeightFeed::setBatchListener); until then, and after a cost-model
+    // change, routes search the index. Fare prices whole routes by zone and
+    // always searches the index (MultiLevelOverlay::supports).
+    void setMultiLevelOverlay(std::shared_ptr<const MultiLevelOverlay> overlay);
+    std::shared_ptr<const MultiLevelOverlay> getMultiLevelOverlay() const;  // nullptr if none
+
+    // Customize every supported criterion for the current live conditions,
+    // with cells split across the pool's workers (not from inside a pool
+    // task). One caller at a time; queries keep using the last metric until
+    // the new one is published.
+    void customizeOverlay(ThreadPool* pool = nullptr) const;
+
+    // Live conditions for findRoute: every criterion avoids closed edges, and
+    // time / weighted routes count delays and slow zones. Updates to the
+    // overlay take effect on the next query; nothing is rebuilt. While an
+    // edge is closed, distance routes search instead of using hub labels.
+    void setWeightOverlay(std::shared_ptr<WeightOverlay> overlay);
+    std::shared_ptr<WeightOverlay> getWeightOverlay() const;  // nullptr if none
+
+    // Fare rules used for PathInfo::estimatedFare
+    void setFareCalculator(const FareCalculator& calculator) { fareCalc = calculator; }
+    const FareCalculator& getFareCalculator() const { return fareCalc; }
+
+    // Unweighted view of the routing index for hop-count ("within N stops")
+    // queries; rebuilt when the routing index changes
+    std::shared_ptr<const HopGraph> getHopGraph() const;
+
+    // Ordered station sequences of every line with prefix-summed lengths;
+    // rebuilt when the routing index changes. findRoute answers same-line
+    // trips by transfers from it without a search.
+    std::shared_ptr<const LineIndex> getLineIndex() const;
 
     // BFS traversal from a station (returns order of visit)
     std::vector<std::string> bfs(const std::string& start) const;
@@ -65,26 +255,44 @@ public:
     const Station* getStation(const std::string& name) const;
     int getStationCount() const { return stations.size(); }
     int getEdgeCount() const;
+
+    // Approximate heap bytes held by the graph (maps, edges, strings, and the
+    // routing index if built); pooled line names are not included
+    size_t memoryBytes() const;
+
+    // Cheapest edge from one station to another (nullptr if not adjacent)
+    const Edge* getEdge(const std::string& from, const std::string& to) const;
     
     // Display methods
     void displayAllStations() const;
     void displayNetwork() const;
     void displayByMetroLine(const std::string& lineName) const;
     std::vector<std::string> getAllMetroLines() const;
+    // Stations ridden by a line in travel order: its longest sequence first,
+    // then stations only on branches; alphabetical if the line has no
+    // recovered sequence
     std::vector<std::string> getStationsByLine(const std::string& lineName) const;
+
+    // Every recovered sequence of a line (one per pair of terminals on a
+    // branched line), as station names in order
+    std::vector<std::vector<std::string>> getLineSequences(const std::string& lineName) const;
     
     // Getters for UI
     const std::unordered_map<std::string, Station>& getStations() const { return stations; }
+    const std::unordered_map<std::string, std::vector<Edge>>& getAdjacency() const { return adjList; }
 };
 
 /*
  * Additional Algorithms/DSA exposed:
- * - BFS, DFS traversals
+ * - BFS, DFS traversals; hop-count BFS over the routing index (HopReachability.h)
+ * - Line sequence recovery with prefix sums (LineIndex.h)
+ * - Inertial partitioning and customizable cell overlays (MultiLevelOverlay.h)
  * - All-paths search (backtracking)
  * - Cycle detection (DFS)
  * - Connected components (BFS/DFS)
  * - Minimum Spanning Tree (Prim's)
  * - Station/edge removal
+ * - Typed, directed edges (ride / transfer / walk) and walking-link generation
  *
  * See implementation in src/Graph.cpp
  */
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "CompactGraph.h"
+
+class ThreadPool;
+
+// Hop counts ("stops") from one station
+struct HopResult {
+    int source = -1;
+    std::vector<int> hops;          // per station ID; -1 if not reached within the limit
+    std::vector<int> levels;        // stations first reached at hop 0, 1, 2, ...
+    int topDownLevels = 0;          // how each level was expanded
+    int bottomUpLevels = 0;
+
+    int reached() const;
+};
+
+// Scratch space for one BFS at a time (bitmaps, frontiers, per-worker
+// buffers); sized on first use, reused across searches
+struct HopWorkspace {
+    std::unique_ptr<std::atomic<uint64_t>[]> visited;
+    std::vector<uint64_t> frontierBits;
+    std::vector<uint64_t> nextBits;
+    std::vector<int> frontier;
+    std::vector<std::vector<int>> localNext;    // per pool worker
+    std::vector<long long> localEdges;          // out-degree sums, per chunk
+    std::vector<int> localCounts;
+    std::vector<int> touched;       // stations visited top-down, cleared one by one
+    bool dirty = true;              // a bottom-up level ran: clear the bitmaps whole
+    size_t words = 0;
+
+    void prepare(int n, unsigned workers);
+};
+
+// Unweighted view of a routing index for hop-count queries: deduplicated
+// out- and in-neighbor CSR arrays (every edge is one hop, whatever its type).
+//
+// BFS is level-synchronous and direction-optimizing. Small frontiers are
+// expanded top-down (each frontier station claims its unvisited neighbors).
+// Once the frontier's edges outnumber a fraction of the unexplored edges,
+// levels run bottom-up instead: each unvisited station scans its
+// in-neighbors for one on the frontier bitmap and stops at the first hit,
+// which skips most edges in the middle levels of a wide search. Visited
+// sets are bitmaps. With a pool, large levels are split across workers;
+// the many-source calls run one search per worker instead, which keeps
+// every core busy on whole-network sweeps.
+class HopGraph {
+public:
+    static constexpr int UNLIMITED = -1;
+
+private:
+    std::shared_ptr<const CompactGraph> index;
+    std::vector<int> outOffsets, outTargets;
+    std::vector<int> inOffsets, inTargets;
+
+    void search(int source, int maxHops, HopWorkspace& ws, ThreadPool* pool,
+                int* hops, HopResult& result) const;
+    void topDown(int level, HopWorkspace& ws, ThreadPool* pool, int* hops,
+                 std::vector<int>& next, long long& nextEdges) const;
+    int bottomUp(int level, HopWorkspace& ws, ThreadPool* pool, int* hops, long long& nextEdges) const;
+
+public:
+    explicit HopGraph(std::shared_ptr<const CompactGraph> index);
+
+    const std::shared_ptr<const CompactGraph>& getIndex() const { return index; }
+    int size() const { return static_cast<int>(outOffsets.size()) - 1; }
+    long long edgeCount() const { return static_cast<long long>(outTargets.size()); }
+
+    // Hop counts from source, up to maxHops (UNLIMITED for all); levels are
+    // split across pool workers when one is given (not from inside a pool task)
+    HopResult distances(int source, int maxHops = UNLIMITED, ThreadPool* pool = nullptr) const;
+    HopResult distances(int source, int maxHops, HopWorkspace& workspace, ThreadPool* pool = nullptr) const;
+
+    // Accessibility sweep: for each source, how many stations are within
+    // 0, 1, ..., maxHops hops (cumulative, maxHops + 1 entries; one per
+    // level reached when UNLIMITED). One search per pool worker at a time;
+    // hop arrays are never materialized. Not from inside a pool task.
+    std::vector<std::vector<int>> reachCounts(const std::vector<int>& sources, int maxHops,
+                                              ThreadPool& pool) const;
+
+    size_t memoryBytes() const;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "CompactGraph.h"
+
+// Hub labeling (2-hop cover) over a CompactGraph for exact shortest
+// distances by track length, built with pruned landmark labeling.
+//
+// Stations are ranked by degree (interchanges first). Every station v keeps
+// an out-label (hub h, dist(v -> h)) and an in-label (hub h, dist(h -> v)),
+// both sorted by hub rank. dist(s, t) is the minimum of out(s)[h] + in(t)[h]
+// over common hubs: one linear merge of two short arrays, with no search and
+// no per-query scratch space. Hub ranks and distances are stored in separate
+// arrays, so the merge only walks the hub IDs until they match.
+//
+// Each label entry also stores the neighbouring station and edge toward the
+// hub, so routes are recovered one edge at a time (path()). Distances are
+// whole meters, the same metric as DistanceCost, so answers match
+// Graph::findRoute(RouteCriterion::Distance).
+class HubLabels {
+public:
+    static constexpr uint32_t UNREACHED = UINT32_MAX;
+
+private:
+    // Flattened labels: entries of station v are [offsets[v], offsets[v + 1])
+    struct LabelSet {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> hubs;     // hub rank, ascending within a station
+        std::vector<uint32_t> dists;    // meters
+        std::vector<int32_t> next;      // out: next station toward the hub; in: previous station from it
+        std::vector<int32_t> edges;     // edge between the station and next
+    };
+
+    int stations = 0;
+    int edgeCount = 0;
+    std::vector<int32_t> order;         // station at each rank
+    LabelSet out;
+    LabelSet in;
+
+    // Best common hub of out(s) and in(t): writes the entry positions
+    uint32_t merge(int s, int t, uint32_t& outPos, uint32_t& inPos) const;
+
+public:
+    // Cache artifact name and payload version (ArtifactCache)
+    static constexpr const char* ARTIFACT_NAME = "hub-labels";
+    static constexpr uint32_t ARTIFACT_VERSION = 1;
+
+    // Pruned landmark labeling, one forward and one backward pruned
+    // Dijkstra per station in rank order
+    static std::shared_ptr<const HubLabels> build(const CompactGraph& graph);
+
+    std::string serialize() const;
+    static std::shared_ptr<const HubLabels> deserialize(const unsigned char* data, size_t size);
+
+    // True if the labels were built from a snapshot of this shape
+    bool matches(const CompactGraph& graph) const {
+        return stations == graph.size() && edgeCount == graph.getEdgeCount();
+    }
+
+    // Shortest distance s -> t in meters, or UNREACHED
+    uint32_t distanceMeters(int s, int t) const;
+
+    // Shortest distance in km, -1 when unreachable (like PathInfo::totalDistance)
+    double distance(int s, int t) const;
+
+    // Stations and edges of a shortest route, written into the buffers;
+    // false when t is unreachable from s
+    bool path(int s, int t, std::vector<int>& stations, std::vector<int>& edges) const;
+
+    // Average entries per out-/in-label, and heap bytes
+    double averageLabelSize() const;
+    size_t memoryBytes() const;
+};
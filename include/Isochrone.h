@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "CompactGraph.h"
+#include "FareCalculator.h"
+
+class ThreadPool;
+
+// What an isochrone budget is measured in
+enum class BudgetKind {
+    Distance,   // km along the shortest route
+    Fare        // rupees, FareCalculator applied to the shortest route
+};
+
+// Stations whose cost is in (previous limit, limit]
+struct IsochroneBand {
+    double limit;
+    std::vector<int> stations;
+};
+
+struct IsochroneResult {
+    int source = -1;
+    std::vector<IsochroneBand> bands;   // same order as the requested limits
+};
+
+// Reachability queries: every station within a distance or fare budget,
+// grouped into bands (e.g. 5/10/15 km or ₹20/₹40). Built on a Dijkstra that
+// stops as soon as the frontier can no longer fit the largest budget.
+class Isochrone {
+public:
+    // Single source; limits must be ascending. Distance bands compare whole
+    // meters (CompactGraph::edgeMeters) against the limits rounded to meters,
+    // as the route kernels measure distance. Fare bands use the fare of the
+    // shortest-distance route, with the source zone as the lower bound used
+    // to stop the search.
+    static IsochroneResult compute(const CompactGraph& graph, int source,
+                                   const std::vector<double>& limits, BudgetKind kind,
+                                   const FareCalculator& fares, SearchWorkspace& workspace);
+
+    // Many sources at once (heatmaps); one workspace per pool worker
+    static std::vector<IsochroneResult> computeMany(const CompactGraph& graph,
+                                                    const std::vector<int>& sources,
+                                                    const std::vector<double>& limits,
+                                                    BudgetKind kind,
+                                                    const FareCalculator& fares,
+                                                    ThreadPool& pool);
+};
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "CompactGraph.h"
+
+// Ordered station sequences ("patterns") of every line in a routing index,
+// recovered from its ride edges, with prefix-summed track lengths.
+//
+// A line's rides form a path, a tree (branches), a ring, or something with
+// loops (a shortcut between two of its stations). A path gives one pattern;
+// a tree gives one pattern per pair of terminals (trunk + branch), so every
+// two stations of the line share a pattern; a ring gives one pattern that
+// wraps around. With loops, patterns are the shortest paths between
+// terminals, and the line counts as covered only if a check of every pair
+// of its stations finds their shortest ride on one of them.
+//
+// Each pattern keeps cumulative meters in both directions, so the distance
+// and stop count between two of its stations are two subtractions. Stations
+// list their (pattern, position) memberships, so a same-line query is a
+// short merge of two lists instead of a graph search. Lengths are whole
+// meters (CompactGraph::edgeMeters), the same metric as the route kernels.
+class LineIndex {
+public:
+    // One ride along a pattern: positions from -> to, in the given direction
+    struct Segment {
+        int pattern = -1;
+        int line = -1;
+        int from = 0;
+        int to = 0;
+        bool forward = true;
+        uint32_t meters = 0;
+        int stops = 0;
+
+        bool found() const { return pattern >= 0; }
+    };
+
+private:
+    struct Pattern {
+        int line;
+        bool ring;
+        bool forwardOk;     // every ride i -> i + 1 exists
+        bool backwardOk;    // every ride i + 1 -> i exists
+        uint32_t first;     // offset into the flattened arrays
+        int length;         // stations
+    };
+
+    std::shared_ptr<const CompactGraph> index;
+    std::vector<Pattern> patterns;
+    // Flattened, length + 1 entries per pattern. Entry i holds station i,
+    // the rides i -> i + 1 and i + 1 -> i, and the meters from station 0 to
+    // station i each way. On a ring, entry length closes the loop (station
+    // 0 again; its meters are the whole loop); elsewhere it is padding.
+    std::vector<int> stations;
+    std::vector<int> forwardEdges, backwardEdges;
+    std::vector<uint32_t> forwardMeters, backwardMeters;
+
+    // Memberships of station v: [memberOffsets[v], memberOffsets[v + 1])
+    std::vector<uint32_t> memberOffsets;
+    std::vector<int> memberPattern;
+    std::vector<int> memberPosition;
+
+    // Patterns are stored line by line: line l has [lineOffsets[l], lineOffsets[l + 1])
+    std::vector<uint32_t> lineOffsets;
+
+    // Stations on a line whose patterns do not give every shortest ride
+    std::vector<char> uncovered;
+
+    // Cheapest ride edge of one line between two stations (build only)
+    struct Ride {
+        int line;
+        int from;
+        int to;
+        uint32_t meters;
+        int edge;
+        bool operator<(const Ride& other) const;
+    };
+
+    // A line component with loops, to be checked once memberships exist;
+    // its rides are [begin, end) of the sorted ride list
+    struct Check {
+        int line;
+        size_t begin, end;
+        std::vector<int> stations;  // sorted
+    };
+
+    Segment ride(int pattern, int from, int to, bool forward) const;
+    Segment bestRide(int s, int t, int line) const;    // line -1: any
+    bool servesAllPairs(const Check& check, const std::vector<Ride>& rides) const;
+
+public:
+    explicit LineIndex(std::shared_ptr<const CompactGraph> index);
+
+    const std::shared_ptr<const CompactGraph>& getIndex() const { return index; }
+    int patternCount() const { return static_cast<int>(patterns.size()); }
+
+    // Shortest ride from s to t without changing line (any shared pattern,
+    // either direction on a ring); not found() when they share none
+    Segment sameLine(int s, int t) const;
+
+    // True if every line through v has patterns, so that sameLine(v, x) is
+    // the shortest ride among all single-line routes from v
+    bool covers(int v) const { return !uncovered[v]; }
+
+    // Stations and rides of a segment, into the buffers (source first)
+    void path(const Segment& segment, std::vector<int>& stationsOut, std::vector<int>& edgesOut) const;
+
+    // Patterns of a line by CompactGraph line ID, each as station IDs in order
+    std::vector<std::vector<int>> sequences(int line) const;
+
+    size_t memoryBytes() const;
+};
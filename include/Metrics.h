@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Query instrumentation: per-thread counters and log-linear latency
+// histograms (HDR-style, ~12% relative precision), summed on demand.
+// Disabled by default; when disabled every hook is one relaxed atomic load.
+// Build with -DMETRO_COUNT_ALLOCATIONS to also count heap allocations.
+enum class Counter : int {
+    RouteQueries,
+    NodesSettled,
+    EdgesRelaxed,
+    HeapPushes,
+    HeapPops,
+    SearchQueries,
+    StationsLoaded,
+    ConnectionsLoaded,
+    CacheHits,
+    CacheMisses,
+    RouteCacheHits,
+    RouteCacheMisses,
+    JournalRecords,
+    JournalSyncs,
+    Allocations,
+    COUNT
+};
+
+enum class Timer : int {
+    RouteQuery,
+    SearchQuery,
+    Load,
+    COUNT
+};
+
+// Log-linear histogram of nanosecond values. Written by one thread, read by
+// the exporter; relaxed load+store increments keep writers lock-free.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 3;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int MAX_MSB = 47;                                      // ~39 hours
+    static constexpr int BUCKETS = (MAX_MSB - SUB_BITS + 2) * SUB_BUCKETS;
+
+    std::atomic<uint64_t> counts[BUCKETS];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> sumNs;
+
+    LatencyHistogram();
+    void record(uint64_t ns);
+
+    static int bucketOf(uint64_t ns);
+    static uint64_t bucketUpperBound(int bucket);
+};
+
+// Totals across all threads at one point in time
+struct MetricsSnapshot {
+    uint64_t counters[static_cast<int>(Counter::COUNT)] = {};
+    uint64_t histograms[static_cast<int>(Timer::COUNT)][LatencyHistogram::BUCKETS] = {};
+    uint64_t timerCount[static_cast<int>(Timer::COUNT)] = {};
+    uint64_t timerSumNs[static_cast<int>(Timer::COUNT)] = {};
+
+    uint64_t get(Counter c) const { return counters[static_cast<int>(c)]; }
+    uint64_t count(Timer t) const { return timerCount[static_cast<int>(t)]; }
+
+    // Latency at quantile q (0..1) in nanoseconds, bucket upper bound
+    uint64_t percentileNs(Timer t, double q) const;
+};
+
+class Metrics {
+private:
+    static std::atomic<bool> enabledFlag;
+    static void addSlow(Counter c, uint64_t n);
+    static void recordSlow(Timer t, uint64_t ns);
+
+public:
+    static bool enabled() { return enabledFlag.load(std::memory_order_relaxed); }
+    static void setEnabled(bool on) { enabledFlag.store(on, std::memory_order_relaxed); }
+
+    static void add(Counter c, uint64_t n = 1) {
+        if (enabled()) addSlow(c, n);
+    }
+    static void recordLatency(Timer t, uint64_t ns) {
+        if (enabled()) recordSlow(t, ns);
+    }
+
+    static MetricsSnapshot snapshot();
+
+    // Prometheus text exposition format (counters + histograms)
+    static std::string prometheusText();
+
+    // One-line summary for logs
+    static std::string statsLine();
+
+    // Write statsLine() to out every intervalSeconds from a background thread
+    static void startPeriodicLog(std::ostream& out, int intervalSeconds);
+    static void stopPeriodicLog();
+
+    static const char* counterName(Counter c);
+    static const char* timerName(Timer t);
+};
+
+// Records the lifetime of the scope into a latency histogram
+class ScopedTimer {
+private:
+    Timer timer;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ScopedTimer(Timer t) : timer(t), active(Metrics::enabled()) {
+        if (active) start = std::chrono::steady_clock::now();
+    }
+    ~ScopedTimer() {
+        if (active) {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            Metrics::recordLatency(timer, static_cast<uint64_t>(ns));
+        }
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
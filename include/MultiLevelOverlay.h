@@ -0,0 +1,156 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "CompactGraph.h"
+
+class ThreadPool;
+class OverlayMetric;
+
+// Customizable route planning (CRP) over a CompactGraph: a metric-independent
+// multi-level partition, plus per-metric cell overlays (OverlayMetric) that
+// are cheap to recompute when costs change.
+//
+// Stations are split by recursive inertial bisection of their coordinates
+// (project onto the principal axis, cut at the median) until ranges hold at
+// most the smallest cell size; each larger cell size groups whole ranges,
+// so cells nest from level 1 (smallest) upward.
+//
+// Searches run over one of two node graphs on that partition. Distance
+// uses the stations and their edges. Criteria that charge line changes
+// (time, transfers, weighted) use the arrival states of the route kernels
+// (CompactGraph::arrivalState): a state's arcs are its station's edges,
+// each into the state it arrives in, and cost the edge plus the change it
+// makes from the state's line, so cliques carry changes at cell borders
+// exactly. A node is in its station's cells, and is a boundary node of its
+// cell at a level when one of its arcs, in or out, crosses to another cell
+// of that level.
+//
+// Customization gives every cell a clique: the cost between each pair of
+// its boundary nodes, found by searching the level below inside the cell
+// (base arcs at level 1; subcell cliques plus the arcs between subcells
+// above). Cells of one level are independent and run in parallel.
+//
+// A query is a bidirectional Dijkstra in which each node is expanded at the
+// highest level whose cell holds neither endpoint: its cell's clique row
+// plus the arcs leaving the cell, or every arc near the endpoints. Over
+// states it starts from the source station's edges, as the kernels' source
+// state does, and ends at any state of the target. Clique arcs on the
+// result are unpacked by repeating the cell search one level down. Costs
+// are the route kernels' keys (RouteKernel.h), so routes cost the same as
+// Graph::findRoute's searches.
+class MultiLevelOverlay {
+public:
+    static constexpr uint64_t UNREACHED = UINT64_MAX;
+
+private:
+    friend class OverlayMetric;
+
+    struct Level {
+        int cellSize;
+        int cells = 0;
+        std::vector<int> cellOf;                // per station
+    };
+
+    // Boundary nodes of one node graph at one level
+    struct Boundary {
+        std::vector<int> position;              // per node: index in its cell's boundary, -1 if inside
+        std::vector<uint32_t> offsets;          // cells + 1; boundary nodes of cell c are
+        std::vector<int> nodes;                 //   nodes[offsets[c], offsets[c + 1])
+        std::vector<size_t> cliqueOffsets;      // cells + 1; cell c's clique is count * count costs
+    };
+
+    // Stations and edges, or arrival states and the edges between them
+    struct Topology {
+        std::vector<int> stations;              // per node
+        std::vector<int> nodeOffsets;           // stations + 1; nodes of station u are [nodeOffsets[u], nodeOffsets[u + 1])
+        std::vector<int> outOffsets;            // nodes + 1; arcs leaving node v are [outOffsets[v], outOffsets[v + 1])
+        std::vector<int> heads, tails, edges;   // per arc: node it enters and leaves, edge it takes
+        std::vector<int> inOffsets, inArcs;     // arcs into each node
+        std::vector<Boundary> levels;           // levels[0] is level 1
+
+        int size() const { return static_cast<int>(stations.size()); }
+        size_t memoryBytes() const;
+    };
+
+    std::shared_ptr<const CompactGraph> index;
+    std::vector<Level> levels;                  // levels[0] is level 1
+    Topology stations, states;
+
+    struct Workspace;
+    struct Hop {
+        int from, to, arc;      // arc: arc ID, or -level for a clique arc
+    };
+
+    void bisect(std::vector<int>& order, size_t begin, size_t end, size_t parentSize,
+                const std::vector<double>& x, const std::vector<double>& y, std::vector<double>& key);
+    void buildBoundaries(Topology& graph) const;
+    const Topology& topology(RouteCriterion criterion) const;
+    int queryLevel(const Topology& graph, int v, int s, int t) const;
+    template <bool Forward, typename Relax>
+    void arcs(const OverlayMetric& metric, int level, int v, Relax&& relax) const;
+    void cellSearch(const OverlayMetric& metric, int level, int source, int target, Workspace& ws) const;
+    void customize(OverlayMetric& metric, ThreadPool* pool) const;
+    uint64_t search(const OverlayMetric& metric, int s, int t, std::vector<Hop>* hops, int* startEdge) const;
+    void unpack(const OverlayMetric& metric, const Hop& hop, Workspace& ws,
+                std::vector<int>& stations, std::vector<int>& edges) const;
+
+public:
+    // Level cell sizes (stations per cell); sizes that give a single cell,
+    // or the same cells as a smaller size, add no level
+    static std::vector<int> defaultCellSizes() { return {128, 1024, 8192}; }
+
+    explicit MultiLevelOverlay(std::shared_ptr<const CompactGraph> index,
+                               std::vector<int> cellSizes = defaultCellSizes());
+
+    const std::shared_ptr<const CompactGraph>& getIndex() const { return index; }
+    int levelCount() const { return static_cast<int>(levels.size()); }
+    int cellSize(int level) const { return levels[level - 1].cellSize; }     // level 1..levelCount()
+    int cellCount(int level) const { return levels[level - 1].cells; }
+    // Boundary stations, and boundary arrival states, of a level
+    int boundaryCount(int level) const { return static_cast<int>(stations.levels[level - 1].nodes.size()); }
+    int stateBoundaryCount(int level) const { return static_cast<int>(states.levels[level - 1].nodes.size()); }
+
+    // Criteria whose cost is a sum over arcs: distance, time, transfers and
+    // weighted. Fare is not: a route's fare depends on the highest zone it
+    // enters and is priced once per route (FareCalculator)
+    static bool supports(RouteCriterion criterion);
+
+    size_t memoryBytes() const;
+};
+
+// Arc costs and cell cliques of one criterion on a MultiLevelOverlay
+class OverlayMetric {
+private:
+    friend class MultiLevelOverlay;
+
+    std::shared_ptr<const MultiLevelOverlay> overlay;
+    RouteCriterion criterion = RouteCriterion::Distance;
+    const MultiLevelOverlay::Topology* graph = nullptr;     // the overlay's node graph for criterion
+    std::vector<uint64_t> arcCosts;                 // UNREACHED for closed edges
+    std::vector<uint64_t> startCosts;               // states: per edge, taken first from the source
+    std::vector<std::vector<uint64_t>> cliques;     // per level, cell by cell, row-major
+
+public:
+    // Costs of criterion under model, with live conditions when live is an
+    // overlay's words (WeightOverlay.h); cells of each level are customized
+    // in parallel on the pool when one is given (not from inside a pool
+    // task). nullptr if the criterion is not supported.
+    static std::shared_ptr<const OverlayMetric> customize(std::shared_ptr<const MultiLevelOverlay> overlay,
+                                                          RouteCriterion criterion, const CostModel& model,
+                                                          const std::atomic<uint32_t>* live = nullptr,
+                                                          ThreadPool* pool = nullptr);
+
+    const std::shared_ptr<const MultiLevelOverlay>& getOverlay() const { return overlay; }
+    RouteCriterion getCriterion() const { return criterion; }
+
+    // Cost of the best route s -> t in the criterion's kernel key, or UNREACHED
+    uint64_t cost(int s, int t) const;
+
+    // Stations and edges of the best route, written into the buffers
+    // (source first); false when t is unreachable from s
+    bool route(int s, int t, std::vector<int>& stations, std::vector<int>& edges) const;
+
+    size_t memoryBytes() const;
+};
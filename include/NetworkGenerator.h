@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include "Graph.h"
+
+// Synthetic metro networks for benchmarking (1k to 1M stations).
+//
+// Grid: half the lines run east-west and half north-south across a city
+// square; where two lines cross, their stations are joined by a short
+// interchange link. Radial: lines run outward from the centre and ring lines
+// circle it; each ring station is linked to the nearest radial station.
+// Station spacing is ~1 km with jitter, coordinates are around a city centre,
+// and zones grow with distance from the centre. The same seed always yields
+// the same network.
+enum class Topology { Grid, Radial };
+
+struct NetworkSpec {
+    Topology topology = Topology::Grid;
+    int stations = 1000;            // approximate target station count
+    unsigned seed = 42;
+    double centerLat = 28.6139;
+    double centerLon = 77.2090;
+};
+
+class NetworkGenerator {
+public:
+    // Populate an empty graph; returns the number of stations created
+    static int generate(Graph& graph, const NetworkSpec& spec);
+
+    // Write graph as stations.txt / connections.txt under dir (must exist)
+    static bool writeNetwork(const Graph& graph, const std::string& dir);
+
+    static bool parseTopology(const std::string& name, Topology& topology);
+};
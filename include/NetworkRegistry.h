@@ -0,0 +1,107 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include "Graph.h"
+#include "QueryEngine.h"
+#include "ArtifactCache.h"
+
+// One loaded network (city): its graph, query engine and artifact cache.
+// Immutable once published, so queries can share it without locks.
+struct Network {
+    std::string id;
+    Graph graph;
+    std::unique_ptr<QueryEngine> engine;
+    std::unique_ptr<ArtifactCache> cache;   // joins background artifact writes on eviction
+    size_t memoryBytes = 0;                 // estimate taken after loading
+};
+
+// Registry status of one network
+struct NetworkStatus {
+    std::string id;
+    std::string dataDir;
+    bool loaded;
+    bool pinned;
+    size_t memoryBytes;     // 0 while not loaded
+    uint64_t loads;         // times loaded (reloads after eviction included)
+    uint64_t queries;
+};
+
+// Many networks in one process. Networks are registered by ID with their data
+// directory and loaded on first use; the least recently used unpinned ones
+// are evicted when the resident set goes over the memory or count budget.
+// All networks share the caller's ThreadPool (via QueryServer) and
+// StringPool::shared(). Memory per network is estimated from the graph,
+// routing index and search snapshot (Graph/CompactGraph/SearchEngine
+// memoryBytes()).
+//
+// Requests name their network with a leading "@<id>|" field, e.g.
+// "@delhi|route|Rajiv Chowk|Yamuna Bank"; without one they go to the default
+// network. "networks" lists the registry status.
+class NetworkRegistry {
+public:
+    struct Options {
+        size_t maxResidentBytes = 0;    // 0 = unlimited
+        size_t maxResident = 0;         // networks kept loaded; 0 = unlimited
+        double walkKm = 0;              // walking links generated on load
+        bool hubLabels = false;         // load or build HubLabels per network
+        StationOrder order = StationOrder::Name;   // routing-index numbering
+        bool compressed = false;        // packed routing-index edges (Graph::setCompressedRouting)
+        bool multiLevel = false;        // partition for MultiLevelOverlay routes (customized at load)
+        size_t routeCacheEntries = 0;   // per-network RouteCache size; 0 = none
+    };
+
+private:
+    struct Entry {
+        std::string id;
+        std::string dataDir;
+        bool pinned = false;
+        std::mutex loadMutex;                       // one loader per network
+        std::shared_ptr<const Network> network;     // atomic_load / atomic_store
+        std::atomic<uint64_t> lastUsed{0};
+        std::atomic<uint64_t> loads{0};
+        std::atomic<uint64_t> queries{0};
+    };
+
+    Options options;
+    mutable std::shared_mutex entriesMutex;
+    std::map<std::string, std::unique_ptr<Entry>> entries;
+    std::string defaultId;
+    std::atomic<uint64_t> clock{0};
+
+    Entry* find(const std::string& id) const;
+    std::shared_ptr<const Network> load(Entry& entry) const;
+    void enforceBudget(const Entry* keep);
+
+public:
+    explicit NetworkRegistry(const Options& options);
+
+    // Register a network; the first one registered becomes the default.
+    // Pinned networks are never evicted. False if the ID is taken.
+    bool add(const std::string& id, const std::string& dataDir, bool pinned = false);
+
+    // Register every subdirectory of root that has a stations.txt, using the
+    // subdirectory name as the ID; returns how many were added
+    int addAll(const std::string& root);
+
+    void setDefault(const std::string& id) { defaultId = id; }
+    const std::string& getDefault() const { return defaultId; }
+
+    // Loaded network for id, loading it now if needed; nullptr if the ID is
+    // unknown or loading failed
+    std::shared_ptr<const Network> acquire(const std::string& id);
+
+    // Drop a loaded network (in-flight queries keep their reference)
+    bool evict(const std::string& id);
+
+    std::vector<NetworkStatus> status() const;
+    size_t residentBytes() const;
+
+    // QueryServer handler: strips an optional "@<id>|" and answers on that network
+    std::string answer(const std::string& request, ResponseFormat format);
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Graph.h"
+#include "SearchEngine.h"
+
+class RouteCache;
+
+// Answer encodings for the headless line protocol
+enum class ResponseFormat {
+    Json,       // one JSON object per line (default)
+    Text,       // "OK\t<field>\t<field>..." / "ERR\t<message>", lists joined by ';'
+    Binary      // uint32 little-endian length + Text payload (no newline)
+};
+
+// Stateless request handler for the headless protocol. One request per line,
+// fields separated by '|':
+//   route|<from>|<to>        shortest route by distance
+//   route|<from>|<to>|<c>    best route for criterion c: distance, time, fare,
+//                            transfers or weighted (Graph::findRoute)
+//   cheapest|<from>|<to>     cheapest route by fare
+//   distance|<from>|<to>     shortest distance only (from hub labels when loaded)
+//   table|<a;b;...>|<x;y;...>  shortest distances from each station of the
+//                            first list to each of the second, row by row
+//                            (-1 when unreachable; ShardCoordinator)
+//   isochrone|<station>|distance|<km;...>  stations reachable within each
+//   isochrone|<station>|fare|<rupees;...>  ascending band (Isochrone.h): band
+//                            limits, station count per band, names by band
+//   line|<from>|<to>         same-line ride: line, distance and stop count
+//                            (from the line index, no search)
+//   hops|<station>|<n>       stations within n stops, nearest first and by
+//                            name within a hop, with the count first
+//                            reached at each hop
+//   search|<keyword>         stations whose name contains keyword
+//   nearest|<lat>|<lon>      closest station to a coordinate
+//   fare|<km>|<maxZone>      fare for a trip
+//   fare|<km;...>|<zone;...> fares for many trips at once (calculateFares)
+//   ping                     liveness check
+//   stats                    one-line metrics summary (see Metrics.h)
+//   metrics                  Prometheus text dump as a string field
+//   format|json|text|binary  switch the answer encoding for later requests
+// All methods are const, so one engine can be shared by many worker threads.
+// With a route cache, route/cheapest/distance answers are kept per request
+// and format (RouteCache.h).
+class QueryEngine {
+private:
+    const Graph& graph;
+    SearchEngine search;
+    std::unique_ptr<RouteCache> routeCache;
+
+    std::string compute(const std::string& request, ResponseFormat format) const;
+
+public:
+    // routeCacheEntries > 0 keeps up to that many route answers
+    explicit QueryEngine(const Graph& graph, size_t routeCacheEntries = 0);
+    ~QueryEngine();
+
+    // Answer one request (without the trailing newline) in the given format.
+    // The returned string includes the line terminator for Json/Text.
+    std::string answer(const std::string& request, ResponseFormat format) const;
+
+    // If request is a valid "format|<name>", set format and return true.
+    // Transports call this before answer() since the format is per-connection.
+    static bool parseFormatCommand(const std::string& request, ResponseFormat& format);
+
+    // nullptr without a route cache
+    RouteCache* getRouteCache() const { return routeCache.get(); }
+
+    // Approximate heap bytes of the engine's own indexes (not the Graph)
+    size_t memoryBytes() const { return search.memoryBytes(); }
+
+    // Render an error / a single list field, for handlers layered on top
+    // of the engine (NetworkRegistry)
+    static std::string errorAnswer(const std::string& message, ResponseFormat format);
+    static std::string listAnswer(const std::string& key, const std::vector<std::string>& values,
+                                  ResponseFormat format);
+    // Number fields (three decimals) followed by list fields
+    static std::string fieldsAnswer(const std::vector<std::pair<std::string, double>>& numbers,
+                                    const std::vector<std::pair<std::string, std::vector<std::string>>>& lists,
+                                    ResponseFormat format);
+
+    // Split a request line on '|'
+    static std::vector<std::string> splitFields(const std::string& request);
+};
@@ -0,0 +1,101 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "QueryEngine.h"
+#include "QueryServer.h"
+
+class ThreadPool;
+
+// Kinds of recorded queries (the command of the request)
+enum class QueryKind : uint8_t {
+    Route = 1,      // route, cheapest, distance
+    Search = 2,
+    Nearest = 3,
+    Fare = 4
+};
+
+// One recorded query
+struct LoggedQuery {
+    uint64_t micros = 0;        // since the log was started
+    QueryKind kind = QueryKind::Route;
+    ResponseFormat format = ResponseFormat::Json;
+    std::string request;        // as received ("batch|" and "@<id>|" prefixes kept)
+};
+
+// Binary log of incoming queries, for replay (tools/replay.cpp) and for
+// pre-warming route caches on startup.
+//
+// File: "MRFQLOG1" | uint32 version | uint32 byte-order mark | uint64 start
+// (Unix microseconds), then one record per query:
+//   varint microseconds since the previous record | uint8 kind | uint8 format
+//   | varint length | request bytes
+// About 40 bytes per query. A record cut off by a crash ends the log.
+//
+// record() only appends to a buffer under a mutex (a clock read and a copy);
+// a writer thread empties the buffer every flushMillis. If the disk falls
+// behind by more than maxPendingBytes, records are dropped and counted
+// rather than slowing queries down. Starting a log truncates the file.
+class QueryLog {
+public:
+    struct Options {
+        unsigned flushMillis = 200;
+        size_t maxPendingBytes = 16 << 20;
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::string path;
+    Options options;
+    std::FILE* file = nullptr;
+    Clock::time_point start;
+
+    std::mutex pendingMutex;
+    std::condition_variable wake;
+    std::string pending;
+    uint64_t lastMicros = 0;
+    uint64_t recordedCount = 0;
+    uint64_t droppedCount = 0;
+    bool stopping = false;
+    std::thread writer;
+
+    void writerLoop();
+
+public:
+    explicit QueryLog(const std::string& path);
+    QueryLog(const std::string& path, const Options& options);
+    ~QueryLog();        // writes everything buffered
+
+    QueryLog(const QueryLog&) = delete;
+    QueryLog& operator=(const QueryLog&) = delete;
+
+    // False if the file could not be created (record() is then a no-op)
+    bool ok() const { return file != nullptr; }
+
+    // Append request if it is a recorded kind; other commands are ignored
+    void record(const std::string& request, ResponseFormat format);
+
+    uint64_t recorded();
+    uint64_t dropped();
+
+    // Kind of a request line ("batch|" and "@<id>|" prefixes skipped);
+    // false if not recorded
+    static bool kindOf(const std::string& request, QueryKind& kind);
+    static const char* kindName(QueryKind kind);
+
+    // All complete records of a log file; false if it is missing or not a query log
+    static bool read(const std::string& path, std::vector<LoggedQuery>& queries);
+
+    // Answer the `limit` most frequent distinct route requests of a log
+    // through handler, without their "batch|" prefix, so that route caches
+    // and lazily built indexes are warm before serving. Runs on pool when
+    // given (not from inside a pool task); returns the requests answered.
+    static size_t warm(const std::vector<LoggedQuery>& queries, size_t limit,
+                       const QueryServer::Handler& handler, ThreadPool* pool = nullptr);
+};
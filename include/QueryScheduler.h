@@ -0,0 +1,141 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "CancelToken.h"
+#include "QueryEngine.h"
+
+// Runs protocol requests for a handler (QueryEngine::answer, NetworkRegistry)
+// on its own workers so that one expensive query cannot starve the rest:
+//
+// - Deadlines: every query runs under a CancelToken (CancelToken.h) with the
+//   deadline of its priority class. Search loops poll it, and a query past
+//   its deadline answers "deadline exceeded" instead of a partial result.
+//   Queries whose deadline passes while still queued are not started.
+// - Priorities: a request prefixed with "batch|" is batch work; everything
+//   else is interactive. Each worker has an interactive and a batch deque;
+//   an idle worker takes its own interactive work, then steals interactive
+//   work from the others, and only then looks at batch work. At most
+//   batchWorkers workers run batch queries at once, so interactive queries
+//   always have a free worker.
+// - Coalescing: identical requests (same text, format and priority) that
+//   arrive while one is running share its answer instead of recomputing it.
+//
+// Cancellation: submit() returns a Ticket. Cancelling it answers that caller
+// with "cancelled" at once; the shared computation stops once every caller
+// waiting on it has cancelled.
+class QueryScheduler {
+public:
+    using Handler = std::function<std::string(const std::string& request, ResponseFormat format)>;
+    using Callback = std::function<void(std::string answer)>;
+
+    enum class Priority { Interactive, Batch };
+
+    struct Options {
+        unsigned threads = 0;                   // 0 = hardware concurrency
+        unsigned interactiveDeadlineMs = 2000;  // 0 = no deadline
+        unsigned batchDeadlineMs = 60000;
+        unsigned batchWorkers = 0;              // 0 = threads - 1 (at least 1)
+        bool coalesce = true;
+    };
+
+    // Counters since construction
+    struct Stats {
+        uint64_t completed = 0;     // computations run to the end
+        uint64_t coalesced = 0;     // requests answered by another request's computation
+        uint64_t expired = 0;       // computations stopped (or skipped) at their deadline
+        uint64_t cancelled = 0;     // requests cancelled by their caller
+        uint64_t stolen = 0;        // tasks run by a worker other than the one queued on
+    };
+
+    class Ticket;
+
+private:
+    struct Computation;
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::shared_ptr<Computation>> interactive;
+        std::deque<std::shared_ptr<Computation>> batch;
+    };
+
+    Handler handler;
+    Options options;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+
+    // Sleep/wake for idle workers; the queued counters cover all deques
+    std::mutex idleMutex;
+    std::condition_variable workReady;
+    std::condition_variable allDone;
+    std::atomic<size_t> queuedInteractive{0};
+    std::atomic<size_t> queuedBatch{0};
+    size_t outstanding = 0;             // queued or running computations; guarded by idleMutex
+    std::atomic<unsigned> runningBatch{0};
+    unsigned batchLimit = 1;
+    std::atomic<unsigned> nextQueue{0};
+    bool stopping = false;
+
+    // Requests being computed (or queued), by coalescing key
+    std::mutex inFlightMutex;
+    std::unordered_map<std::string, std::shared_ptr<Computation>> inFlight;
+
+    std::atomic<uint64_t> completed{0}, coalesced{0}, expired{0}, cancelled{0}, stolen{0};
+
+    void enqueue(const std::shared_ptr<Computation>& computation);
+    void workerLoop(unsigned index);
+    std::shared_ptr<Computation> take(unsigned index);
+    void execute(const std::shared_ptr<Computation>& computation);
+    void finish(const std::shared_ptr<Computation>& computation, const std::string& answer);
+    void cancel(Ticket& ticket);
+
+public:
+    explicit QueryScheduler(Handler handler);
+    QueryScheduler(Handler handler, const Options& options);
+    ~QueryScheduler();      // finishes queued work
+
+    QueryScheduler(const QueryScheduler&) = delete;
+    QueryScheduler& operator=(const QueryScheduler&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    // Queue a request; done(answer) runs on a worker thread (or, for a
+    // cancelled ticket, on the cancelling thread)
+    std::shared_ptr<Ticket> submit(const std::string& request, ResponseFormat format, Callback done);
+
+    // Submit and wait for the answer (not from inside a done() callback)
+    std::string answer(const std::string& request, ResponseFormat format);
+
+    // Block until every queued and running computation has finished
+    void wait();
+
+    Stats stats() const;
+
+    // Priority of a request line and the request without the "batch|" prefix
+    static Priority classify(const std::string& request, std::string& stripped);
+};
+
+// Handle for one submitted request
+class QueryScheduler::Ticket {
+private:
+    friend class QueryScheduler;
+    QueryScheduler* scheduler = nullptr;
+    std::shared_ptr<Computation> computation;
+    Callback done;
+    std::atomic<bool> answered{false};
+
+public:
+    // Answer "cancelled" now and stop the computation if nobody else waits on it
+    void cancel();
+
+    // True once done() has been called
+    bool isAnswered() const { return answered.load(); }
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include "QueryEngine.h"
+
+class ThreadPool;
+class QueryScheduler;
+class QueryLog;
+
+// Headless transports for QueryEngine (or any handler with the same
+// answer() contract, e.g. NetworkRegistry for many networks).
+//
+// serveStream: reads newline-delimited requests (e.g. stdin), answers every
+// line that is already buffered as one batch on the ThreadPool, and writes
+// the answers back in request order.
+//
+// serveSocket: event-driven (epoll) server on "tcp:<port>" (127.0.0.1) or
+// "unix:<path>". Clients may pipeline any number of requests; each
+// connection's pending lines are answered as a batch by a pool worker and
+// written back in order. Linux only; returns false elsewhere.
+//
+// Built on a QueryScheduler instead of a ThreadPool, each line is scheduled
+// on its own (deadlines, priorities, coalescing; see QueryScheduler.h);
+// answers still go back in request order, and a connection that fails
+// cancels its unanswered requests.
+class QueryServer {
+private:
+public:
+    // Answers one request line; must be safe to call from many threads
+    using Handler = std::function<std::string(const std::string& request, ResponseFormat format)>;
+
+private:
+    Handler handler;
+    ThreadPool* pool = nullptr;
+    QueryScheduler* scheduler = nullptr;
+    std::atomic<bool> stopRequested;
+    int wakeFd;
+    QueryLog* queryLog = nullptr;
+
+public:
+    QueryServer(const QueryEngine& engine, ThreadPool& pool);
+    QueryServer(Handler handler, ThreadPool& pool);
+    explicit QueryServer(QueryScheduler& scheduler);
+
+    // Returns the number of requests answered
+    size_t serveStream(std::istream& in, std::ostream& out);
+
+    // Blocks until stop() is called; false if the address cannot be bound
+    bool serveSocket(const std::string& address);
+
+    // Ask serveSocket to return (safe from any thread)
+    void stop();
+
+    // Record request lines to log as they are taken for answering (call
+    // before serving); the log must outlive the server
+    void setQueryLog(QueryLog* log) { queryLog = log; }
+
+    // Maximum lines answered per batch
+    static constexpr size_t MAX_BATCH = 256;
+
+    // Per-connection limits of the socket server. A line longer than
+    // MAX_LINE_BYTES, or more than MAX_PENDING_BYTES of unanswered requests,
+    // closes the connection. Requests wait while more than MAX_OUTPUT_BYTES
+    // of answers are unread, so a client that never reads hits the pending cap.
+    static constexpr size_t MAX_LINE_BYTES = 64 << 10;
+    static constexpr size_t MAX_PENDING_BYTES = 4 << 20;
+    static constexpr size_t MAX_OUTPUT_BYTES = 4 << 20;
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "QueryEngine.h"
+
+// Bounded cache of rendered route answers (route, cheapest, distance),
+// keyed by request line and format. Split into shards by key hash, each an
+// LRU list under its own mutex, so workers rarely wait on each other.
+//
+// Each entry carries the version it was computed under: the weight
+// overlay's batch count (WeightOverlay::batchCount), 0 without live
+// conditions. A lookup with a newer version misses and the entry is
+// replaced. The version is read before the answer is computed, so a batch
+// landing in between can only cost a miss, never serve a stale route.
+class RouteCache {
+private:
+    static constexpr size_t SHARDS = 16;
+
+    struct Entry {
+        std::string key;
+        uint64_t version;
+        std::string answer;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> lru;       // most recently used first
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+
+    size_t perShard;
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> missCount{0};
+
+    Shard& shardOf(const std::string& key) const;
+
+public:
+    // Holds at most `capacity` answers (at least one per shard)
+    explicit RouteCache(size_t capacity);
+
+    RouteCache(const RouteCache&) = delete;
+    RouteCache& operator=(const RouteCache&) = delete;
+
+    // Cache key of a request line in a format
+    static std::string key(const std::string& request, ResponseFormat format);
+
+    // Copy the answer for key into answer if present at this version
+    bool lookup(const std::string& key, uint64_t version, std::string& answer);
+    void insert(const std::string& key, uint64_t version, const std::string& answer);
+
+    size_t capacity() const { return perShard * SHARDS; }
+    size_t size() const;
+    uint64_t hits() const { return hitCount.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return missCount.load(std::memory_order_relaxed); }
+};
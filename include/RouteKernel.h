@@ -0,0 +1,188 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+#include "CompactGraph.h"
+
+// Cost policies. Each one fixes the heap key type and how one edge of each
+// type adds to it; the kernel relaxes rides, transfers and walks in separate
+// loops, so these calls inline to straight-line integer arithmetic.
+// Edge lengths come in as whole meters (CompactGraph::edgeMeters).
+// live(e, step) adjusts the step for live conditions on edge e, or returns
+// false when the edge is closed; the plain policies have none, and the call
+// compiles away (see LiveCost).
+//
+// Policies with LINE_CHANGES also charge change() for every change, counted
+// as describeRoute counts them: a ride on another line than the ride before
+// it, or the first transfer / walk edge of a run (also at the start of the
+// route). That depends on how a station was reached, so their searches run
+// over (station, arrival line) states rather than stations.
+
+// Key: meters
+struct DistanceCost {
+    using Key = uint32_t;
+    static constexpr bool LINE_CHANGES = false;
+    static bool allowed(int) { return true; }
+    static Key ride(uint32_t m) { return m; }
+    static Key transfer(uint32_t m) { return m; }
+    static Key walk(uint32_t m) { return m; }
+    static bool live(int, Key&) { return true; }
+};
+
+// Key: milliseconds. Rates are Q16 fixed-point ms per meter; transfers move
+// at train speed (interchange links carry track distance), walks on foot.
+// Each change adds the transfer penalty.
+struct TimeCost {
+    using Key = uint32_t;
+    static constexpr bool LINE_CHANGES = true;
+    uint32_t rideRate, walkRate, dwell, changeMs;
+    explicit TimeCost(const CostModel& model);
+    static bool allowed(int) { return true; }
+    Key ride(uint32_t m) const { return static_cast<Key>((uint64_t(m) * rideRate) >> 16) + dwell; }
+    Key transfer(uint32_t m) const { return static_cast<Key>((uint64_t(m) * rideRate) >> 16); }
+    Key walk(uint32_t m) const { return static_cast<Key>((uint64_t(m) * walkRate) >> 16); }
+    Key change() const { return changeMs; }
+    static bool live(int, Key&) { return true; }
+};
+
+// Key: meters, restricted to stations in zones <= zoneCap. The per-km part of
+// the fare is proportional to distance, so the cheapest route under a cap is
+// the shortest one; Graph::findRoute tries each cap and prices the result.
+struct FareCost {
+    using Key = uint32_t;
+    static constexpr bool LINE_CHANGES = false;
+    const CompactGraph* graph;
+    int zoneCap;
+    bool allowed(int v) const { return graph->zoneOf(v) <= zoneCap; }
+    static Key ride(uint32_t m) { return m; }
+    static Key transfer(uint32_t m) { return m; }
+    static Key walk(uint32_t m) { return m; }
+    static bool live(int, Key&) { return true; }
+};
+
+// Key: changes in the high 32 bits, meters in the low 32 bits (lexicographic)
+struct TransferCost {
+    using Key = uint64_t;
+    static constexpr bool LINE_CHANGES = true;
+    static constexpr Key CHANGE = Key(1) << 32;
+    static bool allowed(int) { return true; }
+    static Key ride(uint32_t m) { return m; }
+    static Key transfer(uint32_t m) { return m; }
+    static Key walk(uint32_t m) { return m; }
+    static Key change() { return CHANGE; }
+    static bool live(int, Key&) { return true; }
+};
+
+// Key: thousandths of a cost unit. Q16 rates per meter plus dwell per ride,
+// and the transfer penalty and perTransfer per change, as in TimeCost.
+// delay is the cost of one second of live delay (perSecond of LiveCost).
+struct WeightedCost {
+    using Key = uint64_t;
+    static constexpr bool LINE_CHANGES = true;
+    uint64_t rideRate, walkRate, dwell, changeCost, delay;
+    explicit WeightedCost(const CostModel& model);
+    static bool allowed(int) { return true; }
+    Key ride(uint32_t m) const { return ((uint64_t(m) * rideRate) >> 16) + dwell; }
+    Key transfer(uint32_t m) const { return ((uint64_t(m) * rideRate) >> 16); }
+    Key walk(uint32_t m) const { return ((uint64_t(m) * walkRate) >> 16); }
+    Key change() const { return changeCost; }
+    static bool live(int, Key&) { return true; }
+};
+
+// Key of a policy under live conditions. A delay of up to MAX_SECONDS
+// (WeightOverlay.h) adds over 65 million ms to one edge, so a few delayed
+// edges would wrap 32-bit time keys: live time searches use 64-bit keys.
+template <typename Cost>
+struct LiveKey {
+    using Type = typename Cost::Key;
+};
+
+template <>
+struct LiveKey<TimeCost> {
+    using Type = uint64_t;
+};
+
+// A policy plus live conditions from a WeightOverlay (WeightOverlay.h): one
+// relaxed load per edge, skipping closed edges and adding perSecond key
+// units for every extra second. Criteria that do not count time (distance,
+// fare, transfers) use perSecond = 0, so only closures change their routes.
+template <typename Cost>
+struct LiveCost : Cost {
+    using Key = typename LiveKey<Cost>::Type;
+    const std::atomic<uint32_t>* words;
+    Key perSecond;
+
+    LiveCost(const Cost& cost, const std::atomic<uint32_t>* words, Key perSecond)
+        : Cost(cost), words(words), perSecond(perSecond) {}
+
+    bool live(int e, Key& step) const {
+        uint32_t word = words[e].load(std::memory_order_relaxed);
+        if (word == 0) return true;
+        if (word == UINT32_MAX) return false;
+        step += static_cast<Key>(word) * perSecond;
+        return true;
+    }
+};
+
+// Heap entry for a key type. 32-bit keys are packed with the station into
+// one 64-bit integer, so heap comparisons are single integer compares.
+template <typename Key>
+struct HeapEntry {
+    using Type = std::pair<Key, int>;
+    static Type make(Key key, int v) { return {key, v}; }
+    static Key key(const Type& e) { return e.first; }
+    static int node(const Type& e) { return e.second; }
+};
+
+template <>
+struct HeapEntry<uint32_t> {
+    using Type = uint64_t;
+    static Type make(uint32_t key, int v) { return (uint64_t(key) << 32) | static_cast<uint32_t>(v); }
+    static uint32_t key(Type e) { return static_cast<uint32_t>(e >> 32); }
+    static int node(Type e) { return static_cast<int>(static_cast<uint32_t>(e)); }
+};
+
+// Per-thread scratch space for one key type; reset like SearchWorkspace.
+// Searches by station index the arrays by station. Line-aware searches
+// index them by arrival state (CompactGraph::arrivalState), plus one source
+// state after the graph's: parent is then the previous state, and via the
+// edge into the state (the source station for the source state). Keep
+// separate workspaces for the two, or each switch resizes the arrays.
+template <typename Key>
+struct KernelWorkspace {
+    static constexpr Key UNREACHED = std::numeric_limits<Key>::max();
+
+    std::vector<Key> dist;
+    std::vector<int> parent;       // previous station
+    std::vector<int> via;          // edge used to reach the station
+    std::vector<char> settled;
+    std::vector<int> touched;
+    std::vector<typename HeapEntry<Key>::Type> heap;
+    CompactGraph::EdgeCursor edges;
+    int found = -1;                // line-aware searches: the settled target state
+
+    void prepare(int n);
+};
+
+// Point-to-point Dijkstra specialized per cost policy. Explicitly
+// instantiated for the policies above in src/RouteKernel.cpp.
+class RouteKernel {
+public:
+    // Search from source until target is settled. Returns false when the
+    // target is unreachable; otherwise route() reads the route from ws.
+    template <typename Cost>
+    static bool run(const CompactGraph& graph, int source, int target, const Cost& cost,
+                    KernelWorkspace<typename Cost::Key>& ws);
+
+    // Stations (source first) and the edges between them of the route the
+    // last successful run() found to target
+    template <typename Key>
+    static void route(const CompactGraph& graph, const KernelWorkspace<Key>& ws, int target,
+                      std::vector<int>& stations, std::vector<int>& edges);
+
+    // Accepts distance|time|fare|transfers|weighted
+    static bool parseCriterion(const std::string& name, RouteCriterion& criterion);
+};
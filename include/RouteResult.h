@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Graph.h"
+
+class CompactGraph;
+
+// One stretch of a route: consecutive rides on one line, or a run of
+// transfer / walk edges between lines
+struct RouteLeg {
+    EdgeType type;
+    int line;           // CompactGraph line ID for rides, -1 otherwise
+    uint32_t from;      // positions in RouteResult::stations
+    uint32_t to;
+    double km;
+};
+
+// Compact route answer in routing-index (CompactGraph) IDs. No names are
+// copied: callers keep one RouteResult per thread and pass it to
+// Graph::findRoute again and again, so after warm-up a query allocates
+// nothing. Resolve names only when rendering (nameOf / lineName on the
+// index that produced the result).
+struct RouteResult {
+    std::vector<int> stations;          // station IDs, source first
+    std::vector<int> edges;             // edge taken between stations[i] and stations[i + 1]
+    std::vector<RouteLeg> legs;
+    std::vector<uint32_t> transfers;    // positions in stations where a change starts
+    double totalDistance = -1;          // km, -1 when there is no route
+    int estimatedFare = 0;
+    int transferPoints = 0;
+    double travelMinutes = 0;
+
+    bool found() const { return totalDistance >= 0; }
+
+    // Empty the result but keep the buffers' capacity
+    void clear();
+
+    // Distinct line IDs ridden, in travel order, appended to lines
+    void linesUsed(std::vector<int>& lines) const;
+
+    // Copy into the name-based PathInfo used by the menu and older callers
+    void toPathInfo(const Graph& graph, const CompactGraph& index, PathInfo& info) const;
+};
@@ -3,18 +3,33 @@
 #include <vector>
 #include <unordered_map>
 #include <algorithm>
+#include <cstdint>
 #include "Station.h"
 
+// Station search over a struct-of-arrays snapshot of the station map (sorted
+// names, lowercase name buffer, coordinates, zones, line IDs) scanned with
+// SimdKernels. Call refresh() after the station map changes.
 class SearchEngine {
 private:
     const std::unordered_map<std::string, Station>& stationDB;
-    
-    // Helper - case insensitive compare
-    static bool caseInsensitiveCompare(const std::string& str1, const std::string& str2);
-    static bool containsSubstring(const std::string& str, const std::string& substr);
+
+    std::vector<std::string> names;        // sorted; index = position in the arrays below
+    std::vector<char> lowerNames;          // lowercase names, NUL-separated, zero padded
+    std::vector<uint32_t> nameStarts;      // offset of each name in lowerNames
+    std::vector<double> latitudes;
+    std::vector<double> longitudes;
+    std::vector<int32_t> zones;
+    std::vector<int32_t> lineIds;
+    std::vector<std::string> lowerLines;   // lowercase line name per line ID
+
+    static std::string lowered(const std::string& text);
+    std::vector<std::string> namesAt(const uint32_t* indices, size_t count) const;
 
 public:
     explicit SearchEngine(const std::unordered_map<std::string, Station>& db);
+
+    // Rebuild the snapshot from the station map (after add/remove/reload)
+    void refresh();
     
     // Search by station name (partial match, case-insensitive)
     std::vector<std::string> searchByName(const std::string& keyword) const;
@@ -30,4 +45,14 @@ public:
     
     // Get nearest station by coordinates
     std::string getNearestStation(double latitude, double longitude) const;
+
+    // Bulk form for snapping many points: stations[i] = index of the station
+    // nearest to (latitudes[i], longitudes[i]) (see stationName), -1 if there
+    // are no stations. Large batches run on ThreadPool::shared().
+    void snapToStations(const double* latitudes, const double* longitudes, size_t count,
+                        int* stations) const;
+    const std::string& stationName(int index) const { return names[index]; }
+
+    // Approximate heap bytes held by the snapshot
+    size_t memoryBytes() const;
 };
@@ -0,0 +1,145 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Graph.h"
+#include "QueryEngine.h"
+
+// One network split into geographic shards, each served by its own process,
+// with a coordinator that answers routes across them.
+//
+// splitNetwork cuts the stations into balanced regions by recursive
+// inertial bisection of their coordinates and writes, under one directory:
+//   shard-<i>/stations.txt, connections.txt   one data directory per shard
+//                                             (its stations, the links between them)
+//   shards.txt    StationName,Shard
+//   cut.txt       Station1,Station2,Distance(km),Type: one-way links between
+//                 shards, Type as in connections.txt (TRANSFER, WALK or a line)
+// Each shard is an ordinary network: "metro --serve unix:DIR/shard-<i>.sock
+// --data DIR/shard-<i>". A station with a cut link is a boundary station of
+// its shard.
+//
+// ShardCoordinator (metro --shards DIR) connects to those sockets, fetches
+// each shard's boundary-to-boundary distance table once (table|...), and
+// joins the tables and cut links into a small boundary graph. A query asks
+// the source shard for its distances to its boundary, the target shard for
+// its boundary's distances to the target (and, in one shard, for the direct
+// route), then runs Dijkstra over the boundary graph. Routes are stitched
+// from per-shard routes between consecutive boundary stations.
+//
+// Distances are km by track length (the distance criterion). Stitched
+// routes carry distance, lines and path only: fare, transfers and minutes
+// depend on zones and on the edges on both sides of each cut, which the
+// coordinator does not see. lines joins each shard leg's lines and the lines
+// of cut rides; a leg without rides reports its first station's line, as a
+// route answer does. Requests that need other shards' stations or the
+// whole network (hops, table, cheapest, isochrone, nearest, other route
+// criteria, line between shards) are refused rather than answered from one
+// shard. Shards answer in the Text format, so station names must not contain
+// ';' or tabs.
+
+// Station-to-shard assignment and cut links of a split network
+struct ShardLayout {
+    struct Link {
+        std::string from;
+        std::string to;
+        double km;
+        EdgeType type;
+        std::string line;       // line ridden; "" for transfers and walks
+    };
+
+    int shards = 0;
+    std::unordered_map<std::string, int> shardOf;
+    std::vector<Link> cut;
+
+    // Reads shards.txt and cut.txt from dir; false if either is missing or malformed
+    static bool load(const std::string& dir, ShardLayout& layout);
+};
+
+// Split graph into `shards` regions and write the shard data directories and
+// layout files under outDir (created if needed). Pass a graph without
+// generated walking links, or they become part of the shards' data.
+bool splitNetwork(const Graph& graph, int shards, const std::string& outDir);
+
+// Socket path of shard i under a split directory
+std::string shardSocketPath(const std::string& dir, int shard);
+
+// Line-protocol connections to one shard process over a Unix socket. Each
+// call borrows an idle connection (or opens one), so calls from many
+// threads run in parallel.
+class ShardClient {
+private:
+    struct Connection {
+        int fd = -1;
+        std::string pending;    // bytes read past the last answer
+    };
+
+    std::string path;
+    std::mutex idleMutex;
+    std::vector<Connection> idle;      // connected, in Text format
+
+    bool open(Connection& connection) const;
+    bool exchange(const std::string& requests, const std::vector<ResponseFormat>& formats,
+                  std::vector<std::string>& answers);
+
+public:
+    explicit ShardClient(std::string socketPath);
+    ~ShardClient();
+
+    ShardClient(const ShardClient&) = delete;
+    ShardClient& operator=(const ShardClient&) = delete;
+
+    // Send one request and read its Text answer split on tabs ("OK" or
+    // "ERR" first); false if the shard cannot be reached
+    bool call(const std::string& request, std::vector<std::string>& fields);
+
+    // Send one request and return the shard's answer in the given format
+    bool forward(const std::string& request, ResponseFormat format, std::string& answer);
+};
+
+class ShardCoordinator {
+private:
+    ShardLayout layout;
+    std::vector<std::unique_ptr<ShardClient>> clients;
+
+    // Boundary graph: boundary stations 0..names.size()-1 with their shard,
+    // and arcs within a shard (table entries) or along a cut link
+    std::vector<std::string> names;
+    std::vector<int> shardOfNode;
+    std::unordered_map<std::string, int> nodeOf;
+    std::vector<std::vector<int>> boundaryOf;      // per shard, node IDs
+    std::vector<int> arcOffsets;
+    std::vector<int> arcTargets;
+    std::vector<double> arcKm;
+    std::vector<int> arcLink;       // index into layout.cut, -1 within a shard
+
+    struct Leg {
+        std::string from, to;
+        int shard;      // -1 for a cut link
+        int link;       // index into layout.cut for a cut link
+    };
+
+    bool table(int shard, const std::vector<std::string>& from, const std::vector<std::string>& to,
+               std::vector<double>& km);
+    // Best distance s -> t; legs gets the route's shard legs and cut links
+    // when given. -1 when there is no route, -2 when a shard is unreachable.
+    double shortest(const std::string& s, const std::string& t, std::vector<Leg>* legs);
+
+public:
+    // Read the layout and build the boundary graph from every shard's table;
+    // false (with a message on stderr) if a shard cannot be reached
+    bool connect(const std::string& dir);
+
+    int shardCount() const { return layout.shards; }
+    size_t boundaryCount() const { return names.size(); }
+
+    // QueryServer handler: distance|A|B and route|A|B[|distance] across
+    // shards, "shards" for the layout, search merged from every shard.
+    // Other requests go to the shard of the stations they name (shard 0 if
+    // none), and are refused when they name stations in several shards or
+    // their answer depends on the whole network.
+    std::string answer(const std::string& request, ResponseFormat format);
+};
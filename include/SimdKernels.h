@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Vectorized scans used by SearchEngine, and the adjacency decoder used by
+// compressed routing indexes (CompressedAdjacency.h). Each kernel has a portable scalar
+// version and, on x86-64 GCC/Clang builds, an AVX2 version compiled with a
+// function-level target attribute (no extra compiler flags needed). The
+// implementation is picked once at startup from the CPU; setting the
+// environment variable METRO_SIMD=scalar forces the scalar versions.
+class SimdKernels {
+public:
+    // "avx2" or "scalar"
+    static const char* isa();
+
+    // Index of the point closest to (lat, lon) by squared planar distance,
+    // first index on ties; -1 when count is 0
+    static long nearest(const double* lats, const double* lons, size_t count,
+                        double lat, double lon);
+
+    // Find every occurrence of needle (length >= 1) in haystack[0, size).
+    // haystack must be readable up to size + 32 bytes (zero padding). Calls
+    // onMatch with each match offset in increasing order and returns the
+    // number of matches. Byte-exact: lowercase both sides to ignore case.
+    static size_t findAll(const char* haystack, size_t size, const char* needle, size_t length,
+                          void (*onMatch)(size_t offset, void* context), void* context);
+
+    // out[i] = 1 when the NUL-terminated string at base + starts[i] begins
+    // with prefix, else 0. Each string must be readable for 32 bytes past
+    // its start (following strings or padding).
+    static void prefixMatch(const char* base, const uint32_t* starts, size_t count,
+                            const char* prefix, size_t length, unsigned char* out);
+
+    // Write the indices i with values[i] == key to out; returns how many
+    static size_t filterEqual(const int32_t* values, size_t count, int32_t key, uint32_t* out);
+
+    // ASCII lowercase of src[0, length) into dst
+    static void toLower(const char* src, size_t length, char* dst);
+
+    // Stream VByte: decode count 32-bit values. control holds each value's
+    // byte length minus one in 2 bits, four values per byte, low bits first;
+    // data holds the values' little-endian bytes back to back. data must be
+    // readable for 16 bytes past the encoded values and out must have room
+    // for count rounded up to a multiple of 4. Returns the data bytes used.
+    static size_t decodeStreamVByte(const uint8_t* control, const uint8_t* data, size_t count,
+                                    uint32_t* out);
+};
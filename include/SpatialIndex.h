@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Station.h"
+
+// Uniform latitude/longitude grid over a station map for radius queries.
+// Cells are roughly cellKm on a side (longitude scaled at the mean latitude).
+// Holds a reference to the station map; rebuild after the map changes.
+class SpatialIndex {
+private:
+    const std::unordered_map<std::string, Station>& stations;
+    std::unordered_map<long long, std::vector<std::string>> cells;
+    double cellKm;
+    double cellDegLat;
+    double cellDegLon;
+
+    long long cellKey(long long row, long long col) const { return (row << 32) ^ (col & 0xffffffffLL); }
+    long long rowOf(double lat) const;
+    long long colOf(double lon) const;
+
+public:
+    SpatialIndex(const std::unordered_map<std::string, Station>& stations, double cellKm);
+
+    // Stations within km of (lat, lon), including one at the exact point
+    std::vector<std::string> withinKm(double latitude, double longitude, double km) const;
+};
@@ -4,7 +4,7 @@
 class Station {
 private:
     std::string name;
-    std::string metroLine;
+    const std::string* metroLine;   // pooled (StringPool::shared())
     int zoneNumber;
     double latitude;
     double longitude;
@@ -16,11 +16,14 @@ public:
     
     // Getters
     const std::string& getName() const { return name; }
-    const std::string& getMetroLine() const { return metroLine; }
+    const std::string& getMetroLine() const { return *metroLine; }
     int getZone() const { return zoneNumber; }
     double getLatitude() const { return latitude; }
     double getLongitude() const { return longitude; }
     
+    // Great-circle distance to another station in km (haversine)
+    double distanceKmTo(const Station& other) const;
+    
     // Comparison operator for sorting
     bool operator<(const Station& other) const { 
         return name < other.name; 
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Graph;
+class CompactGraph;
+
+// How CompactGraph numbers stations. Dijkstra-family searches touch
+// dist/parent entries and edge ranges of neighbouring stations one after
+// another, so numbering stations that are close in the network close
+// together keeps those accesses on the same cache lines and pages.
+enum class StationOrder : uint8_t {
+    Name = 0,       // sorted station names (the default, and stable across tools)
+    Bfs = 1,        // reverse Cuthill-McKee: BFS from low-degree stations, neighbours by degree
+    Hilbert = 2,    // position along a Hilbert curve over latitude/longitude
+    Line = 3        // line by line, stations in ride order along each line
+};
+
+class StationOrdering {
+public:
+    // Station names in ID order for the given strategy; deterministic for a
+    // given network (ties fall back to name order)
+    static std::vector<std::string> arrange(const Graph& graph, StationOrder order);
+
+    // "name", "bfs" (or "rcm"), "hilbert", "line"
+    static bool parse(const std::string& name, StationOrder& order);
+    static const char* name(StationOrder order);
+
+    // Mean |u - v| over the edges u -> v: a cheap locality score, lower is better
+    static double averageEdgeSpan(const CompactGraph& graph);
+};
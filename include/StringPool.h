@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+// Process-wide interning of short, highly repeated strings (metro line
+// names). Each distinct value is stored once and its address stays valid for
+// the life of the pool, so Station and Edge keep a pointer instead of their
+// own copy, and networks loaded side by side (NetworkRegistry) share them.
+// Entries are never removed; only intern values from a small vocabulary.
+class StringPool {
+private:
+    mutable std::mutex mtx;
+    std::unordered_set<std::string> values;
+    size_t bytes = 0;
+
+public:
+    StringPool() = default;
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    // Stable reference to the pooled copy of value (thread-safe)
+    const std::string& intern(const std::string& value);
+
+    size_t size() const;
+
+    // Approximate heap bytes held by the pool
+    size_t memoryBytes() const;
+
+    // Pool used by Station and Graph
+    static StringPool& shared();
+
+    // Heap bytes owned by a std::string (0 while it fits the inline buffer);
+    // shared by the memoryBytes() estimates
+    static size_t heapBytes(const std::string& value) {
+        static const size_t inlineCapacity = std::string().capacity();
+        return value.capacity() > inlineCapacity ? value.capacity() + 1 : 0;
+    }
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed-size worker pool shared by the batch/parallel query engines.
+// Uses <thread>/<mutex>; build with -pthread on Linux.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable taskReady;
+    std::condition_variable allDone;
+    size_t active = 0;
+    bool stopping = false;
+
+    void workerLoop();
+
+public:
+    // threads == 0 uses std::thread::hardware_concurrency()
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    // Queue a task; returns immediately
+    void submit(std::function<void()> task);
+
+    // Block until the queue is empty and every worker is idle
+    void wait();
+
+    // Run body(index, worker) for index in [0, count), blocking until all are done.
+    // worker is in [0, size()) and is stable for one call, so it can select
+    // per-thread scratch space. Must not be called from inside a pool task.
+    void parallelFor(size_t count, const std::function<void(size_t index, unsigned worker)>& body);
+
+    // Process-wide pool sized to the machine
+    static ThreadPool& shared();
+};
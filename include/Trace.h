@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Scoped trace spans written as Chrome trace-event JSON (chrome://tracing,
+// Perfetto). Off until Trace::start(); each thread records into its own
+// lock-free ring buffer and a background thread drains them to the file.
+// Spans are dropped (and counted) if a ring fills faster than it is flushed.
+class Trace {
+private:
+    static std::atomic<bool> enabledFlag;
+
+public:
+    static bool enabled() { return enabledFlag.load(std::memory_order_relaxed); }
+
+    // Begin writing to path; false if the file cannot be opened
+    static bool start(const std::string& path);
+
+    // Flush remaining spans, close the JSON array and stop the writer thread
+    static void stop();
+
+    // Number of spans dropped because a ring buffer was full
+    static uint64_t dropped();
+
+    // Record a finished span (used by TraceSpan); name/category must be string literals
+    static void record(const char* name, const char* category, uint64_t startNs,
+                       uint64_t durationNs, const std::string& detail);
+
+    static uint64_t nowNs();
+};
+
+// RAII span: TraceSpan span("findShortestPath", "query", source + " -> " + destination);
+class TraceSpan {
+private:
+    const char* name;
+    const char* category;
+    std::string detail;
+    uint64_t startNs;
+    bool active;
+
+public:
+    TraceSpan(const char* spanName, const char* spanCategory)
+        : name(spanName), category(spanCategory), startNs(0), active(Trace::enabled()) {
+        if (active) startNs = Trace::nowNs();
+    }
+    TraceSpan(const char* spanName, const char* spanCategory, const std::string& spanDetail)
+        : name(spanName), category(spanCategory), startNs(0), active(Trace::enabled()) {
+        if (active) {
+            detail = spanDetail;
+            startNs = Trace::nowNs();
+        }
+    }
+    ~TraceSpan() {
+        if (active) Trace::record(name, category, startNs, Trace::nowNs() - startNs, detail);
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
@@ -0,0 +1,168 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "CompactGraph.h"
+
+// One live-conditions update, as written in a feed file (one per line):
+//   delay|<from>|<to>|<seconds>   extra seconds on every edge from -> to (0 clears)
+//   slow|<from>|<to>|<kmh>        slow zone: edges from -> to run at kmh (0 clears)
+//   close|<from>|<to>             edges from -> to cannot be used
+//   open|<from>|<to>              undo close
+//   clear|<from>|<to>             drop every condition on from -> to
+//   clear                         drop every condition
+struct WeightUpdate {
+    enum class Kind { Delay, Slow, Close, Open, Clear, ClearAll };
+    Kind kind;
+    std::string from;
+    std::string to;
+    double value = 0;
+
+    // Parse one feed line; false for blank, comment (#) or malformed lines
+    static bool parse(const std::string& line, WeightUpdate& update);
+};
+
+// Live edge conditions (delays, slow zones, closures) on top of a routing
+// index, read by Graph::findRoute on every query without rebuilding anything.
+//
+// Conditions are kept by station names and resolved into one 32-bit word per
+// CompactGraph edge ID: extra seconds, or CLOSED. Any preprocessing that
+// keeps the index's edge IDs works unchanged; bind() re-resolves the words
+// when the index is rebuilt.
+//
+// Readers never block or retry. The words are double-buffered: the writer
+// brings the table readers are not using up to date, applies the batch to
+// it and publishes it whole with std::atomic_store, so a published table
+// never changes and a query that holds one (View) sees exactly one batch.
+// The previous table becomes the spare for the next batch once no query
+// holds it; while one still does, the next batch copies into a new table.
+class WeightOverlay {
+public:
+    static constexpr uint32_t CLOSED = UINT32_MAX;
+    static constexpr uint32_t MAX_SECONDS = 65535;    // cap per edge; live time keys are 64-bit (LiveKey)
+
+private:
+    struct Condition {
+        uint32_t delaySeconds = 0;
+        double slowKmh = 0;
+        bool closed = false;
+    };
+
+    // Words for one routing index as of one batch; the index is held so its
+    // address cannot be reused by another snapshot while the words exist.
+    // Words stay atomics so LiveCost reads them as before.
+    struct Table {
+        std::shared_ptr<const CompactGraph> index;
+        std::unique_ptr<std::atomic<uint32_t>[]> words;
+        int closedEdges = 0;
+        size_t active = 0;          // conditions in force
+        uint64_t sequence = 0;      // batch the words reflect
+    };
+
+    CostModel model;    // speeds for slow-zone seconds
+    std::mutex writeMutex;
+    std::map<std::pair<std::string, std::string>, Condition> conditions;   // guarded by writeMutex
+    std::shared_ptr<const Table> table;     // published; std::atomic_load / atomic_store
+    std::shared_ptr<Table> spare;           // unpublished, same index; guarded by writeMutex
+    uint64_t sequence = 0;                  // guarded by writeMutex
+    std::atomic<uint64_t> batches{0};
+    std::atomic<size_t> active{0};          // conditions in force
+
+    uint32_t edgeWord(const CompactGraph& index, int e, const Condition& condition) const;
+    void resolve(Table& target, const std::pair<std::string, std::string>& pair,
+                 const Condition* condition) const;
+    std::shared_ptr<Table> copy(const Table& current);
+
+public:
+    explicit WeightOverlay(const CostModel& model = CostModel());
+
+    WeightOverlay(const WeightOverlay&) = delete;
+    WeightOverlay& operator=(const WeightOverlay&) = delete;
+
+    // Resolve the current conditions against a (new) routing index
+    void bind(std::shared_ptr<const CompactGraph> index);
+
+    // Apply a batch and publish it as one table; returns how many updates
+    // named known stations and changed something
+    size_t apply(const std::vector<WeightUpdate>& updates);
+
+    // The words of one batch, for one query; they do not change while held
+    class View {
+    private:
+        friend class WeightOverlay;
+        std::shared_ptr<const Table> table;
+
+    public:
+        explicit operator bool() const { return table != nullptr; }
+        // Sequence of the batch seen; views with the same one saw the same conditions
+        uint64_t getSequence() const { return table->sequence; }
+        const std::atomic<uint32_t>* words() const { return table->words.get(); }
+        bool hasClosures() const { return table->closedEdges > 0; }
+
+        // Extra seconds on edge e (0 if closed; closed edges are never on a route)
+        uint32_t seconds(int e) const {
+            uint32_t word = table->words[e].load(std::memory_order_relaxed);
+            return word == CLOSED ? 0 : word;
+        }
+    };
+
+    // Empty view unless the words were resolved for this index and some
+    // condition is in force
+    View view(const CompactGraph& index) const;
+
+    // Any edge of the bound index closed right now
+    bool hasClosures() const;
+
+    size_t conditionCount() const { return active.load(); }
+    uint64_t batchCount() const { return batches.load(); }
+};
+
+// Tails a feed file of WeightUpdate lines on a background thread. Writers
+// append lines; every interval the new complete lines are applied as one
+// batch. If the file shrinks (rewritten or truncated), conditions are
+// cleared and the file is read again from the start.
+class WeightFeed {
+private:
+    std::shared_ptr<WeightOverlay> overlay;
+    std::string path;
+    unsigned intervalMs;
+
+    std::thread poller;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    uint64_t offset = 0;
+    std::string partial;    // last line, not yet terminated
+    std::atomic<uint64_t> applied{0}, rejected{0};
+    std::function<void()> onBatch;
+
+    void run();
+    void poll();
+
+public:
+    WeightFeed(std::shared_ptr<WeightOverlay> overlay, const std::string& path, unsigned intervalMs = 1000);
+    ~WeightFeed();      // stops the thread
+
+    WeightFeed(const WeightFeed&) = delete;
+    WeightFeed& operator=(const WeightFeed&) = delete;
+
+    // Called on the polling thread after each batch is applied, e.g. to
+    // recustomize overlay metrics off the query path; set before start()
+    void setBatchListener(std::function<void()> listener) { onBatch = std::move(listener); }
+
+    // Read what the file holds now, then keep polling in the background
+    void start();
+    void stop();
+
+    uint64_t appliedCount() const { return applied.load(); }
+    uint64_t rejectedCount() const { return rejected.load(); }
+};
@@ -2,91 +2,28 @@
 #include <fstream>
 #include <sstream>
 #include <limits>
+#include <cstdlib>
+#include <memory>
 #include "Graph.h"
 #include "SearchEngine.h"
 #include "FareCalculator.h"
 #include "UI.h"
+#include "DataLoader.h"
+#include "QueryEngine.h"
+#include "QueryServer.h"
+#include "NetworkRegistry.h"
+#include "ChangeJournal.h"
+#include "QueryScheduler.h"
+#include "WeightOverlay.h"
+#include "MultiLevelOverlay.h"
+#include "ShardRouting.h"
+#include "QueryLog.h"
+#include "ThreadPool.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 using namespace std;
 
-// Load stations from file
-bool loadStationsFromFile(Graph& graph, const string& filename) {
-    ifstream file(filename);
-    
-    if (!file.is_open()) {
-        cout << "Error: Could not open " << filename << endl;
-        return false;
-    }
-    
-    string line;
-    int count = 0;
-    
-    cout << "Loading stations...\n";
-    
-    while (getline(file, line)) {
-        // Skip comments and empty lines
-        if (line.empty() || line[0] == '#') continue;
-        
-        // Parse: StationName,MetroLine,Zone,Latitude,Longitude
-        stringstream ss(line);
-        string station, line_name, zone_str, lat_str, lon_str;
-        
-        if (getline(ss, station, ',') && 
-            getline(ss, line_name, ',') &&
-            getline(ss, zone_str, ',') &&
-            getline(ss, lat_str, ',') &&
-            getline(ss, lon_str, ',')) {
-            
-            int zone = stoi(zone_str);
-            double lat = stod(lat_str);
-            double lon = stod(lon_str);
-            
-            graph.addStation(station, line_name, zone, lat, lon);
-            count++;
-        }
-    }
-    
-    file.close();
-    cout << "Loaded " << count << " stations.\n";
-    return count > 0;
-}
-
-// Load connections from file
-bool loadConnectionsFromFile(Graph& graph, const string& filename) {
-    ifstream file(filename);
-    
-    if (!file.is_open()) {
-        cout << "Error: Could not open " << filename << endl;
-        return false;
-    }
-    
-    string line;
-    int count = 0;
-    
-    cout << "Loading connections...\n";
-    
-    while (getline(file, line)) {
-        if (line.empty() || line[0] == '#') continue;
-        
-        // Parse: Station1,Station2,Distance
-        stringstream ss(line);
-        string station1, station2, distance_str;
-        
-        if (getline(ss, station1, ',') && 
-            getline(ss, station2, ',') &&
-            getline(ss, distance_str, ',')) {
-            
-            double distance = stod(distance_str);
-            graph.addEdge(station1, station2, distance);
-            count++;
-        }
-    }
-    
-    file.close();
-    cout << "Loaded " << count << " connections.\n";
-    return true;
-}
-
 void searchStationsMenu(Graph& graph, SearchEngine& search) {
     int choice;
     
@@ -139,18 +76,308 @@ void searchStationsMenu(Graph& graph, SearchEngine& search) {
     }
 }
 
-int main() {
+void printUsage(const char* program) {
+    cout << "Usage: " << program << " [--data DIR] [--stdin | --serve tcp:PORT|unix:PATH] [--threads N]\n"
+         << "       [--metrics] [--stats-interval SECONDS] [--trace FILE] [--walk-km KM] [--hub-labels]\n"
+         << "       [--order name|bfs|hilbert|line] [--deadline-ms MS] [--batch-deadline-ms MS]\n"
+         << "       [--live-feed FILE] [--compress] [--crp]\n"
+         << "       [--networks ROOT [--network ID] [--max-resident N] [--max-resident-mb MB]]\n"
+         << "       [--shards DIR] [--query-log FILE] [--route-cache N] [--warm-log FILE]\n"
+         << "  (no options)   interactive menu\n"
+         << "  --stdin        answer newline-delimited queries from stdin (see QueryEngine.h)\n"
+         << "  --serve ADDR   answer queries on a local TCP port or Unix socket\n"
+         << "  --metrics      enable query instrumentation (stats/metrics requests)\n"
+         << "  --stats-interval N  log a metrics summary line to stderr every N seconds\n"
+         << "  --trace FILE   write Chrome trace-event JSON for loads, index builds and queries\n"
+         << "  --walk-km KM   add walking links between stations up to KM apart\n"
+         << "  --order ORDER  station numbering of the routing index (see StationOrder.h)\n"
+         << "  --compress     headless: keep the routing index with packed edges (large networks)\n"
+         << "  --deadline-ms MS  headless: schedule queries with per-query deadlines, priorities\n"
+         << "                 and coalescing (see QueryScheduler.h); \"batch|<request>\" is batch\n"
+         << "                 work, limited by --batch-deadline-ms MS\n"
+         << "  --live-feed FILE  headless: follow delay/slow/close lines appended to FILE\n"
+         << "                 (see WeightOverlay.h) and route around live conditions\n"
+         << "  --hub-labels   headless: build (or load cached) hub labels for distance routes\n"
+         << "  --crp          headless: partition the network into nested cells and answer\n"
+         << "                 routes over customized cell overlays (see MultiLevelOverlay.h)\n"
+         << "  --networks ROOT  headless: serve every ROOT/<id>/ data directory, chosen per\n"
+         << "                 request with a leading @<id>| field (see NetworkRegistry.h)\n"
+         << "  --network ID   default network for requests without @<id>|\n"
+         << "  --max-resident N / --max-resident-mb MB  evict least recently used networks\n"
+         << "  --shards DIR   headless: coordinate the shard processes of a split network\n"
+         << "                 (tools/shard.cpp) and answer routes across them (see ShardRouting.h)\n"
+         << "  --query-log FILE  headless: record route/search/nearest/fare requests to a binary\n"
+         << "                 log (see QueryLog.h) for tools/replay.cpp\n"
+         << "  --route-cache N  headless: keep up to N route answers (see RouteCache.h)\n"
+         << "  --warm-log FILE  headless: answer a query log's most frequent routes before serving\n";
+}
+
+// Query log settings of the headless modes
+struct QueryCapture {
+    string logPath;         // --query-log
+    string warmPath;        // --warm-log
+    size_t warmLimit = 1000;
+};
+
+// Answer requests from stdin or a socket with handler, on a ThreadPool, or
+// on a QueryScheduler when scheduling options are given
+int serveRequests(const QueryServer::Handler& handler, const string& serveAddress, unsigned threads,
+                  const QueryScheduler::Options* scheduling, const string& banner, const string& detail,
+                  const QueryCapture& capture) {
+    if (!capture.warmPath.empty()) {
+        vector<LoggedQuery> queries;
+        if (QueryLog::read(capture.warmPath, queries)) {
+            size_t warmed = QueryLog::warm(queries, capture.warmLimit, handler, &ThreadPool::shared());
+            cerr << "Warmed " << warmed << " routes from " << capture.warmPath << "\n";
+        }
+    }
+    unique_ptr<QueryLog> queryLog;
+    if (!capture.logPath.empty()) queryLog.reset(new QueryLog(capture.logPath));
+
+    unique_ptr<ThreadPool> pool;
+    unique_ptr<QueryScheduler> scheduler;
+    unique_ptr<QueryServer> server;
+    unsigned workers;
+    if (scheduling) {
+        QueryScheduler::Options options = *scheduling;
+        options.threads = threads;
+        scheduler.reset(new QueryScheduler(handler, options));
+        server.reset(new QueryServer(*scheduler));
+        workers = scheduler->size();
+    } else {
+        pool.reset(new ThreadPool(threads));
+        server.reset(new QueryServer(handler, *pool));
+        workers = pool->size();
+    }
+    if (queryLog && queryLog->ok()) server->setQueryLog(queryLog.get());
+
+    bool ok = true;
+    if (serveAddress.empty()) {
+        ios::sync_with_stdio(false);
+        server->serveStream(cin, cout);
+    } else {
+        cerr << banner << " on " << serveAddress << " with " << workers << " workers" << detail << "\n";
+        ok = server->serveSocket(serveAddress);
+    }
+    if (scheduler) {
+        QueryScheduler::Stats stats = scheduler->stats();
+        cerr << "Scheduler: " << stats.completed << " completed, " << stats.coalesced << " coalesced, "
+             << stats.expired << " past deadline, " << stats.cancelled << " cancelled, "
+             << stats.stolen << " stolen\n";
+    }
+    if (queryLog && queryLog->ok()) {
+        cerr << "Query log: " << queryLog->recorded() << " recorded, " << queryLog->dropped() << " dropped\n";
+    }
+    return ok ? 0 : 1;
+}
+
+// Headless mode: load once, then answer queries until EOF or shutdown
+int runHeadless(const string& dataDir, const string& serveAddress, unsigned threads,
+                const NetworkRegistry::Options& options, const QueryScheduler::Options* scheduling,
+                const string& liveFeed, const QueryCapture& capture) {
+    Graph metro;
+    if (!loadNetwork(metro, dataDir, false)) {
+        cerr << "Failed to load network from " << dataDir << "\n";
+        return 1;
+    }
+    ChangeJournal::replay(dataDir, metro);
+    metro.generateWalkingLinks(options.walkKm);
+    metro.setStationOrder(options.order);
+    metro.setCompressedRouting(options.compressed);
+    ArtifactCache cache(dataDir, artifactParams(options.walkKm, options.order) + ChangeJournal::cacheKey(dataDir));
+    bool cached = loadRoutingIndex(metro, cache);
+    if (options.hubLabels) loadHubLabels(metro, cache);
+
+    unique_ptr<WeightFeed> feed;
+    if (!liveFeed.empty()) {
+        shared_ptr<WeightOverlay> overlay = make_shared<WeightOverlay>(metro.getCostModel());
+        metro.setWeightOverlay(overlay);
+        feed.reset(new WeightFeed(overlay, liveFeed));
+    }
+    if (options.multiLevel) {
+        metro.setMultiLevelOverlay(make_shared<const MultiLevelOverlay>(metro.getRoutingIndex()));
+        metro.customizeOverlay(&ThreadPool::shared());
+        // Each live batch is customized once, on the feed's thread, instead
+        // of by the queries that first see it
+        if (feed) feed->setBatchListener([&metro]() { metro.customizeOverlay(&ThreadPool::shared()); });
+    }
+    if (feed) feed->start();
+
+    QueryEngine engine(metro, options.routeCacheEntries);
+    return serveRequests([&engine](const string& request, ResponseFormat format) {
+        return engine.answer(request, format);
+    }, serveAddress, threads, scheduling, "Serving " + to_string(metro.getStationCount()) + " stations",
+       string(" (routing index ") + (cached ? "from cache" : "rebuilt") + ")", capture);
+}
+
+// Headless mode over many networks, loaded on demand
+int runRegistry(const string& root, const string& defaultId, const string& serveAddress,
+                unsigned threads, const NetworkRegistry::Options& options,
+                const QueryScheduler::Options* scheduling, const QueryCapture& capture) {
+    NetworkRegistry registry(options);
+    if (registry.addAll(root) == 0) {
+        cerr << "No networks (subdirectories with stations.txt) under " << root << "\n";
+        return 1;
+    }
+    if (!defaultId.empty()) registry.setDefault(defaultId);
+    if (!registry.acquire(registry.getDefault())) {
+        cerr << "Failed to load default network " << registry.getDefault() << "\n";
+        return 1;
+    }
+
+    return serveRequests([&registry](const string& request, ResponseFormat format) {
+        return registry.answer(request, format);
+    }, serveAddress, threads, scheduling,
+       "Serving " + to_string(registry.status().size()) + " networks (default " + registry.getDefault() + ")", "",
+       capture);
+}
+
+// Headless mode over a split network whose shards are already serving
+int runShards(const string& dir, const string& serveAddress, unsigned threads,
+              const QueryScheduler::Options* scheduling, const QueryCapture& capture) {
+    ShardCoordinator coordinator;
+    if (!coordinator.connect(dir)) return 1;
+    return serveRequests([&coordinator](const string& request, ResponseFormat format) {
+        return coordinator.answer(request, format);
+    }, serveAddress, threads, scheduling,
+       "Coordinating " + to_string(coordinator.shardCount()) + " shards",
+       " (" + to_string(coordinator.boundaryCount()) + " boundary stations)", capture);
+}
+
+int main(int argc, char* argv[]) {
+    string dataDir = "data";
+    string serveAddress;
+    bool headless = false;
+    unsigned threads = 0;
+    int statsInterval = 0;
+    double walkKm = 0;
+    string networksRoot;
+    string shardsDir;
+    QueryCapture capture;
+    string defaultNetwork;
+    string liveFeed;
+    NetworkRegistry::Options registryOptions;
+    QueryScheduler::Options scheduling;
+    bool scheduled = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--data" && i + 1 < argc) {
+            dataDir = argv[++i];
+        } else if (arg == "--stdin") {
+            headless = true;
+        } else if (arg == "--serve" && i + 1 < argc) {
+            headless = true;
+            serveAddress = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<unsigned>(stoul(argv[++i]));
+        } else if (arg == "--walk-km" && i + 1 < argc) {
+            walkKm = stod(argv[++i]);
+        } else if (arg == "--order" && i + 1 < argc) {
+            if (!StationOrdering::parse(argv[++i], registryOptions.order)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--live-feed" && i + 1 < argc) {
+            liveFeed = argv[++i];
+        } else if (arg == "--compress") {
+            registryOptions.compressed = true;
+        } else if (arg == "--hub-labels") {
+            registryOptions.hubLabels = true;
+        } else if (arg == "--crp") {
+            registryOptions.multiLevel = true;
+        } else if (arg == "--networks" && i + 1 < argc) {
+            networksRoot = argv[++i];
+        } else if (arg == "--shards" && i + 1 < argc) {
+            shardsDir = argv[++i];
+        } else if (arg == "--query-log" && i + 1 < argc) {
+            capture.logPath = argv[++i];
+        } else if (arg == "--warm-log" && i + 1 < argc) {
+            capture.warmPath = argv[++i];
+        } else if (arg == "--route-cache" && i + 1 < argc) {
+            registryOptions.routeCacheEntries = stoul(argv[++i]);
+        } else if (arg == "--network" && i + 1 < argc) {
+            defaultNetwork = argv[++i];
+        } else if (arg == "--max-resident" && i + 1 < argc) {
+            registryOptions.maxResident = stoul(argv[++i]);
+        } else if (arg == "--max-resident-mb" && i + 1 < argc) {
+            registryOptions.maxResidentBytes = stoul(argv[++i]) << 20;
+        } else if (arg == "--deadline-ms" && i + 1 < argc) {
+            scheduling.interactiveDeadlineMs = static_cast<unsigned>(stoul(argv[++i]));
+            scheduled = true;
+        } else if (arg == "--batch-deadline-ms" && i + 1 < argc) {
+            scheduling.batchDeadlineMs = static_cast<unsigned>(stoul(argv[++i]));
+            scheduled = true;
+        } else if (arg == "--metrics") {
+            Metrics::setEnabled(true);
+        } else if (arg == "--stats-interval" && i + 1 < argc) {
+            statsInterval = stoi(argv[++i]);
+            Metrics::setEnabled(true);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            if (!Trace::start(argv[++i])) {
+                cerr << "Error: cannot write trace file " << argv[i] << "\n";
+                return 1;
+            }
+            // The interactive menu exits from several places; close the JSON on any of them
+            atexit([] { Trace::stop(); });
+        } else {
+            printUsage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (!networksRoot.empty() && !headless) {
+        cerr << "--networks needs --stdin or --serve\n";
+        return 1;
+    }
+    if (!shardsDir.empty() && (!headless || !networksRoot.empty())) {
+        cerr << "--shards needs --stdin or --serve, without --networks\n";
+        return 1;
+    }
+    if (!liveFeed.empty() && (!headless || !networksRoot.empty() || !shardsDir.empty())) {
+        cerr << "--live-feed needs --stdin or --serve with a single network\n";
+        return 1;
+    }
+    if (headless) {
+        if (statsInterval > 0) Metrics::startPeriodicLog(cerr, statsInterval);
+        registryOptions.walkKm = walkKm;
+        if (registryOptions.routeCacheEntries > 0) capture.warmLimit = registryOptions.routeCacheEntries;
+        int status = !shardsDir.empty()
+            ? runShards(shardsDir, serveAddress, threads, scheduled ? &scheduling : nullptr, capture)
+            : networksRoot.empty()
+            ? runHeadless(dataDir, serveAddress, threads, registryOptions, scheduled ? &scheduling : nullptr,
+                          liveFeed, capture)
+            : runRegistry(networksRoot, defaultNetwork, serveAddress, threads, registryOptions,
+                          scheduled ? &scheduling : nullptr, capture);
+        Metrics::stopPeriodicLog();
+        Trace::stop();
+        return status;
+    }
+
     Graph metro;
     FareCalculator fareCalc;
 
     // Load data
-    if (!loadStationsFromFile(metro, "data/stations.txt")) {
+    if (!loadStationsFromFile(metro, dataDir + "/stations.txt")) {
         cout << "Failed to load stations!\n";
         return 1;
     }
-    if (!loadConnectionsFromFile(metro, "data/connections.txt")) {
+    if (!loadConnectionsFromFile(metro, dataDir + "/connections.txt")) {
         cout << "Warning: Could not load all connections.\n";
     }
+    if (!fareCalc.loadFromFile(dataDir + "/fares.txt")) {
+        cout << "Note: fares.txt not found, using default fare rules.\n";
+    }
+    metro.setFareCalculator(fareCalc);
+    size_t replayed = ChangeJournal::replay(dataDir, metro);
+    if (replayed > 0) cout << "Replayed " << replayed << " journaled admin edits.\n";
+    metro.generateWalkingLinks(walkKm);
+    metro.setStationOrder(registryOptions.order);
+    {
+        ArtifactCache cache(dataDir, artifactParams(walkKm, registryOptions.order) + ChangeJournal::cacheKey(dataDir));
+        loadRoutingIndex(metro, cache);
+    }
+
+    // Admin edits are journaled so they survive restarts (see ChangeJournal.h)
+    ChangeJournal journal(dataDir);
 
     SearchEngine search(metro.getStations());
     cout << "\n✓ Metro system loaded successfully!\n";
@@ -227,17 +454,31 @@ int main() {
                         continue;
                     }
                     cin.ignore(10000, '\n');
-                    metro.addStation(name, line, zone, lat, lon);
-                    cout << "✓ Station added: " << name << "\n";
+                    Change change = Change::addStation(name, line, zone, lat, lon);
+                    if (change.apply(metro)) {
+                        if (!journal.waitDurable(journal.append(change))) {
+                            cout << "Error: could not save the edit to " << ChangeJournal::pathFor(dataDir)
+                                 << "; it will be lost on restart.\n";
+                        }
+                        search.refresh();
+                        cout << "✓ Station added: " << name << "\n";
+                    } else {
+                        cout << "Station already exists!\n";
+                    }
                 } else if (adminChoice == 2) {
                     cout << "\n--- Delete Station ---\n";
                     metro.displayAllStations();
                     cout << "\nStation name to delete: ";
                     string delName;
                     getline(cin, delName);
-                    if (metro.hasStation(delName)) {
+                    Change change = Change::removeStation(delName);
+                    if (change.apply(metro)) {
+                        if (!journal.waitDurable(journal.append(change))) {
+                            cout << "Error: could not save the edit to " << ChangeJournal::pathFor(dataDir)
+                                 << "; it will be lost on restart.\n";
+                        }
+                        search.refresh();
                         cout << "✓ Station deleted: " << delName << "\n";
-                        cout << "(Note: Full deletion requires additional implementation)\n";
                     } else {
                         cout << "Station not found!\n";
                     }
@@ -258,8 +499,16 @@ int main() {
                         continue;
                     }
                     cin.ignore(10000, '\n');
-                    metro.addEdge(sta1, sta2, dist);
-                    cout << "✓ Connection added: " << sta1 << " <-> " << sta2 << "\n";
+                    Change change = Change::addConnection(sta1, sta2, dist);
+                    if (change.apply(metro)) {
+                        if (!journal.waitDurable(journal.append(change))) {
+                            cout << "Error: could not save the edit to " << ChangeJournal::pathFor(dataDir)
+                                 << "; it will be lost on restart.\n";
+                        }
+                        cout << "✓ Connection added: " << sta1 << " <-> " << sta2 << "\n";
+                    } else {
+                        cout << "Connection not added (unknown station or already connected)\n";
+                    }
                 } else if (adminChoice == 4) {
                     metro.displayAllStations();
                 } else if (adminChoice == 5) {
@@ -269,9 +518,26 @@ int main() {
                     UI::displayNetworkStats(metro.getStationCount(), metro.getEdgeCount(), lines);
                 } else if (adminChoice == 7) {
                     cout << "\nReloading data...\n";
+                    TraceSpan reloadSpan("reload", "reload", dataDir);
                     Graph newMetro;
-                    if (loadStationsFromFile(newMetro, "data/stations.txt") && loadConnectionsFromFile(newMetro, "data/connections.txt")) {
+                    newMetro.setFareCalculator(fareCalc);
+                    // Load after the journal is on disk and any compaction it started
+                    // has rewritten the text files
+                    bool saved = journal.flush();
+                    journal.waitCompaction();
+                    if (!saved) {
+                        cout << "Error: admin edits could not be saved to " << ChangeJournal::pathFor(dataDir)
+                             << "; keeping the current data.\n";
+                    } else if (loadStationsFromFile(newMetro, dataDir + "/stations.txt") && loadConnectionsFromFile(newMetro, dataDir + "/connections.txt")) {
+                        ChangeJournal::replay(dataDir, newMetro);
+                        newMetro.generateWalkingLinks(walkKm);
+                        newMetro.setStationOrder(registryOptions.order);
+                        ArtifactCache cache(dataDir, artifactParams(walkKm, registryOptions.order) +
+                                                         ChangeJournal::cacheKey(dataDir));
+                        loadRoutingIndex(newMetro, cache);
+                        TraceSpan swapSpan("reloadSwap", "reload");
                         metro = newMetro;
+                        search.refresh();
                         cout << "✓ Data reloaded successfully!\n";
                     } else {
                         cout << "Error reloading data!\n";
@@ -316,9 +582,26 @@ int main() {
                     UI::displayNetworkStats(metro.getStationCount(), metro.getEdgeCount(), lines);
                 } else if (userChoice == 5) {
                     cout << "\nReloading data...\n";
+                    TraceSpan reloadSpan("reload", "reload", dataDir);
                     Graph newMetro;
-                    if (loadStationsFromFile(newMetro, "data/stations.txt") && loadConnectionsFromFile(newMetro, "data/connections.txt")) {
+                    newMetro.setFareCalculator(fareCalc);
+                    // Load after the journal is on disk and any compaction it started
+                    // has rewritten the text files
+                    bool saved = journal.flush();
+                    journal.waitCompaction();
+                    if (!saved) {
+                        cout << "Error: admin edits could not be saved to " << ChangeJournal::pathFor(dataDir)
+                             << "; keeping the current data.\n";
+                    } else if (loadStationsFromFile(newMetro, dataDir + "/stations.txt") && loadConnectionsFromFile(newMetro, dataDir + "/connections.txt")) {
+                        ChangeJournal::replay(dataDir, newMetro);
+                        newMetro.generateWalkingLinks(walkKm);
+                        newMetro.setStationOrder(registryOptions.order);
+                        ArtifactCache cache(dataDir, artifactParams(walkKm, registryOptions.order) +
+                                                         ChangeJournal::cacheKey(dataDir));
+                        loadRoutingIndex(newMetro, cache);
+                        TraceSpan swapSpan("reloadSwap", "reload");
                         metro = newMetro;
+                        search.refresh();
                         cout << "✓ Data reloaded successfully!\n";
                     } else {
                         cout << "Error reloading data!\n";
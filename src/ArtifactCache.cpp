@@ -0,0 +1,199 @@
+#include "ArtifactCache.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define METRO_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char MAGIC[8] = {'M', 'R', 'F', 'A', 'R', 'T', '1', '\0'};
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct ArtifactHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t version;
+    uint64_t inputHash;
+    uint64_t payloadSize;
+    uint32_t byteOrder;
+    uint32_t reserved;
+};
+
+// Hash a whole file into seed; missing files hash as empty
+uint64_t hashFile(const std::string& path, uint64_t seed) {
+    std::ifstream in(path, std::ios::binary);
+    char chunk[1 << 16];
+    while (in) {
+        in.read(chunk, sizeof(chunk));
+        seed = ArtifactCache::fnv1a(chunk, static_cast<size_t>(in.gcount()), seed);
+    }
+    return seed;
+}
+
+bool headerMatches(const ArtifactHeader& header, uint32_t version, uint64_t hash, size_t fileSize) {
+    return std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+           header.format == ArtifactCache::FORMAT_VERSION &&
+           header.version == version &&
+           header.inputHash == hash &&
+           header.byteOrder == BYTE_ORDER_MARK &&
+           header.payloadSize == fileSize - sizeof(ArtifactHeader);
+}
+
+} // namespace
+
+MappedArtifact::~MappedArtifact() {
+#ifdef METRO_HAVE_MMAP
+    if (base != nullptr) munmap(base, mappedSize);
+#endif
+}
+
+uint64_t ArtifactCache::fnv1a(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        seed ^= bytes[i];
+        seed *= 1099511628211ULL;
+    }
+    return seed;
+}
+
+ArtifactCache::ArtifactCache(const std::string& dataDir, const std::string& params)
+    : directory(dataDir + "/cache") {
+    TraceSpan span("ArtifactCache::hashInputs", "cache", dataDir);
+    hash = hashFile(dataDir + "/stations.txt", fnv1a(nullptr, 0));
+    hash = hashFile(dataDir + "/connections.txt", hash);
+    hash = fnv1a(params.data(), params.size(), hash);
+}
+
+ArtifactCache::~ArtifactCache() {
+    wait();
+}
+
+std::string ArtifactCache::pathFor(const std::string& name) const {
+    std::ostringstream oss;
+    oss << directory << "/" << name << "-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+    return oss.str();
+}
+
+std::unique_ptr<MappedArtifact> ArtifactCache::open(const std::string& name, uint32_t version) const {
+    TraceSpan span("ArtifactCache::open", "cache", name);
+    std::string path = pathFor(name);
+    std::unique_ptr<MappedArtifact> artifact(new MappedArtifact());
+
+#ifdef METRO_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd >= 0 && fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(ArtifactHeader)) {
+        size_t size = static_cast<size_t>(info.st_size);
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            artifact->base = mapped;
+            artifact->mappedSize = size;
+        }
+    }
+    if (fd >= 0) ::close(fd);
+    const unsigned char* bytes = static_cast<const unsigned char*>(artifact->base);
+    size_t fileSize = artifact->mappedSize;
+#else
+    std::ifstream in(path, std::ios::binary);
+    artifact->buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    const unsigned char* bytes = artifact->buffer.data();
+    size_t fileSize = artifact->buffer.size();
+#endif
+
+    ArtifactHeader header;
+    if (fileSize >= sizeof(header)) {
+        std::memcpy(&header, bytes, sizeof(header));
+        if (headerMatches(header, version, hash, fileSize)) {
+            artifact->payload = bytes + sizeof(header);
+            artifact->payloadSize = fileSize - sizeof(header);
+            Metrics::add(Counter::CacheHits);
+            return artifact;
+        }
+    }
+    Metrics::add(Counter::CacheMisses);
+    return nullptr;
+}
+
+bool ArtifactCache::write(const std::string& name, uint32_t version, const std::string& payload) const {
+    TraceSpan span("ArtifactCache::write", "cache", name);
+    std::error_code error;
+    fs::create_directories(directory, error);
+
+    ArtifactHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.format = FORMAT_VERSION;
+    header.version = version;
+    header.inputHash = hash;
+    header.payloadSize = payload.size();
+    header.byteOrder = BYTE_ORDER_MARK;
+
+    std::string path = pathFor(name);
+    std::ostringstream tmpName;
+    tmpName << path << ".tmp." << std::this_thread::get_id() << "."
+            << std::chrono::steady_clock::now().time_since_epoch().count();
+    std::string tmp = tmpName.str();
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        if (!out) {
+            std::cerr << "Warning: could not write cache file " << tmp << "\n";
+            fs::remove(tmp, error);
+            return false;
+        }
+    }
+    fs::rename(tmp, path, error);
+    if (error) {
+        std::cerr << "Warning: could not install cache file " << path << "\n";
+        fs::remove(tmp, error);
+        return false;
+    }
+
+    // Drop artifacts of this name built from older inputs
+    std::string prefix = name + "-";
+    std::string current = fs::path(path).filename().string();
+    for (const auto& entry : fs::directory_iterator(directory, error)) {
+        std::string file = entry.path().filename().string();
+        if (file.compare(0, prefix.size(), prefix) == 0 && file != current &&
+            file.find(".tmp.") == std::string::npos &&
+            file.size() == prefix.size() + 16 + 4) {
+            fs::remove(entry.path(), error);
+        }
+    }
+    return true;
+}
+
+void ArtifactCache::writeAsync(const std::string& name, uint32_t version,
+                               std::function<std::string()> build) {
+    std::lock_guard<std::mutex> lock(writersMutex);
+    writers.emplace_back([this, name, version, build]() {
+        TraceSpan span("ArtifactCache::rebuild", "cache", name);
+        write(name, version, build());
+    });
+}
+
+void ArtifactCache::wait() {
+    std::vector<std::thread> running;
+    {
+        std::lock_guard<std::mutex> lock(writersMutex);
+        running.swap(writers);
+    }
+    for (auto& writer : running) {
+        writer.join();
+    }
+}
@@ -0,0 +1,146 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+CacheMissCounter::CacheMissCounter() {
+#ifdef __linux__
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+}
+
+CacheMissCounter::~CacheMissCounter() {
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#endif
+}
+
+void CacheMissCounter::start() {
+#ifdef __linux__
+    if (fd < 0) return;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+uint64_t CacheMissCounter::read() {
+    uint64_t count = 0;
+#ifdef __linux__
+    if (fd < 0) return 0;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (::read(fd, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count))) count = 0;
+#endif
+    return count;
+}
+
+BenchResult Benchmark::run(const std::string& name, size_t iterations,
+                           const std::function<void(size_t)>& op) {
+    BenchResult result;
+    result.name = name;
+    std::vector<uint64_t> samples;
+    samples.reserve(iterations);
+    thread_local CacheMissCounter misses;
+
+    misses.start();
+    auto wallStart = Clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        auto start = Clock::now();
+        op(i);
+        auto end = Clock::now();
+        samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+    double wall = std::chrono::duration<double>(Clock::now() - wallStart).count();
+    uint64_t missCount = misses.read();
+
+    summarize(samples, wall, result);
+    if (misses.available() && iterations > 0) {
+        result.cacheMissesPerOp = static_cast<double>(missCount) / iterations;
+    }
+    return result;
+}
+
+BenchResult Benchmark::runParallel(const std::string& name, size_t iterations, int threads,
+                                   const std::function<void(size_t)>& op) {
+    BenchResult result;
+    result.name = name;
+    result.threads = std::max(1, threads);
+
+    std::vector<std::vector<uint64_t>> perThread(result.threads);
+    std::atomic<size_t> next(0);
+
+    auto wallStart = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < result.threads; t++) {
+        workers.emplace_back([&, t] {
+            for (size_t i = next.fetch_add(1); i < iterations; i = next.fetch_add(1)) {
+                auto start = Clock::now();
+                op(i);
+                auto end = Clock::now();
+                perThread[t].push_back(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double wall = std::chrono::duration<double>(Clock::now() - wallStart).count();
+
+    std::vector<uint64_t> samples;
+    for (auto& v : perThread) samples.insert(samples.end(), v.begin(), v.end());
+    summarize(samples, wall, result);
+    return result;
+}
+
+void Benchmark::summarize(std::vector<uint64_t>& samplesNs, double wallSeconds, BenchResult& result) {
+    result.samples = samplesNs.size();
+    if (samplesNs.empty()) return;
+
+    std::sort(samplesNs.begin(), samplesNs.end());
+    auto percentile = [&](double p) {
+        size_t idx = static_cast<size_t>(p * (samplesNs.size() - 1) + 0.5);
+        return samplesNs[idx] / 1000.0;
+    };
+    double total = 0;
+    for (uint64_t s : samplesNs) total += s;
+
+    result.p50Us = percentile(0.50);
+    result.p90Us = percentile(0.90);
+    result.p99Us = percentile(0.99);
+    result.p999Us = percentile(0.999);
+    result.maxUs = samplesNs.back() / 1000.0;
+    result.meanUs = total / samplesNs.size() / 1000.0;
+    result.throughputPerSec = (wallSeconds > 0) ? samplesNs.size() / wallSeconds : 0;
+}
+
+void Benchmark::writeJson(std::ostream& out, const BenchResult& r) {
+    out << std::fixed << std::setprecision(3)
+        << "{\"bench\":\"" << r.name << "\""
+        << ",\"topology\":\"" << r.topology << "\""
+        << ",\"stations\":" << r.stations
+        << ",\"threads\":" << r.threads
+        << ",\"samples\":" << r.samples
+        << ",\"p50_us\":" << r.p50Us
+        << ",\"p90_us\":" << r.p90Us
+        << ",\"p99_us\":" << r.p99Us
+        << ",\"p999_us\":" << r.p999Us
+        << ",\"max_us\":" << r.maxUs
+        << ",\"mean_us\":" << r.meanUs
+        << ",\"throughput_per_s\":" << r.throughputPerSec;
+    if (r.cacheMissesPerOp >= 0) out << ",\"cache_misses_per_op\":" << r.cacheMissesPerOp;
+    for (const auto& value : r.extra) out << ",\"" << value.first << "\":" << value.second;
+    out << "}" << std::endl;
+}
@@ -0,0 +1,12 @@
+#include "CancelToken.h"
+
+thread_local CancelToken* CancelToken::active = nullptr;
+
+bool CancelToken::stopped() {
+    if (isCancelled()) return true;
+    if (deadline != Clock::time_point::max() && Clock::now() >= deadline) {
+        cancel();
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,428 @@
+#include "ChangeJournal.h"
+#include "ArtifactCache.h"
+#include "DataLoader.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <iomanip>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define METRO_HAVE_FSYNC 1
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char MAGIC[8] = {'M', 'R', 'F', 'J', 'R', 'N', '1', '\0'};
+const uint32_t FORMAT_VERSION = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+const size_t HEADER_SIZE = sizeof(MAGIC) + 2 * sizeof(uint32_t);
+const size_t RECORD_PREFIX = sizeof(uint32_t) + sizeof(uint64_t);   // length + checksum
+
+std::string encodeHeader() {
+    ArtifactWriter out;
+    out.str().append(MAGIC, sizeof(MAGIC));
+    out.put(FORMAT_VERSION);
+    out.put(BYTE_ORDER_MARK);
+    return std::move(out.str());
+}
+
+bool headerValid(const std::string& bytes) {
+    if (bytes.size() < HEADER_SIZE || bytes.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0) {
+        return false;
+    }
+    ArtifactReader in(reinterpret_cast<const unsigned char*>(bytes.data()) + sizeof(MAGIC),
+                      HEADER_SIZE - sizeof(MAGIC));
+    uint32_t format = 0, byteOrder = 0;
+    in.get(format);
+    in.get(byteOrder);
+    return in.ok() && format == FORMAT_VERSION && byteOrder == BYTE_ORDER_MARK;
+}
+
+// Record: uint32 payload length | uint64 FNV-1a of payload | payload
+void encodeRecord(const Change& change, std::string& out) {
+    ArtifactWriter payload;
+    payload.put(static_cast<uint8_t>(change.type));
+    payload.putString(change.station);
+    payload.putString(change.other);
+    payload.put(static_cast<int32_t>(change.zone));
+    payload.put(change.latitude);
+    payload.put(change.longitude);
+    payload.put(change.km);
+    const std::string& body = payload.str();
+
+    ArtifactWriter record;
+    record.put(static_cast<uint32_t>(body.size()));
+    record.put(ArtifactCache::fnv1a(body.data(), body.size()));
+    out += record.str();
+    out += body;
+}
+
+bool decodeRecord(const unsigned char* data, size_t size, Change& change) {
+    ArtifactReader in(data, size);
+    uint8_t type = 0;
+    int32_t zone = 0;
+    in.get(type);
+    in.getString(change.station);
+    in.getString(change.other);
+    in.get(zone);
+    in.get(change.latitude);
+    in.get(change.longitude);
+    in.get(change.km);
+    change.type = static_cast<ChangeType>(type);
+    change.zone = zone;
+    return in.atEnd() && type >= 1 && type <= 4;
+}
+
+// Walk the records after the header, calling onRecord for each valid one.
+// Returns the offset just past the last valid record.
+template <typename OnRecord>
+size_t scanRecords(const std::string& bytes, size_t begin, size_t end, OnRecord onRecord) {
+    const unsigned char* base = reinterpret_cast<const unsigned char*>(bytes.data());
+    size_t pos = begin;
+    while (end - pos >= RECORD_PREFIX) {
+        ArtifactReader prefix(base + pos, RECORD_PREFIX);
+        uint32_t length = 0;
+        uint64_t checksum = 0;
+        prefix.get(length);
+        prefix.get(checksum);
+        if (end - pos - RECORD_PREFIX < length) break;
+        const unsigned char* payload = base + pos + RECORD_PREFIX;
+        Change change;
+        if (ArtifactCache::fnv1a(payload, length) != checksum || !decodeRecord(payload, length, change)) break;
+        onRecord(change);
+        pos += RECORD_PREFIX + length;
+    }
+    return pos;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+bool syncFile(std::FILE* file) {
+    if (std::fflush(file) != 0) return false;
+#ifdef METRO_HAVE_FSYNC
+    return fsync(fileno(file)) == 0;
+#else
+    return true;
+#endif
+}
+
+} // namespace
+
+Change Change::addStation(const std::string& name, const std::string& line, int zone,
+                          double lat, double lon) {
+    Change change;
+    change.type = ChangeType::AddStation;
+    change.station = name;
+    change.other = line;
+    change.zone = zone;
+    change.latitude = lat;
+    change.longitude = lon;
+    return change;
+}
+
+Change Change::addConnection(const std::string& a, const std::string& b, double km) {
+    Change change;
+    change.type = ChangeType::AddConnection;
+    change.station = a;
+    change.other = b;
+    change.km = km;
+    return change;
+}
+
+Change Change::removeStation(const std::string& name) {
+    Change change;
+    change.type = ChangeType::RemoveStation;
+    change.station = name;
+    return change;
+}
+
+Change Change::removeConnection(const std::string& a, const std::string& b) {
+    Change change;
+    change.type = ChangeType::RemoveConnection;
+    change.station = a;
+    change.other = b;
+    return change;
+}
+
+bool Change::apply(Graph& graph) const {
+    switch (type) {
+        case ChangeType::AddStation:
+            if (graph.hasStation(station)) return false;
+            graph.addStation(station, other, zone, latitude, longitude);
+            return true;
+        case ChangeType::AddConnection: {
+            if (!graph.hasStation(station) || !graph.hasStation(other)) return false;
+            // An identical link already there means this change was applied
+            for (const auto& edge : graph.getAdjacency().at(station)) {
+                if (edge.to == other && edge.type != EdgeType::Walk && edge.weight == km) return false;
+            }
+            graph.addEdge(station, other, km);
+            return true;
+        }
+        case ChangeType::RemoveStation:
+            return graph.removeStation(station);
+        case ChangeType::RemoveConnection:
+            return graph.removeEdge(station, other);
+    }
+    return false;
+}
+
+ChangeJournal::ChangeJournal(const std::string& dir) : ChangeJournal(dir, Options()) {}
+
+ChangeJournal::ChangeJournal(const std::string& dir, const Options& opts)
+    : dataDir(dir), path(pathFor(dir)), options(opts) {
+    openForAppend();
+    writer = std::thread([this]() { writerLoop(); });
+}
+
+ChangeJournal::~ChangeJournal() {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        stopping = true;
+    }
+    pendingReady.notify_all();
+    writer.join();
+    waitCompaction();
+    if (file != nullptr) std::fclose(file);
+}
+
+std::string ChangeJournal::pathFor(const std::string& dir) {
+    return dir + "/journal.bin";
+}
+
+// Validate the existing file, cut off a torn tail, count its records
+bool ChangeJournal::openForAppend() {
+    std::string bytes = readFile(path);
+    std::error_code error;
+    if (!bytes.empty() && !headerValid(bytes)) {
+        std::cerr << "Warning: " << path << " is not a journal; moved to " << path << ".corrupt\n";
+        fs::rename(path, path + ".corrupt", error);
+        bytes.clear();
+    }
+    if (bytes.empty()) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << encodeHeader();
+        if (!out) {
+            std::cerr << "Warning: cannot create " << path << "; admin edits will not persist\n";
+            return false;
+        }
+    } else {
+        fileRecords = 0;
+        size_t valid = scanRecords(bytes, HEADER_SIZE, bytes.size(), [&](const Change&) { fileRecords++; });
+        if (valid < bytes.size()) {
+            std::cerr << "Warning: dropping " << bytes.size() - valid << " torn bytes at the end of " << path << "\n";
+            fs::resize_file(path, valid, error);
+        }
+    }
+    file = std::fopen(path.c_str(), "ab");
+    return file != nullptr;
+}
+
+uint64_t ChangeJournal::append(const Change& change) {
+    std::string record;
+    encodeRecord(change, record);
+    uint64_t seq;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pending += record;
+        pendingRecords++;
+        seq = ++appendedSeq;
+    }
+    pendingReady.notify_one();
+    Metrics::add(Counter::JournalRecords);
+    return seq;
+}
+
+bool ChangeJournal::waitDurable(uint64_t seq) {
+    std::unique_lock<std::mutex> lock(pendingMutex);
+    durable.wait(lock, [&]() { return durableSeq >= seq || (stopping && pending.empty()); });
+    return durableSeq >= seq && (failedSeq == 0 || seq < failedSeq);
+}
+
+bool ChangeJournal::flush() {
+    uint64_t seq;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        seq = appendedSeq;
+    }
+    return waitDurable(seq);
+}
+
+void ChangeJournal::writerLoop() {
+    std::unique_lock<std::mutex> lock(pendingMutex);
+    while (true) {
+        pendingReady.wait(lock, [&]() { return stopping || !pending.empty(); });
+        if (pending.empty()) break;     // stopping with nothing left
+
+        // Group commit: let more records join this write
+        if (!stopping && options.groupCommitMicros > 0) {
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::microseconds(options.groupCommitMicros));
+            lock.lock();
+        }
+        std::string batch;
+        batch.swap(pending);
+        size_t records = pendingRecords;
+        pendingRecords = 0;
+        uint64_t from = durableSeq + 1;
+        uint64_t upTo = appendedSeq;
+        lock.unlock();
+
+        bool compactDue = false;
+        bool failed = false;
+        {
+            std::lock_guard<std::mutex> fileLock(fileMutex);
+            TraceSpan span("ChangeJournal::commit", "journal", std::to_string(records) + " records");
+            if (file != nullptr) {
+                bool written = std::fwrite(batch.data(), 1, batch.size(), file) == batch.size();
+                failed = !written || (options.sync ? !syncFile(file) : std::fflush(file) != 0);
+                Metrics::add(Counter::JournalSyncs);
+            } else {
+                failed = true;
+            }
+            fileRecords += records;
+            compactDue = options.compactRecords > 0 && fileRecords >= options.compactRecords;
+        }
+
+        lock.lock();
+        if (failed && failedSeq == 0) {
+            std::cerr << "Warning: journal write to " << path << " failed; later admin edits will not persist\n";
+            failedSeq = from;
+        }
+        durableSeq = upTo;
+        // Mark the compaction before waking waiters, so flush() + waitCompaction() sees it
+        bool launch = compactDue && !compacting && !stopping && failedSeq == 0;
+        if (launch) compacting = true;
+        durable.notify_all();
+        if (launch) {
+            lock.unlock();
+            launchCompaction();
+            lock.lock();
+        }
+    }
+    durable.notify_all();
+}
+
+void ChangeJournal::launchCompaction() {
+    std::lock_guard<std::mutex> lock(compactorMutex);
+    if (compactor.joinable()) compactor.join();     // the previous one has finished
+    compactor = std::thread([this]() {
+        compact();
+        std::lock_guard<std::mutex> pendingLock(pendingMutex);
+        compacting = false;
+        compacted.notify_all();
+    });
+}
+
+void ChangeJournal::compactNow() {
+    if (!flush()) return;       // a torn record would end the fold early
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (compacting) return;
+        compacting = true;
+    }
+    launchCompaction();
+}
+
+void ChangeJournal::waitCompaction() {
+    {
+        std::unique_lock<std::mutex> lock(pendingMutex);
+        compacted.wait(lock, [&]() { return !compacting; });
+    }
+    std::lock_guard<std::mutex> lock(compactorMutex);
+    if (compactor.joinable()) compactor.join();
+}
+
+size_t ChangeJournal::size() {
+    std::lock_guard<std::mutex> lock(fileMutex);
+    return fileRecords;
+}
+
+void ChangeJournal::compact() {
+    TraceSpan span("ChangeJournal::compact", "journal", dataDir);
+    size_t foldEnd, folded;
+    {
+        std::lock_guard<std::mutex> lock(fileMutex);
+        if (file == nullptr) return;
+        std::fflush(file);
+        std::error_code error;
+        foldEnd = static_cast<size_t>(fs::file_size(path, error));
+        if (error) return;
+        folded = fileRecords;
+    }
+
+    // Snapshot + the records written so far, without generated walking links
+    Graph snapshot;
+    if (!loadStationsFromFile(snapshot, dataDir + "/stations.txt", false) ||
+        !loadConnectionsFromFile(snapshot, dataDir + "/connections.txt", false)) {
+        std::cerr << "Warning: journal compaction skipped; snapshot files unreadable\n";
+        return;
+    }
+    std::string bytes = readFile(path);
+    if (bytes.size() < foldEnd || !headerValid(bytes)) return;
+    scanRecords(bytes, HEADER_SIZE, foldEnd, [&](const Change& change) { change.apply(snapshot); });
+    if (!saveNetwork(snapshot, dataDir)) {
+        std::cerr << "Warning: journal compaction could not write the snapshot in " << dataDir << "\n";
+        return;
+    }
+
+    // New journal: header + whatever was appended while we worked
+    std::lock_guard<std::mutex> lock(fileMutex);
+    std::fflush(file);
+    std::string tail = readFile(path).substr(foldEnd);
+    std::string tmp = path + ".tmp";
+    std::FILE* out = std::fopen(tmp.c_str(), "wb");
+    std::string header = encodeHeader();
+    bool ok = out != nullptr &&
+              std::fwrite(header.data(), 1, header.size(), out) == header.size() &&
+              std::fwrite(tail.data(), 1, tail.size(), out) == tail.size() &&
+              syncFile(out);
+    if (out != nullptr) std::fclose(out);
+    std::error_code error;
+    if (ok) fs::rename(tmp, path, error);
+    if (!ok || error) {
+        // The snapshot already holds these records; replaying them again is harmless
+        std::cerr << "Warning: could not truncate " << path << " after compaction\n";
+        fs::remove(tmp, error);
+        return;
+    }
+    std::fclose(file);
+    file = std::fopen(path.c_str(), "ab");
+    fileRecords -= folded;
+}
+
+size_t ChangeJournal::replay(const std::string& dir, Graph& graph) {
+    TraceSpan span("ChangeJournal::replay", "load", dir);
+    std::string bytes = readFile(pathFor(dir));
+    if (bytes.empty()) return 0;
+    if (!headerValid(bytes)) {
+        std::cerr << "Warning: ignoring " << pathFor(dir) << " (not a journal)\n";
+        return 0;
+    }
+    size_t records = 0;
+    scanRecords(bytes, HEADER_SIZE, bytes.size(), [&](const Change& change) {
+        change.apply(graph);
+        records++;
+    });
+    return records;
+}
+
+std::string ChangeJournal::cacheKey(const std::string& dir) {
+    std::string bytes = readFile(pathFor(dir));
+    if (bytes.size() <= HEADER_SIZE) return "";
+    std::ostringstream oss;
+    oss << ";journal=" << std::hex << ArtifactCache::fnv1a(bytes.data(), bytes.size());
+    return oss.str();
+}
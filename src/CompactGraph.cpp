@@ -0,0 +1,370 @@
+#include "CompactGraph.h"
+#include "Trace.h"
+#include "ArtifactCache.h"
+#include "StringPool.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+CompactGraph::CompactGraph(const Graph& graph, StationOrder stationOrder) : order(stationOrder) {
+    TraceSpan span("CompactGraph::build", "index");
+    const auto& stationMap = graph.getStations();
+    const auto& adjacency = graph.getAdjacency();
+
+    names = StationOrdering::arrange(graph, stationOrder);
+
+    ids.reserve(names.size());
+    zones.resize(names.size());
+    latitudes.resize(names.size());
+    longitudes.resize(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        ids[names[i]] = static_cast<int>(i);
+        const Station& station = stationMap.at(names[i]);
+        zones[i] = station.getZone();
+        latitudes[i] = station.getLatitude();
+        longitudes[i] = station.getLongitude();
+    }
+
+    std::unordered_map<std::string, int> lineIds;
+    auto lineId = [&](const std::string& line) {
+        auto it = lineIds.find(line);
+        if (it != lineIds.end()) return it->second;
+        int id = static_cast<int>(lineNames.size());
+        lineNames.push_back(line);
+        lineIds[line] = id;
+        return id;
+    };
+
+    offsets.assign(names.size() + 1, 0);
+    rideEnd.assign(names.size(), 0);
+    transferEnd.assign(names.size(), 0);
+    const EdgeType order[3] = {EdgeType::Ride, EdgeType::Transfer, EdgeType::Walk};
+    for (size_t i = 0; i < names.size(); i++) {
+        auto it = adjacency.find(names[i]);
+        for (int group = 0; group < 3; group++) {
+            if (it != adjacency.end()) {
+                for (const auto& edge : it->second) {
+                    if (edge.type != order[group] || !ids.count(edge.to)) continue;
+                    targets.push_back(ids[edge.to]);
+                    weights.push_back(edge.weight);
+                    meters.push_back(static_cast<uint32_t>(std::llround(std::max(0.0, edge.weight) * 1000.0)));
+                    types.push_back(static_cast<unsigned char>(edge.type));
+                    edgeLines.push_back(edge.type == EdgeType::Ride ? lineId(edge.lineName()) : -1);
+                }
+            }
+            if (group == 0) rideEnd[i] = static_cast<int>(targets.size());
+            if (group == 1) transferEnd[i] = static_cast<int>(targets.size());
+        }
+        offsets[i + 1] = static_cast<int>(targets.size());
+    }
+    buildArrivalStates();
+}
+
+void CompactGraph::buildArrivalStates() {
+    int n = size();
+    int m = getEdgeCount();
+    // Edges into each station, by counting sort on the target
+    std::vector<int> inOffsets(n + 1, 0), inEdges(m);
+    for (int e = 0; e < m; e++) inOffsets[targets[e] + 1]++;
+    for (int v = 0; v < n; v++) inOffsets[v + 1] += inOffsets[v];
+    std::vector<int> fill(inOffsets.begin(), inOffsets.end() - 1);
+    for (int e = 0; e < m; e++) inEdges[fill[targets[e]]++] = e;
+
+    arrivalStates.assign(m, -1);
+    stateStations.clear();
+    stateLines.clear();
+    for (int v = 0; v < n; v++) {
+        size_t first = stateLines.size();
+        for (int i = inOffsets[v]; i < inOffsets[v + 1]; i++) {
+            int e = inEdges[i];
+            int line = (static_cast<EdgeType>(types[e]) == EdgeType::Ride) ? edgeLines[e] : -1;
+            size_t state = first;
+            while (state < stateLines.size() && stateLines[state] != line) state++;
+            if (state == stateLines.size()) {
+                stateStations.push_back(v);
+                stateLines.push_back(line);
+            }
+            arrivalStates[e] = static_cast<int>(state);
+        }
+    }
+}
+
+std::string CompactGraph::serialize() const {
+    TraceSpan span("CompactGraph::serialize", "cache");
+    if (packed) {
+        // The artifact holds the flat form; loading compresses it again
+        CompactGraph flat = *this;
+        flat.packed.reset();
+        int m = getEdgeCount();
+        flat.rideEnd.resize(size());
+        flat.transferEnd.resize(size());
+        flat.targets.resize(m);
+        flat.weights.resize(m);
+        flat.meters.resize(m);
+        flat.types.resize(m);
+        flat.edgeLines.resize(m);
+        EdgeCursor cursor;
+        for (int u = 0; u < size(); u++) {
+            cursor.load(*this, u);
+            flat.rideEnd[u] = cursor.rideEnd;
+            flat.transferEnd[u] = cursor.transferEnd;
+            for (int e = cursor.begin; e < cursor.end; e++) {
+                flat.targets[e] = cursor.target(e);
+                flat.meters[e] = cursor.meters(e);
+                flat.weights[e] = edgeWeight(e);
+                flat.types[e] = static_cast<unsigned char>(edgeType(e));
+                flat.edgeLines[e] = edgeLine(e);
+            }
+        }
+        return flat.serialize();
+    }
+    ArtifactWriter out;
+    out.put(static_cast<uint8_t>(order));
+    out.put(static_cast<uint32_t>(names.size()));
+    for (const auto& name : names) out.putString(name);
+    out.put(static_cast<uint32_t>(lineNames.size()));
+    for (const auto& line : lineNames) out.putString(line);
+    out.putArray(offsets);
+    out.putArray(rideEnd);
+    out.putArray(transferEnd);
+    out.putArray(targets);
+    out.putArray(weights);
+    out.putArray(meters);
+    out.putArray(types);
+    out.putArray(edgeLines);
+    out.putArray(zones);
+    out.putArray(latitudes);
+    out.putArray(longitudes);
+    return std::move(out.str());
+}
+
+std::shared_ptr<const CompactGraph> CompactGraph::deserialize(const unsigned char* data, size_t size) {
+    TraceSpan span("CompactGraph::deserialize", "cache");
+    std::shared_ptr<CompactGraph> graph = std::make_shared<CompactGraph>();
+    ArtifactReader in(data, size);
+
+    uint8_t order = 0;
+    in.get(order);
+    if (order > static_cast<uint8_t>(StationOrder::Line)) return nullptr;
+    graph->order = static_cast<StationOrder>(order);
+    uint32_t count = 0;
+    in.get(count);
+    for (uint32_t i = 0; i < count && in.ok(); i++) {
+        graph->names.emplace_back();
+        in.getString(graph->names.back());
+    }
+    in.get(count);
+    for (uint32_t i = 0; i < count && in.ok(); i++) {
+        graph->lineNames.emplace_back();
+        in.getString(graph->lineNames.back());
+    }
+    in.getArray(graph->offsets);
+    in.getArray(graph->rideEnd);
+    in.getArray(graph->transferEnd);
+    in.getArray(graph->targets);
+    in.getArray(graph->weights);
+    in.getArray(graph->meters);
+    in.getArray(graph->types);
+    in.getArray(graph->edgeLines);
+    in.getArray(graph->zones);
+    in.getArray(graph->latitudes);
+    in.getArray(graph->longitudes);
+
+    size_t n = graph->names.size();
+    size_t m = graph->targets.size();
+    if (!in.atEnd() || graph->offsets.size() != n + 1 || graph->rideEnd.size() != n ||
+        graph->transferEnd.size() != n || graph->zones.size() != n ||
+        graph->latitudes.size() != n || graph->longitudes.size() != n ||
+        graph->weights.size() != m || graph->meters.size() != m ||
+        graph->types.size() != m || graph->edgeLines.size() != m ||
+        graph->offsets.back() != static_cast<int>(m)) {
+        return nullptr;
+    }
+    for (int target : graph->targets) {
+        if (target < 0 || target >= static_cast<int>(n)) return nullptr;
+    }
+    // Searches index the edge arrays by these bounds without checks: each
+    // station's groups must be ordered and within its own edges, and every
+    // edge's type and line must match its group.
+    if (graph->offsets[0] != 0) return nullptr;
+    const int lineCount = static_cast<int>(graph->lineNames.size());
+    const EdgeType groupType[3] = {EdgeType::Ride, EdgeType::Transfer, EdgeType::Walk};
+    for (size_t u = 0; u < n; u++) {
+        const int bounds[4] = {graph->offsets[u], graph->rideEnd[u], graph->transferEnd[u], graph->offsets[u + 1]};
+        if (bounds[0] > bounds[1] || bounds[1] > bounds[2] || bounds[2] > bounds[3]) return nullptr;
+        for (int group = 0; group < 3; group++) {
+            for (int e = bounds[group]; e < bounds[group + 1]; e++) {
+                if (graph->types[e] != static_cast<unsigned char>(groupType[group])) return nullptr;
+                int line = graph->edgeLines[e];
+                if (group == 0 ? (line < 0 || line >= lineCount) : line != -1) return nullptr;
+                if (!(graph->weights[e] >= 0) || !std::isfinite(graph->weights[e])) return nullptr;
+            }
+        }
+    }
+
+    graph->ids.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        graph->ids[graph->names[i]] = static_cast<int>(i);
+    }
+    graph->buildArrivalStates();
+    return graph;
+}
+
+namespace {
+
+template <typename T>
+size_t vectorBytes(const std::vector<T>& values) {
+    return values.capacity() * sizeof(T);
+}
+
+} // namespace
+
+std::shared_ptr<const CompactGraph> CompactGraph::compressed() const {
+    if (packed) return std::make_shared<const CompactGraph>(*this);
+    std::shared_ptr<const CompressedAdjacency> edges = CompressedAdjacency::build(*this);
+    if (!edges) return nullptr;
+    std::shared_ptr<CompactGraph> graph = std::make_shared<CompactGraph>();
+    graph->names = names;
+    graph->ids = ids;
+    graph->offsets = offsets;
+    graph->lineNames = lineNames;
+    graph->zones = zones;
+    graph->latitudes = latitudes;
+    graph->longitudes = longitudes;
+    graph->order = order;
+    graph->arrivalStates = arrivalStates;
+    graph->stateStations = stateStations;
+    graph->stateLines = stateLines;
+    graph->packed = std::move(edges);
+    return graph;
+}
+
+int CompactGraph::stationOfEdge(int e) const {
+    // Last station whose edges start at or before e
+    return static_cast<int>(std::upper_bound(offsets.begin(), offsets.end(), e) - offsets.begin()) - 1;
+}
+
+int CompactGraph::packedTarget(int e) const {
+    int u = stationOfEdge(e);
+    return packed->target(u, offsets[u + 1] - offsets[u], e - offsets[u]);
+}
+
+int CompactGraph::rideEndOf(int u) const {
+    if (!packed) return rideEnd[u];
+    int rides, transfers;
+    packed->groups(u, rides, transfers);
+    return offsets[u] + rides;
+}
+
+int CompactGraph::transferEndOf(int u) const {
+    if (!packed) return transferEnd[u];
+    int rides, transfers;
+    packed->groups(u, rides, transfers);
+    return offsets[u] + rides + transfers;
+}
+
+void CompactGraph::EdgeCursor::loadPacked(const CompactGraph& graph, int u) {
+    int degree = end - begin;
+    size_t room = static_cast<size_t>(degree + 3) & ~size_t(3);
+    if (targetBuffer.size() < room) {
+        targetBuffer.resize(room);
+        meterBuffer.resize(room);
+    }
+    int rides, transfers;
+    graph.packed->groups(u, rides, transfers);
+    rideEnd = begin + rides;
+    transferEnd = rideEnd + transfers;
+    graph.packed->decode(u, degree, begin, targetBuffer.data(), meterBuffer.data());
+    targetRow = targetBuffer.data();
+    meterRow = meterBuffer.data();
+}
+
+size_t CompactGraph::memoryBytes() const {
+    size_t bytes = vectorBytes(names) + vectorBytes(lineNames) + vectorBytes(offsets) +
+                   vectorBytes(rideEnd) + vectorBytes(transferEnd) + vectorBytes(targets) +
+                   vectorBytes(weights) + vectorBytes(meters) + vectorBytes(types) +
+                   vectorBytes(edgeLines) + vectorBytes(zones) + vectorBytes(latitudes) +
+                   vectorBytes(longitudes) + vectorBytes(arrivalStates) + vectorBytes(stateStations) +
+                   vectorBytes(stateLines);
+    if (packed) bytes += packed->memoryBytes();
+    for (const auto& name : names) bytes += StringPool::heapBytes(name);
+    for (const auto& line : lineNames) bytes += StringPool::heapBytes(line);
+    bytes += ids.bucket_count() * sizeof(void*);
+    for (const auto& pair : ids) {
+        bytes += sizeof(pair) + 2 * sizeof(void*) + StringPool::heapBytes(pair.first);
+    }
+    return bytes;
+}
+
+size_t CompactGraph::adjacencyBytes() const {
+    size_t bytes = vectorBytes(offsets) + vectorBytes(rideEnd) + vectorBytes(transferEnd) +
+                   vectorBytes(targets) + vectorBytes(weights) + vectorBytes(meters) +
+                   vectorBytes(types) + vectorBytes(edgeLines);
+    if (packed) bytes += packed->memoryBytes();
+    return bytes;
+}
+
+int CompactGraph::findEdge(int u, int v) const {
+    int best = -1;
+    EdgeCursor cursor;
+    cursor.load(*this, u);
+    for (int e = cursor.begin; e < cursor.end; e++) {
+        if (cursor.target(e) == v && (best < 0 || edgeWeight(e) < edgeWeight(best))) best = e;
+    }
+    return best;
+}
+
+int CompactGraph::idOf(const std::string& name) const {
+    auto it = ids.find(name);
+    return (it != ids.end()) ? it->second : -1;
+}
+
+void SearchWorkspace::prepare(int n) {
+    if (static_cast<int>(dist.size()) != n) {
+        dist.assign(n, UNREACHED);
+        parent.assign(n, -1);
+        settled.assign(n, 0);
+        touched.clear();
+    } else {
+        for (int v : touched) {
+            dist[v] = UNREACHED;
+            parent[v] = -1;
+            settled[v] = 0;
+        }
+        touched.clear();
+    }
+    heap.clear();
+    if (static_cast<int>(aux.size()) != n) aux.assign(n, 0);
+    if (static_cast<int>(tags.size()) != n) {
+        tags.assign(n, 0);
+        tag = 0;
+    }
+}
+
+void SearchWorkspace::newTag() {
+    if (++tag == 0) {
+        std::fill(tags.begin(), tags.end(), 0);
+        tag = 1;
+    }
+}
+
+void SearchWorkspace::push(int v, double d, int p) {
+    if (dist[v] == UNREACHED) touched.push_back(v);
+    dist[v] = d;
+    parent[v] = p;
+    heap.push_back({d, v});
+    std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<double, int>>());
+}
+
+int SearchWorkspace::popMin() {
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<std::pair<double, int>>());
+        int v = heap.back().second;
+        double d = heap.back().first;
+        heap.pop_back();
+        if (settled[v] || d > dist[v]) continue;   // stale entry
+        settled[v] = 1;
+        return v;
+    }
+    return -1;
+}
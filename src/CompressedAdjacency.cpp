@@ -0,0 +1,141 @@
+#include "CompressedAdjacency.h"
+#include "CompactGraph.h"
+#include "SimdKernels.h"
+#include "Trace.h"
+#include <algorithm>
+
+namespace {
+
+uint32_t zigzag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+int32_t unzigzag(uint32_t value) {
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+void putVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+const uint8_t* getVarint(const uint8_t* p, int& value) {
+    uint32_t result = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte = *p++;
+        result |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    value = static_cast<int>(result);
+    return p;
+}
+
+// Stream VByte encoding of values: controls, then data
+void putStreamVByte(std::vector<uint8_t>& out, const std::vector<uint32_t>& values) {
+    size_t controlAt = out.size();
+    out.resize(out.size() + (values.size() + 3) / 4, 0);
+    for (size_t i = 0; i < values.size(); i++) {
+        uint32_t value = values[i];
+        int bytes = value < (1u << 8) ? 1 : value < (1u << 16) ? 2 : value < (1u << 24) ? 3 : 4;
+        out[controlAt + i / 4] |= static_cast<uint8_t>((bytes - 1) << (2 * (i % 4)));
+        for (int b = 0; b < bytes; b++) out.push_back(static_cast<uint8_t>(value >> (8 * b)));
+    }
+}
+
+} // namespace
+
+std::shared_ptr<const CompressedAdjacency> CompressedAdjacency::build(const CompactGraph& graph) {
+    TraceSpan span("CompressedAdjacency::build", "index");
+    if (graph.lineCount() > MAX_LINES) return nullptr;
+
+    std::shared_ptr<CompressedAdjacency> packed = std::make_shared<CompressedAdjacency>();
+    int n = graph.size();
+    int m = graph.getEdgeCount();
+
+    uint32_t longest = 0;
+    for (int e = 0; e < m; e++) longest = std::max(longest, graph.edgeMeters(e));
+    while ((longest >> packed->shift) > 0xFFFF) packed->shift++;
+
+    packed->lengths.resize(m);
+    packed->tags.resize(m);
+    packed->blockOffsets.resize(n + 1);
+    std::vector<uint32_t> deltas;
+    for (int u = 0; u < n; u++) {
+        packed->blockOffsets[u] = static_cast<uint32_t>(packed->bytes.size());
+        int rides = graph.rideEndOf(u) - graph.edgeBegin(u);
+        int transfers = graph.transferEndOf(u) - graph.rideEndOf(u);
+        packed->bytes.push_back(static_cast<uint8_t>(std::min(rides, 15) | (std::min(transfers, 15) << 4)));
+        if (rides >= 15) putVarint(packed->bytes, static_cast<uint32_t>(rides));
+        if (transfers >= 15) putVarint(packed->bytes, static_cast<uint32_t>(transfers));
+
+        deltas.clear();
+        int previous = u;
+        for (int e = graph.edgeBegin(u); e < graph.edgeEnd(u); e++) {
+            int v = graph.edgeTarget(e);
+            deltas.push_back(zigzag(v - previous));
+            previous = v;
+
+            uint32_t rounded = graph.edgeMeters(e);
+            if (packed->shift > 0) rounded = (rounded + (1u << (packed->shift - 1))) >> packed->shift;
+            packed->lengths[e] = static_cast<uint16_t>(std::min<uint32_t>(rounded, 0xFFFF));
+            EdgeType type = graph.edgeType(e);
+            packed->tags[e] = type == EdgeType::Transfer ? TRANSFER
+                            : type == EdgeType::Walk ? WALK
+                            : static_cast<uint16_t>(graph.edgeLine(e));
+        }
+        putStreamVByte(packed->bytes, deltas);
+    }
+    packed->blockOffsets[n] = static_cast<uint32_t>(packed->bytes.size());
+    packed->bytes.resize(packed->bytes.size() + PADDING, 0);
+    packed->bytes.shrink_to_fit();
+    return packed;
+}
+
+const uint8_t* CompressedAdjacency::header(int u, int& rides, int& transfers) const {
+    const uint8_t* p = bytes.data() + blockOffsets[u];
+    uint8_t counts = *p++;
+    rides = counts & 15;
+    transfers = counts >> 4;
+    if (rides == 15) p = getVarint(p, rides);
+    if (transfers == 15) p = getVarint(p, transfers);
+    return p;
+}
+
+void CompressedAdjacency::decode(int u, int degree, int firstEdge, int* out, uint32_t* lengthsOut) const {
+    int rides, transfers;
+    const uint8_t* control = header(u, rides, transfers);
+    // Signed and unsigned ints may alias; deltas are decoded in place
+    uint32_t* raw = reinterpret_cast<uint32_t*>(out);
+    SimdKernels::decodeStreamVByte(control, control + (degree + 3) / 4, static_cast<size_t>(degree), raw);
+    int previous = u;
+    for (int k = 0; k < degree; k++) {
+        previous += unzigzag(raw[k]);
+        out[k] = previous;
+    }
+    if (lengthsOut) {
+        for (int k = 0; k < degree; k++) lengthsOut[k] = static_cast<uint32_t>(lengths[firstEdge + k]) << shift;
+    }
+}
+
+int CompressedAdjacency::target(int u, int degree, int k) const {
+    int rides, transfers;
+    const uint8_t* control = header(u, rides, transfers);
+    const uint8_t* data = control + (degree + 3) / 4;
+    int previous = u;
+    for (int i = 0; i <= k; i++) {
+        int bytes = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t value = 0;
+        for (int b = 0; b < bytes; b++) value |= static_cast<uint32_t>(data[b]) << (8 * b);
+        data += bytes;
+        previous += unzigzag(value);
+    }
+    return previous;
+}
+
+size_t CompressedAdjacency::memoryBytes() const {
+    return blockOffsets.capacity() * sizeof(uint32_t) + bytes.capacity() +
+           lengths.capacity() * sizeof(uint16_t) + tags.capacity() * sizeof(uint16_t);
+}
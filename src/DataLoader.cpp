@@ -0,0 +1,246 @@
+#include "DataLoader.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "CompactGraph.h"
+#include "HubLabels.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+
+// Load stations from file
+bool loadStationsFromFile(Graph& graph, const std::string& filename, bool verbose) {
+    ScopedTimer timer(Timer::Load);
+    TraceSpan span("loadStationsFromFile", "load", filename);
+    std::ifstream file(filename);
+    
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open " << filename << std::endl;
+        return false;
+    }
+    
+    std::string line;
+    int count = 0;
+    
+    if (verbose) std::cout << "Loading stations...\n";
+    
+    while (std::getline(file, line)) {
+        // Skip comments and empty lines
+        if (line.empty() || line[0] == '#') continue;
+        
+        // Parse: StationName,MetroLine,Zone,Latitude,Longitude
+        std::stringstream ss(line);
+        std::string station, line_name, zone_str, lat_str, lon_str;
+        
+        if (std::getline(ss, station, ',') && 
+            std::getline(ss, line_name, ',') &&
+            std::getline(ss, zone_str, ',') &&
+            std::getline(ss, lat_str, ',') &&
+            std::getline(ss, lon_str, ',')) {
+            
+            int zone = std::stoi(zone_str);
+            double lat = std::stod(lat_str);
+            double lon = std::stod(lon_str);
+            
+            graph.addStation(station, line_name, zone, lat, lon);
+            count++;
+        }
+    }
+    
+    file.close();
+    Metrics::add(Counter::StationsLoaded, count);
+    if (verbose) std::cout << "Loaded " << count << " stations.\n";
+    return count > 0;
+}
+
+// Load connections from file
+bool loadConnectionsFromFile(Graph& graph, const std::string& filename, bool verbose) {
+    ScopedTimer timer(Timer::Load);
+    TraceSpan span("loadConnectionsFromFile", "load", filename);
+    std::ifstream file(filename);
+    
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open " << filename << std::endl;
+        return false;
+    }
+    
+    std::string line;
+    int count = 0;
+    
+    if (verbose) std::cout << "Loading connections...\n";
+    
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        
+        // Parse: Station1,Station2,Distance[,Type[,oneway]]
+        std::stringstream ss(line);
+        std::string station1, station2, distance_str, type_str, direction_str;
+        
+        if (std::getline(ss, station1, ',') && 
+            std::getline(ss, station2, ',') &&
+            std::getline(ss, distance_str, ',')) {
+            
+            double distance = std::stod(distance_str);
+            std::getline(ss, type_str, ',');
+            std::getline(ss, direction_str, ',');
+            bool oneway = (direction_str == "oneway");
+            
+            if (type_str.empty() && !oneway) {
+                graph.addEdge(station1, station2, distance);
+            } else {
+                // TRANSFER, WALK, or the name of the line ridden
+                EdgeType type = EdgeType::Ride;
+                std::string rideLine = type_str;
+                if (type_str == "TRANSFER") type = EdgeType::Transfer;
+                else if (type_str == "WALK") type = EdgeType::Walk;
+                else if (type_str.empty() && graph.getStation(station1)) {
+                    rideLine = graph.getStation(station1)->getMetroLine();
+                }
+                graph.addDirectedEdge(station1, station2, distance, type, rideLine);
+                if (!oneway) graph.addDirectedEdge(station2, station1, distance, type, rideLine);
+            }
+            count++;
+        }
+    }
+    
+    file.close();
+    Metrics::add(Counter::ConnectionsLoaded, count);
+    if (verbose) std::cout << "Loaded " << count << " connections.\n";
+    return true;
+}
+
+bool loadNetwork(Graph& graph, const std::string& dataDir, bool verbose) {
+    TraceSpan span("loadNetwork", "load", dataDir);
+    if (!loadStationsFromFile(graph, dataDir + "/stations.txt", verbose)) {
+        return false;
+    }
+    if (!loadConnectionsFromFile(graph, dataDir + "/connections.txt", verbose)) {
+        return false;
+    }
+    FareCalculator fares;
+    if (fares.loadFromFile(dataDir + "/fares.txt")) {
+        graph.setFareCalculator(fares);
+    }
+    return true;
+}
+
+namespace {
+
+// Same type, line and length in the other direction
+bool hasReverse(const Graph& graph, const std::string& from, const Edge& edge) {
+    auto it = graph.getAdjacency().find(edge.to);
+    if (it == graph.getAdjacency().end()) return false;
+    for (const auto& back : it->second) {
+        if (back.to == from && back.type == edge.type && back.line == edge.line && back.weight == edge.weight) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool replaceFile(const std::string& tmp, const std::string& path) {
+    std::error_code error;
+    std::filesystem::rename(tmp, path, error);
+    if (error) std::filesystem::remove(tmp, error);
+    return !error;
+}
+
+} // namespace
+
+bool saveNetwork(const Graph& graph, const std::string& dataDir) {
+    TraceSpan span("saveNetwork", "save", dataDir);
+    std::vector<std::string> names;
+    for (const auto& pair : graph.getStations()) names.push_back(pair.first);
+    std::sort(names.begin(), names.end());
+
+    std::string stationsPath = dataDir + "/stations.txt";
+    std::string connectionsPath = dataDir + "/connections.txt";
+    std::ofstream stationsOut(stationsPath + ".tmp");
+    std::ofstream connectionsOut(connectionsPath + ".tmp");
+    if (!stationsOut.is_open() || !connectionsOut.is_open()) return false;
+
+    stationsOut << "# Metro Stations\n# Format: StationName,MetroLine,Zone,Latitude,Longitude\n";
+    stationsOut << std::setprecision(15);
+    for (const auto& name : names) {
+        const Station& s = graph.getStations().at(name);
+        stationsOut << name << "," << s.getMetroLine() << "," << s.getZone() << ","
+                    << s.getLatitude() << "," << s.getLongitude() << "\n";
+    }
+
+    connectionsOut << "# Metro Connections\n# Format: Station1,Station2,Distance(km)[,Type[,oneway]]\n";
+    connectionsOut << std::setprecision(15);
+    for (const auto& name : names) {
+        const std::string& fromLine = graph.getStations().at(name).getMetroLine();
+        for (const auto& edge : graph.getAdjacency().at(name)) {
+            bool twoWay = hasReverse(graph, name, edge);
+            if (twoWay && edge.to < name) continue;     // written from the other end
+            const std::string& toLine = graph.getStations().at(edge.to).getMetroLine();
+            connectionsOut << name << "," << edge.to << "," << edge.weight;
+
+            // Plain records get their type from the stations' lines (Graph::addEdge)
+            bool plain = twoWay && ((edge.type == EdgeType::Ride && edge.lineName() == fromLine &&
+                                     fromLine == toLine) ||
+                                    (edge.type == EdgeType::Transfer && fromLine != toLine));
+            if (!plain) {
+                connectionsOut << "," << (edge.type == EdgeType::Transfer ? "TRANSFER"
+                                          : edge.type == EdgeType::Walk ? "WALK" : edge.lineName());
+                if (!twoWay) connectionsOut << ",oneway";
+            }
+            connectionsOut << "\n";
+        }
+    }
+    stationsOut.close();
+    connectionsOut.close();
+    if (!stationsOut || !connectionsOut) return false;
+    return replaceFile(connectionsPath + ".tmp", connectionsPath) &&
+           replaceFile(stationsPath + ".tmp", stationsPath);
+}
+
+bool loadRoutingIndex(Graph& graph, ArtifactCache& cache) {
+    TraceSpan span("loadRoutingIndex", "load");
+    auto artifact = cache.open(CompactGraph::ARTIFACT_NAME, CompactGraph::ARTIFACT_VERSION);
+    if (artifact) {
+        std::shared_ptr<const CompactGraph> index = CompactGraph::deserialize(artifact->data(), artifact->size());
+        if (index && index->size() == graph.getStationCount() &&
+            index->getOrder() == graph.getStationOrder()) {
+            graph.setRoutingIndex(index);
+            return true;
+        }
+        std::cerr << "Warning: ignoring malformed cache artifact " << CompactGraph::ARTIFACT_NAME << "\n";
+    }
+
+    // The snapshot is immutable, so serializing it can overlap with queries
+    std::shared_ptr<const CompactGraph> index = graph.getRoutingIndex();
+    cache.writeAsync(CompactGraph::ARTIFACT_NAME, CompactGraph::ARTIFACT_VERSION,
+                     [index]() { return index->serialize(); });
+    return false;
+}
+
+bool loadHubLabels(Graph& graph, ArtifactCache& cache) {
+    TraceSpan span("loadHubLabels", "load");
+    std::shared_ptr<const CompactGraph> index = graph.getRoutingIndex();
+    auto artifact = cache.open(HubLabels::ARTIFACT_NAME, HubLabels::ARTIFACT_VERSION);
+    if (artifact) {
+        std::shared_ptr<const HubLabels> labels = HubLabels::deserialize(artifact->data(), artifact->size());
+        if (labels && labels->matches(*index)) {
+            graph.setHubLabels(labels);
+            return true;
+        }
+        std::cerr << "Warning: ignoring malformed cache artifact " << HubLabels::ARTIFACT_NAME << "\n";
+    }
+
+    std::shared_ptr<const HubLabels> labels = HubLabels::build(*index);
+    graph.setHubLabels(labels);
+    cache.writeAsync(HubLabels::ARTIFACT_NAME, HubLabels::ARTIFACT_VERSION,
+                     [labels]() { return labels->serialize(); });
+    return false;
+}
+
+std::string artifactParams(double walkKm, StationOrder order) {
+    std::ostringstream oss;
+    oss << "walk_km=" << walkKm;
+    if (order != StationOrder::Name) oss << ";order=" << StationOrdering::name(order);
+    return oss.str();
+}
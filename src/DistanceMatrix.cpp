@@ -0,0 +1,119 @@
+#include "DistanceMatrix.h"
+#include "ThreadPool.h"
+#include "CancelToken.h"
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+
+std::vector<double> DistanceMatrix::oneToMany(const CompactGraph& graph, int source,
+                                              const std::vector<int>& targets,
+                                              SearchWorkspace& ws) {
+    std::vector<double> result(targets.size(), -1);
+    if (source < 0 || source >= graph.size()) return result;
+
+    ws.prepare(graph.size());
+
+    // Count distinct valid targets so the search can stop early
+    size_t remaining = 0;
+    ws.newTag();
+    for (int t : targets) {
+        if (t >= 0 && t < graph.size() && ws.tags[t] != ws.tag) {
+            ws.tags[t] = ws.tag;
+            remaining++;
+        }
+    }
+
+    ws.push(source, 0.0, -1);
+    unsigned ticks = 0;
+    while (remaining > 0 && !CancelToken::poll(ticks)) {
+        int u = ws.popMin();
+        if (u < 0) break;
+        if (ws.tags[u] == ws.tag) remaining--;
+
+        double du = ws.dist[u];
+        ws.edges.load(graph, u);
+        for (int e = ws.edges.begin; e < ws.edges.end; e++) {
+            int v = ws.edges.target(e);
+            double nd = du + graph.edgeWeight(e);
+            if (!ws.settled[v] && nd < ws.dist[v]) {
+                ws.push(v, nd, u);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < targets.size(); i++) {
+        int t = targets[i];
+        if (t >= 0 && t < graph.size() && ws.settled[t]) {
+            result[i] = ws.dist[t];
+        }
+    }
+    return result;
+}
+
+DistanceMatrix DistanceMatrix::manyToMany(const CompactGraph& graph,
+                                          const std::vector<int>& sources,
+                                          const std::vector<int>& targets,
+                                          ThreadPool& pool) {
+    DistanceMatrix matrix;
+    matrix.sources = sources;
+    matrix.targets = targets;
+    matrix.values.assign(sources.size() * targets.size(), -1);
+
+    std::vector<std::unique_ptr<SearchWorkspace>> workspaces;
+    for (unsigned w = 0; w < pool.size(); w++) {
+        workspaces.emplace_back(new SearchWorkspace());
+    }
+
+    pool.parallelFor(sources.size(), [&](size_t row, unsigned worker) {
+        std::vector<double> dists = oneToMany(graph, sources[row], targets, *workspaces[worker]);
+        std::copy(dists.begin(), dists.end(), matrix.values.begin() + row * targets.size());
+    });
+    return matrix;
+}
+
+DistanceMatrix DistanceMatrix::manyToMany(const CompactGraph& graph,
+                                          const std::vector<std::string>& sourceNames,
+                                          const std::vector<std::string>& targetNames,
+                                          ThreadPool& pool) {
+    std::vector<int> sourceIds, targetIds;
+    for (const auto& name : sourceNames) sourceIds.push_back(graph.idOf(name));
+    for (const auto& name : targetNames) targetIds.push_back(graph.idOf(name));
+    return manyToMany(graph, sourceIds, targetIds, pool);
+}
+
+void DistanceMatrix::writeCSV(std::ostream& out, const CompactGraph& graph) const {
+    auto label = [&](int id) { return id >= 0 ? graph.nameOf(id) : std::string("?"); };
+
+    out << "source";
+    for (int t : targets) out << "," << label(t);
+    out << "\n";
+
+    out << std::fixed << std::setprecision(3);
+    for (size_t r = 0; r < sources.size(); r++) {
+        out << label(sources[r]);
+        for (size_t c = 0; c < targets.size(); c++) {
+            out << "," << at(r, c);
+        }
+        out << "\n";
+    }
+}
+
+void DistanceMatrix::writeBinary(std::ostream& out) const {
+    const char magic[8] = {'M', 'R', 'F', 'D', 'M', '1', '\0', '\0'};
+    uint32_t rowCount = static_cast<uint32_t>(sources.size());
+    uint32_t colCount = static_cast<uint32_t>(targets.size());
+
+    out.write(magic, sizeof(magic));
+    out.write(reinterpret_cast<const char*>(&rowCount), sizeof(rowCount));
+    out.write(reinterpret_cast<const char*>(&colCount), sizeof(colCount));
+    for (int s : sources) {
+        int32_t id = s;
+        out.write(reinterpret_cast<const char*>(&id), sizeof(id));
+    }
+    for (int t : targets) {
+        int32_t id = t;
+        out.write(reinterpret_cast<const char*>(&id), sizeof(id));
+    }
+    out.write(reinterpret_cast<const char*>(values.data()),
+              static_cast<std::streamsize>(values.size() * sizeof(double)));
+}
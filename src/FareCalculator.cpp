@@ -1,30 +1,97 @@
 #include "FareCalculator.h"
 #include <sstream>
+#include <fstream>
 #include <iomanip>
 
+bool FareCalculator::loadFromFile(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        // Parse: key,value  or  zone,ZoneNumber,Surcharge
+        std::stringstream ss(line);
+        std::string key, first, second;
+        if (!std::getline(ss, key, ',') || !std::getline(ss, first, ',')) continue;
+
+        if (key == "base") {
+            baseFare = std::stod(first);
+        } else if (key == "per_km") {
+            costPerKm = std::stod(first);
+        } else if (key == "zone_surcharge") {
+            zoneSurcharge = std::stod(first);
+        } else if (key == "zone" && std::getline(ss, second, ',')) {
+            int zone = std::stoi(first);
+            if (zone < 0) continue;
+            if (static_cast<int>(zoneCharges.size()) <= zone) {
+                zoneCharges.resize(zone + 1, -1.0);
+            }
+            zoneCharges[zone] = std::stod(second);
+        }
+    }
+
+    // Zones without an explicit table entry fall back to zone * zoneSurcharge
+    for (size_t z = 0; z < zoneCharges.size(); z++) {
+        if (zoneCharges[z] < 0) zoneCharges[z] = z * zoneSurcharge;
+    }
+    return true;
+}
+
+double FareCalculator::getZoneCharge(int maxZone) const {
+    if (maxZone >= 0 && maxZone < static_cast<int>(zoneCharges.size())) {
+        return zoneCharges[maxZone];
+    }
+    return maxZone * zoneSurcharge;
+}
+
 int FareCalculator::calculateFare(double distance, int maxZone) const {
-    double fare = BASE_FARE;
-    fare += distance * COST_PER_KM;
-    fare += maxZone * ZONE_SURCHARGE;
+    double fare = baseFare;
+    fare += distance * costPerKm;
+    fare += getZoneCharge(maxZone);
     
     // Round to nearest rupee
     return static_cast<int>(fare + 0.5);
 }
 
+void FareCalculator::calculateFares(const double* distances, const int* maxZones,
+                                    int* fares, size_t count) const {
+    // Zone charges are resolved per block first so the inner loop is a
+    // branch-free multiply-add over contiguous arrays the compiler can vectorize
+    const size_t BLOCK = 256;
+    double charge[BLOCK];
+    int tableSize = static_cast<int>(zoneCharges.size());
+    const double base = baseFare;
+    const double perKm = costPerKm;
+
+    for (size_t start = 0; start < count; start += BLOCK) {
+        size_t n = (count - start < BLOCK) ? count - start : BLOCK;
+        for (size_t i = 0; i < n; i++) {
+            int z = maxZones[start + i];
+            charge[i] = (z >= 0 && z < tableSize) ? zoneCharges[z] : z * zoneSurcharge;
+        }
+        const double* d = distances + start;
+        int* out = fares + start;
+        for (size_t i = 0; i < n; i++) {
+            out[i] = static_cast<int>(base + d[i] * perKm + charge[i] + 0.5);
+        }
+    }
+}
+
 std::string FareCalculator::getFareBreakdown(double distance, int maxZone) const {
     std::ostringstream oss;
     
-    double baseFare = BASE_FARE;
-    double distanceFare = distance * COST_PER_KM;
-    double zoneFare = maxZone * ZONE_SURCHARGE;
+    double distanceFare = distance * costPerKm;
+    double zoneFare = getZoneCharge(maxZone);
     double totalFare = baseFare + distanceFare + zoneFare;
     
     oss << "\n========== FARE BREAKDOWN ==========\n";
     oss << "Base Fare:          ₹" << std::fixed << std::setprecision(2) << baseFare << std::endl;
     oss << "Distance Charge:    ₹" << std::fixed << std::setprecision(2) 
-        << distanceFare << " (" << distance << " km × ₹" << COST_PER_KM << "/km)" << std::endl;
+        << distanceFare << " (" << distance << " km × ₹" << costPerKm << "/km)" << std::endl;
     oss << "Zone Surcharge:     ₹" << std::fixed << std::setprecision(2) 
-        << zoneFare << " (" << maxZone << " zones × ₹" << ZONE_SURCHARGE << ")" << std::endl;
+        << zoneFare << " (max zone " << maxZone << ")" << std::endl;
     oss << "====================================\n";
     oss << "Total Fare:         ₹" << static_cast<int>(totalFare + 0.5) << std::endl;
     oss << "====================================\n";
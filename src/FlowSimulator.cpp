@@ -0,0 +1,245 @@
+#include "FlowSimulator.h"
+#include "RouteResult.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace {
+
+// Per-worker counters; edges use 32 bits to keep one copy per worker small
+struct WorkerFlows {
+    std::vector<uint32_t> edgeFlow;
+    std::vector<uint64_t> boardings;
+    std::vector<uint64_t> alightings;
+    std::vector<uint64_t> transfers;
+    std::vector<uint64_t> throughput;
+    uint64_t trips = 0;
+    uint64_t routed = 0;
+    double km = 0;
+    double minutes = 0;
+    uint64_t changes = 0;
+    RouteResult route;
+};
+
+// Index of the cumulative bucket holding x
+size_t sample(const std::vector<double>& cumulative, double x) {
+    size_t i = std::upper_bound(cumulative.begin(), cumulative.end(), x) - cumulative.begin();
+    return std::min(i, cumulative.size() - 1);
+}
+
+const char* typeName(EdgeType type) {
+    switch (type) {
+        case EdgeType::Ride: return "ride";
+        case EdgeType::Transfer: return "transfer";
+        case EdgeType::Walk: return "walk";
+    }
+    return "?";
+}
+
+// Indices of the `top` largest values (ties by index), largest first
+std::vector<int> topIndices(const std::vector<uint64_t>& values, size_t top) {
+    std::vector<int> order;
+    for (size_t i = 0; i < values.size(); i++) {
+        if (values[i] > 0) order.push_back(static_cast<int>(i));
+    }
+    top = std::min(top, order.size());
+    std::partial_sort(order.begin(), order.begin() + top, order.end(), [&](int a, int b) {
+        return values[a] != values[b] ? values[a] > values[b] : a < b;
+    });
+    order.resize(top);
+    return order;
+}
+
+} // namespace
+
+FlowSimulator::FlowSimulator(const Graph& g) : graph(g), index(g.getRoutingIndex()) {
+    double total = 0;
+    for (int v = 0; v < index->size(); v++) {
+        total += std::max(1, index->edgeEnd(v) - index->edgeBegin(v));
+        stationCumulative.push_back(total);
+    }
+}
+
+void FlowSimulator::setDemand(const std::vector<DemandPair>& pairs) {
+    demand.clear();
+    cumulative.clear();
+    double total = 0;
+    for (const auto& pair : pairs) {
+        if (pair.origin < 0 || pair.destination < 0 || pair.weight <= 0 ||
+            pair.origin >= index->size() || pair.destination >= index->size()) {
+            continue;
+        }
+        demand.push_back(pair);
+        total += pair.weight;
+        cumulative.push_back(total);
+    }
+}
+
+bool FlowSimulator::loadDemand(const std::string& path, std::vector<DemandPair>& pairs) const {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open " << path << "\n";
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        std::stringstream ss(line);
+        std::string origin, destination, trips;
+        std::getline(ss, origin, ',');
+        std::getline(ss, destination, ',');
+        std::getline(ss, trips, ',');
+        int from = index->idOf(origin);
+        int to = index->idOf(destination);
+        double weight = 0;
+        try {
+            weight = std::stod(trips);
+        } catch (...) {
+            weight = -1;
+        }
+        if (from < 0 || to < 0 || weight < 0) {
+            std::cerr << "Warning: skipping demand line " << lineNumber << ": " << line << "\n";
+            continue;
+        }
+        pairs.push_back({from, to, weight});
+    }
+    return true;
+}
+
+FlowReport FlowSimulator::run(const Options& options, ThreadPool& pool) const {
+    TraceSpan span("FlowSimulator::run", "simulate", std::to_string(options.trips) + " trips");
+    auto started = std::chrono::steady_clock::now();
+    int n = index->size();
+    size_t edgeCount = static_cast<size_t>(index->getEdgeCount());
+
+    std::vector<WorkerFlows> workers(std::max(1u, pool.size()));
+    for (auto& w : workers) {
+        w.edgeFlow.assign(edgeCount, 0);
+        w.boardings.assign(n, 0);
+        w.alightings.assign(n, 0);
+        w.transfers.assign(n, 0);
+        w.throughput.assign(n, 0);
+    }
+
+    size_t chunk = std::max<size_t>(1, options.chunk);
+    size_t chunks = static_cast<size_t>((options.trips + chunk - 1) / chunk);
+    bool useMatrix = !demand.empty();
+    pool.parallelFor(n > 1 ? chunks : 0, [&](size_t c, unsigned worker) {
+        WorkerFlows& w = workers[worker];
+        std::mt19937_64 rng(options.seed ^ ((c + 1) * 0x9E3779B97F4A7C15ULL));
+        std::uniform_real_distribution<double> pairDist(0, useMatrix ? cumulative.back() : 0);
+        std::uniform_real_distribution<double> stationDist(0, stationCumulative.back());
+        uint64_t begin = static_cast<uint64_t>(c) * chunk;
+        uint64_t end = std::min<uint64_t>(options.trips, begin + chunk);
+
+        for (uint64_t trip = begin; trip < end; trip++) {
+            int origin, destination;
+            if (useMatrix) {
+                const DemandPair& pair = demand[sample(cumulative, pairDist(rng))];
+                origin = pair.origin;
+                destination = pair.destination;
+            } else {
+                origin = static_cast<int>(sample(stationCumulative, stationDist(rng)));
+                do {
+                    destination = static_cast<int>(sample(stationCumulative, stationDist(rng)));
+                } while (destination == origin);
+            }
+            w.trips++;
+            w.boardings[origin]++;
+            w.alightings[destination]++;
+            if (!graph.findRoute(origin, destination, options.criterion, *index, w.route)) continue;
+
+            const RouteResult& route = w.route;
+            w.routed++;
+            w.km += route.totalDistance;
+            w.minutes += route.travelMinutes;
+            w.changes += route.transferPoints;
+            for (int e : route.edges) w.edgeFlow[e]++;
+            for (int v : route.stations) w.throughput[v]++;
+            for (uint32_t at : route.transfers) w.transfers[route.stations[at]]++;
+        }
+    });
+
+    FlowReport report;
+    report.edgeFlow.assign(edgeCount, 0);
+    report.boardings.assign(n, 0);
+    report.alightings.assign(n, 0);
+    report.transfers.assign(n, 0);
+    report.throughput.assign(n, 0);
+    for (const auto& w : workers) {
+        report.trips += w.trips;
+        report.routed += w.routed;
+        report.totalKm += w.km;
+        report.totalMinutes += w.minutes;
+        report.totalTransfers += w.changes;
+        for (size_t e = 0; e < edgeCount; e++) report.edgeFlow[e] += w.edgeFlow[e];
+        for (int v = 0; v < n; v++) {
+            report.boardings[v] += w.boardings[v];
+            report.alightings[v] += w.alightings[v];
+            report.transfers[v] += w.transfers[v];
+            report.throughput[v] += w.throughput[v];
+        }
+    }
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return report;
+}
+
+void FlowSimulator::writeReport(std::ostream& out, const FlowReport& report, size_t top) const {
+    double routed = std::max<double>(1, static_cast<double>(report.routed));
+    out << std::fixed << std::setprecision(1);
+    out << "Trips: " << report.trips << " sampled, " << report.routed << " routed in "
+        << report.seconds << " s (" << std::setprecision(0)
+        << report.trips / std::max(report.seconds, 1e-9) << " trips/s)\n";
+    out << std::setprecision(2) << "Average trip: " << report.totalKm / routed << " km, "
+        << report.totalMinutes / routed << " min, " << report.totalTransfers / routed << " transfers\n";
+
+    out << "\nBusiest segments\n";
+    out << std::setw(10) << "trips" << std::setw(8) << "share" << "  " << std::left
+        << std::setw(9) << "type" << std::setw(18) << "line" << "segment\n" << std::right;
+    std::vector<int> from(index->getEdgeCount());
+    for (int v = 0; v < index->size(); v++) {
+        for (int e = index->edgeBegin(v); e < index->edgeEnd(v); e++) from[e] = v;
+    }
+    for (int e : topIndices(report.edgeFlow, top)) {
+        int line = index->edgeLine(e);
+        out << std::setw(10) << report.edgeFlow[e] << std::setw(7) << std::setprecision(1)
+            << 100.0 * report.edgeFlow[e] / routed << "%  " << std::left
+            << std::setw(9) << typeName(index->edgeType(e))
+            << std::setw(18) << (line >= 0 ? index->lineName(line) : "-")
+            << index->nameOf(from[e]) << " -> " << index->nameOf(index->edgeTarget(e)) << "\n"
+            << std::right;
+    }
+
+    out << "\nBusiest stations\n";
+    out << std::setw(10) << "through" << std::setw(10) << "board" << std::setw(10) << "alight"
+        << std::setw(10) << "change" << "  station\n";
+    for (int v : topIndices(report.throughput, top)) {
+        out << std::setw(10) << report.throughput[v] << std::setw(10) << report.boardings[v]
+            << std::setw(10) << report.alightings[v] << std::setw(10) << report.transfers[v]
+            << "  " << index->nameOf(v) << "\n";
+    }
+}
+
+void FlowSimulator::writeEdgeCSV(std::ostream& out, const FlowReport& report) const {
+    out << "from,to,type,line,km,trips\n";
+    out << std::fixed << std::setprecision(3);
+    for (int v = 0; v < index->size(); v++) {
+        for (int e = index->edgeBegin(v); e < index->edgeEnd(v); e++) {
+            if (report.edgeFlow[e] == 0) continue;
+            int line = index->edgeLine(e);
+            out << index->nameOf(v) << "," << index->nameOf(index->edgeTarget(e)) << ","
+                << typeName(index->edgeType(e)) << "," << (line >= 0 ? index->lineName(line) : "") << ","
+                << index->edgeWeight(e) << "," << report.edgeFlow[e] << "\n";
+        }
+    }
+}
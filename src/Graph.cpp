@@ -1,4 +1,18 @@
 #include "Graph.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "StringPool.h"
+#include "SpatialIndex.h"
+#include "CompactGraph.h"
+#include "RouteKernel.h"
+#include "RouteResult.h"
+#include "HubLabels.h"
+#include "CancelToken.h"
+#include "WeightOverlay.h"
+#include "HopReachability.h"
+#include "LineIndex.h"
+#include "MultiLevelOverlay.h"
+#include "ThreadPool.h"
 #include <iostream>
 #include <algorithm>
 #include <unordered_set>
@@ -10,12 +24,20 @@
 #include <set>
 #include <tuple>
 
+// A criterion's overlay metric and the live conditions it was customized with
+struct OverlayCustomization {
+    std::shared_ptr<const OverlayMetric> metric;
+    bool live = false;
+    uint64_t sequence = 0;      // WeightOverlay::View::getSequence() when live
+};
+
 void Graph::addStation(const std::string& name, const std::string& line,
                        int zone, double lat, double lon) {
     if (stations.find(name) == stations.end()) {
+        invalidateIndexes();
         stations[name] = Station(name, line, zone, lat, lon);
         if (adjList.find(name) == adjList.end()) {
-            adjList[name] = std::vector<std::pair<std::string, double>>();
+            adjList[name] = std::vector<Edge>();
         }
     }
 }
@@ -24,19 +46,78 @@ void Graph::addEdge(const std::string& station1, const std::string& station2,
                     double distance) {
     if (stations.find(station1) != stations.end() && 
         stations.find(station2) != stations.end()) {
-        adjList[station1].push_back({station2, distance});
-        adjList[station2].push_back({station1, distance});
+        const std::string& line1 = stations[station1].getMetroLine();
+        const std::string& line2 = stations[station2].getMetroLine();
+        if (line1 == line2) {
+            invalidateIndexes();
+            const std::string* pooled = &StringPool::shared().intern(line1);
+            adjList[station1].push_back({station2, distance, EdgeType::Ride, pooled});
+            adjList[station2].push_back({station1, distance, EdgeType::Ride, pooled});
+        } else {
+            addTransfer(station1, station2, distance);
+        }
+    }
+}
+
+void Graph::addDirectedEdge(const std::string& from, const std::string& to, double distance,
+                            EdgeType type, const std::string& line) {
+    if (stations.find(from) != stations.end() && stations.find(to) != stations.end()) {
+        invalidateIndexes();
+        adjList[from].push_back({to, distance, type,
+                                 &StringPool::shared().intern(type == EdgeType::Ride ? line : "")});
+    }
+}
+
+void Graph::addTransfer(const std::string& station1, const std::string& station2, double distance) {
+    addDirectedEdge(station1, station2, distance, EdgeType::Transfer);
+    addDirectedEdge(station2, station1, distance, EdgeType::Transfer);
+}
+
+int Graph::generateWalkingLinks(double maxKm) {
+    if (maxKm <= 0) return 0;
+    SpatialIndex index(stations, maxKm);
+    int linked = 0;
+    for (const auto& pair : stations) {
+        const Station& from = pair.second;
+        for (const auto& name : index.withinKm(from.getLatitude(), from.getLongitude(), maxKm)) {
+            // Visit each unordered pair once and keep existing links as they are
+            if (!(pair.first < name) || hasEdgeTo(pair.first, name) || hasEdgeTo(name, pair.first)) {
+                continue;
+            }
+            double km = from.distanceKmTo(stations.at(name));
+            addDirectedEdge(pair.first, name, km, EdgeType::Walk);
+            addDirectedEdge(name, pair.first, km, EdgeType::Walk);
+            linked++;
+        }
+    }
+    return linked;
+}
+
+bool Graph::hasEdgeTo(const std::string& from, const std::string& to) const {
+    return getEdge(from, to) != nullptr;
+}
+
+const Edge* Graph::getEdge(const std::string& from, const std::string& to) const {
+    auto it = adjList.find(from);
+    if (it == adjList.end()) return nullptr;
+    const Edge* best = nullptr;
+    for (const auto& edge : it->second) {
+        if (edge.to == to && (best == nullptr || edge.weight < best->weight)) {
+            best = &edge;
+        }
     }
+    return best;
 }
 
 // Remove a station and all its edges
 bool Graph::removeStation(const std::string& name) {
     if (stations.find(name) == stations.end()) return false;
+    invalidateIndexes();
     stations.erase(name);
     adjList.erase(name);
-    for (std::unordered_map<std::string, std::vector<std::pair<std::string, double>>>::iterator it = adjList.begin(); it != adjList.end(); ++it) {
-        std::vector<std::pair<std::string, double> >& v = it->second;
-        v.erase(std::remove_if(v.begin(), v.end(), [&](const std::pair<std::string, double>& p) { return p.first == name; }), v.end());
+    for (std::unordered_map<std::string, std::vector<Edge>>::iterator it = adjList.begin(); it != adjList.end(); ++it) {
+        std::vector<Edge>& v = it->second;
+        v.erase(std::remove_if(v.begin(), v.end(), [&](const Edge& e) { return e.to == name; }), v.end());
     }
     return true;
 }
@@ -44,14 +125,15 @@ bool Graph::removeStation(const std::string& name) {
 // Remove an edge between two stations
 bool Graph::removeEdge(const std::string& station1, const std::string& station2) {
     bool found = false;
+    invalidateIndexes();
     if (adjList.find(station1) != adjList.end()) {
         auto& v = adjList[station1];
-        auto it = std::remove_if(v.begin(), v.end(), [&](const auto& p) { return p.first == station2; });
+        auto it = std::remove_if(v.begin(), v.end(), [&](const Edge& e) { return e.to == station2; });
         if (it != v.end()) { v.erase(it, v.end()); found = true; }
     }
     if (adjList.find(station2) != adjList.end()) {
         auto& v = adjList[station2];
-        auto it = std::remove_if(v.begin(), v.end(), [&](const auto& p) { return p.first == station1; });
+        auto it = std::remove_if(v.begin(), v.end(), [&](const Edge& e) { return e.to == station1; });
         if (it != v.end()) { v.erase(it, v.end()); found = true; }
     }
     return found;
@@ -68,8 +150,8 @@ std::vector<std::string> Graph::bfs(const std::string& start) const {
         std::string curr = q.front(); q.pop();
         order.push_back(curr);
         for (const auto& edge : adjList.at(curr)) {
-            if (visited.insert(edge.first).second) {
-                q.push(edge.first);
+            if (visited.insert(edge.to).second) {
+                q.push(edge.to);
             }
         }
     }
@@ -88,7 +170,7 @@ std::vector<std::string> Graph::dfs(const std::string& start) const {
         if (visited.insert(curr).second) {
             order.push_back(curr);
             for (const auto& edge : adjList.at(curr)) {
-                if (!visited.count(edge.first)) s.push(edge.first);
+                if (!visited.count(edge.to)) s.push(edge.to);
             }
         }
     }
@@ -96,9 +178,11 @@ std::vector<std::string> Graph::dfs(const std::string& start) const {
 }
 
 // Helper for all-paths (recursive)
+// (the count of paths grows exponentially, so it stops early when cancelled)
 void findAllPathsUtil(const std::string& u, const std::string& d, std::unordered_set<std::string>& visited,
                       std::vector<std::string>& path, std::vector<std::vector<std::string>>& paths,
-                      const std::unordered_map<std::string, std::vector<std::pair<std::string, double>>>& adjList) {
+                      const std::unordered_map<std::string, std::vector<Edge>>& adjList, unsigned& ticks) {
+    if (CancelToken::poll(ticks)) return;
     visited.insert(u);
     path.push_back(u);
     if (u == d) {
@@ -107,8 +191,8 @@ void findAllPathsUtil(const std::string& u, const std::string& d, std::unordered
         auto it = adjList.find(u);
         if (it != adjList.end()) {
             for (const auto& edge : it->second) {
-                if (!visited.count(edge.first)) {
-                    findAllPathsUtil(edge.first, d, visited, path, paths, adjList);
+                if (!visited.count(edge.to)) {
+                    findAllPathsUtil(edge.to, d, visited, path, paths, adjList, ticks);
                 }
             }
         }
@@ -123,21 +207,22 @@ std::vector<std::vector<std::string>> Graph::findAllPaths(const std::string& sou
     if (!hasStation(source) || !hasStation(destination)) return paths;
     std::unordered_set<std::string> visited;
     std::vector<std::string> path;
-    findAllPathsUtil(source, destination, visited, path, paths, adjList);
+    unsigned ticks = 0;
+    findAllPathsUtil(source, destination, visited, path, paths, adjList, ticks);
     return paths;
 }
 
 // Helper for cycle detection
 bool hasCycleUtil(const std::string& v, const std::string& parent,
                   std::unordered_set<std::string>& visited,
-                  const std::unordered_map<std::string, std::vector<std::pair<std::string, double>>>& adjList) {
+                  const std::unordered_map<std::string, std::vector<Edge>>& adjList) {
     visited.insert(v);
     auto it = adjList.find(v);
     if (it != adjList.end()) {
         for (const auto& edge : it->second) {
-            if (!visited.count(edge.first)) {
-                if (hasCycleUtil(edge.first, v, visited, adjList)) return true;
-            } else if (edge.first != parent) {
+            if (!visited.count(edge.to)) {
+                if (hasCycleUtil(edge.to, v, visited, adjList)) return true;
+            } else if (edge.to != parent) {
                 return true;
             }
         }
@@ -170,8 +255,8 @@ std::vector<std::vector<std::string>> Graph::connectedComponents() const {
                 std::string curr = q.front(); q.pop();
                 comp.push_back(curr);
                 for (const auto& edge : adjList.at(curr)) {
-                    if (visited.insert(edge.first).second) {
-                        q.push(edge.first);
+                    if (visited.insert(edge.to).second) {
+                        q.push(edge.to);
                     }
                 }
             }
@@ -196,8 +281,8 @@ std::vector<std::tuple<std::string, std::string, double>> Graph::minimumSpanning
     // Start from any station
     std::string start = stations.begin()->first;
     inMST.insert(start);
-    for (std::vector<std::pair<std::string, double> >::const_iterator it = adjList.at(start).begin(); it != adjList.at(start).end(); ++it) {
-        pq.push(std::make_tuple(it->second, start, it->first));
+    for (std::vector<Edge>::const_iterator it = adjList.at(start).begin(); it != adjList.at(start).end(); ++it) {
+        pq.push(std::make_tuple(it->weight, start, it->to));
     }
     while (!pq.empty() && inMST.size() < stations.size()) {
         double weight;
@@ -206,9 +291,9 @@ std::vector<std::tuple<std::string, std::string, double>> Graph::minimumSpanning
         if (inMST.count(v)) continue;
         inMST.insert(v);
         mst.push_back(std::make_tuple(u, v, weight));
-        for (std::vector<std::pair<std::string, double> >::const_iterator it2 = adjList.at(v).begin(); it2 != adjList.at(v).end(); ++it2) {
-            if (!inMST.count(it2->first)) {
-                pq.push(std::make_tuple(it2->second, v, it2->first));
+        for (std::vector<Edge>::const_iterator it2 = adjList.at(v).begin(); it2 != adjList.at(v).end(); ++it2) {
+            if (!inMST.count(it2->to)) {
+                pq.push(std::make_tuple(it2->weight, v, it2->to));
             }
         }
     }
@@ -225,79 +310,79 @@ const Station* Graph::getStation(const std::string& name) const {
 }
 
 int Graph::getEdgeCount() const {
+    // Two-way links count once, one-way edges count once
     int count = 0;
     for (const auto& pair : adjList) {
-        count += pair.second.size();
-    }
-    return count / 2; // undirected graph
-}
-
-std::string Graph::getCurrentLine(const std::string& from, const std::string& to) {
-    auto it = stations.find(to);
-    if (it != stations.end()) {
-        return it->second.getMetroLine();
+        for (const auto& edge : pair.second) {
+            count += hasEdgeTo(edge.to, pair.first) ? 1 : 2;
+        }
     }
-    return "Unknown";
+    return count / 2;
 }
 
 void Graph::reconstructPath(const std::unordered_map<std::string, std::string>& parent,
-                            const std::string& destination, PathInfo& result) {
-    std::vector<std::string> path;
-    std::string current = destination;
-    
-    while (!current.empty()) {
-        path.push_back(current);
-        auto it = parent.find(current);
+                            const std::string& destination, PathInfo& result) const {
+    // Built in place, back to front, then reversed
+    std::vector<std::string>& path = result.path;
+    path.clear();
+    const std::string* current = &destination;
+    while (true) {
+        path.push_back(*current);
+        auto it = parent.find(*current);
         if (it == parent.end() || it->second.empty()) {
             break;
         }
-        current = it->second;
+        current = &it->second;
     }
     
     std::reverse(path.begin(), path.end());
-    result.path = path;
-    
-    // Extract metro lines used
-    std::unordered_set<std::string> linesSet;
-    for (const auto& station : path) {
-        auto stIt = stations.find(station);
-        if (stIt != stations.end()) {
-            linesSet.insert(stIt->second.getMetroLine());
+    describePath(result);
+}
+
+// Lines, transfers and travel time for result.path. Lines come from the ride
+// edges actually used, in travel order. A run of transfer / walk edges, or a
+// ride on a different line, is one transfer.
+void Graph::describePath(PathInfo& result) const {
+    const std::vector<std::string>& path = result.path;
+    result.transferPoints = 0;
+    result.travelMinutes = 0;
+    result.metroLines.clear();
+    // Line names are pooled (StringPool), so lines compare by pointer
+    const std::string* currentLine = nullptr;
+    bool changing = false;
+    for (size_t i = 1; i < path.size(); i++) {
+        const Edge* edge = getEdge(path[i - 1], path[i]);
+        if (edge != nullptr) {
+            result.travelMinutes += costModel.edgeMinutes(edge->type, edge->weight);
         }
+        if (edge == nullptr || edge->type != EdgeType::Ride || edge->lineName().empty()) {
+            if (!changing) result.transferPoints++;
+            changing = true;
+            currentLine = nullptr;
+            continue;
+        }
+        if (currentLine != nullptr && edge->line != currentLine) {
+            result.transferPoints++;
+        }
+        changing = false;
+        if (edge->line != currentLine &&
+            std::find(result.metroLines.begin(), result.metroLines.end(), *edge->line) == result.metroLines.end()) {
+            result.metroLines.push_back(*edge->line);
+        }
+        currentLine = edge->line;
     }
+    result.travelMinutes += result.transferPoints * costModel.transferSeconds / 60.0;
     
-    for (const auto& line : linesSet) {
-        result.metroLines.push_back(line);
-    }
-    
-    // Count transfers
-    if (path.size() > 1) {
-        result.transferPoints = 0;
-        std::string currentLine = stations.find(path[0])->second.getMetroLine();
-        for (size_t i = 1; i < path.size(); i++) {
-            std::string nextLine = stations.find(path[i])->second.getMetroLine();
-            if (nextLine != currentLine) {
-                result.transferPoints++;
-                currentLine = nextLine;
-            }
-        }
+    if (result.metroLines.empty() && !path.empty()) {
+        result.metroLines.push_back(stations.find(path[0])->second.getMetroLine());
     }
 }
 
-// Dijkstra's Algorithm - O((V+E)log V)
-PathInfo Graph::findShortestPath(const std::string& source, 
-                                  const std::string& destination) {
-    PathInfo result;
-    result.totalDistance = -1;
-    result.estimatedFare = 0;
-    result.transferPoints = 0;
-    
-    if (!hasStation(source) || !hasStation(destination)) {
-        return result;
-    }
-    
+// Dijkstra restricted to stations in zones <= zoneCap.
+// Fills parent and returns the distance to destination, or -1 if unreachable.
+double Graph::runDijkstra(const std::string& source, const std::string& destination, int zoneCap,
+                          std::unordered_map<std::string, std::string>& parent) const {
     std::unordered_map<std::string, double> distance;
-    std::unordered_map<std::string, std::string> parent;
     std::unordered_set<std::string> visited;
     
     // Priority queue: (distance, station)
@@ -317,16 +402,27 @@ PathInfo Graph::findShortestPath(const std::string& source,
     parent[source] = "";
     pq.push({0, source});
     
+    // Work counters are kept local and published once per query
+    uint64_t pushes = 1, pops = 0, settled = 0, relaxed = 0;
+    
     // Dijkstra's main loop
+    unsigned ticks = 0;
+    bool cancelled = false;
     while (!pq.empty()) {
+        if (CancelToken::poll(ticks)) {
+            cancelled = true;
+            break;
+        }
         double currentDist = pq.top().first;
         std::string currentStation = pq.top().second;
         pq.pop();
+        pops++;
         
         if (visited.find(currentStation) != visited.end()) {
             continue;
         }
         visited.insert(currentStation);
+        settled++;
         
         if (currentStation == destination) {
             break;
@@ -337,34 +433,517 @@ PathInfo Graph::findShortestPath(const std::string& source,
         }
         
         // Check neighbors
-        for (const auto& edge : adjList[currentStation]) {
-            const auto& neighbor = edge.first;
-            double weight = edge.second;
+        for (const auto& edge : adjList.at(currentStation)) {
+            const auto& neighbor = edge.to;
+            double weight = edge.weight;
+            if (stations.at(neighbor).getZone() > zoneCap) {
+                continue;
+            }
             if (visited.find(neighbor) == visited.end()) {
                 double newDist = currentDist + weight;
+                relaxed++;
                 if (newDist < distance[neighbor]) {
                     distance[neighbor] = newDist;
                     parent[neighbor] = currentStation;
                     pq.push({newDist, neighbor});
+                    pushes++;
                 }
             }
         }
     }
     
-    if (distance[destination] >= 1e9) {
+    if (Metrics::enabled()) {
+        Metrics::add(Counter::NodesSettled, settled);
+        Metrics::add(Counter::EdgesRelaxed, relaxed);
+        Metrics::add(Counter::HeapPushes, pushes);
+        Metrics::add(Counter::HeapPops, pops);
+    }
+    
+    if (cancelled || distance[destination] >= 1e9) {
+        return -1; // No path found (or the query was cancelled)
+    }
+    return distance[destination];
+}
+
+int Graph::maxZoneOnPath(const std::vector<std::string>& path) const {
+    int maxZone = 0;
+    for (const auto& station : path) {
+        maxZone = std::max(maxZone, getStation(station)->getZone());
+    }
+    return maxZone;
+}
+
+// Dijkstra's Algorithm - O((V+E)log V)
+PathInfo Graph::findShortestPath(const std::string& source, 
+                                  const std::string& destination) const {
+    ScopedTimer timer(Timer::RouteQuery);
+    TraceSpan span("findShortestPath", "query", source + " -> " + destination);
+    Metrics::add(Counter::RouteQueries);
+    PathInfo result;
+    result.totalDistance = -1;
+    result.estimatedFare = 0;
+    result.transferPoints = 0;
+    
+    if (!hasStation(source) || !hasStation(destination)) {
+        return result;
+    }
+    
+    std::unordered_map<std::string, std::string> parent;
+    double distance = runDijkstra(source, destination, INT_MAX, parent);
+    if (distance < 0) {
         return result; // No path found
     }
     
-    result.totalDistance = distance[destination];
+    result.totalDistance = distance;
     reconstructPath(parent, destination, result);
     
     // Calculate fare based on zones
-    int maxZone = 0;
-    for (const auto& station : result.path) {
-        maxZone = std::max(maxZone, getStation(station)->getZone());
+    result.estimatedFare = fareCalc.calculateFare(result.totalDistance, maxZoneOnPath(result.path));
+    
+    return result;
+}
+
+// Cheapest route by fare. The distance part of the fare is additive
+// (costPerKm per km), but the zone charge depends on the highest zone used,
+// so run one distance-minimizing search per zone cap and keep the cheapest.
+// Assumes zone charges do not decrease as the zone number grows.
+PathInfo Graph::findCheapestPath(const std::string& source,
+                                 const std::string& destination) const {
+    ScopedTimer timer(Timer::RouteQuery);
+    TraceSpan span("findCheapestPath", "query", source + " -> " + destination);
+    Metrics::add(Counter::RouteQueries);
+    PathInfo best;
+    best.totalDistance = -1;
+    best.estimatedFare = 0;
+    best.transferPoints = 0;
+    
+    if (!hasStation(source) || !hasStation(destination)) {
+        return best;
+    }
+    
+    int minCap = std::max(getStation(source)->getZone(), getStation(destination)->getZone());
+    std::set<int> zoneCaps;
+    for (const auto& station : stations) {
+        if (station.second.getZone() >= minCap) {
+            zoneCaps.insert(station.second.getZone());
+        }
     }
-    result.estimatedFare = 10 + (int)(maxZone * 3) + (int)(result.totalDistance * 1.5);
     
+    for (int cap : zoneCaps) {
+        std::unordered_map<std::string, std::string> parent;
+        double distance = runDijkstra(source, destination, cap, parent);
+        if (distance < 0) continue;
+        
+        PathInfo candidate;
+        candidate.totalDistance = distance;
+        candidate.transferPoints = 0;
+        reconstructPath(parent, destination, candidate);
+        candidate.estimatedFare = fareCalc.calculateFare(distance, maxZoneOnPath(candidate.path));
+        
+        if (best.totalDistance < 0 || candidate.estimatedFare < best.estimatedFare ||
+            (candidate.estimatedFare == best.estimatedFare && distance < best.totalDistance)) {
+            best = candidate;
+        }
+    }
+    
+    return best;
+}
+
+std::shared_ptr<const CompactGraph> Graph::getRoutingIndex() const {
+    // Concurrent first calls may both build; either snapshot is valid
+    std::shared_ptr<const CompactGraph> index = std::atomic_load(&routingIndex);
+    if (!index) {
+        index = std::make_shared<const CompactGraph>(*this, stationOrder);
+        if (compressedRouting) {
+            std::shared_ptr<const CompactGraph> packed = index->compressed();
+            if (packed) index = std::move(packed);
+        }
+        std::atomic_store(&routingIndex, index);
+        std::shared_ptr<WeightOverlay> overlay = std::atomic_load(&weightOverlay);
+        if (overlay) overlay->bind(index);
+    }
+    return index;
+}
+
+size_t Graph::memoryBytes() const {
+    // Hash map node: value + next pointer + cached hash
+    const size_t nodeOverhead = 2 * sizeof(void*);
+    size_t bytes = (stations.bucket_count() + adjList.bucket_count()) * sizeof(void*);
+    for (const auto& pair : stations) {
+        bytes += sizeof(pair) + nodeOverhead + StringPool::heapBytes(pair.first) +
+                 StringPool::heapBytes(pair.second.getName());
+    }
+    for (const auto& pair : adjList) {
+        bytes += sizeof(pair) + nodeOverhead + StringPool::heapBytes(pair.first) +
+                 pair.second.capacity() * sizeof(Edge);
+        for (const auto& edge : pair.second) {
+            bytes += StringPool::heapBytes(edge.to);
+        }
+    }
+    std::shared_ptr<const CompactGraph> index = std::atomic_load(&routingIndex);
+    if (index) bytes += index->memoryBytes();
+    std::shared_ptr<const HubLabels> labels = std::atomic_load(&hubLabels);
+    if (labels) bytes += labels->memoryBytes();
+    std::shared_ptr<const HopGraph> hops = std::atomic_load(&hopGraph);
+    if (hops) bytes += hops->memoryBytes();
+    std::shared_ptr<const LineIndex> lines = std::atomic_load(&lineIndex);
+    if (lines) bytes += lines->memoryBytes();
+    std::shared_ptr<const MultiLevelOverlay> cells = std::atomic_load(&multiLevelOverlay);
+    if (cells) bytes += cells->memoryBytes();
+    for (const auto& slot : overlayMetrics) {
+        std::shared_ptr<const OverlayCustomization> customized = std::atomic_load(&slot);
+        if (customized) bytes += customized->metric->memoryBytes();
+    }
+    return bytes;
+}
+
+void Graph::setRoutingIndex(std::shared_ptr<const CompactGraph> index) {
+    if (index && compressedRouting && !index->isCompressed()) {
+        std::shared_ptr<const CompactGraph> packed = index->compressed();
+        if (packed) index = std::move(packed);
+    }
+    std::atomic_store(&routingIndex, index);
+    std::shared_ptr<WeightOverlay> overlay = std::atomic_load(&weightOverlay);
+    if (overlay) overlay->bind(index);
+}
+
+void Graph::setStationOrder(StationOrder order) {
+    if (order == stationOrder) return;
+    stationOrder = order;
+    invalidateIndexes();
+}
+
+void Graph::setCompressedRouting(bool compressed) {
+    if (compressed == compressedRouting) return;
+    compressedRouting = compressed;
+    invalidateIndexes();
+}
+
+std::shared_ptr<const HopGraph> Graph::getHopGraph() const {
+    std::shared_ptr<const CompactGraph> index = getRoutingIndex();
+    std::shared_ptr<const HopGraph> hops = std::atomic_load(&hopGraph);
+    if (!hops || hops->getIndex() != index) {
+        hops = std::make_shared<const HopGraph>(index);
+        std::atomic_store(&hopGraph, hops);
+    }
+    return hops;
+}
+
+std::shared_ptr<const LineIndex> Graph::getLineIndex() const {
+    std::shared_ptr<const CompactGraph> index = getRoutingIndex();
+    std::shared_ptr<const LineIndex> lines = std::atomic_load(&lineIndex);
+    if (!lines || lines->getIndex() != index) {
+        lines = std::make_shared<const LineIndex>(index);
+        std::atomic_store(&lineIndex, lines);
+    }
+    return lines;
+}
+
+void Graph::setCostModel(const CostModel& model) {
+    costModel = model;
+    dropOverlayMetrics();
+}
+
+void Graph::setMultiLevelOverlay(std::shared_ptr<const MultiLevelOverlay> overlay) {
+    std::atomic_store(&multiLevelOverlay, overlay);
+    dropOverlayMetrics();
+}
+
+std::shared_ptr<const MultiLevelOverlay> Graph::getMultiLevelOverlay() const {
+    return std::atomic_load(&multiLevelOverlay);
+}
+
+void Graph::dropOverlayMetrics() const {
+    for (auto& slot : overlayMetrics) std::atomic_store(&slot, std::shared_ptr<const OverlayCustomization>());
+}
+
+void Graph::setHubLabels(std::shared_ptr<const HubLabels> labels) {
+    std::atomic_store(&hubLabels, labels);
+}
+
+std::shared_ptr<const HubLabels> Graph::getHubLabels() const {
+    return std::atomic_load(&hubLabels);
+}
+
+void Graph::setWeightOverlay(std::shared_ptr<WeightOverlay> overlay) {
+    std::atomic_store(&weightOverlay, overlay);
+    if (overlay) overlay->bind(getRoutingIndex());
+}
+
+std::shared_ptr<WeightOverlay> Graph::getWeightOverlay() const {
+    return std::atomic_load(&weightOverlay);
+}
+
+void Graph::invalidateIndexes() {
+    routingIndex.reset();
+    hubLabels.reset();
+    hopGraph.reset();
+    lineIndex.reset();
+    multiLevelOverlay.reset();
+    dropOverlayMetrics();
+}
+
+namespace {
+
+// One workspace per key type and search kind per thread, reused across queries
+template <typename Key, bool States>
+KernelWorkspace<Key>& kernelWorkspace() {
+    thread_local KernelWorkspace<Key> workspace;
+    return workspace;
+}
+
+// Runs the kernel and writes the route's stations and the edges between them
+template <typename Cost>
+bool runKernel(const CompactGraph& index, int source, int target, const Cost& cost,
+               std::vector<int>& route, std::vector<int>& edges) {
+    auto& ws = kernelWorkspace<typename Cost::Key, Cost::LINE_CHANGES>();
+    if (!RouteKernel::run(index, source, target, cost, ws)) return false;
+    RouteKernel::route(index, ws, target, route, edges);
+    return true;
+}
+
+// Legs, transfers, distance and time of result.stations/edges. Same transfer
+// rule as Graph::describePath and the line-aware kernels: a run of transfer /
+// walk edges, or a ride on a different line, is one transfer, and each
+// transfer adds the transfer penalty to the time.
+void describeRoute(const CompactGraph& index, const CostModel& model, RouteResult& result) {
+    result.totalDistance = 0;
+    result.travelMinutes = 0;
+    result.transferPoints = 0;
+    int currentLine = -1;
+    bool changing = false;
+    for (size_t i = 0; i < result.edges.size(); i++) {
+        int e = result.edges[i];
+        EdgeType type = index.edgeType(e);
+        int line = index.edgeLine(e);
+        double km = index.edgeWeight(e);
+        result.totalDistance += km;
+        result.travelMinutes += model.edgeMinutes(type, km);
+
+        uint32_t at = static_cast<uint32_t>(i);
+        if (type != EdgeType::Ride) {
+            if (!changing) {
+                result.transferPoints++;
+                result.transfers.push_back(at);
+            }
+            changing = true;
+            currentLine = -1;
+        } else {
+            if (currentLine >= 0 && line != currentLine) {
+                result.transferPoints++;
+                result.transfers.push_back(at);
+            }
+            changing = false;
+            currentLine = line;
+        }
+
+        if (result.legs.empty() || result.legs.back().type != type || result.legs.back().line != line) {
+            result.legs.push_back({type, line, at, at + 1, km});
+        } else {
+            result.legs.back().to = at + 1;
+            result.legs.back().km += km;
+        }
+    }
+    result.travelMinutes += result.transferPoints * model.transferSeconds / 60.0;
+}
+
+// Cost policies as they are, or wrapped to read an overlay's live conditions
+struct PlainWeights {
+    template <typename Cost>
+    Cost operator()(const Cost& cost, typename Cost::Key) const { return cost; }
+};
+
+struct LiveWeights {
+    const std::atomic<uint32_t>* words;
+    template <typename Cost>
+    LiveCost<Cost> operator()(const Cost& cost, typename Cost::Key perSecond) const {
+        return LiveCost<Cost>(cost, words, perSecond);
+    }
+};
+
+// The customized overlay metric for a criterion if it was customized under
+// the live conditions the query sees; nullptr when there is none, and the
+// query searches the index instead. Queries never customize.
+std::shared_ptr<const OverlayMetric> overlayMetric(const std::shared_ptr<const OverlayCustomization>& slot,
+                                                   const std::shared_ptr<const MultiLevelOverlay>& cells,
+                                                   const CompactGraph& index, RouteCriterion criterion,
+                                                   const WeightOverlay::View& live) {
+    if (!cells || cells->getIndex().get() != &index || !MultiLevelOverlay::supports(criterion)) return nullptr;
+    bool conditions = static_cast<bool>(live);
+    std::shared_ptr<const OverlayCustomization> current = std::atomic_load(&slot);
+    if (current && current->metric->getOverlay() == cells && current->live == conditions &&
+        (!conditions || current->sequence == live.getSequence())) {
+        return current->metric;
+    }
+    return nullptr;
+}
+
+// Customize the metric for the current live conditions into slot, unless
+// it already holds them
+void customizeMetric(std::shared_ptr<const OverlayCustomization>& slot,
+                     const std::shared_ptr<const MultiLevelOverlay>& cells, const CompactGraph& index,
+                     RouteCriterion criterion, const CostModel& model, const WeightOverlay* overlay,
+                     ThreadPool* pool) {
+    WeightOverlay::View live = overlay ? overlay->view(index) : WeightOverlay::View();
+    if (overlayMetric(slot, cells, index, criterion, live)) return;
+    bool conditions = static_cast<bool>(live);
+    std::shared_ptr<OverlayCustomization> fresh = std::make_shared<OverlayCustomization>();
+    fresh->metric = OverlayMetric::customize(cells, criterion, model, conditions ? live.words() : nullptr, pool);
+    fresh->live = conditions;
+    fresh->sequence = conditions ? live.getSequence() : 0;
+    std::atomic_store(&slot, std::shared_ptr<const OverlayCustomization>(std::move(fresh)));
+}
+
+// One search for the criterion into result.stations/edges; labels, lines
+// and metric are nullptr when they must not be used
+template <typename Weights>
+bool searchRoute(const CompactGraph& index, int s, int t, RouteCriterion criterion, const CostModel& model,
+                 const FareCalculator& fares, const HubLabels* labels, const LineIndex* lines,
+                 const OverlayMetric* metric, const Weights& weights, RouteResult& result) {
+    // Overlay metrics carry the live conditions they were customized with
+    bool overlay = metric && metric->getCriterion() == criterion;
+    switch (criterion) {
+        case RouteCriterion::Distance:
+            // Hub labels answer the same metric without a search
+            if (labels) return labels->path(s, t, result.stations, result.edges);
+            if (overlay) return metric->route(s, t, result.stations, result.edges);
+            return runKernel(index, s, t, weights(DistanceCost(), 0), result.stations, result.edges);
+        case RouteCriterion::Time:
+            if (overlay) return metric->route(s, t, result.stations, result.edges);
+            return runKernel(index, s, t, weights(TimeCost(model), 1000), result.stations, result.edges);
+        case RouteCriterion::Transfers:
+            // A ride along one line has no changes, so the shortest one is the
+            // route; covers() rules out lines the index has no sequences for
+            if (lines && (lines->covers(s) || lines->covers(t))) {
+                LineIndex::Segment segment = lines->sameLine(s, t);
+                if (segment.found()) {
+                    lines->path(segment, result.stations, result.edges);
+                    return true;
+                }
+            }
+            if (overlay) return metric->route(s, t, result.stations, result.edges);
+            return runKernel(index, s, t, weights(TransferCost(), 0), result.stations, result.edges);
+        case RouteCriterion::Weighted: {
+            if (overlay) return metric->route(s, t, result.stations, result.edges);
+            WeightedCost cost(model);
+            return runKernel(index, s, t, weights(cost, cost.delay), result.stations, result.edges);
+        }
+        case RouteCriterion::Fare: {
+            // Same search as findCheapestPath: one capped search per zone
+            int minCap = std::max(index.zoneOf(s), index.zoneOf(t));
+            std::set<int> zoneCaps;
+            for (int v = 0; v < index.size(); v++) {
+                if (index.zoneOf(v) >= minCap) zoneCaps.insert(index.zoneOf(v));
+            }
+            thread_local std::vector<int> candidate, candidateEdges;
+            bool found = false;
+            int bestFare = 0;
+            double bestKm = 0;
+            for (int cap : zoneCaps) {
+                FareCost cost{&index, cap};
+                if (!runKernel(index, s, t, weights(cost, 0), candidate, candidateEdges)) continue;
+                double km = 0;
+                int maxZone = 0;
+                for (int v : candidate) maxZone = std::max(maxZone, index.zoneOf(v));
+                for (int e : candidateEdges) km += index.edgeWeight(e);
+                int fare = fares.calculateFare(km, maxZone);
+                if (!found || fare < bestFare || (fare == bestFare && km < bestKm)) {
+                    found = true;
+                    bestFare = fare;
+                    bestKm = km;
+                    result.stations.swap(candidate);
+                    result.edges.swap(candidateEdges);
+                }
+            }
+            return found;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+// The criterion is resolved once per query into a specialized kernel; the
+// search loops themselves have no runtime cost switch.
+bool Graph::findRoute(int source, int destination, RouteCriterion criterion,
+                      const CompactGraph& index, RouteResult& result) const {
+    ScopedTimer timer(Timer::RouteQuery);
+    Metrics::add(Counter::RouteQueries);
+    result.clear();
+    if (source < 0 || destination < 0 || source >= index.size() || destination >= index.size()) {
+        return false;
+    }
+
+    std::shared_ptr<const HubLabels> labels = std::atomic_load(&hubLabels);
+    if (labels && !labels->matches(index)) labels.reset();
+    std::shared_ptr<const LineIndex> lines;
+    if (criterion == RouteCriterion::Transfers) {
+        lines = getLineIndex();
+        if (lines->getIndex().get() != &index) lines.reset();
+    }
+    std::shared_ptr<WeightOverlay> overlay = std::atomic_load(&weightOverlay);
+    std::shared_ptr<const MultiLevelOverlay> cells = std::atomic_load(&multiLevelOverlay);
+    const std::shared_ptr<const OverlayCustomization>& slot = overlayMetrics[static_cast<int>(criterion)];
+
+    // The view's words are one batch and do not change while it is held
+    bool found = false;
+    uint64_t delaySeconds = 0;
+    WeightOverlay::View live = overlay ? overlay->view(index) : WeightOverlay::View();
+    std::shared_ptr<const OverlayMetric> metric = overlayMetric(slot, cells, index, criterion, live);
+    if (!live) {
+        found = searchRoute(index, source, destination, criterion, costModel, fareCalc, labels.get(),
+                            lines.get(), metric.get(), PlainWeights(), result);
+    } else {
+        // Labels and line sequences know nothing of closures; delays alone
+        // do not change distances or changes
+        bool closures = live.hasClosures();
+        found = searchRoute(index, source, destination, criterion, costModel, fareCalc,
+                            closures ? nullptr : labels.get(), closures ? nullptr : lines.get(), metric.get(),
+                            LiveWeights{live.words()}, result);
+        for (int e : result.edges) delaySeconds += live.seconds(e);
+    }
+    if (!found) {
+        result.clear();
+        return false;
+    }
+
+    describeRoute(index, costModel, result);
+    result.travelMinutes += delaySeconds / 60.0;
+    int maxZone = 0;
+    for (int v : result.stations) maxZone = std::max(maxZone, index.zoneOf(v));
+    result.estimatedFare = fareCalc.calculateFare(result.totalDistance, maxZone);
+    return true;
+}
+
+void Graph::customizeOverlay(ThreadPool* pool) const {
+    std::shared_ptr<const MultiLevelOverlay> cells = std::atomic_load(&multiLevelOverlay);
+    if (!cells) return;
+    std::shared_ptr<const CompactGraph> index = getRoutingIndex();
+    std::shared_ptr<WeightOverlay> overlay = std::atomic_load(&weightOverlay);
+    const RouteCriterion criteria[] = {RouteCriterion::Distance, RouteCriterion::Time, RouteCriterion::Fare,
+                                       RouteCriterion::Transfers, RouteCriterion::Weighted};
+    for (RouteCriterion criterion : criteria) {
+        if (!MultiLevelOverlay::supports(criterion)) continue;
+        customizeMetric(overlayMetrics[static_cast<int>(criterion)], cells, *index, criterion, costModel,
+                        overlay.get(), pool);
+    }
+}
+
+bool Graph::findRoute(const std::string& source, const std::string& destination,
+                      RouteCriterion criterion, RouteResult& result) const {
+    TraceSpan span("findRoute", "query", source + " -> " + destination);
+    std::shared_ptr<const CompactGraph> index = getRoutingIndex();
+    return findRoute(index->idOf(source), index->idOf(destination), criterion, *index, result);
+}
+
+PathInfo Graph::findRoute(const std::string& source, const std::string& destination,
+                          RouteCriterion criterion) const {
+    TraceSpan span("findRoute", "query", source + " -> " + destination);
+    thread_local RouteResult route;
+    PathInfo result;
+    std::shared_ptr<const CompactGraph> index = getRoutingIndex();
+    findRoute(index->idOf(source), index->idOf(destination), criterion, *index, route);
+    route.toPathInfo(*this, *index, result);
     return result;
 }
 
@@ -406,10 +985,13 @@ void Graph::displayNetwork() const {
                   << stations.find(station)->second.getMetroLine() << ")" << std::endl;
         std::cout << "  Connected to:" << std::endl;
         for (const auto& edge : pair.second) {
-            std::string neighbor = edge.first;
-            double distance = edge.second;
+            std::string neighbor = edge.to;
+            double distance = edge.weight;
             std::cout << "    -> " << neighbor << " (" 
-                      << std::fixed << std::setprecision(1) << distance << " km)" << std::endl;
+                      << std::fixed << std::setprecision(1) << distance << " km";
+            if (edge.type == EdgeType::Transfer) std::cout << ", transfer";
+            else if (edge.type == EdgeType::Walk) std::cout << ", walk";
+            std::cout << ")" << std::endl;
         }
     }
     std::cout << "\n" << std::string(50, '=') << std::endl;
@@ -418,21 +1000,22 @@ void Graph::displayNetwork() const {
 void Graph::displayByMetroLine(const std::string& lineName) const {
     std::cout << "\n";
     printHeader("STATIONS ON " + lineName);
-    
-    std::vector<std::string> lineStations;
-    for (const auto& pair : stations) {
-        if (pair.second.getMetroLine() == lineName) {
-            lineStations.push_back(pair.first);
-        }
-    }
-    
-    std::sort(lineStations.begin(), lineStations.end());
-    
+
+    std::vector<std::vector<std::string>> sequences = getLineSequences(lineName);
+    std::vector<std::string> lineStations = getStationsByLine(lineName);
     if (lineStations.empty()) {
         std::cout << "No stations found on this line.\n";
         return;
     }
-    
+
+    if (sequences.size() > 1) {
+        // Branched line: each terminal-to-terminal sequence on one line
+        std::cout << "\nRoutes on " << lineName << ":\n";
+        for (const auto& sequence : sequences) {
+            std::cout << " - " << sequence.front() << " -> " << sequence.back()
+                      << " (" << sequence.size() << " stations)\n";
+        }
+    }
     std::cout << "\nStations on " << lineName << ":\n";
     for (size_t i = 0; i < lineStations.size(); i++) {
         std::cout << std::setw(2) << (i + 1) << ". " << lineStations[i] << std::endl;
@@ -452,8 +1035,37 @@ std::vector<std::string> Graph::getAllMetroLines() const {
     return lines;
 }
 
+std::vector<std::vector<std::string>> Graph::getLineSequences(const std::string& lineName) const {
+    std::vector<std::vector<std::string>> result;
+    std::shared_ptr<const LineIndex> lines = getLineIndex();
+    const CompactGraph& index = *lines->getIndex();
+    for (int line = 0; line < index.lineCount(); line++) {
+        if (index.lineName(line) != lineName) continue;
+        for (const auto& sequence : lines->sequences(line)) {
+            std::vector<std::string> names;
+            for (int v : sequence) names.push_back(index.nameOf(v));
+            result.push_back(std::move(names));
+        }
+    }
+    return result;
+}
+
 std::vector<std::string> Graph::getStationsByLine(const std::string& lineName) const {
+    std::vector<std::vector<std::string>> sequences = getLineSequences(lineName);
     std::vector<std::string> result;
+    if (!sequences.empty()) {
+        std::stable_sort(sequences.begin(), sequences.end(),
+                         [](const std::vector<std::string>& a, const std::vector<std::string>& b) {
+                             return a.size() > b.size();
+                         });
+        std::unordered_set<std::string> listed;
+        for (const auto& sequence : sequences) {
+            for (const auto& name : sequence) {
+                if (listed.insert(name).second) result.push_back(name);
+            }
+        }
+        return result;
+    }
     for (const auto& pair : stations) {
         if (pair.second.getMetroLine() == lineName) {
             result.push_back(pair.first);
@@ -0,0 +1,297 @@
+#include "HopReachability.h"
+#include "ThreadPool.h"
+#include "CancelToken.h"
+#include "Trace.h"
+#include <algorithm>
+
+namespace {
+
+// Direction switches (Beamer et al.): go bottom-up once the frontier's
+// edges exceed unexplored / ALPHA, back top-down once it holds fewer than
+// n / BETA stations
+constexpr long long ALPHA = 14;
+constexpr long long BETA = 24;
+
+// Below these sizes a level is cheaper on one thread than handing it out
+constexpr size_t PARALLEL_FRONTIER = 4096;
+constexpr size_t PARALLEL_WORDS = 256;
+
+uint64_t bit(int v) {
+    return uint64_t(1) << (v & 63);
+}
+
+} // namespace
+
+int HopResult::reached() const {
+    int total = 0;
+    for (int count : levels) total += count;
+    return total;
+}
+
+void HopWorkspace::prepare(int n, unsigned workers) {
+    size_t needed = (static_cast<size_t>(n) + 63) / 64;
+    if (needed != words || !visited) {
+        words = needed;
+        visited.reset(new std::atomic<uint64_t>[words]);
+        dirty = true;
+    }
+    // Bounded searches touch few stations; clearing just their words keeps
+    // many-source sweeps from paying O(n) per source
+    if (dirty) {
+        for (size_t w = 0; w < words; w++) visited[w].store(0, std::memory_order_relaxed);
+        frontierBits.assign(words, 0);
+        nextBits.assign(words, 0);
+    } else {
+        for (int v : touched) visited[v >> 6].store(0, std::memory_order_relaxed);
+    }
+    touched.clear();
+    dirty = false;
+    frontier.clear();
+    if (localNext.size() < workers) localNext.resize(workers);
+}
+
+HopGraph::HopGraph(std::shared_ptr<const CompactGraph> graph) : index(std::move(graph)) {
+    TraceSpan span("HopGraph::build", "index");
+    int n = index->size();
+    outOffsets.assign(n + 1, 0);
+    outTargets.reserve(index->getEdgeCount());
+
+    // Parallel edges (one per line) and self-loops add nothing to hop counts
+    CompactGraph::EdgeCursor edges;
+    std::vector<int> row;
+    for (int u = 0; u < n; u++) {
+        edges.load(*index, u);
+        row.clear();
+        for (int e = edges.begin; e < edges.end; e++) {
+            int v = edges.target(e);
+            if (v != u) row.push_back(v);
+        }
+        std::sort(row.begin(), row.end());
+        row.erase(std::unique(row.begin(), row.end()), row.end());
+        outTargets.insert(outTargets.end(), row.begin(), row.end());
+        outOffsets[u + 1] = static_cast<int>(outTargets.size());
+    }
+    outTargets.shrink_to_fit();
+
+    inOffsets.assign(n + 1, 0);
+    for (int v : outTargets) inOffsets[v + 1]++;
+    for (int v = 0; v < n; v++) inOffsets[v + 1] += inOffsets[v];
+    inTargets.resize(outTargets.size());
+    std::vector<int> fill(inOffsets.begin(), inOffsets.end() - 1);
+    for (int u = 0; u < n; u++) {
+        for (int k = outOffsets[u]; k < outOffsets[u + 1]; k++) {
+            inTargets[fill[outTargets[k]]++] = u;
+        }
+    }
+}
+
+void HopGraph::topDown(int level, HopWorkspace& ws, ThreadPool* pool, int* hops,
+                       std::vector<int>& next, long long& nextEdges) const {
+    size_t count = ws.frontier.size();
+    next.clear();
+    nextEdges = 0;
+
+    if (!pool || pool->size() < 2 || count < PARALLEL_FRONTIER) {
+        // Single writer: plain load/store instead of a locked fetch_or
+        for (int u : ws.frontier) {
+            for (int k = outOffsets[u]; k < outOffsets[u + 1]; k++) {
+                int v = outTargets[k];
+                std::atomic<uint64_t>& word = ws.visited[v >> 6];
+                uint64_t seen = word.load(std::memory_order_relaxed);
+                if (seen & bit(v)) continue;
+                word.store(seen | bit(v), std::memory_order_relaxed);
+                if (hops) hops[v] = level + 1;
+                next.push_back(v);
+                nextEdges += outOffsets[v + 1] - outOffsets[v];
+            }
+        }
+        return;
+    }
+
+    size_t chunks = std::min<size_t>(pool->size() * 4, count / 1024);
+    ws.localEdges.assign(chunks, 0);
+    pool->parallelFor(chunks, [&](size_t chunk, unsigned worker) {
+        std::vector<int>& local = ws.localNext[worker];
+        size_t first = count * chunk / chunks;
+        size_t last = count * (chunk + 1) / chunks;
+        long long edges = 0;
+        for (size_t i = first; i < last; i++) {
+            int u = ws.frontier[i];
+            for (int k = outOffsets[u]; k < outOffsets[u + 1]; k++) {
+                int v = outTargets[k];
+                std::atomic<uint64_t>& word = ws.visited[v >> 6];
+                // Cheap test first; the fetch_or decides which worker claims v
+                if (word.load(std::memory_order_relaxed) & bit(v)) continue;
+                if (word.fetch_or(bit(v), std::memory_order_relaxed) & bit(v)) continue;
+                if (hops) hops[v] = level + 1;
+                local.push_back(v);
+                edges += outOffsets[v + 1] - outOffsets[v];
+            }
+        }
+        ws.localEdges[chunk] = edges;
+    });
+    for (std::vector<int>& local : ws.localNext) {
+        next.insert(next.end(), local.begin(), local.end());
+        local.clear();
+    }
+    for (long long edges : ws.localEdges) nextEdges += edges;
+}
+
+int HopGraph::bottomUp(int level, HopWorkspace& ws, ThreadPool* pool, int* hops, long long& nextEdges) const {
+    int n = size();
+    size_t words = ws.words;
+    const uint64_t* frontierBits = ws.frontierBits.data();
+
+    // Each range of words has one owner, so visited needs no atomic updates here
+    auto scan = [&](size_t firstWord, size_t lastWord, long long& edges) {
+        int count = 0;
+        for (size_t w = firstWord; w < lastWord; w++) {
+            uint64_t seen = ws.visited[w].load(std::memory_order_relaxed);
+            uint64_t todo = ~seen;
+            int base = static_cast<int>(w * 64);
+            if (n - base < 64) todo &= bit(n - base) - 1;
+            uint64_t found = 0;
+            while (todo) {
+                int v = base + __builtin_ctzll(todo);
+                todo &= todo - 1;
+                for (int k = inOffsets[v]; k < inOffsets[v + 1]; k++) {
+                    int p = inTargets[k];
+                    if (frontierBits[p >> 6] & bit(p)) {
+                        found |= bit(v);
+                        if (hops) hops[v] = level + 1;
+                        edges += outOffsets[v + 1] - outOffsets[v];
+                        count++;
+                        break;
+                    }
+                }
+            }
+            if (found) {
+                ws.nextBits[w] = found;
+                ws.visited[w].store(seen | found, std::memory_order_relaxed);
+            }
+        }
+        return count;
+    };
+
+    int count = 0;
+    nextEdges = 0;
+    if (!pool || pool->size() < 2 || words < PARALLEL_WORDS) {
+        count = scan(0, words, nextEdges);
+    } else {
+        size_t chunks = std::min<size_t>(pool->size() * 4, words / 64);
+        ws.localEdges.assign(chunks, 0);
+        ws.localCounts.assign(chunks, 0);
+        pool->parallelFor(chunks, [&](size_t chunk, unsigned) {
+            ws.localCounts[chunk] = scan(words * chunk / chunks, words * (chunk + 1) / chunks,
+                                         ws.localEdges[chunk]);
+        });
+        for (size_t c = 0; c < chunks; c++) {
+            count += ws.localCounts[c];
+            nextEdges += ws.localEdges[c];
+        }
+    }
+    ws.frontierBits.swap(ws.nextBits);
+    std::fill(ws.nextBits.begin(), ws.nextBits.end(), 0);
+    return count;
+}
+
+void HopGraph::search(int source, int maxHops, HopWorkspace& ws, ThreadPool* pool,
+                      int* hops, HopResult& result) const {
+    int n = size();
+    result.source = source;
+    result.levels.clear();
+    result.topDownLevels = result.bottomUpLevels = 0;
+    if (source < 0 || source >= n) return;
+
+    ws.prepare(n, pool ? pool->size() : 1);
+    ws.visited[source >> 6].store(bit(source), std::memory_order_relaxed);
+    if (hops) hops[source] = 0;
+    ws.frontier.push_back(source);
+    ws.touched.push_back(source);
+    result.levels.push_back(1);
+
+    long long frontierEdges = outOffsets[source + 1] - outOffsets[source];
+    long long unexplored = edgeCount() - frontierEdges;
+    int frontierSize = 1;
+    bool bottom = false;
+    std::vector<int> next;
+    CancelToken* token = CancelToken::current();
+
+    for (int level = 0; maxHops == UNLIMITED || level < maxHops; level++) {
+        if (token && token->stopped()) break;
+
+        if (!bottom && frontierEdges > unexplored / ALPHA) {
+            for (int u : ws.frontier) ws.frontierBits[u >> 6] |= bit(u);
+            bottom = true;
+            ws.dirty = true;
+        } else if (bottom && frontierSize < n / BETA) {
+            ws.frontier.clear();
+            for (size_t w = 0; w < ws.words; w++) {
+                for (uint64_t bits = ws.frontierBits[w]; bits; bits &= bits - 1) {
+                    ws.frontier.push_back(static_cast<int>(w * 64) + __builtin_ctzll(bits));
+                }
+                ws.frontierBits[w] = 0;
+            }
+            bottom = false;
+        }
+
+        long long nextEdges = 0;
+        if (bottom) {
+            frontierSize = bottomUp(level, ws, pool, hops, nextEdges);
+            result.bottomUpLevels++;
+        } else {
+            topDown(level, ws, pool, hops, next, nextEdges);
+            ws.frontier.swap(next);
+            if (!ws.dirty) ws.touched.insert(ws.touched.end(), ws.frontier.begin(), ws.frontier.end());
+            frontierSize = static_cast<int>(ws.frontier.size());
+            result.topDownLevels++;
+        }
+        if (frontierSize == 0) break;
+        result.levels.push_back(frontierSize);
+        unexplored -= nextEdges;
+        frontierEdges = nextEdges;
+    }
+}
+
+HopResult HopGraph::distances(int source, int maxHops, ThreadPool* pool) const {
+    HopWorkspace ws;
+    return distances(source, maxHops, ws, pool);
+}
+
+HopResult HopGraph::distances(int source, int maxHops, HopWorkspace& ws, ThreadPool* pool) const {
+    TraceSpan span("HopGraph::distances", "query");
+    HopResult result;
+    result.hops.assign(size(), -1);
+    search(source, maxHops, ws, pool, result.hops.data(), result);
+    return result;
+}
+
+std::vector<std::vector<int>> HopGraph::reachCounts(const std::vector<int>& sources, int maxHops,
+                                                    ThreadPool& pool) const {
+    TraceSpan span("HopGraph::reachCounts", "query", std::to_string(sources.size()) + " sources");
+    std::vector<std::vector<int>> counts(sources.size());
+    std::vector<std::unique_ptr<HopWorkspace>> workspaces;
+    for (unsigned w = 0; w < pool.size(); w++) workspaces.emplace_back(new HopWorkspace());
+
+    // The worker's token is not the caller's; check the caller's between sources
+    CancelToken* token = CancelToken::current();
+    pool.parallelFor(sources.size(), [&](size_t i, unsigned worker) {
+        if (token && token->isCancelled()) return;
+        HopResult result;
+        search(sources[i], maxHops, *workspaces[worker], nullptr, nullptr, result);
+        size_t entries = (maxHops == UNLIMITED) ? result.levels.size() : static_cast<size_t>(maxHops) + 1;
+        std::vector<int>& row = counts[i];
+        row.assign(entries, 0);
+        int total = 0;
+        for (size_t h = 0; h < entries; h++) {
+            if (h < result.levels.size()) total += result.levels[h];
+            row[h] = total;
+        }
+    });
+    return counts;
+}
+
+size_t HopGraph::memoryBytes() const {
+    return (outOffsets.capacity() + outTargets.capacity() + inOffsets.capacity() + inTargets.capacity()) *
+           sizeof(int);
+}
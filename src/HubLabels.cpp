@@ -0,0 +1,282 @@
+#include "HubLabels.h"
+#include "ArtifactCache.h"
+#include "Trace.h"
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+struct LabelEntry {
+    uint32_t hub;
+    uint32_t dist;
+    int32_t next;
+    int32_t edge;
+};
+
+uint64_t packEntry(uint32_t dist, int v) {
+    return (static_cast<uint64_t>(dist) << 32) | static_cast<uint32_t>(v);
+}
+
+} // namespace
+
+std::shared_ptr<const HubLabels> HubLabels::build(const CompactGraph& graph) {
+    TraceSpan span("HubLabels::build", "index");
+    int n = graph.size();
+    int m = graph.getEdgeCount();
+
+    // Reverse adjacency for the backward searches
+    std::vector<int> revOffsets(n + 1, 0), revSources(m), revEdges(m);
+    CompactGraph::EdgeCursor edges;
+    for (int u = 0; u < n; u++) {
+        edges.load(graph, u);
+        for (int e = edges.begin; e < edges.end; e++) revOffsets[edges.target(e) + 1]++;
+    }
+    for (int v = 0; v < n; v++) revOffsets[v + 1] += revOffsets[v];
+    std::vector<int> fill(revOffsets.begin(), revOffsets.end() - 1);
+    for (int u = 0; u < n; u++) {
+        edges.load(graph, u);
+        for (int e = edges.begin; e < edges.end; e++) {
+            int slot = fill[edges.target(e)]++;
+            revSources[slot] = u;
+            revEdges[slot] = e;
+        }
+    }
+
+    // Highest degree first: interchanges cover the most shortest paths
+    std::shared_ptr<HubLabels> labels = std::make_shared<HubLabels>();
+    labels->stations = n;
+    labels->edgeCount = m;
+    labels->order.resize(n);
+    for (int v = 0; v < n; v++) labels->order[v] = v;
+    auto degree = [&](int v) {
+        return (graph.edgeEnd(v) - graph.edgeBegin(v)) + (revOffsets[v + 1] - revOffsets[v]);
+    };
+    std::stable_sort(labels->order.begin(), labels->order.end(),
+                     [&](int a, int b) { return degree(a) > degree(b); });
+
+    std::vector<std::vector<LabelEntry>> outLabels(n), inLabels(n);
+    std::vector<uint32_t> hubDist(n, UNREACHED);     // by rank: the current hub's own label
+    std::vector<uint32_t> dist(n, UNREACHED);
+    std::vector<int> parent(n, -1), parentEdge(n, -1), touched;
+    std::vector<uint64_t> heap;
+
+    // forward: dist(h -> v) into in(v), pruned with out(h);
+    // backward: dist(v -> h) into out(v), pruned with in(h)
+    auto prunedSearch = [&](int h, uint32_t rank, bool forward) {
+        const auto& own = forward ? outLabels[h] : inLabels[h];
+        auto& labelsOf = forward ? inLabels : outLabels;
+        for (const auto& entry : own) hubDist[entry.hub] = entry.dist;
+
+        dist[h] = 0;
+        touched.push_back(h);
+        heap.push_back(packEntry(0, h));
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<uint64_t>());
+            uint64_t top = heap.back();
+            heap.pop_back();
+            uint32_t d = static_cast<uint32_t>(top >> 32);
+            int v = static_cast<int>(static_cast<uint32_t>(top));
+            if (d > dist[v]) continue;
+
+            bool covered = false;
+            for (const auto& entry : labelsOf[v]) {
+                uint32_t via = hubDist[entry.hub];
+                if (via != UNREACHED && via + entry.dist <= d) {
+                    covered = true;
+                    break;
+                }
+            }
+            if (covered) continue;
+            labelsOf[v].push_back({rank, d, parent[v], parentEdge[v]});
+
+            auto relax = [&](int w, int e) {
+                uint32_t nd = d + graph.edgeMeters(e);
+                if (nd < dist[w]) {
+                    if (dist[w] == UNREACHED) touched.push_back(w);
+                    dist[w] = nd;
+                    parent[w] = v;
+                    parentEdge[w] = e;
+                    heap.push_back(packEntry(nd, w));
+                    std::push_heap(heap.begin(), heap.end(), std::greater<uint64_t>());
+                }
+            };
+            if (forward) {
+                edges.load(graph, v);
+                for (int e = edges.begin; e < edges.end; e++) relax(edges.target(e), e);
+            } else {
+                for (int k = revOffsets[v]; k < revOffsets[v + 1]; k++) relax(revSources[k], revEdges[k]);
+            }
+        }
+
+        for (int v : touched) {
+            dist[v] = UNREACHED;
+            parent[v] = -1;
+            parentEdge[v] = -1;
+        }
+        touched.clear();
+        for (const auto& entry : own) hubDist[entry.hub] = UNREACHED;
+    };
+
+    for (int rank = 0; rank < n; rank++) {
+        int h = labels->order[rank];
+        prunedSearch(h, static_cast<uint32_t>(rank), true);
+        prunedSearch(h, static_cast<uint32_t>(rank), false);
+    }
+
+    // Entries were appended in rank order, so every label is already sorted
+    auto flatten = [n](std::vector<std::vector<LabelEntry>>& from, LabelSet& to) {
+        to.offsets.assign(1, 0);
+        for (int v = 0; v < n; v++) {
+            for (const auto& entry : from[v]) {
+                to.hubs.push_back(entry.hub);
+                to.dists.push_back(entry.dist);
+                to.next.push_back(entry.next);
+                to.edges.push_back(entry.edge);
+            }
+            to.offsets.push_back(static_cast<uint32_t>(to.hubs.size()));
+            std::vector<LabelEntry>().swap(from[v]);
+        }
+    };
+    flatten(outLabels, labels->out);
+    flatten(inLabels, labels->in);
+    return labels;
+}
+
+uint32_t HubLabels::merge(int s, int t, uint32_t& outPos, uint32_t& inPos) const {
+    uint32_t i = out.offsets[s], iEnd = out.offsets[s + 1];
+    uint32_t j = in.offsets[t], jEnd = in.offsets[t + 1];
+    const uint32_t* a = out.hubs.data();
+    const uint32_t* b = in.hubs.data();
+    uint32_t best = UNREACHED;
+    while (i < iEnd && j < jEnd) {
+        uint32_t ha = a[i], hb = b[j];
+        if (ha == hb) {
+            uint32_t d = out.dists[i] + in.dists[j];
+            if (d < best) {
+                best = d;
+                outPos = i;
+                inPos = j;
+            }
+            i++;
+            j++;
+        } else {
+            // Branch-free advance of whichever side has the smaller hub
+            i += (ha < hb);
+            j += (hb < ha);
+        }
+    }
+    return best;
+}
+
+uint32_t HubLabels::distanceMeters(int s, int t) const {
+    if (s < 0 || t < 0 || s >= stations || t >= stations) return UNREACHED;
+    uint32_t i, j;
+    return merge(s, t, i, j);
+}
+
+double HubLabels::distance(int s, int t) const {
+    uint32_t meters = distanceMeters(s, t);
+    return (meters == UNREACHED) ? -1.0 : meters / 1000.0;
+}
+
+// Walk from both ends toward the best hub: step forward from the source
+// while it is not the hub, otherwise step backward from the target. Each
+// step stays on a shortest route, so the ends meet.
+bool HubLabels::path(int s, int t, std::vector<int>& stationsOut, std::vector<int>& edgesOut) const {
+    stationsOut.clear();
+    edgesOut.clear();
+    if (distanceMeters(s, t) == UNREACHED) return false;
+
+    thread_local std::vector<int> backStations, backEdges;
+    backStations.assign(1, t);
+    backEdges.clear();
+    stationsOut.push_back(s);
+    int a = s, b = t;
+    for (int steps = 0; a != b; steps++) {
+        uint32_t i = 0, j = 0;
+        if (steps > 2 * stations || merge(a, b, i, j) == UNREACHED) return false;
+        if (order[out.hubs[i]] != a) {
+            edgesOut.push_back(out.edges[i]);
+            a = out.next[i];
+            stationsOut.push_back(a);
+        } else {
+            backEdges.push_back(in.edges[j]);
+            b = in.next[j];
+            backStations.push_back(b);
+        }
+    }
+    for (size_t k = backStations.size() - 1; k-- > 0;) stationsOut.push_back(backStations[k]);
+    for (size_t k = backEdges.size(); k-- > 0;) edgesOut.push_back(backEdges[k]);
+    return true;
+}
+
+double HubLabels::averageLabelSize() const {
+    return stations == 0 ? 0.0 : (out.hubs.size() + in.hubs.size()) / (2.0 * stations);
+}
+
+size_t HubLabels::memoryBytes() const {
+    auto setBytes = [](const LabelSet& set) {
+        return set.offsets.capacity() * sizeof(uint32_t) +
+               (set.hubs.capacity() + set.dists.capacity()) * sizeof(uint32_t) +
+               (set.next.capacity() + set.edges.capacity()) * sizeof(int32_t);
+    };
+    return order.capacity() * sizeof(int32_t) + setBytes(out) + setBytes(in);
+}
+
+std::string HubLabels::serialize() const {
+    TraceSpan span("HubLabels::serialize", "cache");
+    ArtifactWriter writer;
+    writer.put(static_cast<int32_t>(stations));
+    writer.put(static_cast<int32_t>(edgeCount));
+    writer.putArray(order);
+    for (const LabelSet* set : {&out, &in}) {
+        writer.putArray(set->offsets);
+        writer.putArray(set->hubs);
+        writer.putArray(set->dists);
+        writer.putArray(set->next);
+        writer.putArray(set->edges);
+    }
+    return std::move(writer.str());
+}
+
+std::shared_ptr<const HubLabels> HubLabels::deserialize(const unsigned char* data, size_t size) {
+    TraceSpan span("HubLabels::deserialize", "cache");
+    ArtifactReader reader(data, size);
+    std::shared_ptr<HubLabels> labels = std::make_shared<HubLabels>();
+    int32_t n = 0, m = 0;
+    reader.get(n);
+    reader.get(m);
+    reader.getArray(labels->order);
+    for (LabelSet* set : {&labels->out, &labels->in}) {
+        reader.getArray(set->offsets);
+        reader.getArray(set->hubs);
+        reader.getArray(set->dists);
+        reader.getArray(set->next);
+        reader.getArray(set->edges);
+    }
+    if (!reader.atEnd() || n < 0 || labels->order.size() != static_cast<size_t>(n)) return nullptr;
+    labels->stations = n;
+    labels->edgeCount = m;
+
+    // Offsets must be monotone and every array must match the entry count
+    for (const LabelSet* set : {&labels->out, &labels->in}) {
+        size_t entries = set->hubs.size();
+        if (set->offsets.size() != static_cast<size_t>(n) + 1 || set->offsets[0] != 0 ||
+            set->offsets.back() != entries || set->dists.size() != entries ||
+            set->next.size() != entries || set->edges.size() != entries) {
+            return nullptr;
+        }
+        for (int v = 0; v < n; v++) {
+            if (set->offsets[v] > set->offsets[v + 1]) return nullptr;
+        }
+        for (size_t k = 0; k < entries; k++) {
+            if (set->hubs[k] >= static_cast<uint32_t>(n) || set->next[k] >= n || set->edges[k] >= m) {
+                return nullptr;
+            }
+        }
+    }
+    for (int32_t v : labels->order) {
+        if (v < 0 || v >= n) return nullptr;
+    }
+    return labels;
+}
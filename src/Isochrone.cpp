@@ -0,0 +1,85 @@
+#include "Isochrone.h"
+#include "ThreadPool.h"
+#include "CancelToken.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+IsochroneResult Isochrone::compute(const CompactGraph& graph, int source,
+                                   const std::vector<double>& limits, BudgetKind kind,
+                                   const FareCalculator& fares, SearchWorkspace& ws) {
+    IsochroneResult result;
+    result.source = source;
+    for (double limit : limits) {
+        result.bands.push_back({limit, {}});
+    }
+    if (source < 0 || source >= graph.size() || limits.empty()) return result;
+
+    double budget = limits.back();
+    int sourceZone = graph.zoneOf(source);
+
+    // Distances are whole meters, summed as the route kernels sum them
+    // (CompactGraph::edgeMeters) and held exactly in the workspace's
+    // doubles; distance limits are converted to meters once
+    std::vector<int64_t> limitMeters;
+    for (double limit : limits) limitMeters.push_back(std::llround(limit * 1000.0));
+    int64_t budgetMeters = limitMeters.back();
+
+    ws.prepare(graph.size());
+    ws.push(source, 0.0, -1);
+
+    unsigned ticks = 0;
+    while (!CancelToken::poll(ticks)) {
+        int u = ws.popMin();
+        if (u < 0) break;
+        int64_t du = static_cast<int64_t>(ws.dist[u]);
+
+        // Max zone along the tree path; the parent is always settled first
+        int p = ws.parent[u];
+        ws.aux[u] = (p < 0) ? graph.zoneOf(u) : std::max(ws.aux[p], graph.zoneOf(u));
+
+        size_t band = limits.size();
+        if (kind == BudgetKind::Distance) {
+            if (du > budgetMeters) break;
+            band = std::lower_bound(limitMeters.begin(), limitMeters.end(), du) - limitMeters.begin();
+        } else {
+            // Fare never drops below the fare at the source zone, and it grows
+            // with distance, so once that bound passes the budget we are done
+            double km = du / 1000.0;
+            if (fares.calculateFare(km, sourceZone) > budget) break;
+            double cost = fares.calculateFare(km, ws.aux[u]);
+            if (cost <= budget) band = std::lower_bound(limits.begin(), limits.end(), cost) - limits.begin();
+        }
+        if (band < limits.size()) result.bands[band].stations.push_back(u);
+
+        ws.edges.load(graph, u);
+        for (int e = ws.edges.begin; e < ws.edges.end; e++) {
+            int v = ws.edges.target(e);
+            double nd = static_cast<double>(du + ws.edges.meters(e));
+            if (!ws.settled[v] && nd < ws.dist[v]) {
+                ws.push(v, nd, u);
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<IsochroneResult> Isochrone::computeMany(const CompactGraph& graph,
+                                                    const std::vector<int>& sources,
+                                                    const std::vector<double>& limits,
+                                                    BudgetKind kind,
+                                                    const FareCalculator& fares,
+                                                    ThreadPool& pool) {
+    std::vector<IsochroneResult> results(sources.size());
+
+    std::vector<std::unique_ptr<SearchWorkspace>> workspaces;
+    for (unsigned w = 0; w < pool.size(); w++) {
+        workspaces.emplace_back(new SearchWorkspace());
+    }
+
+    pool.parallelFor(sources.size(), [&](size_t i, unsigned worker) {
+        results[i] = compute(graph, sources[i], limits, kind, fares, *workspaces[worker]);
+    });
+    return results;
+}
@@ -0,0 +1,414 @@
+#include "LineIndex.h"
+#include "Trace.h"
+#include <algorithm>
+#include <climits>
+#include <queue>
+#include <tuple>
+
+namespace {
+
+// A line with more terminals than this keeps the patterns between the
+// first ones only (the rest are left to the searches)
+constexpr size_t MAX_TERMINALS = 8;
+
+// Lines with loops are checked pair by pair up to this many stations
+constexpr size_t MAX_CHECKED = 2048;
+
+} // namespace
+
+bool LineIndex::Ride::operator<(const Ride& other) const {
+    return std::tie(line, from, to, meters, edge) <
+           std::tie(other.line, other.from, other.to, other.meters, other.edge);
+}
+
+LineIndex::LineIndex(std::shared_ptr<const CompactGraph> graph) : index(std::move(graph)) {
+    TraceSpan span("LineIndex::build", "index");
+    int n = index->size();
+    int lines = index->lineCount();
+    uncovered.assign(n, 0);
+
+    std::vector<Ride> rides;
+    CompactGraph::EdgeCursor edges;
+    for (int u = 0; u < n; u++) {
+        edges.load(*index, u);
+        for (int e = edges.begin; e < edges.rideEnd; e++) {
+            int v = edges.target(e);
+            if (v != u) rides.push_back({index->edgeLine(e), u, v, edges.meters(e), e});
+        }
+    }
+    std::sort(rides.begin(), rides.end());
+    rides.erase(std::unique(rides.begin(), rides.end(),
+                            [](const Ride& a, const Ride& b) {
+                                return a.line == b.line && a.from == b.from && a.to == b.to;
+                            }),
+                rides.end());
+
+    lineOffsets.assign(lines + 1, 0);
+    std::vector<int> members, local, neighbourOffsets, neighbours, parent, queue, component, terminals;
+    std::vector<uint64_t> distance;
+    std::vector<Check> checks;
+    size_t begin = 0;
+    for (int line = 0; line < lines; line++) {
+        lineOffsets[line] = static_cast<uint32_t>(patterns.size());
+        size_t end = begin;
+        while (end < rides.size() && rides[end].line == line) end++;
+
+        // Rides of this line, for pattern edges
+        auto findRide = [&](int from, int to) -> const Ride* {
+            Ride key{line, from, to, 0, 0};
+            auto it = std::lower_bound(rides.begin() + begin, rides.begin() + end, key);
+            return (it != rides.begin() + end && it->from == from && it->to == to) ? &*it : nullptr;
+        };
+
+        // Undirected simple graph of the line over local indices
+        members.clear();
+        for (size_t r = begin; r < end; r++) {
+            members.push_back(rides[r].from);
+            members.push_back(rides[r].to);
+        }
+        std::sort(members.begin(), members.end());
+        members.erase(std::unique(members.begin(), members.end()), members.end());
+        int m = static_cast<int>(members.size());
+        auto localOf = [&](int v) {
+            return static_cast<int>(std::lower_bound(members.begin(), members.end(), v) - members.begin());
+        };
+        std::vector<std::pair<int, int>> links;
+        for (size_t r = begin; r < end; r++) {
+            int a = localOf(rides[r].from), b = localOf(rides[r].to);
+            links.push_back({std::min(a, b), std::max(a, b)});
+        }
+        std::sort(links.begin(), links.end());
+        links.erase(std::unique(links.begin(), links.end()), links.end());
+        neighbourOffsets.assign(m + 1, 0);
+        for (const auto& link : links) {
+            neighbourOffsets[link.first + 1]++;
+            neighbourOffsets[link.second + 1]++;
+        }
+        for (int i = 0; i < m; i++) neighbourOffsets[i + 1] += neighbourOffsets[i];
+        neighbours.resize(neighbourOffsets[m]);
+        local.assign(neighbourOffsets.begin(), neighbourOffsets.end() - 1);
+        for (const auto& link : links) {
+            neighbours[local[link.first]++] = link.second;
+            neighbours[local[link.second]++] = link.first;
+        }
+        auto degree = [&](int i) { return neighbourOffsets[i + 1] - neighbourOffsets[i]; };
+
+        // Tree path from the BFS root to x, root first
+        auto treePath = [&](int x, std::vector<int>& sequence) {
+            sequence.clear();
+            for (int at = x; at >= 0; at = parent[at]) sequence.push_back(members[at]);
+            std::reverse(sequence.begin(), sequence.end());
+        };
+        // Shortest-path tree by meters over the line, for lines with loops
+        auto dijkstra = [&](int root) {
+            for (int i : component) {
+                parent[i] = -2;
+                distance[i] = UINT64_MAX;
+            }
+            using Entry = std::pair<uint64_t, int>;
+            std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+            parent[root] = -1;
+            distance[root] = 0;
+            heap.push({0, root});
+            while (!heap.empty()) {
+                Entry top = heap.top();
+                heap.pop();
+                int i = top.second;
+                if (top.first > distance[i]) continue;
+                for (int k = neighbourOffsets[i]; k < neighbourOffsets[i + 1]; k++) {
+                    int j = neighbours[k];
+                    const Ride* link = findRide(members[i], members[j]);
+                    if (!link) link = findRide(members[j], members[i]);
+                    uint64_t d = top.first + link->meters;
+                    if (d < distance[j]) {
+                        distance[j] = d;
+                        parent[j] = i;
+                        heap.push({d, j});
+                    }
+                }
+            }
+        };
+        auto bfs = [&](int root) {
+            for (int i : component) parent[i] = -2;
+            parent[root] = -1;
+            size_t head = 0;
+            queue.assign(1, root);
+            while (head < queue.size()) {
+                int i = queue[head++];
+                for (int k = neighbourOffsets[i]; k < neighbourOffsets[i + 1]; k++) {
+                    if (parent[neighbours[k]] == -2) {
+                        parent[neighbours[k]] = i;
+                        queue.push_back(neighbours[k]);
+                    }
+                }
+            }
+        };
+
+        auto addPattern = [&](bool ring, const std::vector<int>& sequence) {
+            Pattern p;
+            p.line = line;
+            p.ring = ring;
+            p.forwardOk = p.backwardOk = true;
+            p.first = static_cast<uint32_t>(stations.size());
+            p.length = static_cast<int>(sequence.size());
+            uint32_t forward = 0, backward = 0;
+            for (int i = 0; i <= p.length; i++) {
+                int a = (i < p.length) ? sequence[i] : (ring ? sequence[0] : -1);
+                int b = (i + 1 < p.length) ? sequence[i + 1] : (ring && i + 1 == p.length ? sequence[0] : -1);
+                const Ride* there = (b >= 0) ? findRide(a, b) : nullptr;
+                const Ride* back = (b >= 0) ? findRide(b, a) : nullptr;
+                if (b >= 0 && !there) p.forwardOk = false;
+                if (b >= 0 && !back) p.backwardOk = false;
+                stations.push_back(a);
+                forwardEdges.push_back(there ? there->edge : -1);
+                backwardEdges.push_back(back ? back->edge : -1);
+                forwardMeters.push_back(forward);
+                backwardMeters.push_back(backward);
+                if (there) forward += there->meters;
+                if (back) backward += back->meters;
+            }
+            patterns.push_back(p);
+        };
+
+        parent.assign(m, -2);
+        distance.assign(m, UINT64_MAX);
+        std::vector<char> seen(m, 0);
+        std::vector<int> sequence;
+        for (int start = 0; start < m; start++) {
+            if (seen[start]) continue;
+            // One connected component of the line
+            component.clear();
+            queue.assign(1, start);
+            seen[start] = 1;
+            for (size_t head = 0; head < queue.size(); head++) {
+                int i = queue[head];
+                component.push_back(i);
+                for (int k = neighbourOffsets[i]; k < neighbourOffsets[i + 1]; k++) {
+                    if (!seen[neighbours[k]]) {
+                        seen[neighbours[k]] = 1;
+                        queue.push_back(neighbours[k]);
+                    }
+                }
+            }
+            long long links2 = 0;       // twice the undirected links
+            terminals.clear();
+            bool allTwo = true;
+            for (int i : component) {
+                links2 += degree(i);
+                if (degree(i) == 1) terminals.push_back(i);
+                if (degree(i) != 2) allTwo = false;
+            }
+            long long linkCount = links2 / 2;
+            long long size = static_cast<long long>(component.size());
+
+            if (linkCount == size - 1) {
+                // Path or tree: a pattern between every two terminals
+                std::sort(terminals.begin(), terminals.end());
+                bool capped = terminals.size() > MAX_TERMINALS;
+                if (capped) terminals.resize(MAX_TERMINALS);
+                for (size_t a = 0; a < terminals.size(); a++) {
+                    bfs(terminals[a]);
+                    for (size_t b = a + 1; b < terminals.size(); b++) {
+                        treePath(terminals[b], sequence);
+                        addPattern(false, sequence);
+                    }
+                }
+                if (capped) {
+                    for (int i : component) uncovered[members[i]] = 1;
+                }
+            } else if (allTwo && linkCount == size) {
+                // Ring: walk it once from its lowest station
+                sequence.clear();
+                int previous = -1, at = component.front();
+                for (int i : component) at = std::min(at, i);
+                int first = at;
+                do {
+                    sequence.push_back(members[at]);
+                    int k = neighbourOffsets[at];
+                    int next = (neighbours[k] != previous) ? neighbours[k] : neighbours[k + 1];
+                    previous = at;
+                    at = next;
+                } while (at != first);
+                addPattern(true, sequence);
+            } else {
+                // Loops (e.g. a shortcut between two stations of the line):
+                // shortest paths between terminals, or between junctions if
+                // there are none. Whether every pair is served is checked below.
+                std::vector<int>& ends = terminals;
+                if (ends.empty()) {
+                    for (int i : component) {
+                        if (degree(i) >= 3) ends.push_back(i);
+                    }
+                }
+                std::sort(ends.begin(), ends.end());
+                if (ends.size() > MAX_TERMINALS) ends.resize(MAX_TERMINALS);
+                for (size_t a = 0; a < ends.size(); a++) {
+                    dijkstra(ends[a]);
+                    for (size_t b = a + 1; b < ends.size(); b++) {
+                        treePath(ends[b], sequence);
+                        addPattern(false, sequence);
+                    }
+                }
+                Check check{line, begin, end, {}};
+                for (int i : component) check.stations.push_back(members[i]);
+                std::sort(check.stations.begin(), check.stations.end());
+                checks.push_back(std::move(check));
+            }
+        }
+        begin = end;
+    }
+    lineOffsets[lines] = static_cast<uint32_t>(patterns.size());
+
+    memberOffsets.assign(n + 1, 0);
+    for (const Pattern& p : patterns) {
+        for (int i = 0; i < p.length; i++) memberOffsets[stations[p.first + i] + 1]++;
+    }
+    for (int v = 0; v < n; v++) memberOffsets[v + 1] += memberOffsets[v];
+    memberPattern.resize(memberOffsets[n]);
+    memberPosition.resize(memberOffsets[n]);
+    std::vector<uint32_t> fill(memberOffsets.begin(), memberOffsets.end() - 1);
+    for (size_t id = 0; id < patterns.size(); id++) {
+        const Pattern& p = patterns[id];
+        for (int i = 0; i < p.length; i++) {
+            uint32_t slot = fill[stations[p.first + i]]++;
+            memberPattern[slot] = static_cast<int>(id);
+            memberPosition[slot] = i;
+        }
+    }
+
+    // A line with loops is covered only if its patterns give the shortest
+    // ride for every ordered pair of its stations
+    for (const Check& check : checks) {
+        if (check.stations.size() > MAX_CHECKED || !servesAllPairs(check, rides)) {
+            for (int v : check.stations) uncovered[v] = 1;
+        }
+    }
+}
+
+bool LineIndex::servesAllPairs(const Check& check, const std::vector<Ride>& rides) const {
+    const std::vector<int>& members = check.stations;
+    auto localOf = [&](int v) {
+        return static_cast<int>(std::lower_bound(members.begin(), members.end(), v) - members.begin());
+    };
+    using Entry = std::pair<uint64_t, int>;
+    std::vector<uint64_t> distance(members.size());
+    for (int s : members) {
+        // Rides of the line only, in their own direction
+        std::fill(distance.begin(), distance.end(), UINT64_MAX);
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+        distance[localOf(s)] = 0;
+        heap.push({0, s});
+        while (!heap.empty()) {
+            Entry top = heap.top();
+            heap.pop();
+            int u = top.second;
+            if (top.first > distance[localOf(u)]) continue;
+            Ride key{check.line, u, INT_MIN, 0, 0};
+            for (auto it = std::lower_bound(rides.begin() + check.begin, rides.begin() + check.end, key);
+                 it != rides.begin() + check.end && it->from == u; ++it) {
+                uint64_t d = top.first + it->meters;
+                int j = localOf(it->to);
+                if (d < distance[j]) {
+                    distance[j] = d;
+                    heap.push({d, it->to});
+                }
+            }
+        }
+        for (size_t j = 0; j < members.size(); j++) {
+            int t = members[j];
+            if (t == s) continue;
+            Segment segment = bestRide(s, t, check.line);
+            if (distance[j] == UINT64_MAX ? segment.found() : (!segment.found() || segment.meters != distance[j])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+LineIndex::Segment LineIndex::ride(int id, int from, int to, bool forward) const {
+    const Pattern& p = patterns[id];
+    const uint32_t* meters = (forward ? forwardMeters.data() : backwardMeters.data()) + p.first;
+    Segment segment;
+    segment.pattern = id;
+    segment.line = p.line;
+    segment.from = from;
+    segment.to = to;
+    segment.forward = forward;
+    if (forward) {
+        bool wrap = to < from;
+        segment.meters = wrap ? meters[p.length] - meters[from] + meters[to] : meters[to] - meters[from];
+        segment.stops = wrap ? p.length - from + to : to - from;
+    } else {
+        bool wrap = to > from;
+        segment.meters = wrap ? meters[from] + meters[p.length] - meters[to] : meters[from] - meters[to];
+        segment.stops = wrap ? from + p.length - to : from - to;
+    }
+    return segment;
+}
+
+LineIndex::Segment LineIndex::sameLine(int s, int t) const {
+    return bestRide(s, t, -1);
+}
+
+LineIndex::Segment LineIndex::bestRide(int s, int t, int line) const {
+    Segment best;
+    if (s == t) return best;
+    for (uint32_t i = memberOffsets[s]; i < memberOffsets[s + 1]; i++) {
+        for (uint32_t j = memberOffsets[t]; j < memberOffsets[t + 1]; j++) {
+            if (memberPattern[i] != memberPattern[j]) continue;
+            int id = memberPattern[i];
+            const Pattern& p = patterns[id];
+            if (line >= 0 && p.line != line) continue;
+            int from = memberPosition[i], to = memberPosition[j];
+            auto consider = [&](bool forward) {
+                Segment candidate = ride(id, from, to, forward);
+                if (!best.found() || candidate.meters < best.meters ||
+                    (candidate.meters == best.meters && candidate.stops < best.stops)) {
+                    best = candidate;
+                }
+            };
+            if (p.forwardOk && (to > from || p.ring)) consider(true);
+            if (p.backwardOk && (to < from || p.ring)) consider(false);
+        }
+    }
+    return best;
+}
+
+void LineIndex::path(const Segment& segment, std::vector<int>& stationsOut, std::vector<int>& edgesOut) const {
+    stationsOut.clear();
+    edgesOut.clear();
+    if (!segment.found()) return;
+    const Pattern& p = patterns[segment.pattern];
+    int at = segment.from;
+    stationsOut.push_back(stations[p.first + at]);
+    while (at != segment.to) {
+        if (segment.forward) {
+            edgesOut.push_back(forwardEdges[p.first + at]);
+            at = (at + 1 == p.length) ? 0 : at + 1;
+        } else {
+            at = (at == 0) ? p.length - 1 : at - 1;
+            edgesOut.push_back(backwardEdges[p.first + at]);
+        }
+        stationsOut.push_back(stations[p.first + at]);
+    }
+}
+
+std::vector<std::vector<int>> LineIndex::sequences(int line) const {
+    std::vector<std::vector<int>> result;
+    if (line < 0 || line + 1 >= static_cast<int>(lineOffsets.size())) return result;
+    for (uint32_t k = lineOffsets[line]; k < lineOffsets[line + 1]; k++) {
+        const Pattern& p = patterns[k];
+        result.emplace_back(stations.begin() + p.first, stations.begin() + p.first + p.length);
+    }
+    return result;
+}
+
+size_t LineIndex::memoryBytes() const {
+    return patterns.capacity() * sizeof(Pattern) +
+           (stations.capacity() + forwardEdges.capacity() + backwardEdges.capacity() +
+            memberPattern.capacity() + memberPosition.capacity()) * sizeof(int) +
+           (forwardMeters.capacity() + backwardMeters.capacity() + memberOffsets.capacity() +
+            lineOffsets.capacity()) * sizeof(uint32_t) +
+           uncovered.capacity();
+}
@@ -0,0 +1,254 @@
+#include "Metrics.h"
+#include <condition_variable>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef METRO_COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+#endif
+
+std::atomic<bool> Metrics::enabledFlag(false);
+
+namespace {
+
+struct ThreadMetrics {
+    std::atomic<uint64_t> counters[static_cast<int>(Counter::COUNT)];
+    LatencyHistogram histograms[static_cast<int>(Timer::COUNT)];
+
+    ThreadMetrics() {
+        for (auto& c : counters) c.store(0, std::memory_order_relaxed);
+    }
+};
+
+// Blocks outlive their threads so totals include finished workers
+std::mutex& registryMutex() {
+    static std::mutex mtx;
+    return mtx;
+}
+
+std::vector<std::unique_ptr<ThreadMetrics>>& registry() {
+    static std::vector<std::unique_ptr<ThreadMetrics>> blocks;
+    return blocks;
+}
+
+thread_local ThreadMetrics* localBlock = nullptr;
+thread_local bool registering = false;
+
+ThreadMetrics* local() {
+    if (localBlock == nullptr) {
+        if (registering) return nullptr;    // allocation hook re-entered
+        registering = true;
+        std::unique_ptr<ThreadMetrics> block(new ThreadMetrics());
+        localBlock = block.get();
+        std::lock_guard<std::mutex> lock(registryMutex());
+        registry().push_back(std::move(block));
+        registering = false;
+    }
+    return localBlock;
+}
+
+void bump(std::atomic<uint64_t>& cell, uint64_t n) {
+    // Single writer per cell: a plain load/store is enough and avoids a locked add
+    cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+std::mutex logMutex;
+std::condition_variable logCv;
+std::thread logThread;
+bool logStopping = false;
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram() {
+    for (auto& c : counts) c.store(0, std::memory_order_relaxed);
+    total.store(0, std::memory_order_relaxed);
+    sumNs.store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucketOf(uint64_t ns) {
+    if (ns < SUB_BUCKETS) return static_cast<int>(ns);
+    int msb = 63 - __builtin_clzll(ns);
+    if (msb > MAX_MSB) return BUCKETS - 1;
+    int sub = static_cast<int>((ns >> (msb - SUB_BITS)) & (SUB_BUCKETS - 1));
+    return (msb - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(int bucket) {
+    if (bucket < SUB_BUCKETS) return static_cast<uint64_t>(bucket);
+    int msb = bucket / SUB_BUCKETS + SUB_BITS - 1;
+    uint64_t sub = bucket % SUB_BUCKETS;
+    uint64_t lower = (SUB_BUCKETS + sub) << (msb - SUB_BITS);
+    return lower + (uint64_t(1) << (msb - SUB_BITS)) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    bump(counts[bucketOf(ns)], 1);
+    bump(total, 1);
+    bump(sumNs, ns);
+}
+
+uint64_t MetricsSnapshot::percentileNs(Timer t, double q) const {
+    int ti = static_cast<int>(t);
+    uint64_t n = timerCount[ti];
+    if (n == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(q * (n - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < LatencyHistogram::BUCKETS; b++) {
+        seen += histograms[ti][b];
+        if (seen >= rank) return LatencyHistogram::bucketUpperBound(b);
+    }
+    return LatencyHistogram::bucketUpperBound(LatencyHistogram::BUCKETS - 1);
+}
+
+void Metrics::addSlow(Counter c, uint64_t n) {
+    ThreadMetrics* block = local();
+    if (block) bump(block->counters[static_cast<int>(c)], n);
+}
+
+void Metrics::recordSlow(Timer t, uint64_t ns) {
+    ThreadMetrics* block = local();
+    if (block) block->histograms[static_cast<int>(t)].record(ns);
+}
+
+MetricsSnapshot Metrics::snapshot() {
+    MetricsSnapshot snap;
+    std::lock_guard<std::mutex> lock(registryMutex());
+    for (const auto& block : registry()) {
+        for (int c = 0; c < static_cast<int>(Counter::COUNT); c++) {
+            snap.counters[c] += block->counters[c].load(std::memory_order_relaxed);
+        }
+        for (int t = 0; t < static_cast<int>(Timer::COUNT); t++) {
+            const LatencyHistogram& h = block->histograms[t];
+            for (int b = 0; b < LatencyHistogram::BUCKETS; b++) {
+                snap.histograms[t][b] += h.counts[b].load(std::memory_order_relaxed);
+            }
+            snap.timerCount[t] += h.total.load(std::memory_order_relaxed);
+            snap.timerSumNs[t] += h.sumNs.load(std::memory_order_relaxed);
+        }
+    }
+    return snap;
+}
+
+const char* Metrics::counterName(Counter c) {
+    switch (c) {
+        case Counter::RouteQueries: return "route_queries";
+        case Counter::NodesSettled: return "nodes_settled";
+        case Counter::EdgesRelaxed: return "edges_relaxed";
+        case Counter::HeapPushes: return "heap_pushes";
+        case Counter::HeapPops: return "heap_pops";
+        case Counter::SearchQueries: return "search_queries";
+        case Counter::StationsLoaded: return "stations_loaded";
+        case Counter::ConnectionsLoaded: return "connections_loaded";
+        case Counter::CacheHits: return "cache_hits";
+        case Counter::CacheMisses: return "cache_misses";
+        case Counter::RouteCacheHits: return "route_cache_hits";
+        case Counter::RouteCacheMisses: return "route_cache_misses";
+        case Counter::JournalRecords: return "journal_records";
+        case Counter::JournalSyncs: return "journal_syncs";
+        case Counter::Allocations: return "allocations";
+        default: return "unknown";
+    }
+}
+
+const char* Metrics::timerName(Timer t) {
+    switch (t) {
+        case Timer::RouteQuery: return "route_query";
+        case Timer::SearchQuery: return "search_query";
+        case Timer::Load: return "load";
+        default: return "unknown";
+    }
+}
+
+std::string Metrics::prometheusText() {
+    MetricsSnapshot snap = snapshot();
+    std::ostringstream out;
+
+    for (int c = 0; c < static_cast<int>(Counter::COUNT); c++) {
+        std::string name = std::string("metro_") + counterName(static_cast<Counter>(c)) + "_total";
+        out << "# TYPE " << name << " counter\n" << name << " " << snap.counters[c] << "\n";
+    }
+
+    // Export the fine histogram at power-of-two boundaries from 1us upward
+    for (int t = 0; t < static_cast<int>(Timer::COUNT); t++) {
+        std::string name = std::string("metro_") + timerName(static_cast<Timer>(t)) + "_seconds";
+        out << "# TYPE " << name << " histogram\n";
+        uint64_t cumulative = 0;
+        int b = 0;
+        for (int msb = 10; msb <= LatencyHistogram::MAX_MSB; msb += 2) {
+            uint64_t le = (uint64_t(1) << msb) - 1;
+            while (b < LatencyHistogram::BUCKETS && LatencyHistogram::bucketUpperBound(b) <= le) {
+                cumulative += snap.histograms[t][b++];
+            }
+            if (msb > 36 && cumulative == snap.timerCount[t]) break;
+            out << name << "_bucket{le=\"" << std::setprecision(9) << (le + 1) / 1e9 << "\"} "
+                << cumulative << "\n";
+        }
+        out << name << "_bucket{le=\"+Inf\"} " << snap.timerCount[t] << "\n";
+        out << name << "_sum " << std::setprecision(9) << snap.timerSumNs[t] / 1e9 << "\n";
+        out << name << "_count " << snap.timerCount[t] << "\n";
+    }
+    return out.str();
+}
+
+std::string Metrics::statsLine() {
+    MetricsSnapshot snap = snapshot();
+    uint64_t routes = snap.get(Counter::RouteQueries);
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1)
+        << "stats routes=" << routes
+        << " route_p50_us=" << snap.percentileNs(Timer::RouteQuery, 0.50) / 1000.0
+        << " route_p99_us=" << snap.percentileNs(Timer::RouteQuery, 0.99) / 1000.0
+        << " settled_per_route=" << (routes ? double(snap.get(Counter::NodesSettled)) / routes : 0.0)
+        << " relaxed_per_route=" << (routes ? double(snap.get(Counter::EdgesRelaxed)) / routes : 0.0)
+        << " searches=" << snap.get(Counter::SearchQueries)
+        << " search_p99_us=" << snap.percentileNs(Timer::SearchQuery, 0.99) / 1000.0
+        << " cache_hits=" << snap.get(Counter::CacheHits)
+        << " cache_misses=" << snap.get(Counter::CacheMisses)
+        << " route_cache_hits=" << snap.get(Counter::RouteCacheHits)
+        << " allocations=" << snap.get(Counter::Allocations);
+    return out.str();
+}
+
+void Metrics::startPeriodicLog(std::ostream& out, int intervalSeconds) {
+    stopPeriodicLog();
+    logStopping = false;
+    logThread = std::thread([&out, intervalSeconds] {
+        std::unique_lock<std::mutex> lock(logMutex);
+        while (!logCv.wait_for(lock, std::chrono::seconds(intervalSeconds), [] { return logStopping; })) {
+            out << statsLine() << std::endl;
+        }
+    });
+}
+
+void Metrics::stopPeriodicLog() {
+    {
+        std::lock_guard<std::mutex> lock(logMutex);
+        logStopping = true;
+    }
+    logCv.notify_all();
+    if (logThread.joinable()) logThread.join();
+}
+
+#ifdef METRO_COUNT_ALLOCATIONS
+// Opt-in global allocation counter; only counts while metrics are enabled
+void* operator new(std::size_t size) {
+    Metrics::add(Counter::Allocations);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+#endif
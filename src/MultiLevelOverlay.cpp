@@ -0,0 +1,575 @@
+#include "MultiLevelOverlay.h"
+#include "RouteKernel.h"
+#include "ThreadPool.h"
+#include "CancelToken.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+using Entry = std::pair<uint64_t, int>;
+const std::greater<Entry> later;
+
+// Cost of every edge under a policy, UNREACHED where it is closed
+template <typename Cost>
+void fillEdgeCosts(const CompactGraph& index, const Cost& cost, std::vector<uint64_t>& out) {
+    out.assign(index.getEdgeCount(), MultiLevelOverlay::UNREACHED);
+    CompactGraph::EdgeCursor edges;
+    auto set = [&](int e, typename Cost::Key step) {
+        if (cost.allowed(edges.target(e)) && cost.live(e, step)) out[e] = step;
+    };
+    for (int u = 0; u < index.size(); u++) {
+        edges.load(index, u);
+        int e = edges.begin;
+        for (; e < edges.rideEnd; e++) set(e, cost.ride(edges.meters(e)));
+        for (; e < edges.transferEnd; e++) set(e, cost.transfer(edges.meters(e)));
+        for (; e < edges.end; e++) set(e, cost.walk(edges.meters(e)));
+    }
+}
+
+template <typename Cost>
+void fillEdgeCosts(const CompactGraph& index, const Cost& cost, const std::atomic<uint32_t>* live,
+               typename Cost::Key perSecond, std::vector<uint64_t>& out) {
+    if (live) fillEdgeCosts(index, LiveCost<Cost>(cost, live, perSecond), out);
+    else fillEdgeCosts(index, cost, out);
+}
+
+// Cost of every arc between arrival states, in arc order (state by state,
+// each over its station's edges), and of every edge taken from the source
+// station; changes are charged as in RouteKernel's line-aware search
+template <typename Cost>
+void fillStateCosts(const CompactGraph& index, const Cost& cost, std::vector<uint64_t>& arcs,
+                    std::vector<uint64_t>& starts) {
+    using Key = typename Cost::Key;
+    const int CHANGING = -1, START = -2;
+    const Key change = cost.change();
+    CompactGraph::EdgeCursor edges;
+    auto costOf = [&](int e, Key step) {
+        return cost.allowed(edges.target(e)) && cost.live(e, step) ? uint64_t(step) : MultiLevelOverlay::UNREACHED;
+    };
+    // mode: the line the station was reached on, CHANGING or START
+    auto fill = [&](int u, int mode, std::vector<uint64_t>& out) {
+        Key leave = (mode == CHANGING) ? 0 : change;
+        edges.load(index, u);
+        int e = edges.begin;
+        for (; e < edges.rideEnd; e++) {
+            Key step = cost.ride(edges.meters(e));
+            if (mode >= 0 && index.edgeLine(e) != mode) step += change;
+            out.push_back(costOf(e, step));
+        }
+        for (; e < edges.transferEnd; e++) out.push_back(costOf(e, cost.transfer(edges.meters(e)) + leave));
+        for (; e < edges.end; e++) out.push_back(costOf(e, cost.walk(edges.meters(e)) + leave));
+    };
+    starts.clear();
+    starts.reserve(index.getEdgeCount());
+    for (int u = 0; u < index.size(); u++) fill(u, START, starts);
+    arcs.clear();
+    for (int state = 0; state < index.stateCount(); state++) {
+        fill(index.stationOfState(state), index.lineOfState(state), arcs);
+    }
+}
+
+template <typename Cost>
+void fillStateCosts(const CompactGraph& index, const Cost& cost, const std::atomic<uint32_t>* live,
+                    typename Cost::Key perSecond, std::vector<uint64_t>& arcs, std::vector<uint64_t>& starts) {
+    if (live) fillStateCosts(index, LiveCost<Cost>(cost, live, perSecond), arcs, starts);
+    else fillStateCosts(index, cost, arcs, starts);
+}
+
+// Arcs into each node, by counting sort on the head
+void buildInArcs(int nodes, const std::vector<int>& heads, std::vector<int>& offsets, std::vector<int>& in) {
+    offsets.assign(nodes + 1, 0);
+    for (int w : heads) offsets[w + 1]++;
+    for (int v = 0; v < nodes; v++) offsets[v + 1] += offsets[v];
+    in.resize(heads.size());
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t a = 0; a < heads.size(); a++) in[fill[heads[a]]++] = static_cast<int>(a);
+}
+
+} // namespace
+
+// Dijkstra scratch space, one per thread and direction; reset like KernelWorkspace
+struct MultiLevelOverlay::Workspace {
+    std::vector<uint64_t> dist;
+    std::vector<int> parent;
+    std::vector<int> via;       // arc into the node: arc ID, or -level; a start state's edge
+    std::vector<int> touched;
+    std::vector<Entry> heap;
+
+    void prepare(int n) {
+        if (static_cast<int>(dist.size()) != n) {
+            dist.assign(n, UNREACHED);
+            parent.assign(n, -1);
+            via.assign(n, -1);
+        } else {
+            for (int v : touched) {
+                dist[v] = UNREACHED;
+                parent[v] = -1;
+                via[v] = -1;
+            }
+        }
+        touched.clear();
+        heap.clear();
+    }
+
+    bool improve(int v, uint64_t d, int from, int arc) {
+        if (d >= dist[v]) return false;
+        if (dist[v] == UNREACHED) touched.push_back(v);
+        dist[v] = d;
+        parent[v] = from;
+        via[v] = arc;
+        heap.push_back({d, v});
+        std::push_heap(heap.begin(), heap.end(), later);
+        return true;
+    }
+
+    // Pops the closest unsettled node, or -1 when the heap runs out
+    int pop() {
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Entry top = heap.back();
+            heap.pop_back();
+            if (top.first == dist[top.second]) return top.second;
+        }
+        return -1;
+    }
+
+    uint64_t top() const { return heap.empty() ? 0 : heap.front().first; }
+};
+
+MultiLevelOverlay::MultiLevelOverlay(std::shared_ptr<const CompactGraph> graph, std::vector<int> cellSizes)
+    : index(std::move(graph)) {
+    TraceSpan span("MultiLevelOverlay::build", "index");
+    int n = index->size();
+    int edgeCount = index->getEdgeCount();
+    int stateCount = index->stateCount();
+
+    // Stations: one node each, one arc per edge
+    stations.stations.resize(n);
+    stations.nodeOffsets.resize(n + 1);
+    stations.outOffsets.resize(n + 1);
+    stations.heads.resize(edgeCount);
+    stations.tails.resize(edgeCount);
+    stations.edges.resize(edgeCount);
+    CompactGraph::EdgeCursor edges;
+    for (int u = 0; u < n; u++) {
+        stations.stations[u] = stations.nodeOffsets[u] = u;
+        stations.outOffsets[u] = index->edgeBegin(u);
+        edges.load(*index, u);
+        for (int e = edges.begin; e < edges.end; e++) {
+            stations.heads[e] = edges.target(e);
+            stations.tails[e] = u;
+            stations.edges[e] = e;
+        }
+    }
+    stations.nodeOffsets[n] = n;
+    stations.outOffsets[n] = edgeCount;
+    buildInArcs(n, stations.heads, stations.inOffsets, stations.inArcs);
+
+    // Arrival states, numbered station by station: one arc per edge of the
+    // state's station, into the state the edge arrives in
+    states.stations.resize(stateCount);
+    states.nodeOffsets.assign(n + 1, 0);
+    states.outOffsets.assign(stateCount + 1, 0);
+    for (int state = 0; state < stateCount; state++) {
+        int u = index->stationOfState(state);
+        states.stations[state] = u;
+        states.nodeOffsets[u + 1]++;
+        states.outOffsets[state + 1] = states.outOffsets[state] + (index->edgeEnd(u) - index->edgeBegin(u));
+    }
+    for (int u = 0; u < n; u++) states.nodeOffsets[u + 1] += states.nodeOffsets[u];
+    size_t arcCount = static_cast<size_t>(states.outOffsets[stateCount]);
+    states.heads.resize(arcCount);
+    states.tails.resize(arcCount);
+    states.edges.resize(arcCount);
+    for (int state = 0; state < stateCount; state++) {
+        int a = states.outOffsets[state];
+        int u = states.stations[state];
+        for (int e = index->edgeBegin(u); e < index->edgeEnd(u); e++, a++) {
+            states.heads[a] = index->arrivalState(e);
+            states.tails[a] = state;
+            states.edges[a] = e;
+        }
+    }
+    buildInArcs(stateCount, states.heads, states.inOffsets, states.inArcs);
+
+    std::sort(cellSizes.begin(), cellSizes.end());
+    cellSizes.erase(std::unique(cellSizes.begin(), cellSizes.end()), cellSizes.end());
+    for (int size : cellSizes) {
+        if (size < 1 || size >= n) continue;
+        Level level;
+        level.cellSize = size;
+        level.cellOf.assign(n, -1);
+        levels.push_back(std::move(level));
+    }
+    if (levels.empty()) return;
+
+    // Plane coordinates: degrees of longitude shrink with latitude
+    double meanLat = 0;
+    for (int v = 0; v < n; v++) meanLat += index->latitudeOf(v) / n;
+    double shrink = std::cos(meanLat * PI / 180.0);
+    std::vector<double> x(n), y(n), key(n);
+    for (int v = 0; v < n; v++) {
+        x[v] = index->longitudeOf(v) * shrink;
+        y[v] = index->latitudeOf(v);
+    }
+    std::vector<int> order(n);
+    for (int v = 0; v < n; v++) order[v] = v;
+    bisect(order, 0, n, SIZE_MAX, x, y, key);
+
+    // A size that splits no finer than the one below it repeats its cells
+    for (size_t l = 1; l < levels.size();) {
+        if (levels[l].cells == levels[l - 1].cells) levels.erase(levels.begin() + l);
+        else l++;
+    }
+    buildBoundaries(stations);
+    buildBoundaries(states);
+}
+
+void MultiLevelOverlay::buildBoundaries(Topology& graph) const {
+    int nodes = graph.size();
+    graph.levels.assign(levels.size(), Boundary());
+    for (size_t l = 0; l < levels.size(); l++) {
+        const std::vector<int>& cellOf = levels[l].cellOf;
+        int cells = levels[l].cells;
+        Boundary& boundary = graph.levels[l];
+        std::vector<char> crossing(nodes, 0);
+        for (size_t a = 0; a < graph.heads.size(); a++) {
+            int v = graph.tails[a], w = graph.heads[a];
+            if (cellOf[graph.stations[v]] != cellOf[graph.stations[w]]) crossing[v] = crossing[w] = 1;
+        }
+        boundary.offsets.assign(cells + 1, 0);
+        for (int v = 0; v < nodes; v++) {
+            if (crossing[v]) boundary.offsets[cellOf[graph.stations[v]] + 1]++;
+        }
+        for (int c = 0; c < cells; c++) boundary.offsets[c + 1] += boundary.offsets[c];
+        boundary.nodes.resize(boundary.offsets.back());
+        boundary.position.assign(nodes, -1);
+        std::vector<uint32_t> next(boundary.offsets.begin(), boundary.offsets.end() - 1);
+        for (int v = 0; v < nodes; v++) {
+            if (!crossing[v]) continue;
+            int c = cellOf[graph.stations[v]];
+            boundary.position[v] = static_cast<int>(next[c] - boundary.offsets[c]);
+            boundary.nodes[next[c]++] = v;
+        }
+        boundary.cliqueOffsets.assign(cells + 1, 0);
+        for (int c = 0; c < cells; c++) {
+            size_t count = boundary.offsets[c + 1] - boundary.offsets[c];
+            boundary.cliqueOffsets[c + 1] = boundary.cliqueOffsets[c] + count * count;
+        }
+    }
+}
+
+void MultiLevelOverlay::bisect(std::vector<int>& order, size_t begin, size_t end, size_t parentSize,
+                               const std::vector<double>& x, const std::vector<double>& y,
+                               std::vector<double>& key) {
+    size_t size = end - begin;
+    // The range is a whole cell at every level whose size it fits and its parent does not
+    for (Level& level : levels) {
+        size_t limit = static_cast<size_t>(level.cellSize);
+        if (size > limit || parentSize <= limit) continue;
+        for (size_t i = begin; i < end; i++) level.cellOf[order[i]] = level.cells;
+        level.cells++;
+    }
+    if (size <= static_cast<size_t>(levels.front().cellSize)) return;
+
+    // Principal axis of the range's points: the direction of largest spread
+    double mx = 0, my = 0;
+    for (size_t i = begin; i < end; i++) {
+        mx += x[order[i]];
+        my += y[order[i]];
+    }
+    mx /= size;
+    my /= size;
+    double sxx = 0, syy = 0, sxy = 0;
+    for (size_t i = begin; i < end; i++) {
+        double dx = x[order[i]] - mx, dy = y[order[i]] - my;
+        sxx += dx * dx;
+        syy += dy * dy;
+        sxy += dx * dy;
+    }
+    double angle = 0.5 * std::atan2(2 * sxy, sxx - syy);
+    double ax = std::cos(angle), ay = std::sin(angle);
+    for (size_t i = begin; i < end; i++) key[order[i]] = x[order[i]] * ax + y[order[i]] * ay;
+
+    // Median cut; ties by ID so stations without coordinates still split evenly
+    size_t middle = begin + size / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                     [&key](int a, int b) { return key[a] < key[b] || (key[a] == key[b] && a < b); });
+    bisect(order, begin, middle, size, x, y, key);
+    bisect(order, middle, end, size, x, y, key);
+}
+
+bool MultiLevelOverlay::supports(RouteCriterion criterion) {
+    return criterion != RouteCriterion::Fare;
+}
+
+const MultiLevelOverlay::Topology& MultiLevelOverlay::topology(RouteCriterion criterion) const {
+    return criterion == RouteCriterion::Distance ? stations : states;
+}
+
+int MultiLevelOverlay::queryLevel(const Topology& graph, int v, int s, int t) const {
+    // Cells nest, so the levels where v shares no cell with s or t are 1..k
+    int u = graph.stations[v];
+    for (int l = static_cast<int>(levels.size()); l >= 1; l--) {
+        const std::vector<int>& cellOf = levels[l - 1].cellOf;
+        if (cellOf[u] != cellOf[s] && cellOf[u] != cellOf[t]) return l;
+    }
+    return 0;
+}
+
+// Calls relax(neighbor, cost, arc) for v's arcs at a level: every arc at
+// level 0; otherwise its cell's clique row (column backward) and the arcs
+// leaving the cell. v must be a boundary node of that cell.
+template <bool Forward, typename Relax>
+void MultiLevelOverlay::arcs(const OverlayMetric& metric, int level, int v, Relax&& relax) const {
+    const Topology& graph = *metric.graph;
+    const uint64_t* costs = metric.arcCosts.data();
+    const std::vector<int>* cellOf = level > 0 ? &levels[level - 1].cellOf : nullptr;
+    int cell = cellOf ? (*cellOf)[graph.stations[v]] : -1;
+
+    auto arc = [&](int a, int w) {
+        if (costs[a] == UNREACHED) return;
+        if (cellOf && (*cellOf)[graph.stations[w]] == cell) return;     // covered by the clique
+        relax(w, costs[a], a);
+    };
+    if (Forward) {
+        for (int a = graph.outOffsets[v]; a < graph.outOffsets[v + 1]; a++) arc(a, graph.heads[a]);
+    } else {
+        for (int k = graph.inOffsets[v]; k < graph.inOffsets[v + 1]; k++) {
+            arc(graph.inArcs[k], graph.tails[graph.inArcs[k]]);
+        }
+    }
+    if (!cellOf) return;
+
+    const Boundary& boundary = graph.levels[level - 1];
+    uint32_t first = boundary.offsets[cell];
+    size_t count = boundary.offsets[cell + 1] - first;
+    size_t p = static_cast<size_t>(boundary.position[v]);
+    const uint64_t* clique = metric.cliques[level - 1].data() + boundary.cliqueOffsets[cell];
+    for (size_t j = 0; j < count; j++) {
+        uint64_t cost = Forward ? clique[p * count + j] : clique[j * count + p];
+        if (j != p && cost != UNREACHED) relax(boundary.nodes[first + j], cost, -level);
+    }
+}
+
+void MultiLevelOverlay::cellSearch(const OverlayMetric& metric, int level, int source, int target,
+                                   Workspace& ws) const {
+    // Dijkstra over the arcs one level down, kept inside source's cell
+    const Topology& graph = *metric.graph;
+    const std::vector<int>& cellOf = levels[level - 1].cellOf;
+    int cell = cellOf[graph.stations[source]];
+    ws.prepare(graph.size());
+    ws.improve(source, 0, -1, -1);
+    for (int u; (u = ws.pop()) >= 0;) {
+        if (u == target) return;
+        uint64_t du = ws.dist[u];
+        arcs<true>(metric, level - 1, u, [&](int w, uint64_t cost, int arc) {
+            if (cellOf[graph.stations[w]] == cell) ws.improve(w, du + cost, u, arc);
+        });
+    }
+}
+
+void MultiLevelOverlay::customize(OverlayMetric& metric, ThreadPool* pool) const {
+    metric.cliques.resize(levels.size());
+    for (size_t l = 1; l <= levels.size(); l++) {
+        const Level& level = levels[l - 1];
+        const Boundary& boundary = metric.graph->levels[l - 1];
+        std::vector<uint64_t>& cliques = metric.cliques[l - 1];
+        cliques.assign(boundary.cliqueOffsets.back(), UNREACHED);
+
+        // One search per boundary node; cells only read the level below
+        auto cell = [&](int c, Workspace& ws) {
+            uint32_t first = boundary.offsets[c];
+            size_t count = boundary.offsets[c + 1] - first;
+            uint64_t* clique = cliques.data() + boundary.cliqueOffsets[c];
+            for (size_t i = 0; i < count; i++) {
+                cellSearch(metric, static_cast<int>(l), boundary.nodes[first + i], -1, ws);
+                for (size_t j = 0; j < count; j++) clique[i * count + j] = ws.dist[boundary.nodes[first + j]];
+            }
+        };
+        if (!pool || pool->size() < 2) {
+            Workspace ws;
+            for (int c = 0; c < level.cells; c++) cell(c, ws);
+        } else {
+            std::vector<Workspace> workspaces(pool->size());
+            pool->parallelFor(level.cells, [&](size_t c, unsigned worker) {
+                cell(static_cast<int>(c), workspaces[worker]);
+            });
+        }
+    }
+}
+
+uint64_t MultiLevelOverlay::search(const OverlayMetric& metric, int s, int t, std::vector<Hop>* hops,
+                                   int* startEdge) const {
+    int n = index->size();
+    if (s < 0 || t < 0 || s >= n || t >= n) return UNREACHED;
+    if (hops) hops->clear();
+    if (startEdge) *startEdge = -1;
+    if (s == t) return 0;
+    const Topology& graph = *metric.graph;
+    thread_local Workspace forward, backward;
+    forward.prepare(graph.size());
+    backward.prepare(graph.size());
+
+    uint64_t best = UNREACHED;
+    int meet = -1;
+    // The route ends at any node of t. Over states it begins with an edge
+    // of s, priced as from the kernels' source state (startCosts)
+    for (int v = graph.nodeOffsets[t]; v < graph.nodeOffsets[t + 1]; v++) backward.improve(v, 0, -1, -1);
+    if (&graph == &stations) {
+        forward.improve(s, 0, -1, -1);
+    } else {
+        for (int e = index->edgeBegin(s); e < index->edgeEnd(s); e++) {
+            uint64_t cost = metric.startCosts[e];
+            int w = index->arrivalState(e);
+            if (cost == UNREACHED || !forward.improve(w, cost, -1, e)) continue;
+            if (backward.dist[w] != UNREACHED && cost < best) {
+                best = cost;
+                meet = w;
+            }
+        }
+    }
+
+    uint64_t settled = 0, relaxed = 0;
+    unsigned ticks = 0;
+    // Any route not yet seen costs at least the sum of the two heap tops
+    while ((!forward.heap.empty() || !backward.heap.empty()) && forward.top() + backward.top() < best) {
+        if (CancelToken::poll(ticks)) return UNREACHED;
+        bool ahead = backward.heap.empty() || (!forward.heap.empty() && forward.top() <= backward.top());
+        Workspace& ws = ahead ? forward : backward;
+        Workspace& other = ahead ? backward : forward;
+        int u = ws.pop();
+        if (u < 0) continue;
+        settled++;
+        uint64_t du = ws.dist[u];
+        auto relax = [&](int w, uint64_t cost, int arc) {
+            relaxed++;
+            uint64_t dw = du + cost;
+            if (!ws.improve(w, dw, u, arc) || other.dist[w] == UNREACHED) return;
+            if (dw + other.dist[w] < best) {
+                best = dw + other.dist[w];
+                meet = w;
+            }
+        };
+        int level = queryLevel(graph, u, s, t);
+        if (ahead) arcs<true>(metric, level, u, relax);
+        else arcs<false>(metric, level, u, relax);
+    }
+    if (Metrics::enabled()) {
+        Metrics::add(Counter::NodesSettled, settled);
+        Metrics::add(Counter::EdgesRelaxed, relaxed);
+    }
+    if (best == UNREACHED || !hops) return best;
+
+    // Arcs from the start to meet from the forward parents, then meet -> t
+    // from the backward ones; searches begin at nodes without a parent
+    int v = meet;
+    for (; forward.parent[v] >= 0; v = forward.parent[v]) hops->push_back({forward.parent[v], v, forward.via[v]});
+    if (startEdge) *startEdge = forward.via[v];
+    std::reverse(hops->begin(), hops->end());
+    for (v = meet; backward.parent[v] >= 0; v = backward.parent[v]) {
+        hops->push_back({v, backward.parent[v], backward.via[v]});
+    }
+    return best;
+}
+
+void MultiLevelOverlay::unpack(const OverlayMetric& metric, const Hop& hop, Workspace& ws,
+                               std::vector<int>& stations, std::vector<int>& edges) const {
+    if (hop.arc >= 0) {
+        stations.push_back(metric.graph->stations[hop.to]);
+        edges.push_back(metric.graph->edges[hop.arc]);
+        return;
+    }
+    // A clique arc is the cheapest route between two boundary nodes
+    // inside the cell: search it again one level down
+    cellSearch(metric, -hop.arc, hop.from, hop.to, ws);
+    std::vector<Hop> inner;
+    for (int v = hop.to; v != hop.from; v = ws.parent[v]) inner.push_back({ws.parent[v], v, ws.via[v]});
+    for (auto it = inner.rbegin(); it != inner.rend(); ++it) unpack(metric, *it, ws, stations, edges);
+}
+
+size_t MultiLevelOverlay::Topology::memoryBytes() const {
+    size_t bytes = (stations.capacity() + nodeOffsets.capacity() + outOffsets.capacity() + heads.capacity() +
+                    tails.capacity() + edges.capacity() + inOffsets.capacity() + inArcs.capacity()) *
+                   sizeof(int);
+    for (const Boundary& boundary : levels) {
+        bytes += (boundary.position.capacity() + boundary.nodes.capacity()) * sizeof(int) +
+                 boundary.offsets.capacity() * sizeof(uint32_t) +
+                 boundary.cliqueOffsets.capacity() * sizeof(size_t);
+    }
+    return bytes;
+}
+
+size_t MultiLevelOverlay::memoryBytes() const {
+    size_t bytes = stations.memoryBytes() + states.memoryBytes();
+    for (const Level& level : levels) bytes += level.cellOf.capacity() * sizeof(int);
+    return bytes;
+}
+
+std::shared_ptr<const OverlayMetric> OverlayMetric::customize(std::shared_ptr<const MultiLevelOverlay> overlay,
+                                                              RouteCriterion criterion, const CostModel& model,
+                                                              const std::atomic<uint32_t>* live, ThreadPool* pool) {
+    if (!overlay || !MultiLevelOverlay::supports(criterion)) return nullptr;
+    TraceSpan span("OverlayMetric::customize", "index");
+    std::shared_ptr<OverlayMetric> metric = std::make_shared<OverlayMetric>();
+    metric->overlay = overlay;
+    metric->criterion = criterion;
+    metric->graph = &overlay->topology(criterion);
+    const CompactGraph& index = *overlay->getIndex();
+    // Live conditions count as in Graph::findRoute: delays at the
+    // criterion's price per second, closures everywhere
+    switch (criterion) {
+        case RouteCriterion::Distance:
+            fillEdgeCosts(index, DistanceCost(), live, 0, metric->arcCosts);
+            break;
+        case RouteCriterion::Time:
+            fillStateCosts(index, TimeCost(model), live, 1000, metric->arcCosts, metric->startCosts);
+            break;
+        case RouteCriterion::Transfers:
+            fillStateCosts(index, TransferCost(), live, 0, metric->arcCosts, metric->startCosts);
+            break;
+        case RouteCriterion::Weighted: {
+            WeightedCost cost(model);
+            fillStateCosts(index, cost, live, cost.delay, metric->arcCosts, metric->startCosts);
+            break;
+        }
+        case RouteCriterion::Fare:
+            return nullptr;
+    }
+    overlay->customize(*metric, pool);
+    return metric;
+}
+
+uint64_t OverlayMetric::cost(int s, int t) const {
+    TraceSpan span("OverlayMetric::cost", "query");
+    return overlay->search(*this, s, t, nullptr, nullptr);
+}
+
+bool OverlayMetric::route(int s, int t, std::vector<int>& stations, std::vector<int>& edges) const {
+    TraceSpan span("OverlayMetric::route", "query");
+    stations.clear();
+    edges.clear();
+    thread_local std::vector<MultiLevelOverlay::Hop> hops;
+    int start = -1;
+    if (overlay->search(*this, s, t, &hops, &start) == MultiLevelOverlay::UNREACHED) return false;
+    thread_local MultiLevelOverlay::Workspace ws;
+    stations.push_back(s);
+    if (start >= 0) {
+        stations.push_back(graph->stations[overlay->getIndex()->arrivalState(start)]);
+        edges.push_back(start);
+    }
+    for (const MultiLevelOverlay::Hop& hop : hops) overlay->unpack(*this, hop, ws, stations, edges);
+    return true;
+}
+
+size_t OverlayMetric::memoryBytes() const {
+    size_t bytes = (arcCosts.capacity() + startCosts.capacity()) * sizeof(uint64_t);
+    for (const std::vector<uint64_t>& clique : cliques) bytes += clique.capacity() * sizeof(uint64_t);
+    return bytes;
+}
@@ -0,0 +1,178 @@
+#include "NetworkGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+namespace {
+
+const double KM_PER_DEG_LAT = 111.0;
+const double PI = 3.14159265358979323846;
+
+struct Builder {
+    Graph& graph;
+    const NetworkSpec& spec;
+    std::mt19937 rng;
+    std::uniform_real_distribution<double> jitter{-0.15, 0.15};
+    int created = 0;
+
+    Builder(Graph& g, const NetworkSpec& s) : graph(g), spec(s), rng(s.seed) {}
+
+    double kmPerDegLon() const {
+        return KM_PER_DEG_LAT * std::cos(spec.centerLat * PI / 180.0);
+    }
+
+    // Add a station at (x, y) km from the centre
+    std::string station(const std::string& name, const std::string& line, double x, double y) {
+        double radius = std::sqrt(x * x + y * y);
+        int zone = 1 + static_cast<int>(radius / 5.0);
+        graph.addStation(name, line, zone,
+                         spec.centerLat + y / KM_PER_DEG_LAT,
+                         spec.centerLon + x / kmPerDegLon());
+        created++;
+        return name;
+    }
+
+    // Track distance in km between two stations, plus a little slack
+    double distanceKm(const std::string& a, const std::string& b) const {
+        const Station* sa = graph.getStation(a);
+        const Station* sb = graph.getStation(b);
+        double dy = (sa->getLatitude() - sb->getLatitude()) * KM_PER_DEG_LAT;
+        double dx = (sa->getLongitude() - sb->getLongitude()) * kmPerDegLon();
+        return std::round(std::sqrt(dx * dx + dy * dy) * 1.1 * 10.0 + 1.0) / 10.0;
+    }
+
+    void connect(const std::string& a, const std::string& b) {
+        graph.addEdge(a, b, distanceKm(a, b));
+    }
+};
+
+void buildGrid(Builder& b) {
+    // 2k lines of n stations each => ~2kn stations; choose k ~ n / 4 so lines are long
+    int target = std::max(b.spec.stations, 16);
+    int n = std::max(4, static_cast<int>(std::sqrt(target * 2.0)));
+    int linesPerAxis = std::max(1, target / (2 * n));
+    double span = n * 1.0;  // km
+    double gap = span / (linesPerAxis + 1);
+
+    std::vector<std::vector<std::string>> eastWest(linesPerAxis), northSouth(linesPerAxis);
+    for (int l = 0; l < linesPerAxis; l++) {
+        std::string ew = "EW" + std::to_string(l + 1) + " Line";
+        std::string ns = "NS" + std::to_string(l + 1) + " Line";
+        double offset = -span / 2 + gap * (l + 1);
+        for (int i = 0; i < n; i++) {
+            double along = -span / 2 + i + 0.5;
+            eastWest[l].push_back(b.station("EW" + std::to_string(l + 1) + "-" + std::to_string(i + 1),
+                                            ew, along + b.jitter(b.rng), offset + b.jitter(b.rng)));
+            northSouth[l].push_back(b.station("NS" + std::to_string(l + 1) + "-" + std::to_string(i + 1),
+                                              ns, offset + b.jitter(b.rng), along + b.jitter(b.rng)));
+            if (i > 0) {
+                b.connect(eastWest[l][i - 1], eastWest[l][i]);
+                b.connect(northSouth[l][i - 1], northSouth[l][i]);
+            }
+        }
+    }
+
+    // Interchanges: where EW line r crosses NS line c, link the closest stations
+    for (int r = 0; r < linesPerAxis; r++) {
+        for (int c = 0; c < linesPerAxis; c++) {
+            double offset = -span / 2 + gap * (c + 1);
+            int i = std::min(n - 1, std::max(0, static_cast<int>(offset + span / 2)));
+            double crossRow = -span / 2 + gap * (r + 1);
+            int j = std::min(n - 1, std::max(0, static_cast<int>(crossRow + span / 2)));
+            b.connect(eastWest[r][i], northSouth[c][j]);
+        }
+    }
+}
+
+void buildRadial(Builder& b) {
+    // r radial lines of n stations + rings; split the budget ~70/30
+    int target = std::max(b.spec.stations, 16);
+    int radials = std::max(3, std::min(64, static_cast<int>(std::sqrt(target / 4.0))));
+    int perRadial = std::max(2, static_cast<int>(target * 0.7) / radials);
+    int rings = std::max(1, perRadial / 8);
+    int perRing = std::max(radials, (target - radials * perRadial) / rings);
+
+    std::vector<std::vector<std::string>> radial(radials);
+    for (int r = 0; r < radials; r++) {
+        std::string line = "R" + std::to_string(r + 1) + " Line";
+        double angle = 2 * PI * r / radials;
+        for (int i = 0; i < perRadial; i++) {
+            double dist = 0.5 + i * 1.0;
+            radial[r].push_back(b.station("R" + std::to_string(r + 1) + "-" + std::to_string(i + 1), line,
+                                          dist * std::cos(angle) + b.jitter(b.rng),
+                                          dist * std::sin(angle) + b.jitter(b.rng)));
+            if (i > 0) b.connect(radial[r][i - 1], radial[r][i]);
+        }
+        // All radials meet at a central interchange
+        if (r > 0) b.connect(radial[0][0], radial[r][0]);
+    }
+
+    for (int k = 0; k < rings; k++) {
+        std::string line = "Ring" + std::to_string(k + 1) + " Line";
+        int radiusIndex = std::min(perRadial - 1, (k + 1) * perRadial / (rings + 1));
+        double radius = 0.5 + radiusIndex * 1.0;
+        std::vector<std::string> ring;
+        for (int i = 0; i < perRing; i++) {
+            double angle = 2 * PI * i / perRing;
+            ring.push_back(b.station("Ring" + std::to_string(k + 1) + "-" + std::to_string(i + 1), line,
+                                     radius * std::cos(angle) + b.jitter(b.rng),
+                                     radius * std::sin(angle) + b.jitter(b.rng)));
+            if (i > 0) b.connect(ring[i - 1], ring[i]);
+        }
+        b.connect(ring.back(), ring.front());
+
+        // Interchange with every radial at this radius
+        for (int r = 0; r < radials; r++) {
+            int i = static_cast<int>(std::round(static_cast<double>(r) * perRing / radials)) % perRing;
+            b.connect(ring[i], radial[r][radiusIndex]);
+        }
+    }
+}
+
+} // namespace
+
+int NetworkGenerator::generate(Graph& graph, const NetworkSpec& spec) {
+    Builder builder(graph, spec);
+    if (spec.topology == Topology::Grid) {
+        buildGrid(builder);
+    } else {
+        buildRadial(builder);
+    }
+    return builder.created;
+}
+
+bool NetworkGenerator::writeNetwork(const Graph& graph, const std::string& dir) {
+    std::ofstream stationsOut(dir + "/stations.txt");
+    std::ofstream connectionsOut(dir + "/connections.txt");
+    if (!stationsOut.is_open() || !connectionsOut.is_open()) return false;
+
+    stationsOut << "# Generated Stations\n# Format: StationName,MetroLine,Zone,Latitude,Longitude\n";
+    stationsOut << std::fixed << std::setprecision(6);
+    for (const auto& pair : graph.getStations()) {
+        const Station& s = pair.second;
+        stationsOut << s.getName() << "," << s.getMetroLine() << "," << s.getZone() << ","
+                    << s.getLatitude() << "," << s.getLongitude() << "\n";
+    }
+
+    // Generated links are two-way and stored in both directions; write each once.
+    // Walk links are left out since the loader can regenerate them.
+    connectionsOut << "# Generated Connections\n# Format: Station1,Station2,Distance(km)\n";
+    for (const auto& pair : graph.getAdjacency()) {
+        for (const auto& edge : pair.second) {
+            if (pair.first < edge.to && edge.type != EdgeType::Walk) {
+                connectionsOut << pair.first << "," << edge.to << "," << edge.weight << "\n";
+            }
+        }
+    }
+    return true;
+}
+
+bool NetworkGenerator::parseTopology(const std::string& name, Topology& topology) {
+    if (name == "grid") topology = Topology::Grid;
+    else if (name == "radial") topology = Topology::Radial;
+    else return false;
+    return true;
+}
@@ -0,0 +1,181 @@
+#include "NetworkRegistry.h"
+#include "DataLoader.h"
+#include "ChangeJournal.h"
+#include "MultiLevelOverlay.h"
+#include "Trace.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+NetworkRegistry::NetworkRegistry(const Options& opts) : options(opts) {}
+
+bool NetworkRegistry::add(const std::string& id, const std::string& dataDir, bool pinned) {
+    std::unique_lock<std::shared_mutex> lock(entriesMutex);
+    if (id.empty() || entries.count(id)) return false;
+    std::unique_ptr<Entry> entry(new Entry());
+    entry->id = id;
+    entry->dataDir = dataDir;
+    entry->pinned = pinned;
+    entries[id] = std::move(entry);
+    if (defaultId.empty()) defaultId = id;
+    return true;
+}
+
+int NetworkRegistry::addAll(const std::string& root) {
+    std::vector<fs::path> dirs;
+    std::error_code error;
+    for (const auto& item : fs::directory_iterator(root, error)) {
+        if (item.is_directory() && fs::exists(item.path() / "stations.txt")) {
+            dirs.push_back(item.path());
+        }
+    }
+    std::sort(dirs.begin(), dirs.end());
+    int added = 0;
+    for (const auto& dir : dirs) {
+        if (add(dir.filename().string(), dir.string())) added++;
+    }
+    return added;
+}
+
+NetworkRegistry::Entry* NetworkRegistry::find(const std::string& id) const {
+    std::shared_lock<std::shared_mutex> lock(entriesMutex);
+    auto it = entries.find(id);
+    return (it != entries.end()) ? it->second.get() : nullptr;
+}
+
+std::shared_ptr<const Network> NetworkRegistry::load(Entry& entry) const {
+    TraceSpan span("NetworkRegistry::load", "load", entry.id);
+    std::shared_ptr<Network> network = std::make_shared<Network>();
+    network->id = entry.id;
+    if (!loadNetwork(network->graph, entry.dataDir, false)) {
+        std::cerr << "Failed to load network " << entry.id << " from " << entry.dataDir << "\n";
+        return nullptr;
+    }
+    ChangeJournal::replay(entry.dataDir, network->graph);
+    network->graph.generateWalkingLinks(options.walkKm);
+    network->graph.setStationOrder(options.order);
+    network->graph.setCompressedRouting(options.compressed);
+    network->cache.reset(new ArtifactCache(entry.dataDir, artifactParams(options.walkKm, options.order) +
+                                                          ChangeJournal::cacheKey(entry.dataDir)));
+    loadRoutingIndex(network->graph, *network->cache);
+    if (options.hubLabels) loadHubLabels(network->graph, *network->cache);
+    // Loads run on request threads, so the metric is customized on this one
+    // rather than on a pool
+    if (options.multiLevel) {
+        network->graph.setMultiLevelOverlay(
+            std::make_shared<const MultiLevelOverlay>(network->graph.getRoutingIndex()));
+        network->graph.customizeOverlay();
+    }
+    network->engine.reset(new QueryEngine(network->graph, options.routeCacheEntries));
+    network->memoryBytes = network->graph.memoryBytes() + network->engine->memoryBytes();
+    return network;
+}
+
+std::shared_ptr<const Network> NetworkRegistry::acquire(const std::string& id) {
+    Entry* entry = find(id);
+    if (entry == nullptr) return nullptr;
+    entry->lastUsed.store(++clock, std::memory_order_relaxed);
+    entry->queries.fetch_add(1, std::memory_order_relaxed);
+
+    std::shared_ptr<const Network> network = std::atomic_load(&entry->network);
+    if (network) return network;
+
+    {
+        // Queries for other networks carry on while this one loads
+        std::lock_guard<std::mutex> lock(entry->loadMutex);
+        network = std::atomic_load(&entry->network);
+        if (!network) {
+            network = load(*entry);
+            if (!network) return nullptr;
+            std::atomic_store(&entry->network, network);
+            entry->loads.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    enforceBudget(entry);
+    return network;
+}
+
+void NetworkRegistry::enforceBudget(const Entry* keep) {
+    if (options.maxResidentBytes == 0 && options.maxResident == 0) return;
+    std::shared_lock<std::shared_mutex> lock(entriesMutex);
+    while (true) {
+        size_t bytes = 0, resident = 0;
+        Entry* victim = nullptr;
+        uint64_t oldest = UINT64_MAX;
+        for (const auto& pair : entries) {
+            Entry* entry = pair.second.get();
+            std::shared_ptr<const Network> network = std::atomic_load(&entry->network);
+            if (!network) continue;
+            bytes += network->memoryBytes;
+            resident++;
+            uint64_t used = entry->lastUsed.load(std::memory_order_relaxed);
+            if (!entry->pinned && entry != keep && used < oldest) {
+                oldest = used;
+                victim = entry;
+            }
+        }
+        bool over = (options.maxResidentBytes > 0 && bytes > options.maxResidentBytes) ||
+                    (options.maxResident > 0 && resident > options.maxResident);
+        if (!over || victim == nullptr) return;
+        std::atomic_store(&victim->network, std::shared_ptr<const Network>());
+    }
+}
+
+bool NetworkRegistry::evict(const std::string& id) {
+    Entry* entry = find(id);
+    if (entry == nullptr || !std::atomic_load(&entry->network)) return false;
+    std::atomic_store(&entry->network, std::shared_ptr<const Network>());
+    return true;
+}
+
+std::vector<NetworkStatus> NetworkRegistry::status() const {
+    std::shared_lock<std::shared_mutex> lock(entriesMutex);
+    std::vector<NetworkStatus> result;
+    for (const auto& pair : entries) {
+        const Entry& entry = *pair.second;
+        std::shared_ptr<const Network> network = std::atomic_load(&entry.network);
+        result.push_back({entry.id, entry.dataDir, network != nullptr, entry.pinned,
+                          network ? network->memoryBytes : 0,
+                          entry.loads.load(std::memory_order_relaxed),
+                          entry.queries.load(std::memory_order_relaxed)});
+    }
+    return result;
+}
+
+size_t NetworkRegistry::residentBytes() const {
+    size_t bytes = 0;
+    for (const auto& network : status()) {
+        bytes += network.memoryBytes;
+    }
+    return bytes;
+}
+
+std::string NetworkRegistry::answer(const std::string& request, ResponseFormat format) {
+    std::string id = defaultId;
+    std::string rest = request;
+    if (!request.empty() && request[0] == '@') {
+        size_t bar = request.find('|');
+        id = request.substr(1, bar == std::string::npos ? std::string::npos : bar - 1);
+        rest = (bar == std::string::npos) ? std::string() : request.substr(bar + 1);
+    }
+
+    std::string command = rest;
+    if (!command.empty() && command.back() == '\r') command.pop_back();
+    if (command == "networks") {
+        std::vector<std::string> lines;
+        for (const auto& network : status()) {
+            lines.push_back(network.id + " loaded=" + (network.loaded ? "1" : "0") +
+                            " pinned=" + (network.pinned ? "1" : "0") +
+                            " bytes=" + std::to_string(network.memoryBytes) +
+                            " loads=" + std::to_string(network.loads) +
+                            " queries=" + std::to_string(network.queries));
+        }
+        return QueryEngine::listAnswer("networks", lines, format);
+    }
+
+    std::shared_ptr<const Network> network = acquire(id);
+    if (!network) return QueryEngine::errorAnswer("unknown network: " + id, format);
+    return network->engine->answer(rest, format);
+}
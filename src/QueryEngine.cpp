@@ -0,0 +1,518 @@
+#include "QueryEngine.h"
+#include "Metrics.h"
+#include "RouteKernel.h"
+#include "RouteResult.h"
+#include "CompactGraph.h"
+#include "HubLabels.h"
+#include "WeightOverlay.h"
+#include "HopReachability.h"
+#include "LineIndex.h"
+#include "DistanceMatrix.h"
+#include "Isochrone.h"
+#include "RouteCache.h"
+#include "CancelToken.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <sstream>
+#include <iomanip>
+
+namespace {
+
+// One answer field, kept in both encodings so rendering is a simple join
+struct Field {
+    std::string key;
+    std::string json;
+    std::string text;
+};
+
+void appendJson(std::string& out, const std::string& value) {
+    out += '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default: out += c;
+        }
+    }
+    out += '"';
+}
+
+std::string jsonEscape(const std::string& value) {
+    std::string out;
+    appendJson(out, value);
+    return out;
+}
+
+std::string formatNumber(double value) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3) << value;
+    return oss.str();
+}
+
+Field numberField(const std::string& key, double value) {
+    std::string s = formatNumber(value);
+    return {key, s, s};
+}
+
+Field intField(const std::string& key, long long value) {
+    std::string s = std::to_string(value);
+    return {key, s, s};
+}
+
+Field stringField(const std::string& key, const std::string& value) {
+    // Text answers are one line each, so embedded newlines are escaped there too
+    std::string text;
+    for (char c : value) {
+        if (c == '\n') text += "\\n";
+        else text += c;
+    }
+    return {key, jsonEscape(value), text};
+}
+
+Field listField(const std::string& key, const std::vector<std::string>& values) {
+    Field f{key, "[", ""};
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0) {
+            f.json += ",";
+            f.text += ";";
+        }
+        f.json += jsonEscape(values[i]);
+        f.text += values[i];
+    }
+    f.json += "]";
+    return f;
+}
+
+std::string frame(const std::string& payload) {
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    std::string out(4, '\0');
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<char>((length >> (8 * i)) & 0xFF);
+    }
+    return out + payload;
+}
+
+std::string render(const std::vector<Field>& fields, ResponseFormat format) {
+    if (format == ResponseFormat::Json) {
+        std::string out = "{\"ok\":true";
+        for (const auto& f : fields) {
+            out += ",\"" + f.key + "\":" + f.json;
+        }
+        return out + "}\n";
+    }
+    std::string payload = "OK";
+    for (const auto& f : fields) {
+        payload += "\t" + f.text;
+    }
+    return (format == ResponseFormat::Text) ? payload + "\n" : frame(payload);
+}
+
+std::string renderError(const std::string& message, ResponseFormat format) {
+    if (format == ResponseFormat::Json) {
+        return "{\"ok\":false,\"error\":" + jsonEscape(message) + "}\n";
+    }
+    std::string payload = "ERR\t" + message;
+    return (format == ResponseFormat::Text) ? payload + "\n" : frame(payload);
+}
+
+bool parseDouble(const std::string& s, double& out) {
+    try {
+        size_t used = 0;
+        out = std::stod(s, &used);
+        return used == s.size();
+    } catch (...) {
+        return false;
+    }
+}
+
+bool parseInt(const std::string& s, int& out) {
+    try {
+        size_t used = 0;
+        out = std::stoi(s, &used);
+        return used == s.size();
+    } catch (...) {
+        return false;
+    }
+}
+
+// Same layout as routeFields, appended straight from a RouteResult: names are
+// looked up in the index as they are written, never collected
+std::string renderRoute(const RouteResult& route, const CompactGraph& index, const Graph& graph,
+                        ResponseFormat format) {
+    bool json = (format == ResponseFormat::Json);
+    char number[32];
+    std::string out = json ? "{\"ok\":true" : "OK";
+    auto field = [&](const char* key) {
+        if (json) {
+            out += ",\"";
+            out += key;
+            out += "\":";
+        } else {
+            out += '\t';
+        }
+    };
+    auto name = [&](const std::string& value, bool first) {
+        if (!first) out += json ? ',' : ';';
+        if (json) appendJson(out, value);
+        else out += value;
+    };
+
+    field("distance");
+    std::snprintf(number, sizeof(number), "%.3f", route.totalDistance);
+    out += number;
+    field("fare");
+    out += std::to_string(route.estimatedFare);
+    field("transfers");
+    out += std::to_string(route.transferPoints);
+    field("minutes");
+    std::snprintf(number, sizeof(number), "%.3f", route.travelMinutes);
+    out += number;
+
+    field("lines");
+    if (json) out += '[';
+    thread_local std::vector<int> lines;
+    lines.clear();
+    route.linesUsed(lines);
+    for (size_t i = 0; i < lines.size(); i++) {
+        name(index.lineName(lines[i]), i == 0);
+    }
+    if (lines.empty() && !route.stations.empty()) {
+        const Station* start = graph.getStation(index.nameOf(route.stations[0]));
+        if (start != nullptr) name(start->getMetroLine(), true);
+    }
+    if (json) out += ']';
+
+    field("path");
+    if (json) out += '[';
+    for (size_t i = 0; i < route.stations.size(); i++) {
+        name(index.nameOf(route.stations[i]), i == 0);
+    }
+    if (json) out += "]}";
+
+    if (format == ResponseFormat::Binary) return frame(out);
+    out += '\n';
+    return out;
+}
+
+bool isErrorAnswer(const std::string& answer, ResponseFormat format) {
+    if (format == ResponseFormat::Json) return answer.compare(0, 11, "{\"ok\":false") == 0;
+    if (format == ResponseFormat::Text) return answer.compare(0, 4, "ERR\t") == 0;
+    return answer.size() >= 8 && answer.compare(4, 4, "ERR\t") == 0;
+}
+
+bool cacheableRequest(const std::string& request) {
+    return request.compare(0, 6, "route|") == 0 || request.compare(0, 9, "cheapest|") == 0 ||
+           request.compare(0, 9, "distance|") == 0;
+}
+
+std::vector<Field> routeFields(const PathInfo& path) {
+    return {numberField("distance", path.totalDistance),
+            intField("fare", path.estimatedFare),
+            intField("transfers", path.transferPoints),
+            numberField("minutes", path.travelMinutes),
+            listField("lines", path.metroLines),
+            listField("path", path.path)};
+}
+
+} // namespace
+
+QueryEngine::QueryEngine(const Graph& g, size_t routeCacheEntries)
+    : graph(g), search(g.getStations()) {
+    if (routeCacheEntries > 0) routeCache.reset(new RouteCache(routeCacheEntries));
+}
+
+QueryEngine::~QueryEngine() = default;
+
+std::string QueryEngine::errorAnswer(const std::string& message, ResponseFormat format) {
+    return renderError(message, format);
+}
+
+std::string QueryEngine::listAnswer(const std::string& key, const std::vector<std::string>& values,
+                                    ResponseFormat format) {
+    return render({listField(key, values)}, format);
+}
+
+std::string QueryEngine::fieldsAnswer(const std::vector<std::pair<std::string, double>>& numbers,
+                                      const std::vector<std::pair<std::string, std::vector<std::string>>>& lists,
+                                      ResponseFormat format) {
+    std::vector<Field> fields;
+    for (const auto& number : numbers) fields.push_back(numberField(number.first, number.second));
+    for (const auto& list : lists) fields.push_back(listField(list.first, list.second));
+    return render(fields, format);
+}
+
+std::vector<std::string> QueryEngine::splitFields(const std::string& request) {
+    std::vector<std::string> fields;
+    std::stringstream ss(request);
+    std::string field;
+    while (std::getline(ss, field, '|')) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+bool QueryEngine::parseFormatCommand(const std::string& request, ResponseFormat& format) {
+    if (request.compare(0, 7, "format|") != 0) return false;
+    std::string name = request.substr(7);
+    if (!name.empty() && name.back() == '\r') name.pop_back();
+    if (name == "json") format = ResponseFormat::Json;
+    else if (name == "text") format = ResponseFormat::Text;
+    else if (name == "binary") format = ResponseFormat::Binary;
+    else return false;
+    return true;
+}
+
+std::string QueryEngine::answer(const std::string& request, ResponseFormat format) const {
+    if (!routeCache || !cacheableRequest(request)) return compute(request, format);
+
+    // Read the version first: a live batch landing mid-query costs a miss
+    std::shared_ptr<WeightOverlay> overlay = graph.getWeightOverlay();
+    uint64_t version = overlay ? overlay->batchCount() : 0;
+    std::string key = RouteCache::key(request, format);
+    std::string out;
+    if (routeCache->lookup(key, version, out)) return out;
+    out = compute(request, format);
+    CancelToken* token = CancelToken::current();
+    if (!isErrorAnswer(out, format) && !(token && token->isCancelled())) {
+        routeCache->insert(key, version, out);
+    }
+    return out;
+}
+
+std::string QueryEngine::compute(const std::string& request, ResponseFormat format) const {
+    std::string line = request;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+
+    std::vector<std::string> f = splitFields(line);
+    if (f.empty()) return renderError("empty request", format);
+    const std::string& cmd = f[0];
+
+    if (cmd == "ping") {
+        return render({stringField("pong", "metro")}, format);
+    }
+
+    if (cmd == "stats") {
+        return render({stringField("stats", Metrics::statsLine())}, format);
+    }
+
+    if (cmd == "metrics") {
+        return render({stringField("prometheus", Metrics::prometheusText())}, format);
+    }
+
+    if (cmd == "format") {
+        if (f.size() != 2 || (f[1] != "json" && f[1] != "text" && f[1] != "binary")) {
+            return renderError("usage: format|json|text|binary", format);
+        }
+        return render({stringField("format", f[1])}, format);
+    }
+
+    if (cmd == "route" && f.size() == 4) {
+        RouteCriterion criterion;
+        if (!RouteKernel::parseCriterion(f[3], criterion)) {
+            return renderError("unknown criterion: " + f[3], format);
+        }
+        if (!graph.hasStation(f[1])) return renderError("unknown station: " + f[1], format);
+        if (!graph.hasStation(f[2])) return renderError("unknown station: " + f[2], format);
+        thread_local RouteResult route;
+        std::shared_ptr<const CompactGraph> index = graph.getRoutingIndex();
+        if (!graph.findRoute(index->idOf(f[1]), index->idOf(f[2]), criterion, *index, route)) {
+            return renderError("no route", format);
+        }
+        return renderRoute(route, *index, graph, format);
+    }
+
+    if (cmd == "route" || cmd == "cheapest") {
+        if (f.size() != 3) {
+            return renderError("usage: " + cmd + "|<from>|<to>" + (cmd == "route" ? "[|<criterion>]" : ""), format);
+        }
+        if (!graph.hasStation(f[1])) return renderError("unknown station: " + f[1], format);
+        if (!graph.hasStation(f[2])) return renderError("unknown station: " + f[2], format);
+        PathInfo path = (cmd == "route") ? graph.findShortestPath(f[1], f[2])
+                                         : graph.findCheapestPath(f[1], f[2]);
+        if (path.totalDistance < 0) return renderError("no route", format);
+        return render(routeFields(path), format);
+    }
+
+    if (cmd == "distance") {
+        if (f.size() != 3) return renderError("usage: distance|<from>|<to>", format);
+        std::shared_ptr<const CompactGraph> index = graph.getRoutingIndex();
+        int s = index->idOf(f[1]);
+        int t = index->idOf(f[2]);
+        if (s < 0) return renderError("unknown station: " + f[1], format);
+        if (t < 0) return renderError("unknown station: " + f[2], format);
+        std::shared_ptr<const HubLabels> labels = graph.getHubLabels();
+        std::shared_ptr<WeightOverlay> overlay = graph.getWeightOverlay();
+        double km;
+        if (labels && labels->matches(*index) && !(overlay && overlay->hasClosures())) {
+            km = labels->distance(s, t);
+        } else {
+            thread_local RouteResult route;
+            graph.findRoute(s, t, RouteCriterion::Distance, *index, route);
+            km = route.totalDistance;
+        }
+        if (km < 0) return renderError("no route", format);
+        return render({numberField("distance", km)}, format);
+    }
+
+    if (cmd == "table") {
+        if (f.size() != 3) return renderError("usage: table|<from;...>|<to;...>", format);
+        std::shared_ptr<const CompactGraph> index = graph.getRoutingIndex();
+        std::vector<int> ids[2];
+        for (int list = 0; list < 2; list++) {
+            std::stringstream names(f[list + 1]);
+            std::string name;
+            while (std::getline(names, name, ';')) {
+                int id = index->idOf(name);
+                if (id < 0) return renderError("unknown station: " + name, format);
+                ids[list].push_back(id);
+            }
+        }
+        // One search per source, stopped once every target is settled
+        thread_local SearchWorkspace workspace;
+        std::vector<std::string> values;
+        values.reserve(ids[0].size() * ids[1].size());
+        for (int s : ids[0]) {
+            for (double km : DistanceMatrix::oneToMany(*index, s, ids[1], workspace)) {
+                values.push_back(formatNumber(km));
+            }
+        }
+        return render({listField("distances", values)}, format);
+    }
+
+    if (cmd == "isochrone") {
+        BudgetKind kind = BudgetKind::Distance;
+        std::vector<double> limits;
+        bool valid = f.size() == 4 && (f[2] == "distance" || f[2] == "fare");
+        if (valid) {
+            kind = (f[2] == "fare") ? BudgetKind::Fare : BudgetKind::Distance;
+            std::stringstream values(f[3]);
+            std::string value;
+            double limit;
+            while (valid && std::getline(values, value, ';')) {
+                valid = parseDouble(value, limit) && limit >= 0 && (limits.empty() || limit > limits.back());
+                limits.push_back(limit);
+            }
+        }
+        if (!valid || limits.empty()) {
+            return renderError("usage: isochrone|<station>|<distance or fare>|<ascending limits;...>", format);
+        }
+        std::shared_ptr<const CompactGraph> index = graph.getRoutingIndex();
+        int s = index->idOf(f[1]);
+        if (s < 0) return renderError("unknown station: " + f[1], format);
+        thread_local SearchWorkspace workspace;
+        IsochroneResult result = Isochrone::compute(*index, s, limits, kind, graph.getFareCalculator(), workspace);
+
+        // Bands in limit order; within a band, by name so the station order does not show
+        std::vector<std::string> counts, stations;
+        for (const auto& band : result.bands) {
+            counts.push_back(std::to_string(band.stations.size()));
+            size_t first = stations.size();
+            for (int v : band.stations) stations.push_back(index->nameOf(v));
+            std::sort(stations.begin() + first, stations.end());
+        }
+        std::vector<std::string> limitNames;
+        for (double limit : limits) limitNames.push_back(formatNumber(limit));
+        return render({listField("limits", limitNames), listField("counts", counts),
+                       listField("stations", stations)}, format);
+    }
+
+    if (cmd == "line") {
+        if (f.size() != 3) return renderError("usage: line|<from>|<to>", format);
+        std::shared_ptr<const LineIndex> lines = graph.getLineIndex();
+        const CompactGraph& index = *lines->getIndex();
+        int s = index.idOf(f[1]);
+        int t = index.idOf(f[2]);
+        if (s < 0) return renderError("unknown station: " + f[1], format);
+        if (t < 0) return renderError("unknown station: " + f[2], format);
+        LineIndex::Segment segment = lines->sameLine(s, t);
+        if (!segment.found()) return renderError("no common line", format);
+        return render({stringField("line", index.lineName(segment.line)),
+                       numberField("distance", segment.meters / 1000.0),
+                       intField("stops", segment.stops)}, format);
+    }
+
+    if (cmd == "hops") {
+        int limit;
+        if (f.size() != 3 || !parseInt(f[2], limit) || limit < 0) {
+            return renderError("usage: hops|<station>|<n>", format);
+        }
+        std::shared_ptr<const HopGraph> hopGraph = graph.getHopGraph();
+        const CompactGraph& index = *hopGraph->getIndex();
+        int s = index.idOf(f[1]);
+        if (s < 0) return renderError("unknown station: " + f[1], format);
+        thread_local HopWorkspace workspace;
+        HopResult result = hopGraph->distances(s, limit, workspace);
+
+        // Group by hop count; within a hop, by name, whatever the station order
+        std::vector<int> offsets(result.levels.size() + 1, 0);
+        for (size_t h = 0; h < result.levels.size(); h++) offsets[h + 1] = offsets[h] + result.levels[h];
+        std::vector<std::string> stations(offsets.back());
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (int v = 0; v < index.size(); v++) {
+            if (result.hops[v] >= 0) stations[fill[result.hops[v]]++] = index.nameOf(v);
+        }
+        for (size_t h = 0; h < result.levels.size(); h++) {
+            std::sort(stations.begin() + offsets[h], stations.begin() + offsets[h + 1]);
+        }
+        std::vector<std::string> levels;
+        for (int count : result.levels) levels.push_back(std::to_string(count));
+        return render({intField("reached", result.reached()), listField("levels", levels),
+                       listField("stations", stations)}, format);
+    }
+
+    if (cmd == "search") {
+        if (f.size() != 2) return renderError("usage: search|<keyword>", format);
+        return render({listField("stations", search.searchByName(f[1]))}, format);
+    }
+
+    if (cmd == "nearest") {
+        double lat, lon;
+        if (f.size() != 3 || !parseDouble(f[1], lat) || !parseDouble(f[2], lon)) {
+            return renderError("usage: nearest|<lat>|<lon>", format);
+        }
+        std::string station = search.getNearestStation(lat, lon);
+        if (station.empty()) return renderError("no stations", format);
+        return render({stringField("station", station)}, format);
+    }
+
+    if (cmd == "fare" && f.size() == 3 && f[1].find(';') != std::string::npos) {
+        // Many trips in one request: parallel lists, fares in the batch form
+        std::vector<double> distances;
+        std::vector<int> zones;
+        std::stringstream kms(f[1]), maxZones(f[2]);
+        std::string value;
+        double distance;
+        int zone;
+        while (std::getline(kms, value, ';')) {
+            if (!parseDouble(value, distance)) return renderError("bad distance: " + value, format);
+            distances.push_back(distance);
+        }
+        while (std::getline(maxZones, value, ';')) {
+            if (!parseInt(value, zone)) return renderError("bad zone: " + value, format);
+            zones.push_back(zone);
+        }
+        if (zones.size() != distances.size()) {
+            return renderError("usage: fare|<km;...>|<maxZone;...> (same number of each)", format);
+        }
+        std::vector<int> fares(distances.size());
+        graph.getFareCalculator().calculateFares(distances.data(), zones.data(), fares.data(), fares.size());
+        std::vector<std::string> values;
+        values.reserve(fares.size());
+        for (int fare : fares) values.push_back(std::to_string(fare));
+        return render({listField("fares", values)}, format);
+    }
+
+    if (cmd == "fare") {
+        double distance;
+        int zone;
+        if (f.size() != 3 || !parseDouble(f[1], distance) || !parseInt(f[2], zone)) {
+            return renderError("usage: fare|<km>|<maxZone>", format);
+        }
+        return render({intField("fare", graph.getFareCalculator().calculateFare(distance, zone))}, format);
+    }
+
+    return renderError("unknown command: " + cmd, format);
+}
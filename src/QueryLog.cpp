@@ -0,0 +1,234 @@
+#include "QueryLog.h"
+#include "ArtifactCache.h"
+#include "QueryScheduler.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <unordered_map>
+
+namespace {
+
+const char MAGIC[8] = {'M', 'R', 'F', 'Q', 'L', 'O', 'G', '1'};
+const uint32_t FORMAT_VERSION = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+const size_t HEADER_SIZE = sizeof(MAGIC) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+bool getVarint(const unsigned char*& pos, const unsigned char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos == end) return false;
+        unsigned char byte = *pos++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+QueryLog::QueryLog(const std::string& p) : QueryLog(p, Options()) {}
+
+QueryLog::QueryLog(const std::string& p, const Options& opts)
+    : path(p), options(opts), start(Clock::now()) {
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Warning: cannot create query log " << path << "\n";
+        return;
+    }
+    ArtifactWriter header;
+    header.str().append(MAGIC, sizeof(MAGIC));
+    header.put(FORMAT_VERSION);
+    header.put(BYTE_ORDER_MARK);
+    uint64_t startMicros = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    header.put(startMicros);
+    std::fwrite(header.str().data(), 1, header.str().size(), file);
+    writer = std::thread([this]() { writerLoop(); });
+}
+
+QueryLog::~QueryLog() {
+    if (file == nullptr) return;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+    std::fclose(file);
+}
+
+bool QueryLog::kindOf(const std::string& request, QueryKind& kind) {
+    size_t begin = (request.compare(0, 6, "batch|") == 0) ? 6 : 0;
+    if (begin < request.size() && request[begin] == '@') {
+        begin = request.find('|', begin);
+        if (begin == std::string::npos) return false;
+        begin++;
+    }
+    size_t end = request.find('|', begin);
+    if (end == std::string::npos) return false;
+    std::string cmd = request.substr(begin, end - begin);
+    if (cmd == "route" || cmd == "cheapest" || cmd == "distance") kind = QueryKind::Route;
+    else if (cmd == "search") kind = QueryKind::Search;
+    else if (cmd == "nearest") kind = QueryKind::Nearest;
+    else if (cmd == "fare") kind = QueryKind::Fare;
+    else return false;
+    return true;
+}
+
+const char* QueryLog::kindName(QueryKind kind) {
+    switch (kind) {
+        case QueryKind::Route: return "route";
+        case QueryKind::Search: return "search";
+        case QueryKind::Nearest: return "nearest";
+        case QueryKind::Fare: return "fare";
+    }
+    return "unknown";
+}
+
+void QueryLog::record(const std::string& request, ResponseFormat format) {
+    QueryKind kind;
+    if (file == nullptr || !kindOf(request, kind)) return;
+    size_t length = request.size();
+    if (length > 0 && request[length - 1] == '\r') length--;
+
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    if (pending.size() > options.maxPendingBytes) {
+        droppedCount++;
+        return;
+    }
+    // Taken under the lock so that deltas never go backwards
+    uint64_t now = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+    putVarint(pending, now - lastMicros);
+    lastMicros = now;
+    pending += static_cast<char>(kind);
+    pending += static_cast<char>(format);
+    putVarint(pending, length);
+    pending.append(request, 0, length);
+    recordedCount++;
+}
+
+uint64_t QueryLog::recorded() {
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    return recordedCount;
+}
+
+uint64_t QueryLog::dropped() {
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    return droppedCount;
+}
+
+void QueryLog::writerLoop() {
+    std::unique_lock<std::mutex> lock(pendingMutex);
+    while (true) {
+        wake.wait_for(lock, std::chrono::milliseconds(options.flushMillis), [&]() { return stopping; });
+        std::string batch;
+        batch.swap(pending);
+        bool last = stopping;
+        lock.unlock();
+        if (!batch.empty()) {
+            TraceSpan span("QueryLog::write", "log", std::to_string(batch.size()) + " bytes");
+            if (std::fwrite(batch.data(), 1, batch.size(), file) != batch.size() || std::fflush(file) != 0) {
+                std::cerr << "Warning: query log write to " << path << " failed\n";
+            }
+        }
+        lock.lock();
+        if (last && pending.empty()) return;
+    }
+}
+
+bool QueryLog::read(const std::string& path, std::vector<LoggedQuery>& queries) {
+    TraceSpan span("QueryLog::read", "load", path);
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: cannot open query log " << path << "\n";
+        return false;
+    }
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const unsigned char* pos = reinterpret_cast<const unsigned char*>(bytes.data());
+    const unsigned char* end = pos + bytes.size();
+    if (bytes.size() < HEADER_SIZE || bytes.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0) {
+        std::cerr << "Error: " << path << " is not a query log\n";
+        return false;
+    }
+    ArtifactReader fields(pos + sizeof(MAGIC), HEADER_SIZE - sizeof(MAGIC));
+    uint32_t format = 0, byteOrder = 0;
+    uint64_t startMicros = 0;
+    fields.get(format);
+    fields.get(byteOrder);
+    fields.get(startMicros);
+    if (!fields.ok() || format != FORMAT_VERSION || byteOrder != BYTE_ORDER_MARK) {
+        std::cerr << "Error: " << path << " is a query log of another version or byte order\n";
+        return false;
+    }
+
+    pos += HEADER_SIZE;
+    uint64_t micros = 0;
+    while (pos < end) {
+        uint64_t delta = 0, length = 0;
+        if (!getVarint(pos, end, delta) || end - pos < 2) break;
+        uint8_t kind = pos[0], responseFormat = pos[1];
+        pos += 2;
+        if (!getVarint(pos, end, length) || static_cast<uint64_t>(end - pos) < length) break;
+        if (kind < 1 || kind > 4 || responseFormat > 2) break;
+        micros += delta;
+        LoggedQuery query;
+        query.micros = micros;
+        query.kind = static_cast<QueryKind>(kind);
+        query.format = static_cast<ResponseFormat>(responseFormat);
+        query.request.assign(reinterpret_cast<const char*>(pos), length);
+        queries.push_back(std::move(query));
+        pos += length;
+    }
+    return true;
+}
+
+size_t QueryLog::warm(const std::vector<LoggedQuery>& queries, size_t limit,
+                      const QueryServer::Handler& handler, ThreadPool* pool) {
+    TraceSpan span("QueryLog::warm", "load", std::to_string(queries.size()) + " queries");
+    // Count each distinct (request, format); ties keep log order
+    struct Candidate {
+        size_t first;
+        size_t count;
+    };
+    std::unordered_map<std::string, Candidate> counts;
+    for (size_t i = 0; i < queries.size(); i++) {
+        if (queries[i].kind != QueryKind::Route) continue;
+        std::string key = queries[i].request;
+        key += '\n';
+        key += static_cast<char>('0' + static_cast<int>(queries[i].format));
+        auto inserted = counts.insert({key, {i, 0}});
+        inserted.first->second.count++;
+    }
+    std::vector<Candidate> chosen;
+    chosen.reserve(counts.size());
+    for (const auto& pair : counts) chosen.push_back(pair.second);
+    std::sort(chosen.begin(), chosen.end(), [](const Candidate& a, const Candidate& b) {
+        return a.count != b.count ? a.count > b.count : a.first < b.first;
+    });
+    if (chosen.size() > limit) chosen.resize(limit);
+
+    auto answer = [&](size_t i, unsigned) {
+        const LoggedQuery& query = queries[chosen[i].first];
+        std::string request;
+        QueryScheduler::classify(query.request, request);
+        handler(request, query.format);
+    };
+    if (pool) {
+        pool->parallelFor(chosen.size(), answer);
+    } else {
+        for (size_t i = 0; i < chosen.size(); i++) answer(i, 0);
+    }
+    return chosen.size();
+}
@@ -0,0 +1,286 @@
+#include "QueryScheduler.h"
+#include "Trace.h"
+#include <algorithm>
+#include <future>
+
+// One computation, shared by every coalesced request with the same key
+struct QueryScheduler::Computation {
+    std::string key;
+    std::string request;        // without the priority prefix
+    ResponseFormat format;
+    Priority priority;
+    CancelToken token;
+
+    std::mutex mutex;
+    std::vector<std::shared_ptr<Ticket>> waiters;
+    size_t live = 0;            // waiters that have not cancelled
+    bool finished = false;
+
+    Computation(CancelToken::Clock::time_point deadline) : token(deadline) {}
+};
+
+namespace {
+
+const char BATCH_PREFIX[] = "batch|";
+
+// Worker index of the calling thread within its scheduler, for local pushes
+thread_local const QueryScheduler* currentScheduler = nullptr;
+thread_local unsigned currentWorker = 0;
+
+} // namespace
+
+QueryScheduler::QueryScheduler(Handler handler) : QueryScheduler(std::move(handler), Options()) {}
+
+QueryScheduler::QueryScheduler(Handler h, const Options& opts) : handler(std::move(h)), options(opts) {
+    unsigned threads = options.threads;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    batchLimit = options.batchWorkers > 0 ? std::min(options.batchWorkers, threads)
+                                          : std::max(1u, threads - 1);
+    for (unsigned i = 0; i < threads; i++) queues.emplace_back(new WorkerQueue());
+    for (unsigned i = 0; i < threads; i++) workers.emplace_back(&QueryScheduler::workerLoop, this, i);
+}
+
+QueryScheduler::~QueryScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+QueryScheduler::Priority QueryScheduler::classify(const std::string& request, std::string& stripped) {
+    const size_t prefixLength = sizeof(BATCH_PREFIX) - 1;
+    if (request.compare(0, prefixLength, BATCH_PREFIX) == 0) {
+        stripped = request.substr(prefixLength);
+        return Priority::Batch;
+    }
+    stripped = request;
+    return Priority::Interactive;
+}
+
+std::shared_ptr<QueryScheduler::Ticket> QueryScheduler::submit(const std::string& request, ResponseFormat format,
+                                                               Callback done) {
+    std::shared_ptr<Ticket> ticket = std::make_shared<Ticket>();
+    ticket->scheduler = this;
+    ticket->done = std::move(done);
+
+    std::string stripped;
+    Priority priority = classify(request, stripped);
+    std::string key;
+    key.reserve(stripped.size() + 2);
+    key += (priority == Priority::Batch) ? 'b' : 'i';
+    key += static_cast<char>('0' + static_cast<int>(format));
+    key += stripped;
+
+    std::unique_lock<std::mutex> lock(inFlightMutex);
+    if (options.coalesce) {
+        auto it = inFlight.find(key);
+        if (it != inFlight.end()) {
+            std::shared_ptr<Computation> running = it->second;
+            std::lock_guard<std::mutex> joinLock(running->mutex);
+            // A computation everyone cancelled is already stopping; start afresh
+            if (!running->finished && running->live > 0) {
+                running->waiters.push_back(ticket);
+                running->live++;
+                ticket->computation = running;
+                coalesced++;
+                return ticket;
+            }
+        }
+    }
+
+    unsigned deadlineMs = (priority == Priority::Batch) ? options.batchDeadlineMs
+                                                        : options.interactiveDeadlineMs;
+    auto deadline = deadlineMs > 0 ? CancelToken::Clock::now() + std::chrono::milliseconds(deadlineMs)
+                                   : CancelToken::Clock::time_point::max();
+    std::shared_ptr<Computation> computation = std::make_shared<Computation>(deadline);
+    computation->key = std::move(key);
+    computation->request = std::move(stripped);
+    computation->format = format;
+    computation->priority = priority;
+    computation->waiters.push_back(ticket);
+    computation->live = 1;
+    ticket->computation = computation;
+    if (options.coalesce) inFlight[computation->key] = computation;
+    lock.unlock();
+
+    enqueue(computation);
+    return ticket;
+}
+
+void QueryScheduler::enqueue(const std::shared_ptr<Computation>& computation) {
+    // Work queued from a worker stays local; outside callers spread round-robin
+    unsigned index = (currentScheduler == this)
+        ? currentWorker
+        : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    bool batch = computation->priority == Priority::Batch;
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        outstanding++;
+    }
+    {
+        // Counters change with the deques, so they never run below the contents
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        (batch ? queues[index]->batch : queues[index]->interactive).push_back(computation);
+        (batch ? queuedBatch : queuedInteractive)++;
+    }
+    {
+        // Idle workers test the counters under idleMutex; taking it here
+        // means a worker about to sleep cannot miss this notification
+        std::lock_guard<std::mutex> lock(idleMutex);
+    }
+    workReady.notify_one();
+}
+
+// Own interactive work first, then interactive work stolen from the back of
+// other workers' deques, then batch work the same way while a batch slot is free
+std::shared_ptr<QueryScheduler::Computation> QueryScheduler::take(unsigned index) {
+    size_t count = queues.size();
+    auto pop = [&](bool batch) -> std::shared_ptr<Computation> {
+        for (size_t k = 0; k < count; k++) {
+            WorkerQueue& queue = *queues[(index + k) % count];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            auto& deque = batch ? queue.batch : queue.interactive;
+            if (deque.empty()) continue;
+            std::shared_ptr<Computation> computation;
+            if (k == 0) {
+                computation = std::move(deque.front());
+                deque.pop_front();
+            } else {
+                computation = std::move(deque.back());
+                deque.pop_back();
+                stolen++;
+            }
+            (batch ? queuedBatch : queuedInteractive)--;
+            return computation;
+        }
+        return nullptr;
+    };
+
+    if (queuedInteractive.load() > 0) {
+        std::shared_ptr<Computation> computation = pop(false);
+        if (computation) return computation;
+    }
+    if (queuedBatch.load() > 0) {
+        if (runningBatch.fetch_add(1) < batchLimit) {
+            std::shared_ptr<Computation> computation = pop(true);
+            if (computation) return computation;
+        }
+        runningBatch--;
+    }
+    return nullptr;
+}
+
+void QueryScheduler::workerLoop(unsigned index) {
+    currentScheduler = this;
+    currentWorker = index;
+    while (true) {
+        std::shared_ptr<Computation> computation = take(index);
+        if (computation) {
+            execute(computation);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idleMutex);
+        auto runnable = [this] {
+            return queuedInteractive.load() > 0 || (queuedBatch.load() > 0 && runningBatch.load() < batchLimit);
+        };
+        workReady.wait(lock, [&] { return runnable() || (stopping && outstanding == 0); });
+        if (!runnable() && stopping && outstanding == 0) return;
+    }
+}
+
+void QueryScheduler::execute(const std::shared_ptr<Computation>& computation) {
+    std::string answer;
+    CancelToken& token = computation->token;
+    if (token.stopped()) {
+        // Deadline passed in the queue, or every caller cancelled
+        if (token.expired()) expired++;
+        answer = QueryEngine::errorAnswer(token.expired() ? "deadline exceeded" : "cancelled",
+                                          computation->format);
+    } else {
+        {
+            TraceSpan span("scheduledQuery", "server", computation->request);
+            CancelToken::Scope scope(&token);
+            answer = handler(computation->request, computation->format);
+        }
+        // A stopped search reports "no route"; never pass that off as the answer
+        if (token.isCancelled()) {
+            bool late = token.expired();
+            if (late) expired++;
+            answer = QueryEngine::errorAnswer(late ? "deadline exceeded" : "cancelled", computation->format);
+        } else {
+            completed++;
+        }
+    }
+    finish(computation, answer);
+
+    bool batch = computation->priority == Priority::Batch;
+    bool drained;
+    {
+        // Under idleMutex, like enqueue(), so a worker about to sleep sees the free slot
+        std::lock_guard<std::mutex> lock(idleMutex);
+        if (batch) runningBatch--;
+        drained = (--outstanding == 0);
+    }
+    if (drained) allDone.notify_all();
+    // A freed batch slot may let a waiting worker run batch work; when
+    // drained, workers waiting for shutdown can exit
+    if (batch || drained) workReady.notify_all();
+}
+
+void QueryScheduler::finish(const std::shared_ptr<Computation>& computation, const std::string& answer) {
+    {
+        std::lock_guard<std::mutex> lock(inFlightMutex);
+        auto it = inFlight.find(computation->key);
+        if (it != inFlight.end() && it->second == computation) inFlight.erase(it);
+    }
+    std::vector<std::shared_ptr<Ticket>> waiters;
+    {
+        std::lock_guard<std::mutex> lock(computation->mutex);
+        computation->finished = true;
+        waiters.swap(computation->waiters);
+    }
+    for (const auto& ticket : waiters) {
+        if (!ticket->answered.exchange(true)) ticket->done(answer);
+    }
+}
+
+void QueryScheduler::cancel(Ticket& ticket) {
+    if (ticket.answered.exchange(true)) return;
+    cancelled++;
+    std::shared_ptr<Computation> computation = ticket.computation;
+    ResponseFormat format = ResponseFormat::Json;
+    if (computation) {
+        std::lock_guard<std::mutex> lock(computation->mutex);
+        format = computation->format;
+        if (computation->live > 0 && --computation->live == 0) computation->token.cancel();
+    }
+    ticket.done(QueryEngine::errorAnswer("cancelled", format));
+}
+
+void QueryScheduler::Ticket::cancel() {
+    scheduler->cancel(*this);
+}
+
+std::string QueryScheduler::answer(const std::string& request, ResponseFormat format) {
+    std::promise<std::string> promise;
+    std::future<std::string> result = promise.get_future();
+    submit(request, format, [&promise](std::string answer) { promise.set_value(std::move(answer)); });
+    return result.get();
+}
+
+void QueryScheduler::wait() {
+    std::unique_lock<std::mutex> lock(idleMutex);
+    allDone.wait(lock, [this] { return outstanding == 0; });
+}
+
+QueryScheduler::Stats QueryScheduler::stats() const {
+    Stats s;
+    s.completed = completed.load();
+    s.coalesced = coalesced.load();
+    s.expired = expired.load();
+    s.cancelled = cancelled.load();
+    s.stolen = stolen.load();
+    return s;
+}
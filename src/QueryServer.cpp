@@ -0,0 +1,423 @@
+#include "QueryServer.h"
+#include "ThreadPool.h"
+#include "QueryScheduler.h"
+#include "QueryLog.h"
+#include "Trace.h"
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+QueryServer::QueryServer(const QueryEngine& engine, ThreadPool& p)
+    : QueryServer([&engine](const std::string& request, ResponseFormat format) {
+          return engine.answer(request, format);
+      }, p) {}
+
+QueryServer::QueryServer(Handler h, ThreadPool& p)
+    : handler(std::move(h)), pool(&p), stopRequested(false), wakeFd(-1) {}
+
+QueryServer::QueryServer(QueryScheduler& s) : scheduler(&s), stopRequested(false), wakeFd(-1) {}
+
+size_t QueryServer::serveStream(std::istream& in, std::ostream& out) {
+    size_t answered = 0;
+    ResponseFormat format = ResponseFormat::Json;
+    std::vector<std::string> batch;
+    std::vector<ResponseFormat> formats;
+    std::vector<std::string> answers;
+    std::string line;
+
+    while (std::getline(in, line)) {
+        // Take the line we blocked on plus whatever the client already pipelined
+        batch.clear();
+        formats.clear();
+        while (true) {
+            QueryEngine::parseFormatCommand(line, format);
+            if (queryLog) queryLog->record(line, format);
+            batch.push_back(line);
+            formats.push_back(format);
+            if (batch.size() >= MAX_BATCH || in.rdbuf()->in_avail() <= 0) break;
+            if (!std::getline(in, line)) break;
+        }
+
+        answers.assign(batch.size(), std::string());
+        if (scheduler) {
+            std::mutex doneMutex;
+            std::condition_variable allAnswered;
+            size_t remaining = batch.size();
+            for (size_t i = 0; i < batch.size(); i++) {
+                scheduler->submit(batch[i], formats[i], [&, i](std::string answer) {
+                    std::lock_guard<std::mutex> lock(doneMutex);
+                    answers[i] = std::move(answer);
+                    if (--remaining == 0) allAnswered.notify_one();
+                });
+            }
+            std::unique_lock<std::mutex> lock(doneMutex);
+            allAnswered.wait(lock, [&] { return remaining == 0; });
+        } else if (batch.size() == 1) {
+            answers[0] = handler(batch[0], formats[0]);
+        } else {
+            pool->parallelFor(batch.size(), [&](size_t i, unsigned) {
+                answers[i] = handler(batch[i], formats[i]);
+            });
+        }
+
+        for (const auto& answer : answers) {
+            out << answer;
+        }
+        out.flush();
+        answered += batch.size();
+    }
+    return answered;
+}
+
+void QueryServer::stop() {
+    stopRequested = true;
+#ifdef __linux__
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+#endif
+}
+
+#ifdef __linux__
+
+namespace {
+
+struct Connection {
+    int fd = -1;
+    std::string inBuf;
+    std::string outBuf;
+    std::deque<std::string> pending;     // complete request lines not yet dispatched
+    size_t pendingBytes = 0;
+    ResponseFormat format = ResponseFormat::Json;
+    bool busy = false;                   // a batch is running on the pool
+    bool peerClosed = false;
+    std::vector<std::shared_ptr<QueryScheduler::Ticket>> tickets;  // scheduled requests of the running batch
+};
+
+// Answers of one scheduled batch, filled in by scheduler callbacks
+struct ScheduledBatch {
+    uint64_t id;
+    std::mutex mutex;
+    std::vector<std::string> answers;
+    size_t remaining;
+};
+
+struct Completion {
+    uint64_t id;
+    std::string output;
+};
+
+// Decimal port 1-65535, digits only; anything else is not a port
+bool parsePort(const std::string& text, uint16_t& port) {
+    if (text.empty() || text.size() > 5) return false;
+    unsigned value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + static_cast<unsigned>(c - '0');
+    }
+    if (value < 1 || value > 65535) return false;
+    port = static_cast<uint16_t>(value);
+    return true;
+}
+
+int openListener(const std::string& address) {
+    if (address.compare(0, 4, "tcp:") == 0) {
+        uint16_t port = 0;
+        if (!parsePort(address.substr(4), port)) {
+            errno = EINVAL;
+            return -1;
+        }
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 128) < 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    if (address.compare(0, 5, "unix:") == 0) {
+        std::string path = address.substr(5);
+        sockaddr_un addr{};
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) return -1;
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(path.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 128) < 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    return -1;
+}
+
+} // namespace
+
+bool QueryServer::serveSocket(const std::string& address) {
+    int listenFd = openListener(address);
+    if (listenFd < 0) {
+        std::cerr << "Error: cannot listen on " << address << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    // epoll data carries a connection id; 0 and 1 are the listener and wake fd
+    const uint64_t LISTEN_ID = 0, WAKE_ID = 1;
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = LISTEN_ID;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.u64 = WAKE_ID;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections;
+    uint64_t nextId = 2;
+    std::mutex completionMtx;
+    std::vector<Completion> completions;
+
+    auto updateInterest = [&](uint64_t id, Connection& c) {
+        epoll_event mod{};
+        // Stop polling for input once the peer has half-closed, or a closed
+        // socket would report readable on every wait
+        mod.events = (c.peerClosed ? 0u : uint32_t(EPOLLIN)) | (c.outBuf.empty() ? 0u : uint32_t(EPOLLOUT));
+        mod.data.u64 = id;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &mod);
+    };
+
+    auto closeConnection = [&](uint64_t id) {
+        auto it = connections.find(id);
+        if (it == connections.end()) return;
+        for (auto& ticket : it->second->tickets) ticket->cancel();
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second->fd, nullptr);
+        close(it->second->fd);
+        connections.erase(it);
+    };
+
+    auto flush = [&](uint64_t id, Connection& c) {
+        while (!c.outBuf.empty()) {
+            ssize_t n = send(c.fd, c.outBuf.data(), c.outBuf.size(), MSG_NOSIGNAL);
+            if (n > 0) {
+                c.outBuf.erase(0, static_cast<size_t>(n));
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                return false;
+            }
+        }
+        updateInterest(id, c);
+        return true;
+    };
+
+    // Hand this connection's pending lines to a pool worker as one batch.
+    // Only one batch per connection is in flight, which keeps answers ordered;
+    // none while the client is behind on reading answers.
+    auto dispatch = [&](uint64_t id, Connection& c) {
+        if (c.busy || c.pending.empty() || c.outBuf.size() > MAX_OUTPUT_BYTES) return;
+        std::vector<std::string> batch;
+        std::vector<ResponseFormat> formats;
+        while (!c.pending.empty() && batch.size() < MAX_BATCH) {
+            QueryEngine::parseFormatCommand(c.pending.front(), c.format);
+            if (queryLog) queryLog->record(c.pending.front(), c.format);
+            batch.push_back(std::move(c.pending.front()));
+            formats.push_back(c.format);
+            c.pendingBytes -= batch.back().size();
+            c.pending.pop_front();
+        }
+        c.busy = true;
+        // Hand a finished batch's output to the event loop
+        auto complete = [this, &completionMtx, &completions](uint64_t connection, std::string output) {
+            {
+                std::lock_guard<std::mutex> lock(completionMtx);
+                completions.push_back({connection, std::move(output)});
+            }
+            uint64_t one = 1;
+            ssize_t ignored = write(wakeFd, &one, sizeof(one));
+            (void)ignored;
+        };
+        if (scheduler) {
+            std::shared_ptr<ScheduledBatch> state = std::make_shared<ScheduledBatch>();
+            state->id = id;
+            state->answers.resize(batch.size());
+            state->remaining = batch.size();
+            for (size_t i = 0; i < batch.size(); i++) {
+                c.tickets.push_back(scheduler->submit(batch[i], formats[i], [state, i, complete](std::string answer) {
+                    std::string output;
+                    {
+                        std::lock_guard<std::mutex> lock(state->mutex);
+                        state->answers[i] = std::move(answer);
+                        if (--state->remaining > 0) return;
+                        for (const auto& part : state->answers) output += part;
+                    }
+                    complete(state->id, std::move(output));
+                }));
+            }
+            return;
+        }
+        pool->submit([this, id, batch = std::move(batch), formats = std::move(formats), complete] {
+            TraceSpan span("answerBatch", "server", std::to_string(batch.size()) + " requests");
+            std::string output;
+            for (size_t i = 0; i < batch.size(); i++) {
+                output += handler(batch[i], formats[i]);
+            }
+            complete(id, std::move(output));
+        });
+    };
+
+    std::vector<epoll_event> events(64);
+    while (!stopRequested) {
+        int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            uint64_t id = events[i].data.u64;
+
+            if (id == LISTEN_ID) {
+                while (true) {
+                    int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (fd < 0) break;
+                    std::unique_ptr<Connection> c(new Connection());
+                    c->fd = fd;
+                    epoll_event add{};
+                    add.events = EPOLLIN;
+                    add.data.u64 = nextId;
+                    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &add);
+                    connections[nextId++] = std::move(c);
+                }
+                continue;
+            }
+
+            if (id == WAKE_ID) {
+                uint64_t count;
+                while (read(wakeFd, &count, sizeof(count)) > 0) {}
+                std::vector<Completion> done;
+                {
+                    std::lock_guard<std::mutex> lock(completionMtx);
+                    done.swap(completions);
+                }
+                for (auto& completion : done) {
+                    auto it = connections.find(completion.id);
+                    if (it == connections.end()) continue;
+                    Connection& c = *it->second;
+                    c.busy = false;
+                    c.tickets.clear();
+                    c.outBuf += completion.output;
+                    if (!flush(completion.id, c)) {
+                        closeConnection(completion.id);
+                        continue;
+                    }
+                    dispatch(completion.id, c);
+                    if (c.peerClosed && !c.busy && c.outBuf.empty()) {
+                        closeConnection(completion.id);
+                    }
+                }
+                continue;
+            }
+
+            auto it = connections.find(id);
+            if (it == connections.end()) continue;
+            Connection& c = *it->second;
+
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                char buf[16384];
+                while (true) {
+                    ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+                    if (n > 0) {
+                        c.inBuf.append(buf, static_cast<size_t>(n));
+                    } else if (n == 0) {
+                        c.peerClosed = true;
+                        break;
+                    } else {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK) c.peerClosed = true;
+                        break;
+                    }
+                }
+                size_t start = 0, nl;
+                while ((nl = c.inBuf.find('\n', start)) != std::string::npos) {
+                    c.pending.push_back(c.inBuf.substr(start, nl - start));
+                    c.pendingBytes += nl - start;
+                    start = nl + 1;
+                }
+                c.inBuf.erase(0, start);
+                if (c.inBuf.size() > MAX_LINE_BYTES || c.pendingBytes > MAX_PENDING_BYTES) {
+                    closeConnection(id);
+                    continue;
+                }
+                dispatch(id, c);
+                if (c.peerClosed) updateInterest(id, c);
+            }
+
+            if (events[i].events & EPOLLOUT) {
+                if (!flush(id, c)) {
+                    closeConnection(id);
+                    continue;
+                }
+                dispatch(id, c);
+            }
+
+            if (c.peerClosed && !c.busy && c.pending.empty() && c.outBuf.empty()) {
+                closeConnection(id);
+            }
+        }
+    }
+
+    // Let in-flight batches finish before their captures go out of scope
+    if (scheduler) {
+        scheduler->wait();
+    } else {
+        pool->wait();
+    }
+    while (!connections.empty()) {
+        closeConnection(connections.begin()->first);
+    }
+    close(listenFd);
+    close(epollFd);
+    close(wakeFd);
+    wakeFd = -1;
+    if (address.compare(0, 5, "unix:") == 0) {
+        unlink(address.substr(5).c_str());
+    }
+    return true;
+}
+
+#else
+
+bool QueryServer::serveSocket(const std::string& address) {
+    std::cerr << "Error: socket server mode (" << address << ") requires Linux (epoll)" << std::endl;
+    return false;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include "RouteCache.h"
+#include "Metrics.h"
+#include <functional>
+
+RouteCache::RouteCache(size_t capacity)
+    : perShard(capacity / SHARDS > 0 ? capacity / SHARDS : 1), shards(new Shard[SHARDS]) {}
+
+RouteCache::Shard& RouteCache::shardOf(const std::string& key) const {
+    return shards[std::hash<std::string>()(key) % SHARDS];
+}
+
+std::string RouteCache::key(const std::string& request, ResponseFormat format) {
+    std::string out = request;
+    if (!out.empty() && out.back() == '\r') out.pop_back();
+    out += '\n';
+    out += static_cast<char>('0' + static_cast<int>(format));
+    return out;
+}
+
+bool RouteCache::lookup(const std::string& key, uint64_t version, std::string& answer) {
+    Shard& shard = shardOf(key);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end() && it->second->version == version) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            answer = it->second->answer;
+            hitCount.fetch_add(1, std::memory_order_relaxed);
+            Metrics::add(Counter::RouteCacheHits);
+            return true;
+        }
+    }
+    missCount.fetch_add(1, std::memory_order_relaxed);
+    Metrics::add(Counter::RouteCacheMisses);
+    return false;
+}
+
+void RouteCache::insert(const std::string& key, uint64_t version, const std::string& answer) {
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        // Never let an answer from an older version replace a newer one
+        if (it->second->version > version) return;
+        it->second->version = version;
+        it->second->answer = answer;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+    shard.lru.push_front({key, version, answer});
+    shard.index[key] = shard.lru.begin();
+    if (shard.lru.size() > perShard) {
+        shard.index.erase(shard.lru.back().key);
+        shard.lru.pop_back();
+    }
+}
+
+size_t RouteCache::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < SHARDS; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        total += shards[i].lru.size();
+    }
+    return total;
+}
@@ -0,0 +1,289 @@
+#include "RouteKernel.h"
+#include "Metrics.h"
+#include "CancelToken.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace {
+
+// value * 65536, rounded, for the Q16 per-meter rates
+uint64_t q16(double value) {
+    return static_cast<uint64_t>(std::llround(value * 65536.0));
+}
+
+// Seconds per meter at the given speed
+double secondsPerMeter(double kmh) {
+    return 3.6 / kmh;
+}
+
+} // namespace
+
+double CostModel::edgeMinutes(EdgeType type, double km) const {
+    switch (type) {
+        case EdgeType::Ride: return (km * 1000.0 * secondsPerMeter(rideKmh) + dwellSeconds) / 60.0;
+        case EdgeType::Transfer: return km * 1000.0 * secondsPerMeter(rideKmh) / 60.0;
+        case EdgeType::Walk: break;
+    }
+    return km * 1000.0 * secondsPerMeter(walkKmh) / 60.0;
+}
+
+TimeCost::TimeCost(const CostModel& model)
+    : rideRate(static_cast<uint32_t>(q16(secondsPerMeter(model.rideKmh) * 1000.0))),
+      walkRate(static_cast<uint32_t>(q16(secondsPerMeter(model.walkKmh) * 1000.0))),
+      dwell(static_cast<uint32_t>(std::llround(model.dwellSeconds * 1000.0))),
+      changeMs(static_cast<uint32_t>(std::llround(model.transferSeconds * 1000.0))) {}
+
+WeightedCost::WeightedCost(const CostModel& model) {
+    // Cost units per meter and per edge, then scaled to thousandths
+    double perSecond = model.perMinute / 60.0;
+    double ridePerMeter = model.perKm / 1000.0 + perSecond * secondsPerMeter(model.rideKmh);
+    double walkPerMeter = model.perKm / 1000.0 + perSecond * secondsPerMeter(model.walkKmh);
+    rideRate = q16(ridePerMeter * 1000.0);
+    walkRate = q16(walkPerMeter * 1000.0);
+    dwell = static_cast<uint64_t>(std::llround(perSecond * model.dwellSeconds * 1000.0));
+    changeCost = static_cast<uint64_t>(std::llround(
+        (perSecond * model.transferSeconds + model.perTransfer) * 1000.0));
+    delay = static_cast<uint64_t>(std::llround(perSecond * 1000.0));
+}
+
+template <typename Key>
+void KernelWorkspace<Key>::prepare(int n) {
+    if (static_cast<int>(dist.size()) != n) {
+        dist.assign(n, UNREACHED);
+        parent.assign(n, -1);
+        via.assign(n, -1);
+        settled.assign(n, 0);
+    } else {
+        for (int v : touched) {
+            dist[v] = UNREACHED;
+            parent[v] = -1;
+            via[v] = -1;
+            settled[v] = 0;
+        }
+    }
+    touched.clear();
+    heap.clear();
+    found = -1;
+}
+
+namespace {
+
+// Line-aware search over arrival states (CompactGraph::arrivalState). A
+// state's mode is the line it arrived on, CHANGING after a transfer or walk
+// edge, or START at the source; the mode decides whether the next edge is a
+// change. The source is one extra state after the graph's.
+template <typename Cost>
+bool runStates(const CompactGraph& graph, int source, int target, const Cost& cost,
+               KernelWorkspace<typename Cost::Key>& ws) {
+    using Key = typename Cost::Key;
+    using Entry = HeapEntry<Key>;
+    using Heap = typename Entry::Type;
+    const std::greater<Heap> later;
+    const int CHANGING = -1, START = -2;
+
+    const int sourceState = graph.stateCount();
+    ws.prepare(sourceState + 1);
+    if (source < 0 || target < 0 || !cost.allowed(source) || !cost.allowed(target)) return false;
+
+    ws.dist[sourceState] = 0;
+    ws.via[sourceState] = source;
+    ws.touched.push_back(sourceState);
+    ws.heap.push_back(Entry::make(0, sourceState));
+
+    uint64_t pushes = 1, pops = 0, settled = 0, relaxed = 0;
+    const Key change = cost.change();
+
+    auto relax = [&](int state, Key du, int e, int v, Key step) {
+        relaxed++;
+        int next = graph.arrivalState(e);
+        if (ws.settled[next] || !cost.allowed(v) || !cost.live(e, step)) return;
+        Key nd = du + step;
+        if (nd < ws.dist[next]) {
+            if (ws.dist[next] == KernelWorkspace<Key>::UNREACHED) ws.touched.push_back(next);
+            ws.dist[next] = nd;
+            ws.parent[next] = state;
+            ws.via[next] = e;
+            ws.heap.push_back(Entry::make(nd, next));
+            std::push_heap(ws.heap.begin(), ws.heap.end(), later);
+            pushes++;
+        }
+    };
+
+    CompactGraph::EdgeCursor& edges = ws.edges;
+    unsigned ticks = 0;
+    while (!ws.heap.empty()) {
+        if (CancelToken::poll(ticks)) break;     // found stays -1
+        std::pop_heap(ws.heap.begin(), ws.heap.end(), later);
+        Heap top = ws.heap.back();
+        ws.heap.pop_back();
+        pops++;
+        int state = Entry::node(top);
+        Key du = Entry::key(top);
+        if (ws.settled[state] || du > ws.dist[state]) continue;   // stale entry
+        ws.settled[state] = 1;
+        settled++;
+        int u = (state == sourceState) ? source : graph.stationOfState(state);
+        if (u == target) {
+            ws.found = state;
+            break;
+        }
+
+        int mode = (state == sourceState) ? START : graph.lineOfState(state);
+        Key leave = (mode == CHANGING) ? 0 : change;     // starting a run of transfers / walks
+        edges.load(graph, u);
+        int e = edges.begin;
+        for (; e < edges.rideEnd; e++) {
+            Key step = cost.ride(edges.meters(e));
+            if (mode >= 0 && graph.edgeLine(e) != mode) step += change;
+            relax(state, du, e, edges.target(e), step);
+        }
+        for (; e < edges.transferEnd; e++) relax(state, du, e, edges.target(e), cost.transfer(edges.meters(e)) + leave);
+        for (; e < edges.end; e++) relax(state, du, e, edges.target(e), cost.walk(edges.meters(e)) + leave);
+    }
+
+    if (Metrics::enabled()) {
+        Metrics::add(Counter::NodesSettled, settled);
+        Metrics::add(Counter::EdgesRelaxed, relaxed);
+        Metrics::add(Counter::HeapPushes, pushes);
+        Metrics::add(Counter::HeapPops, pops);
+    }
+    return ws.found >= 0;
+}
+
+} // namespace
+
+template <typename Cost>
+bool RouteKernel::run(const CompactGraph& graph, int source, int target, const Cost& cost,
+                      KernelWorkspace<typename Cost::Key>& ws) {
+    if constexpr (Cost::LINE_CHANGES) {
+        return runStates(graph, source, target, cost, ws);
+    }
+    using Key = typename Cost::Key;
+    using Entry = HeapEntry<Key>;
+    using Heap = typename Entry::Type;
+    const std::greater<Heap> later;
+
+    ws.prepare(graph.size());
+    if (source < 0 || target < 0 || !cost.allowed(source) || !cost.allowed(target)) return false;
+
+    ws.dist[source] = 0;
+    ws.touched.push_back(source);
+    ws.heap.push_back(Entry::make(0, source));
+
+    // Work counters are kept local and published once per query
+    uint64_t pushes = 1, pops = 0, settled = 0, relaxed = 0;
+    bool found = false;
+
+    auto relax = [&](int u, Key du, int e, int v, Key step) {
+        relaxed++;
+        if (ws.settled[v] || !cost.allowed(v) || !cost.live(e, step)) return;
+        Key nd = du + step;
+        if (nd < ws.dist[v]) {
+            if (ws.dist[v] == KernelWorkspace<Key>::UNREACHED) ws.touched.push_back(v);
+            ws.dist[v] = nd;
+            ws.parent[v] = u;
+            ws.via[v] = e;
+            ws.heap.push_back(Entry::make(nd, v));
+            std::push_heap(ws.heap.begin(), ws.heap.end(), later);
+            pushes++;
+        }
+    };
+
+    CompactGraph::EdgeCursor& edges = ws.edges;
+    unsigned ticks = 0;
+    while (!ws.heap.empty()) {
+        if (CancelToken::poll(ticks)) break;     // found stays false
+        std::pop_heap(ws.heap.begin(), ws.heap.end(), later);
+        Heap top = ws.heap.back();
+        ws.heap.pop_back();
+        pops++;
+        int u = Entry::node(top);
+        Key du = Entry::key(top);
+        if (ws.settled[u] || du > ws.dist[u]) continue;   // stale entry
+        ws.settled[u] = 1;
+        settled++;
+        if (u == target) {
+            found = true;
+            break;
+        }
+
+        // One loop per edge type, so the cost function never switches on type
+        edges.load(graph, u);
+        int e = edges.begin;
+        for (; e < edges.rideEnd; e++) relax(u, du, e, edges.target(e), cost.ride(edges.meters(e)));
+        for (; e < edges.transferEnd; e++) relax(u, du, e, edges.target(e), cost.transfer(edges.meters(e)));
+        for (; e < edges.end; e++) relax(u, du, e, edges.target(e), cost.walk(edges.meters(e)));
+    }
+
+    if (Metrics::enabled()) {
+        Metrics::add(Counter::NodesSettled, settled);
+        Metrics::add(Counter::EdgesRelaxed, relaxed);
+        Metrics::add(Counter::HeapPushes, pushes);
+        Metrics::add(Counter::HeapPops, pops);
+    }
+    return found;
+}
+
+template <typename Key>
+void RouteKernel::route(const CompactGraph& graph, const KernelWorkspace<Key>& ws, int target,
+                        std::vector<int>& stations, std::vector<int>& edges) {
+    stations.clear();
+    edges.clear();
+    if (ws.found >= 0) {
+        // Back along the states to the source state, which has no parent
+        int state = ws.found;
+        for (; ws.parent[state] >= 0; state = ws.parent[state]) {
+            stations.push_back(graph.stationOfState(state));
+            edges.push_back(ws.via[state]);
+        }
+        stations.push_back(ws.via[state]);
+    } else {
+        for (int v = target; v >= 0; v = ws.parent[v]) {
+            stations.push_back(v);
+            if (ws.parent[v] >= 0) edges.push_back(ws.via[v]);
+        }
+    }
+    std::reverse(stations.begin(), stations.end());
+    std::reverse(edges.begin(), edges.end());
+}
+
+bool RouteKernel::parseCriterion(const std::string& name, RouteCriterion& criterion) {
+    if (name == "distance") criterion = RouteCriterion::Distance;
+    else if (name == "time") criterion = RouteCriterion::Time;
+    else if (name == "fare") criterion = RouteCriterion::Fare;
+    else if (name == "transfers") criterion = RouteCriterion::Transfers;
+    else if (name == "weighted") criterion = RouteCriterion::Weighted;
+    else return false;
+    return true;
+}
+
+template struct KernelWorkspace<uint32_t>;
+template struct KernelWorkspace<uint64_t>;
+
+template bool RouteKernel::run<DistanceCost>(const CompactGraph&, int, int, const DistanceCost&,
+                                             KernelWorkspace<uint32_t>&);
+template bool RouteKernel::run<TimeCost>(const CompactGraph&, int, int, const TimeCost&,
+                                         KernelWorkspace<uint32_t>&);
+template bool RouteKernel::run<FareCost>(const CompactGraph&, int, int, const FareCost&,
+                                         KernelWorkspace<uint32_t>&);
+template bool RouteKernel::run<TransferCost>(const CompactGraph&, int, int, const TransferCost&,
+                                             KernelWorkspace<uint64_t>&);
+template bool RouteKernel::run<WeightedCost>(const CompactGraph&, int, int, const WeightedCost&,
+                                             KernelWorkspace<uint64_t>&);
+
+template bool RouteKernel::run<LiveCost<DistanceCost>>(const CompactGraph&, int, int,
+                                                       const LiveCost<DistanceCost>&, KernelWorkspace<uint32_t>&);
+template bool RouteKernel::run<LiveCost<TimeCost>>(const CompactGraph&, int, int, const LiveCost<TimeCost>&,
+                                                   KernelWorkspace<uint64_t>&);
+template bool RouteKernel::run<LiveCost<FareCost>>(const CompactGraph&, int, int, const LiveCost<FareCost>&,
+                                                   KernelWorkspace<uint32_t>&);
+template bool RouteKernel::run<LiveCost<TransferCost>>(const CompactGraph&, int, int,
+                                                       const LiveCost<TransferCost>&, KernelWorkspace<uint64_t>&);
+template bool RouteKernel::run<LiveCost<WeightedCost>>(const CompactGraph&, int, int,
+                                                       const LiveCost<WeightedCost>&, KernelWorkspace<uint64_t>&);
+
+template void RouteKernel::route(const CompactGraph&, const KernelWorkspace<uint32_t>&, int, std::vector<int>&,
+                                 std::vector<int>&);
+template void RouteKernel::route(const CompactGraph&, const KernelWorkspace<uint64_t>&, int, std::vector<int>&,
+                                 std::vector<int>&);
@@ -0,0 +1,46 @@
+#include "RouteResult.h"
+#include "CompactGraph.h"
+#include <algorithm>
+
+void RouteResult::clear() {
+    stations.clear();
+    edges.clear();
+    legs.clear();
+    transfers.clear();
+    totalDistance = -1;
+    estimatedFare = 0;
+    transferPoints = 0;
+    travelMinutes = 0;
+}
+
+void RouteResult::linesUsed(std::vector<int>& lines) const {
+    for (const auto& leg : legs) {
+        if (leg.line >= 0 && std::find(lines.begin(), lines.end(), leg.line) == lines.end()) {
+            lines.push_back(leg.line);
+        }
+    }
+}
+
+void RouteResult::toPathInfo(const Graph& graph, const CompactGraph& index, PathInfo& info) const {
+    info.path.clear();
+    info.metroLines.clear();
+    info.totalDistance = totalDistance;
+    info.estimatedFare = estimatedFare;
+    info.transferPoints = transferPoints;
+    info.travelMinutes = travelMinutes;
+    if (!found()) return;
+
+    for (int v : stations) {
+        info.path.push_back(index.nameOf(v));
+    }
+    std::vector<int> lines;
+    linesUsed(lines);
+    for (int line : lines) {
+        info.metroLines.push_back(index.lineName(line));
+    }
+    // A route without rides (e.g. source == destination) reports the start line
+    if (info.metroLines.empty() && !stations.empty()) {
+        const Station* start = graph.getStation(info.path[0]);
+        if (start != nullptr) info.metroLines.push_back(start->getMetroLine());
+    }
+}
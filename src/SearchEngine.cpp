@@ -1,111 +1,182 @@
 #include "SearchEngine.h"
-#include <cctype>
+#include "SimdKernels.h"
+#include "ThreadPool.h"
+#include "Metrics.h"
+#include "StringPool.h"
 #include <algorithm>
-#include <cmath>
 
-SearchEngine::SearchEngine(const std::unordered_map<std::string, Station>& db)
-    : stationDB(db) {}
-
-bool SearchEngine::caseInsensitiveCompare(const std::string& str1, 
-                                         const std::string& str2) {
-    if (str1.length() != str2.length()) return false;
-    
-    for (size_t i = 0; i < str1.length(); i++) {
-        if (std::tolower(str1[i]) != std::tolower(str2[i])) {
-            return false;
-        }
+namespace {
+
+// Zero bytes after the last name, so 32-byte loads never leave the buffer
+const size_t PADDING = 32;
+
+// Points per task when snapping in bulk
+const size_t SNAP_CHUNK = 4096;
+
+struct NameHits {
+    const std::vector<uint32_t>* starts;
+    std::vector<uint32_t> indices;
+};
+
+// Map a match offset in the name buffer to its station index (once per name)
+void collectNameHit(size_t offset, void* context) {
+    NameHits* hits = static_cast<NameHits*>(context);
+    const auto& starts = *hits->starts;
+    uint32_t index = static_cast<uint32_t>(
+        std::upper_bound(starts.begin(), starts.end(), static_cast<uint32_t>(offset)) - starts.begin() - 1);
+    if (hits->indices.empty() || hits->indices.back() != index) {
+        hits->indices.push_back(index);
     }
-    return true;
 }
 
-bool SearchEngine::containsSubstring(const std::string& str, 
-                                    const std::string& substr) {
-    std::string strLower = str;
-    std::string substrLower = substr;
-    
-    std::transform(strLower.begin(), strLower.end(), strLower.begin(),
-                  [](unsigned char c) { return std::tolower(c); });
-    std::transform(substrLower.begin(), substrLower.end(), substrLower.begin(),
-                  [](unsigned char c) { return std::tolower(c); });
-    
-    return strLower.find(substrLower) != std::string::npos;
+} // namespace
+
+SearchEngine::SearchEngine(const std::unordered_map<std::string, Station>& db)
+    : stationDB(db) {
+    refresh();
 }
 
-std::vector<std::string> SearchEngine::searchByName(const std::string& keyword) const {
-    std::vector<std::string> results;
-    
+std::string SearchEngine::lowered(const std::string& text) {
+    std::string out(text.size(), '\0');
+    SimdKernels::toLower(text.data(), text.size(), &out[0]);
+    return out;
+}
+
+void SearchEngine::refresh() {
+    names.clear();
     for (const auto& pair : stationDB) {
-        if (containsSubstring(pair.first, keyword)) {
-            results.push_back(pair.first);
+        names.push_back(pair.first);
+    }
+    std::sort(names.begin(), names.end());
+
+    size_t n = names.size();
+    lowerNames.clear();
+    nameStarts.resize(n);
+    latitudes.resize(n);
+    longitudes.resize(n);
+    zones.resize(n);
+    lineIds.resize(n);
+    lowerLines.clear();
+
+    std::unordered_map<std::string, int32_t> lineLookup;
+    for (size_t i = 0; i < n; i++) {
+        const Station& station = stationDB.at(names[i]);
+        nameStarts[i] = static_cast<uint32_t>(lowerNames.size());
+        std::string lower = lowered(names[i]);
+        lowerNames.insert(lowerNames.end(), lower.begin(), lower.end());
+        lowerNames.push_back('\0');
+
+        latitudes[i] = station.getLatitude();
+        longitudes[i] = station.getLongitude();
+        zones[i] = station.getZone();
+
+        std::string line = lowered(station.getMetroLine());
+        auto it = lineLookup.find(line);
+        if (it == lineLookup.end()) {
+            it = lineLookup.emplace(line, static_cast<int32_t>(lowerLines.size())).first;
+            lowerLines.push_back(line);
         }
+        lineIds[i] = it->second;
     }
-    
-    std::sort(results.begin(), results.end());
-    return results;
+    lowerNames.insert(lowerNames.end(), PADDING, '\0');
 }
 
-std::vector<std::string> SearchEngine::searchByLine(const std::string& lineName) const {
+std::vector<std::string> SearchEngine::namesAt(const uint32_t* indices, size_t count) const {
     std::vector<std::string> results;
-    
-    for (const auto& pair : stationDB) {
-        if (caseInsensitiveCompare(pair.second.getMetroLine(), lineName)) {
-            results.push_back(pair.first);
-        }
+    results.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        results.push_back(names[indices[i]]);
     }
-    
-    std::sort(results.begin(), results.end());
     return results;
 }
 
+// Names are stored in sorted order, so every result list below comes out sorted
+
+std::vector<std::string> SearchEngine::searchByName(const std::string& keyword) const {
+    ScopedTimer timer(Timer::SearchQuery);
+    Metrics::add(Counter::SearchQueries);
+    if (keyword.empty()) return names;
+
+    // One scan over all names; NUL separators keep matches inside one name
+    std::string needle = lowered(keyword);
+    NameHits hits{&nameStarts, {}};
+    SimdKernels::findAll(lowerNames.data(), lowerNames.size() - PADDING,
+                         needle.data(), needle.size(), collectNameHit, &hits);
+    return namesAt(hits.indices.data(), hits.indices.size());
+}
+
+std::vector<std::string> SearchEngine::searchByLine(const std::string& lineName) const {
+    ScopedTimer timer(Timer::SearchQuery);
+    Metrics::add(Counter::SearchQueries);
+    auto line = std::find(lowerLines.begin(), lowerLines.end(), lowered(lineName));
+    if (line == lowerLines.end()) return {};
+
+    std::vector<uint32_t> indices(names.size());
+    size_t count = SimdKernels::filterEqual(lineIds.data(), lineIds.size(),
+                                            static_cast<int32_t>(line - lowerLines.begin()),
+                                            indices.data());
+    return namesAt(indices.data(), count);
+}
+
 std::vector<std::string> SearchEngine::searchByZone(int zoneNumber) const {
-    std::vector<std::string> results;
-    
-    for (const auto& pair : stationDB) {
-        if (pair.second.getZone() == zoneNumber) {
-            results.push_back(pair.first);
-        }
-    }
-    
-    std::sort(results.begin(), results.end());
-    return results;
+    ScopedTimer timer(Timer::SearchQuery);
+    Metrics::add(Counter::SearchQueries);
+    std::vector<uint32_t> indices(names.size());
+    size_t count = SimdKernels::filterEqual(zones.data(), zones.size(), zoneNumber, indices.data());
+    return namesAt(indices.data(), count);
 }
 
 std::vector<std::string> SearchEngine::getAutocompleteSuggestions(
     const std::string& prefix) const {
+    ScopedTimer timer(Timer::SearchQuery);
+    Metrics::add(Counter::SearchQueries);
+    std::string prefixLower = lowered(prefix);
+    std::vector<unsigned char> matched(names.size());
+    SimdKernels::prefixMatch(lowerNames.data(), nameStarts.data(), names.size(),
+                             prefixLower.data(), prefixLower.size(), matched.data());
+
     std::vector<std::string> results;
-    std::string prefixLower = prefix;
-    std::transform(prefixLower.begin(), prefixLower.end(), prefixLower.begin(),
-                  [](unsigned char c) { return std::tolower(c); });
-    
-    for (const auto& pair : stationDB) {
-        std::string nameLower = pair.first;
-        std::transform(nameLower.begin(), nameLower.end(), nameLower.begin(),
-                      [](unsigned char c) { return std::tolower(c); });
-        
-        if (nameLower.find(prefixLower) == 0) {
-            results.push_back(pair.first);
-        }
+    for (size_t i = 0; i < names.size(); i++) {
+        if (matched[i]) results.push_back(names[i]);
     }
-    
-    std::sort(results.begin(), results.end());
     return results;
 }
 
 std::string SearchEngine::getNearestStation(double latitude, double longitude) const {
-    double minDistance = 1e9;
-    std::string nearest;
-    
-    for (const auto& pair : stationDB) {
-        double dist = std::sqrt(
-            std::pow(pair.second.getLatitude() - latitude, 2) +
-            std::pow(pair.second.getLongitude() - longitude, 2)
-        );
-        
-        if (dist < minDistance) {
-            minDistance = dist;
-            nearest = pair.first;
+    ScopedTimer timer(Timer::SearchQuery);
+    Metrics::add(Counter::SearchQueries);
+    long index = SimdKernels::nearest(latitudes.data(), longitudes.data(), names.size(),
+                                      latitude, longitude);
+    return (index < 0) ? std::string() : names[index];
+}
+
+void SearchEngine::snapToStations(const double* lats, const double* lons, size_t count,
+                                  int* stations) const {
+    ScopedTimer timer(Timer::SearchQuery);
+    Metrics::add(Counter::SearchQueries, count);
+    auto snapRange = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            stations[i] = static_cast<int>(SimdKernels::nearest(latitudes.data(), longitudes.data(),
+                                                                names.size(), lats[i], lons[i]));
         }
+    };
+    if (count <= SNAP_CHUNK) {
+        snapRange(0, count);
+        return;
     }
-    
-    return nearest;
+    size_t chunks = (count + SNAP_CHUNK - 1) / SNAP_CHUNK;
+    ThreadPool::shared().parallelFor(chunks, [&](size_t chunk, unsigned) {
+        snapRange(chunk * SNAP_CHUNK, std::min(count, (chunk + 1) * SNAP_CHUNK));
+    });
+}
+
+size_t SearchEngine::memoryBytes() const {
+    size_t bytes = names.capacity() * sizeof(std::string) + lowerNames.capacity() +
+                   nameStarts.capacity() * sizeof(uint32_t) +
+                   (latitudes.capacity() + longitudes.capacity()) * sizeof(double) +
+                   (zones.capacity() + lineIds.capacity()) * sizeof(int32_t) +
+                   lowerLines.capacity() * sizeof(std::string);
+    for (const auto& name : names) bytes += StringPool::heapBytes(name);
+    for (const auto& line : lowerLines) bytes += StringPool::heapBytes(line);
+    return bytes;
 }
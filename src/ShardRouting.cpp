@@ -0,0 +1,622 @@
+#include "ShardRouting.h"
+#include "DataLoader.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+const double INF = std::numeric_limits<double>::infinity();
+
+// Split stations[begin, end) into `parts` regions of proportional size by
+// recursive inertial bisection: cut along the principal axis of the points
+void bisect(std::vector<int>& stations, size_t begin, size_t end, int parts, int firstShard,
+            const std::vector<double>& x, const std::vector<double>& y,
+            std::vector<double>& key, std::vector<int>& shardOf) {
+    if (parts == 1) {
+        for (size_t i = begin; i < end; i++) shardOf[stations[i]] = firstShard;
+        return;
+    }
+    double n = static_cast<double>(end - begin);
+    double mx = 0, my = 0;
+    for (size_t i = begin; i < end; i++) {
+        mx += x[stations[i]];
+        my += y[stations[i]];
+    }
+    mx /= n;
+    my /= n;
+    double sxx = 0, syy = 0, sxy = 0;
+    for (size_t i = begin; i < end; i++) {
+        double dx = x[stations[i]] - mx, dy = y[stations[i]] - my;
+        sxx += dx * dx;
+        syy += dy * dy;
+        sxy += dx * dy;
+    }
+    double angle = 0.5 * std::atan2(2 * sxy, sxx - syy);
+    double ax = std::cos(angle), ay = std::sin(angle);
+    for (size_t i = begin; i < end; i++) {
+        key[stations[i]] = (x[stations[i]] - mx) * ax + (y[stations[i]] - my) * ay;
+    }
+
+    int left = parts / 2;
+    size_t mid = begin + (end - begin) * left / parts;
+    std::nth_element(stations.begin() + begin, stations.begin() + mid, stations.begin() + end,
+                     [&](int a, int b) { return key[a] < key[b] || (key[a] == key[b] && a < b); });
+    bisect(stations, begin, mid, left, firstShard, x, y, key, shardOf);
+    bisect(stations, mid, end, parts - left, firstShard + left, x, y, key, shardOf);
+}
+
+std::vector<std::string> splitOn(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream ss(text);
+    std::string part;
+    while (std::getline(ss, part, separator)) parts.push_back(part);
+    return parts;
+}
+
+std::string joinNames(const std::vector<std::string>& names) {
+    std::string out;
+    for (size_t i = 0; i < names.size(); i++) {
+        if (i > 0) out += ';';
+        out += names[i];
+    }
+    return out;
+}
+
+#ifdef __linux__
+
+int connectUnix(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Append whatever the socket has (blocking); false on EOF or error
+bool receive(int fd, std::string& buffer) {
+    char buf[16384];
+    while (true) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buffer.append(buf, static_cast<size_t>(n));
+        return true;
+    }
+}
+
+void closeSocket(int fd) {
+    close(fd);
+}
+
+#else
+
+int connectUnix(const std::string&) { return -1; }
+bool sendAll(int, const std::string&) { return false; }
+bool receive(int, std::string&) { return false; }
+void closeSocket(int) {}
+
+#endif
+
+// Take one answer in format off the front of pending, reading more as needed.
+// Json/Text answers keep their newline; Binary answers keep their frame.
+bool readAnswer(int fd, std::string& pending, ResponseFormat format, std::string& answer) {
+    while (true) {
+        if (format == ResponseFormat::Binary) {
+            if (pending.size() >= 4) {
+                uint32_t length = 0;
+                for (int i = 0; i < 4; i++) {
+                    length |= static_cast<uint32_t>(static_cast<unsigned char>(pending[i])) << (8 * i);
+                }
+                if (pending.size() >= 4 + static_cast<size_t>(length)) {
+                    answer = pending.substr(0, 4 + length);
+                    pending.erase(0, 4 + length);
+                    return true;
+                }
+            }
+        } else {
+            size_t nl = pending.find('\n');
+            if (nl != std::string::npos) {
+                answer = pending.substr(0, nl + 1);
+                pending.erase(0, nl + 1);
+                return true;
+            }
+        }
+        if (!receive(fd, pending)) return false;
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------- layout
+
+bool ShardLayout::load(const std::string& dir, ShardLayout& layout) {
+    layout = ShardLayout();
+    std::ifstream shardsIn(dir + "/shards.txt");
+    std::ifstream cutIn(dir + "/cut.txt");
+    if (!shardsIn.is_open() || !cutIn.is_open()) {
+        std::cerr << "Error: " << dir << " has no shards.txt / cut.txt (see ShardRouting.h)\n";
+        return false;
+    }
+    std::string line;
+    try {
+        while (std::getline(shardsIn, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            size_t comma = line.rfind(',');
+            if (comma == std::string::npos) throw std::invalid_argument(line);
+            int shard = std::stoi(line.substr(comma + 1));
+            if (shard < 0) throw std::invalid_argument(line);
+            layout.shardOf[line.substr(0, comma)] = shard;
+            layout.shards = std::max(layout.shards, shard + 1);
+        }
+        while (std::getline(cutIn, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::vector<std::string> parts = splitOn(line, ',');
+            if (parts.size() != 4 || !layout.shardOf.count(parts[0]) || !layout.shardOf.count(parts[1]) ||
+                parts[3].empty()) {
+                throw std::invalid_argument(line);
+            }
+            EdgeType type = parts[3] == "TRANSFER" ? EdgeType::Transfer
+                          : parts[3] == "WALK"     ? EdgeType::Walk : EdgeType::Ride;
+            layout.cut.push_back({parts[0], parts[1], std::stod(parts[2]), type,
+                                  type == EdgeType::Ride ? parts[3] : std::string()});
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Error: malformed shard layout line in " << dir << ": " << line << "\n";
+        return false;
+    }
+    return layout.shards > 0;
+}
+
+bool splitNetwork(const Graph& graph, int shards, const std::string& outDir) {
+    TraceSpan span("splitNetwork", "save", std::to_string(shards) + " shards");
+    std::vector<std::string> names;
+    for (const auto& pair : graph.getStations()) names.push_back(pair.first);
+    std::sort(names.begin(), names.end());
+    if (names.empty() || shards < 1) return false;
+    shards = std::min(shards, static_cast<int>(names.size()));
+
+    // Plane coordinates in degrees, longitude shrunk to the mean latitude
+    double meanLat = 0;
+    for (const auto& name : names) meanLat += graph.getStations().at(name).getLatitude();
+    meanLat /= static_cast<double>(names.size());
+    double shrink = std::cos(meanLat * PI / 180.0);
+    std::vector<double> x(names.size()), y(names.size()), key(names.size());
+    std::vector<int> order(names.size()), shardOf(names.size());
+    std::unordered_map<std::string, int> idOf;
+    for (size_t i = 0; i < names.size(); i++) {
+        const Station& s = graph.getStations().at(names[i]);
+        x[i] = s.getLongitude() * shrink;
+        y[i] = s.getLatitude();
+        order[i] = static_cast<int>(i);
+        idOf[names[i]] = static_cast<int>(i);
+    }
+    bisect(order, 0, order.size(), shards, 0, x, y, key, shardOf);
+
+    std::vector<Graph> parts(shards);
+    for (size_t i = 0; i < names.size(); i++) {
+        const Station& s = graph.getStations().at(names[i]);
+        parts[shardOf[i]].addStation(names[i], s.getMetroLine(), s.getZone(), s.getLatitude(), s.getLongitude());
+    }
+    std::vector<ShardLayout::Link> cut;
+    for (size_t i = 0; i < names.size(); i++) {
+        for (const auto& edge : graph.getAdjacency().at(names[i])) {
+            if (shardOf[idOf.at(edge.to)] == shardOf[i]) {
+                parts[shardOf[i]].addDirectedEdge(names[i], edge.to, edge.weight, edge.type, edge.lineName());
+            } else {
+                cut.push_back({names[i], edge.to, edge.weight, edge.type,
+                               edge.type == EdgeType::Ride ? edge.lineName() : std::string()});
+            }
+        }
+    }
+
+    std::error_code error;
+    for (int i = 0; i < shards; i++) {
+        std::string dir = outDir + "/shard-" + std::to_string(i);
+        std::filesystem::create_directories(dir, error);
+        if (!saveNetwork(parts[i], dir)) {
+            std::cerr << "Error: cannot write " << dir << "\n";
+            return false;
+        }
+    }
+
+    std::ofstream shardsOut(outDir + "/shards.txt");
+    std::ofstream cutOut(outDir + "/cut.txt");
+    if (!shardsOut.is_open() || !cutOut.is_open()) {
+        std::cerr << "Error: cannot write the shard layout in " << outDir << "\n";
+        return false;
+    }
+    shardsOut << "# Shard of each station\n# Format: StationName,Shard\n";
+    for (size_t i = 0; i < names.size(); i++) {
+        shardsOut << names[i] << "," << shardOf[i] << "\n";
+    }
+    cutOut << "# One-way links between shards\n# Format: Station1,Station2,Distance(km),Type\n";
+    cutOut << std::setprecision(15);
+    for (const auto& link : cut) {
+        cutOut << link.from << "," << link.to << "," << link.km << ","
+               << (link.type == EdgeType::Transfer ? "TRANSFER" : link.type == EdgeType::Walk ? "WALK" : link.line)
+               << "\n";
+    }
+    return static_cast<bool>(shardsOut) && static_cast<bool>(cutOut);
+}
+
+std::string shardSocketPath(const std::string& dir, int shard) {
+    return dir + "/shard-" + std::to_string(shard) + ".sock";
+}
+
+// ---------------------------------------------------------------- client
+
+ShardClient::ShardClient(std::string socketPath) : path(std::move(socketPath)) {}
+
+ShardClient::~ShardClient() {
+    for (const auto& connection : idle) closeSocket(connection.fd);
+}
+
+bool ShardClient::open(Connection& connection) const {
+    connection.fd = connectUnix(path);
+    connection.pending.clear();
+    if (connection.fd < 0) return false;
+    // Shards start in Json; every idle connection is left in Text
+    std::string answer;
+    if (sendAll(connection.fd, "format|text\n") &&
+        readAnswer(connection.fd, connection.pending, ResponseFormat::Text, answer)) {
+        return true;
+    }
+    closeSocket(connection.fd);
+    connection.fd = -1;
+    return false;
+}
+
+bool ShardClient::exchange(const std::string& requests, const std::vector<ResponseFormat>& formats,
+                           std::vector<std::string>& answers) {
+    // A borrowed connection may have been closed by a restarted shard; the
+    // second attempt always opens a fresh one
+    for (int attempt = 0; attempt < 2; attempt++) {
+        Connection connection;
+        bool reused = false;
+        if (attempt == 0) {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            if (!idle.empty()) {
+                connection = std::move(idle.back());
+                idle.pop_back();
+                reused = true;
+            }
+        }
+        if (!reused && !open(connection)) return false;
+
+        bool ok = sendAll(connection.fd, requests);
+        answers.assign(formats.size(), std::string());
+        for (size_t i = 0; ok && i < formats.size(); i++) {
+            ok = readAnswer(connection.fd, connection.pending, formats[i], answers[i]);
+        }
+        if (ok) {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            idle.push_back(std::move(connection));
+            return true;
+        }
+        closeSocket(connection.fd);
+        if (!reused) return false;
+    }
+    return false;
+}
+
+bool ShardClient::call(const std::string& request, std::vector<std::string>& fields) {
+    std::vector<std::string> answers;
+    if (!exchange(request + "\n", {ResponseFormat::Text}, answers)) return false;
+    std::string& answer = answers[0];
+    if (!answer.empty() && answer.back() == '\n') answer.pop_back();
+    fields = splitOn(answer, '\t');
+    if (fields.empty()) fields.push_back("ERR");
+    return true;
+}
+
+bool ShardClient::forward(const std::string& request, ResponseFormat format, std::string& answer) {
+    std::vector<std::string> answers;
+    if (format == ResponseFormat::Text) {
+        if (!exchange(request + "\n", {format}, answers)) return false;
+        answer = std::move(answers[0]);
+        return true;
+    }
+    // Switch the connection for this one request and back again
+    std::string name = (format == ResponseFormat::Json) ? "json" : "binary";
+    if (!exchange("format|" + name + "\n" + request + "\nformat|text\n",
+                  {format, format, ResponseFormat::Text}, answers)) {
+        return false;
+    }
+    answer = std::move(answers[1]);
+    return true;
+}
+
+// ---------------------------------------------------------------- coordinator
+
+bool ShardCoordinator::table(int shard, const std::vector<std::string>& from,
+                             const std::vector<std::string>& to, std::vector<double>& km) {
+    km.clear();
+    if (from.empty() || to.empty()) return true;
+    std::vector<std::string> fields;
+    if (!clients[shard]->call("table|" + joinNames(from) + "|" + joinNames(to), fields) ||
+        fields.size() != 2 || fields[0] != "OK") {
+        return false;
+    }
+    std::vector<std::string> values = splitOn(fields[1], ';');
+    if (values.size() != from.size() * to.size()) return false;
+    km.reserve(values.size());
+    for (const auto& value : values) km.push_back(std::stod(value));
+    return true;
+}
+
+bool ShardCoordinator::connect(const std::string& dir) {
+    TraceSpan span("ShardCoordinator::connect", "build", dir);
+    if (!ShardLayout::load(dir, layout)) return false;
+    clients.clear();
+    for (int i = 0; i < layout.shards; i++) {
+        clients.emplace_back(new ShardClient(shardSocketPath(dir, i)));
+    }
+
+    names.clear();
+    shardOfNode.clear();
+    nodeOf.clear();
+    boundaryOf.assign(layout.shards, std::vector<int>());
+    auto node = [&](const std::string& name) {
+        auto it = nodeOf.find(name);
+        if (it != nodeOf.end()) return it->second;
+        int id = static_cast<int>(names.size());
+        int shard = layout.shardOf.at(name);
+        names.push_back(name);
+        shardOfNode.push_back(shard);
+        boundaryOf[shard].push_back(id);
+        nodeOf[name] = id;
+        return id;
+    };
+
+    struct Arc {
+        int from, to;
+        double km;
+        int link;
+    };
+    std::vector<Arc> arcs;
+    for (size_t i = 0; i < layout.cut.size(); i++) {
+        const ShardLayout::Link& link = layout.cut[i];
+        arcs.push_back({node(link.from), node(link.to), link.km, static_cast<int>(i)});
+    }
+
+    for (int shard = 0; shard < layout.shards; shard++) {
+        std::vector<std::string> boundary;
+        for (int v : boundaryOf[shard]) boundary.push_back(names[v]);
+        std::vector<double> km;
+        std::vector<std::string> fields;
+        bool reached = boundary.empty() ? clients[shard]->call("ping", fields) : table(shard, boundary, boundary, km);
+        if (!reached) {
+            std::cerr << "Error: cannot get the boundary table of shard " << shard << " from "
+                      << shardSocketPath(dir, shard) << "\n";
+            return false;
+        }
+        size_t count = boundary.size();
+        for (size_t i = 0; i < count; i++) {
+            for (size_t j = 0; j < count; j++) {
+                if (i != j && km[i * count + j] >= 0) {
+                    arcs.push_back({boundaryOf[shard][i], boundaryOf[shard][j], km[i * count + j], -1});
+                }
+            }
+        }
+    }
+
+    // Arcs grouped by tail (CSR)
+    arcOffsets.assign(names.size() + 1, 0);
+    for (const auto& arc : arcs) arcOffsets[arc.from + 1]++;
+    for (size_t v = 0; v < names.size(); v++) arcOffsets[v + 1] += arcOffsets[v];
+    arcTargets.assign(arcs.size(), 0);
+    arcKm.assign(arcs.size(), 0);
+    arcLink.assign(arcs.size(), -1);
+    std::vector<int> next(arcOffsets.begin(), arcOffsets.end() - 1);
+    for (const auto& arc : arcs) {
+        int slot = next[arc.from]++;
+        arcTargets[slot] = arc.to;
+        arcKm[slot] = arc.km;
+        arcLink[slot] = arc.link;
+    }
+    return true;
+}
+
+double ShardCoordinator::shortest(const std::string& s, const std::string& t, std::vector<Leg>* legs) {
+    int a = layout.shardOf.at(s);
+    int b = layout.shardOf.at(t);
+    double best = INF;
+    int bestNode = -1;      // last boundary station of the best route; -1 for the direct route
+    if (a == b) {
+        std::vector<std::string> fields;
+        if (!clients[a]->call("distance|" + s + "|" + t, fields)) return -2;
+        if (fields[0] == "OK" && fields.size() == 2) best = std::stod(fields[1]);
+    }
+
+    std::vector<std::string> sourceBoundary, targetBoundary;
+    for (int v : boundaryOf[a]) sourceBoundary.push_back(names[v]);
+    for (int v : boundaryOf[b]) targetBoundary.push_back(names[v]);
+    std::vector<double> out, in;
+    if (!table(a, {s}, sourceBoundary, out) || !table(b, targetBoundary, {t}, in)) return -2;
+
+    size_t n = names.size();
+    std::vector<double> dist(n, INF), toTarget(n, -1);
+    std::vector<int> parent(n, -1);
+    std::vector<int> parentLink(n, -1);
+    for (size_t i = 0; i < in.size(); i++) toTarget[boundaryOf[b][i]] = in[i];
+
+    using Entry = std::pair<double, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    for (size_t i = 0; i < out.size(); i++) {
+        if (out[i] < 0) continue;
+        dist[boundaryOf[a][i]] = out[i];
+        queue.push({out[i], boundaryOf[a][i]});
+    }
+    while (!queue.empty()) {
+        Entry top = queue.top();
+        queue.pop();
+        double d = top.first;
+        int v = top.second;
+        if (d > dist[v]) continue;
+        if (d >= best) break;
+        if (toTarget[v] >= 0 && d + toTarget[v] < best) {
+            best = d + toTarget[v];
+            bestNode = v;
+        }
+        for (int arc = arcOffsets[v]; arc < arcOffsets[v + 1]; arc++) {
+            int w = arcTargets[arc];
+            double nd = d + arcKm[arc];
+            if (nd < dist[w]) {
+                dist[w] = nd;
+                parent[w] = v;
+                parentLink[w] = arcLink[arc];
+                queue.push({nd, w});
+            }
+        }
+    }
+    if (best == INF) return -1;
+
+    if (legs) {
+        legs->clear();
+        if (bestNode < 0) {
+            legs->push_back({s, t, a, -1});
+        } else {
+            std::vector<int> chain;
+            for (int v = bestNode; v >= 0; v = parent[v]) chain.push_back(v);
+            std::reverse(chain.begin(), chain.end());
+            legs->push_back({s, names[chain.front()], a, -1});
+            for (size_t i = 1; i < chain.size(); i++) {
+                int link = parentLink[chain[i]];
+                int shard = link >= 0 ? -1 : shardOfNode[chain[i]];
+                legs->push_back({names[chain[i - 1]], names[chain[i]], shard, link});
+            }
+            legs->push_back({names[chain.back()], t, b, -1});
+        }
+    }
+    return best;
+}
+
+std::string ShardCoordinator::answer(const std::string& request, ResponseFormat format) {
+    std::string line = request;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    std::vector<std::string> f = QueryEngine::splitFields(line);
+    if (f.empty()) return QueryEngine::errorAnswer("empty request", format);
+    const std::string& cmd = f[0];
+
+    if (cmd == "distance" || cmd == "route") {
+        bool route = (cmd == "route");
+        if (f.size() != 3 && !(route && f.size() == 4)) {
+            return QueryEngine::errorAnswer("usage: " + cmd + "|<from>|<to>" + (route ? "[|distance]" : ""), format);
+        }
+        if (f.size() == 4 && f[3] != "distance") {
+            return QueryEngine::errorAnswer("only the distance criterion is answered across shards", format);
+        }
+        for (int i = 1; i <= 2; i++) {
+            if (!layout.shardOf.count(f[i])) return QueryEngine::errorAnswer("unknown station: " + f[i], format);
+        }
+        std::vector<Leg> legs;
+        double km = shortest(f[1], f[2], route ? &legs : nullptr);
+        if (km == -2) return QueryEngine::errorAnswer("shard unavailable", format);
+        if (km < 0) return QueryEngine::errorAnswer("no route", format);
+        if (!route) return QueryEngine::fieldsAnswer({{"distance", km}}, {}, format);
+
+        // Stitch the legs: per-shard routes, joined by cut links (rides add their line)
+        std::vector<std::string> lines, path{f[1]};
+        for (const auto& leg : legs) {
+            if (leg.from == leg.to) continue;
+            if (leg.shard < 0) {
+                const std::string& name = layout.cut[leg.link].line;
+                if (!name.empty() && (lines.empty() || lines.back() != name)) lines.push_back(name);
+                path.push_back(leg.to);
+                continue;
+            }
+            std::vector<std::string> fields;
+            if (!clients[leg.shard]->call("route|" + leg.from + "|" + leg.to + "|distance", fields)) {
+                return QueryEngine::errorAnswer("shard unavailable", format);
+            }
+            if (fields[0] != "OK" || fields.size() != 7) return QueryEngine::errorAnswer("no route", format);
+            for (const auto& name : splitOn(fields[5], ';')) {
+                if (lines.empty() || lines.back() != name) lines.push_back(name);
+            }
+            std::vector<std::string> stations = splitOn(fields[6], ';');
+            path.insert(path.end(), stations.begin() + (stations.empty() ? 0 : 1), stations.end());
+        }
+        return QueryEngine::fieldsAnswer({{"distance", km}}, {{"lines", lines}, {"path", path}}, format);
+    }
+
+    if (cmd == "shards") {
+        std::vector<std::string> status;
+        for (int i = 0; i < layout.shards; i++) {
+            std::vector<std::string> fields;
+            bool up = clients[i]->call("ping", fields);
+            status.push_back(std::to_string(i) + ":" + std::to_string(boundaryOf[i].size()) + " boundary:" +
+                             (up ? "up" : "down"));
+        }
+        return QueryEngine::listAnswer("shards", status, format);
+    }
+
+    if (cmd == "search") {
+        if (f.size() != 2) return QueryEngine::errorAnswer("usage: search|<keyword>", format);
+        std::vector<std::string> stations;
+        for (int i = 0; i < layout.shards; i++) {
+            std::vector<std::string> fields;
+            if (!clients[i]->call(line, fields)) return QueryEngine::errorAnswer("shard unavailable", format);
+            if (fields[0] != "OK" || fields.size() != 2) continue;
+            for (auto& name : splitOn(fields[1], ';')) stations.push_back(std::move(name));
+        }
+        std::sort(stations.begin(), stations.end());
+        return QueryEngine::listAnswer("stations", stations, format);
+    }
+
+    // One shard would answer these from its own region only
+    if (cmd == "nearest" || cmd == "hops" || cmd == "table" || cmd == "cheapest" || cmd == "isochrone") {
+        return QueryEngine::errorAnswer(cmd + " is not answered across shards", format);
+    }
+
+    // Everything else is one shard's business: the shard of the stations it
+    // names, or shard 0
+    int shard = -1;
+    for (size_t i = 1; i < f.size(); i++) {
+        auto it = layout.shardOf.find(f[i]);
+        if (it == layout.shardOf.end()) continue;
+        if (shard >= 0 && it->second != shard) {
+            return QueryEngine::errorAnswer(cmd + " is not answered for stations in different shards", format);
+        }
+        shard = it->second;
+    }
+    if (shard < 0) shard = 0;
+    std::string out;
+    if (!clients[shard]->forward(line, format, out)) return QueryEngine::errorAnswer("shard unavailable", format);
+    return out;
+}
@@ -0,0 +1,326 @@
+#include "SimdKernels.h"
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define METRO_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// ---- Scalar versions --------------------------------------------------------
+
+long nearestScalar(const double* lats, const double* lons, size_t count, double lat, double lon) {
+    long best = -1;
+    double bestDist = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < count; i++) {
+        double dy = lats[i] - lat;
+        double dx = lons[i] - lon;
+        double d = dy * dy + dx * dx;
+        if (d < bestDist) {
+            bestDist = d;
+            best = static_cast<long>(i);
+        }
+    }
+    return best;
+}
+
+size_t findAllScalar(const char* haystack, size_t size, const char* needle, size_t length,
+                     void (*onMatch)(size_t, void*), void* context) {
+    size_t matches = 0;
+    if (length == 0 || length > size) return 0;
+    const char* end = haystack + size - length + 1;
+    for (const char* p = haystack; p < end; p++) {
+        p = static_cast<const char*>(std::memchr(p, needle[0], end - p));
+        if (p == nullptr) break;
+        if (std::memcmp(p + 1, needle + 1, length - 1) == 0) {
+            onMatch(p - haystack, context);
+            matches++;
+        }
+    }
+    return matches;
+}
+
+void prefixMatchScalar(const char* base, const uint32_t* starts, size_t count,
+                       const char* prefix, size_t length, unsigned char* out) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = std::strncmp(base + starts[i], prefix, length) == 0;
+    }
+}
+
+size_t filterEqualScalar(const int32_t* values, size_t count, int32_t key, uint32_t* out) {
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (values[i] == key) out[n++] = static_cast<uint32_t>(i);
+    }
+    return n;
+}
+
+void toLowerScalar(const char* src, size_t length, char* dst) {
+    for (size_t i = 0; i < length; i++) {
+        char c = src[i];
+        dst[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+    }
+}
+
+// Data bytes described by one Stream VByte control byte
+struct StreamVByteTables {
+    uint8_t lengths[256];
+    uint8_t shuffles[256][16];     // data byte for each output byte, 0xFF = zero
+
+    StreamVByteTables() {
+        for (int control = 0; control < 256; control++) {
+            int at = 0;
+            for (int slot = 0; slot < 4; slot++) {
+                int bytes = ((control >> (2 * slot)) & 3) + 1;
+                for (int b = 0; b < 4; b++) {
+                    shuffles[control][4 * slot + b] = (b < bytes) ? static_cast<uint8_t>(at + b) : 0xFF;
+                }
+                at += bytes;
+            }
+            lengths[control] = static_cast<uint8_t>(at);
+        }
+    }
+};
+
+const StreamVByteTables& streamVByteTables() {
+    static const StreamVByteTables tables;
+    return tables;
+}
+
+size_t decodeStreamVByteScalar(const uint8_t* control, const uint8_t* data, size_t count, uint32_t* out) {
+    const uint8_t* p = data;
+    for (size_t i = 0; i < count; i++) {
+        int bytes = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t value = 0;
+        for (int b = 0; b < bytes; b++) value |= static_cast<uint32_t>(p[b]) << (8 * b);
+        out[i] = value;
+        p += bytes;
+    }
+    return static_cast<size_t>(p - data);
+}
+
+// ---- AVX2 versions ----------------------------------------------------------
+
+#ifdef METRO_HAVE_AVX2
+
+__attribute__((target("avx2")))
+long nearestAvx2(const double* lats, const double* lons, size_t count, double lat, double lon) {
+    if (count < 4) return nearestScalar(lats, lons, count, lat, lon);
+
+    const __m256d qLat = _mm256_set1_pd(lat);
+    const __m256d qLon = _mm256_set1_pd(lon);
+    const __m256d step = _mm256_set1_pd(4.0);
+    __m256d index = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+    __m256d best = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    __m256d bestIndex = _mm256_set1_pd(-1.0);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(lats + i), qLat);
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(lons + i), qLon);
+        __m256d d = _mm256_add_pd(_mm256_mul_pd(dy, dy), _mm256_mul_pd(dx, dx));
+        __m256d closer = _mm256_cmp_pd(d, best, _CMP_LT_OQ);
+        best = _mm256_blendv_pd(best, d, closer);
+        bestIndex = _mm256_blendv_pd(bestIndex, index, closer);
+        index = _mm256_add_pd(index, step);
+    }
+
+    // Reduce the four lanes; equal distances keep the lowest index
+    alignas(32) double laneDist[4], laneIndex[4];
+    _mm256_store_pd(laneDist, best);
+    _mm256_store_pd(laneIndex, bestIndex);
+    double bestDist = laneDist[0];
+    long result = static_cast<long>(laneIndex[0]);
+    for (int lane = 1; lane < 4; lane++) {
+        long li = static_cast<long>(laneIndex[lane]);
+        if (li < 0) continue;
+        if (laneDist[lane] < bestDist || (laneDist[lane] == bestDist && (result < 0 || li < result))) {
+            bestDist = laneDist[lane];
+            result = li;
+        }
+    }
+
+    for (; i < count; i++) {
+        double dy = lats[i] - lat;
+        double dx = lons[i] - lon;
+        double d = dy * dy + dx * dx;
+        if (d < bestDist) {
+            bestDist = d;
+            result = static_cast<long>(i);
+        }
+    }
+    return result;
+}
+
+// First/last byte filter over 32 positions at a time, then a memcmp on the
+// (rare) candidates
+__attribute__((target("avx2")))
+size_t findAllAvx2(const char* haystack, size_t size, const char* needle, size_t length,
+                   void (*onMatch)(size_t, void*), void* context) {
+    size_t matches = 0;
+    if (length == 0 || length > size) return 0;
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[length - 1]);
+    const size_t limit = size - length + 1;   // candidate positions [0, limit)
+
+    for (size_t i = 0; i < limit; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+        __m256i blockLast = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(haystack + i + length - 1));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst),
+                             _mm256_cmpeq_epi8(last, blockLast))));
+        while (mask != 0) {
+            size_t pos = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (pos >= limit) break;
+            if (length <= 2 || std::memcmp(haystack + pos + 1, needle + 1, length - 2) == 0) {
+                onMatch(pos, context);
+                matches++;
+            }
+        }
+    }
+    return matches;
+}
+
+__attribute__((target("avx2")))
+void prefixMatchAvx2(const char* base, const uint32_t* starts, size_t count,
+                     const char* prefix, size_t length, unsigned char* out) {
+    if (length > 32) {
+        prefixMatchScalar(base, starts, count, prefix, length, out);
+        return;
+    }
+    alignas(32) char padded[32] = {};
+    std::memcpy(padded, prefix, length);
+    const __m256i wanted = _mm256_load_si256(reinterpret_cast<const __m256i*>(padded));
+    const uint32_t lengthMask = (length == 32) ? 0xFFFFFFFFu : ((1u << length) - 1);
+    for (size_t i = 0; i < count; i++) {
+        __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(base + starts[i]));
+        uint32_t equal = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(head, wanted)));
+        out[i] = (equal & lengthMask) == lengthMask;
+    }
+}
+
+__attribute__((target("avx2")))
+size_t filterEqualAvx2(const int32_t* values, size_t count, int32_t key, uint32_t* out) {
+    const __m256i wanted = _mm256_set1_epi32(key);
+    size_t n = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        uint32_t mask = static_cast<uint32_t>(
+            _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(block, wanted))));
+        while (mask != 0) {
+            out[n++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+    for (; i < count; i++) {
+        if (values[i] == key) out[n++] = static_cast<uint32_t>(i);
+    }
+    return n;
+}
+
+__attribute__((target("avx2")))
+void toLowerAvx2(const char* src, size_t length, char* dst) {
+    // 'A'..'Z' shifted to the bottom of the signed range, so one signed
+    // compare finds the uppercase bytes
+    const __m256i shift = _mm256_set1_epi8(static_cast<char>(-128 - 'A'));
+    const __m256i bound = _mm256_set1_epi8(static_cast<char>(-128 + 26));
+    const __m256i bit = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i upper = _mm256_cmpgt_epi8(bound, _mm256_add_epi8(block, shift));
+        block = _mm256_or_si256(block, _mm256_and_si256(upper, bit));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), block);
+    }
+    toLowerScalar(src + i, length - i, dst + i);
+}
+
+// Four values per control byte with one 16-byte shuffle (the SSSE3 subset of
+// AVX2); the last, partial group is decoded by the scalar loop
+__attribute__((target("avx2")))
+size_t decodeStreamVByteAvx2(const uint8_t* control, const uint8_t* data, size_t count, uint32_t* out) {
+    const StreamVByteTables& tables = streamVByteTables();
+    const uint8_t* p = data;
+    size_t groups = count / 4;
+    for (size_t g = 0; g < groups; g++) {
+        uint8_t key = control[g];
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.shuffles[key]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * g), _mm_shuffle_epi8(bytes, shuffle));
+        p += tables.lengths[key];
+    }
+    size_t done = static_cast<size_t>(p - data);
+    size_t rest = count - 4 * groups;
+    if (rest > 0) done += decodeStreamVByteScalar(control + groups, p, rest, out + 4 * groups);
+    return done;
+}
+
+#endif
+
+struct KernelTable {
+    const char* isa;
+    long (*nearest)(const double*, const double*, size_t, double, double);
+    size_t (*findAll)(const char*, size_t, const char*, size_t, void (*)(size_t, void*), void*);
+    void (*prefixMatch)(const char*, const uint32_t*, size_t, const char*, size_t, unsigned char*);
+    size_t (*filterEqual)(const int32_t*, size_t, int32_t, uint32_t*);
+    void (*toLower)(const char*, size_t, char*);
+    size_t (*decodeStreamVByte)(const uint8_t*, const uint8_t*, size_t, uint32_t*);
+};
+
+KernelTable selectKernels() {
+#ifdef METRO_HAVE_AVX2
+    const char* forced = std::getenv("METRO_SIMD");
+    bool scalarOnly = forced != nullptr && std::strcmp(forced, "scalar") == 0;
+    if (!scalarOnly && __builtin_cpu_supports("avx2")) {
+        return {"avx2", nearestAvx2, findAllAvx2, prefixMatchAvx2, filterEqualAvx2, toLowerAvx2,
+                decodeStreamVByteAvx2};
+    }
+#endif
+    return {"scalar", nearestScalar, findAllScalar, prefixMatchScalar, filterEqualScalar, toLowerScalar,
+            decodeStreamVByteScalar};
+}
+
+const KernelTable& kernels() {
+    static const KernelTable table = selectKernels();
+    return table;
+}
+
+} // namespace
+
+const char* SimdKernels::isa() {
+    return kernels().isa;
+}
+
+long SimdKernels::nearest(const double* lats, const double* lons, size_t count,
+                          double lat, double lon) {
+    return kernels().nearest(lats, lons, count, lat, lon);
+}
+
+size_t SimdKernels::findAll(const char* haystack, size_t size, const char* needle, size_t length,
+                            void (*onMatch)(size_t offset, void* context), void* context) {
+    return kernels().findAll(haystack, size, needle, length, onMatch, context);
+}
+
+void SimdKernels::prefixMatch(const char* base, const uint32_t* starts, size_t count,
+                              const char* prefix, size_t length, unsigned char* out) {
+    kernels().prefixMatch(base, starts, count, prefix, length, out);
+}
+
+size_t SimdKernels::filterEqual(const int32_t* values, size_t count, int32_t key, uint32_t* out) {
+    return kernels().filterEqual(values, count, key, out);
+}
+
+void SimdKernels::toLower(const char* src, size_t length, char* dst) {
+    kernels().toLower(src, length, dst);
+}
+
+size_t SimdKernels::decodeStreamVByte(const uint8_t* control, const uint8_t* data, size_t count,
+                                      uint32_t* out) {
+    return kernels().decodeStreamVByte(control, data, count, out);
+}
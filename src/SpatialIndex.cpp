@@ -0,0 +1,48 @@
+#include "SpatialIndex.h"
+#include <cmath>
+#include <algorithm>
+
+SpatialIndex::SpatialIndex(const std::unordered_map<std::string, Station>& db, double km)
+    : stations(db), cellKm(km > 0 ? km : 1.0) {
+    double latSum = 0;
+    for (const auto& pair : stations) latSum += pair.second.getLatitude();
+    double meanLat = stations.empty() ? 0.0 : latSum / stations.size();
+
+    const double KM_PER_DEG = 111.32;
+    double cosLat = std::cos(meanLat * 3.14159265358979323846 / 180.0);
+    cellDegLat = cellKm / KM_PER_DEG;
+    cellDegLon = cellKm / (KM_PER_DEG * std::max(cosLat, 0.01));
+
+    for (const auto& pair : stations) {
+        long long key = cellKey(rowOf(pair.second.getLatitude()), colOf(pair.second.getLongitude()));
+        cells[key].push_back(pair.first);
+    }
+}
+
+long long SpatialIndex::rowOf(double lat) const {
+    return static_cast<long long>(std::floor(lat / cellDegLat));
+}
+
+long long SpatialIndex::colOf(double lon) const {
+    return static_cast<long long>(std::floor(lon / cellDegLon));
+}
+
+std::vector<std::string> SpatialIndex::withinKm(double latitude, double longitude, double km) const {
+    std::vector<std::string> result;
+    Station probe("", "", 0, latitude, longitude);
+    long long reach = static_cast<long long>(std::ceil(km / cellKm));
+    long long row = rowOf(latitude), col = colOf(longitude);
+
+    for (long long r = row - reach; r <= row + reach; r++) {
+        for (long long c = col - reach; c <= col + reach; c++) {
+            auto it = cells.find(cellKey(r, c));
+            if (it == cells.end()) continue;
+            for (const auto& name : it->second) {
+                if (probe.distanceKmTo(stations.at(name)) <= km) {
+                    result.push_back(name);
+                }
+            }
+        }
+    }
+    return result;
+}
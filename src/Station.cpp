@@ -1,13 +1,26 @@
 #include "Station.h"
+#include "StringPool.h"
 #include <iostream>
 #include <iomanip>
+#include <cmath>
 
 Station::Station(const std::string& n, const std::string& line, 
                  int zone, double lat, double lon)
-    : name(n), metroLine(line), zoneNumber(zone), 
+    : name(n), metroLine(&StringPool::shared().intern(line)), zoneNumber(zone), 
       latitude(lat), longitude(lon) {}
 
 void Station::display() const {
-    std::cout << "Name: " << name << " | Line: " << metroLine 
+    std::cout << "Name: " << name << " | Line: " << *metroLine 
               << " | Zone: " << zoneNumber << std::endl;
 }
+
+double Station::distanceKmTo(const Station& other) const {
+    const double R = 6371.0;
+    const double toRad = 3.14159265358979323846 / 180.0;
+    double dLat = (other.latitude - latitude) * toRad;
+    double dLon = (other.longitude - longitude) * toRad;
+    double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+               std::cos(latitude * toRad) * std::cos(other.latitude * toRad) *
+               std::sin(dLon / 2) * std::sin(dLon / 2);
+    return 2 * R * std::asin(std::sqrt(a));
+}
@@ -0,0 +1,266 @@
+#include "StationOrder.h"
+#include "Graph.h"
+#include "CompactGraph.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_map>
+
+namespace {
+
+// Stations by sorted name plus undirected CSR adjacency over those indices;
+// every strategy permutes this base numbering
+struct BaseNumbering {
+    std::vector<std::string> names;
+    std::vector<int> offsets;
+    std::vector<int> neighbours;
+    std::vector<const std::string*> rideLines;  // line of a ride between the two, nullptr otherwise
+
+    explicit BaseNumbering(const Graph& graph) {
+        const auto& stations = graph.getStations();
+        names.reserve(stations.size());
+        for (const auto& pair : stations) names.push_back(pair.first);
+        std::sort(names.begin(), names.end());
+
+        std::unordered_map<std::string, int> ids;
+        ids.reserve(names.size());
+        for (size_t i = 0; i < names.size(); i++) ids[names[i]] = static_cast<int>(i);
+
+        std::vector<std::pair<int, int>> arcs;
+        std::vector<const std::string*> arcLines;
+        for (const auto& pair : graph.getAdjacency()) {
+            auto from = ids.find(pair.first);
+            if (from == ids.end()) continue;
+            for (const auto& edge : pair.second) {
+                auto to = ids.find(edge.to);
+                if (to == ids.end() || to->second == from->second) continue;
+                const std::string* line = (edge.type == EdgeType::Ride) ? edge.line : nullptr;
+                arcs.push_back({from->second, to->second});
+                arcLines.push_back(line);
+                arcs.push_back({to->second, from->second});
+                arcLines.push_back(line);
+            }
+        }
+
+        int n = static_cast<int>(names.size());
+        offsets.assign(n + 1, 0);
+        for (const auto& arc : arcs) offsets[arc.first + 1]++;
+        for (int v = 0; v < n; v++) offsets[v + 1] += offsets[v];
+        neighbours.resize(arcs.size());
+        rideLines.resize(arcs.size());
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t k = 0; k < arcs.size(); k++) {
+            int slot = fill[arcs[k].first]++;
+            neighbours[slot] = arcs[k].second;
+            rideLines[slot] = arcLines[k];
+        }
+    }
+
+    int size() const { return static_cast<int>(names.size()); }
+    int degree(int v) const { return offsets[v + 1] - offsets[v]; }
+};
+
+std::vector<int> cuthillMcKee(const BaseNumbering& base) {
+    int n = base.size();
+    auto byDegree = [&](int a, int b) {
+        int da = base.degree(a), db = base.degree(b);
+        return da != db ? da < db : a < b;
+    };
+    std::vector<int> starts(n);
+    for (int v = 0; v < n; v++) starts[v] = v;
+    std::sort(starts.begin(), starts.end(), byDegree);
+
+    std::vector<int> order;
+    order.reserve(n);
+    std::vector<char> visited(n, 0);
+    std::vector<int> next;
+    for (int start : starts) {
+        if (visited[start]) continue;
+        visited[start] = 1;
+        size_t head = order.size();
+        order.push_back(start);
+        while (head < order.size()) {
+            int u = order[head++];
+            next.clear();
+            for (int k = base.offsets[u]; k < base.offsets[u + 1]; k++) {
+                int v = base.neighbours[k];
+                if (!visited[v]) {
+                    visited[v] = 1;
+                    next.push_back(v);
+                }
+            }
+            std::sort(next.begin(), next.end(), byDegree);
+            order.insert(order.end(), next.begin(), next.end());
+        }
+    }
+    // Reversing (RCM) narrows the profile further
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+// Distance of (x, y) along a Hilbert curve filling a 65536 x 65536 grid
+uint64_t hilbertIndex(uint32_t x, uint32_t y) {
+    const uint32_t side = 1u << 16;
+    uint64_t d = 0;
+    for (uint32_t s = side / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) ? 1 : 0;
+        uint32_t ry = (y & s) ? 1 : 0;
+        d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+std::vector<int> hilbertOrder(const Graph& graph, const BaseNumbering& base) {
+    int n = base.size();
+    const auto& stations = graph.getStations();
+    std::vector<double> lats(n), lons(n);
+    double minLat = 90, maxLat = -90, minLon = 180, maxLon = -180;
+    for (int v = 0; v < n; v++) {
+        const Station& station = stations.at(base.names[v]);
+        lats[v] = station.getLatitude();
+        lons[v] = station.getLongitude();
+        minLat = std::min(minLat, lats[v]);
+        maxLat = std::max(maxLat, lats[v]);
+        minLon = std::min(minLon, lons[v]);
+        maxLon = std::max(maxLon, lons[v]);
+    }
+    auto cell = [](double value, double lo, double hi) {
+        if (hi <= lo) return 0u;
+        double scaled = (value - lo) / (hi - lo) * 65535.0;
+        return static_cast<uint32_t>(std::min(65535.0, std::max(0.0, scaled)));
+    };
+
+    std::vector<std::pair<uint64_t, int>> keyed(n);
+    for (int v = 0; v < n; v++) {
+        keyed[v] = {hilbertIndex(cell(lons[v], minLon, maxLon), cell(lats[v], minLat, maxLat)), v};
+    }
+    std::sort(keyed.begin(), keyed.end());
+    std::vector<int> order(n);
+    for (int i = 0; i < n; i++) order[i] = keyed[i].second;
+    return order;
+}
+
+// Each line in name order, walked along its ride edges from its terminals;
+// interchanges stay with the first line that reaches them, stations without
+// rides go last
+std::vector<int> lineOrder(const BaseNumbering& base) {
+    int n = base.size();
+    std::vector<std::string> lineNames;
+    for (const std::string* line : base.rideLines) {
+        if (line) lineNames.push_back(*line);
+    }
+    std::sort(lineNames.begin(), lineNames.end());
+    lineNames.erase(std::unique(lineNames.begin(), lineNames.end()), lineNames.end());
+    std::unordered_map<std::string, int> lineIds;
+    for (size_t i = 0; i < lineNames.size(); i++) lineIds[lineNames[i]] = static_cast<int>(i);
+
+    // Line of every neighbour entry, and (line, station) pairs: one per ride,
+    // so equal pairs in a row count the station's degree on that line
+    std::vector<int> arcLine(base.neighbours.size(), -1);
+    std::vector<std::pair<int, int>> memberships;
+    for (int v = 0; v < n; v++) {
+        for (int k = base.offsets[v]; k < base.offsets[v + 1]; k++) {
+            if (!base.rideLines[k]) continue;
+            arcLine[k] = lineIds[*base.rideLines[k]];
+            memberships.push_back({arcLine[k], v});
+        }
+    }
+    std::sort(memberships.begin(), memberships.end());
+
+    std::vector<int> order;
+    order.reserve(n);
+    std::vector<char> placed(n, 0);
+    std::vector<std::pair<int, int>> members;   // (degree on the line, station)
+    std::vector<int> stack;
+    for (size_t i = 0; i < memberships.size();) {
+        int line = memberships[i].first;
+        members.clear();
+        while (i < memberships.size() && memberships[i].first == line) {
+            int v = memberships[i].second;
+            int degree = 0;
+            for (; i < memberships.size() && memberships[i] == std::make_pair(line, v); i++) degree++;
+            members.push_back({degree, v});
+        }
+        std::sort(members.begin(), members.end());
+
+        // Depth-first from each terminal follows the line in sequence
+        for (const auto& member : members) {
+            if (placed[member.second]) continue;
+            stack.assign(1, member.second);
+            while (!stack.empty()) {
+                int u = stack.back();
+                stack.pop_back();
+                if (placed[u]) continue;
+                placed[u] = 1;
+                order.push_back(u);
+                for (int k = base.offsets[u]; k < base.offsets[u + 1]; k++) {
+                    if (arcLine[k] == line && !placed[base.neighbours[k]]) stack.push_back(base.neighbours[k]);
+                }
+            }
+        }
+    }
+    for (int v = 0; v < n; v++) {
+        if (!placed[v]) order.push_back(v);
+    }
+    return order;
+}
+
+} // namespace
+
+std::vector<std::string> StationOrdering::arrange(const Graph& graph, StationOrder order) {
+    TraceSpan span("StationOrdering::arrange", "index", name(order));
+    BaseNumbering base(graph);
+    if (order == StationOrder::Name) return std::move(base.names);
+
+    std::vector<int> permutation;
+    if (order == StationOrder::Bfs) {
+        permutation = cuthillMcKee(base);
+    } else if (order == StationOrder::Hilbert) {
+        permutation = hilbertOrder(graph, base);
+    } else {
+        permutation = lineOrder(base);
+    }
+    std::vector<std::string> names;
+    names.reserve(permutation.size());
+    for (int v : permutation) names.push_back(std::move(base.names[v]));
+    return names;
+}
+
+bool StationOrdering::parse(const std::string& name, StationOrder& order) {
+    if (name == "name") order = StationOrder::Name;
+    else if (name == "bfs" || name == "rcm") order = StationOrder::Bfs;
+    else if (name == "hilbert") order = StationOrder::Hilbert;
+    else if (name == "line") order = StationOrder::Line;
+    else return false;
+    return true;
+}
+
+const char* StationOrdering::name(StationOrder order) {
+    switch (order) {
+        case StationOrder::Bfs: return "bfs";
+        case StationOrder::Hilbert: return "hilbert";
+        case StationOrder::Line: return "line";
+        default: return "name";
+    }
+}
+
+double StationOrdering::averageEdgeSpan(const CompactGraph& graph) {
+    int m = graph.getEdgeCount();
+    if (m == 0) return 0.0;
+    double total = 0;
+    CompactGraph::EdgeCursor edges;
+    for (int u = 0; u < graph.size(); u++) {
+        edges.load(graph, u);
+        for (int e = edges.begin; e < edges.end; e++) {
+            total += std::abs(edges.target(e) - u);
+        }
+    }
+    return total / m;
+}
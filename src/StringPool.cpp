@@ -0,0 +1,26 @@
+#include "StringPool.h"
+
+const std::string& StringPool::intern(const std::string& value) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto inserted = values.insert(value);
+    if (inserted.second) {
+        // node + hash + the string's own heap block (past the inline buffer)
+        bytes += sizeof(std::string) + 2 * sizeof(void*) + heapBytes(*inserted.first);
+    }
+    return *inserted.first;
+}
+
+size_t StringPool::size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return values.size();
+}
+
+size_t StringPool::memoryBytes() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return bytes + values.bucket_count() * sizeof(void*);
+}
+
+StringPool& StringPool::shared() {
+    static StringPool pool;
+    return pool;
+}
@@ -0,0 +1,86 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+            active++;
+        }
+        task();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            active--;
+            if (tasks.empty() && active == 0) allDone.notify_all();
+        }
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        tasks.push(std::move(task));
+    }
+    taskReady.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mtx);
+    allDone.wait(lock, [this] { return tasks.empty() && active == 0; });
+}
+
+void ThreadPool::parallelFor(size_t count,
+                             const std::function<void(size_t index, unsigned worker)>& body) {
+    if (count == 0) return;
+
+    unsigned chunks = size();
+    if (count < chunks) chunks = static_cast<unsigned>(count);
+
+    // Indices are handed out dynamically so uneven work (e.g. sources in
+    // dense vs sparse parts of the network) still balances across workers.
+    std::atomic<size_t> next(0);
+    std::mutex doneMtx;
+    std::condition_variable doneCv;
+    unsigned remaining = chunks;
+
+    for (unsigned w = 0; w < chunks; w++) {
+        submit([&, w] {
+            for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+                body(i, w);
+            }
+            std::lock_guard<std::mutex> lock(doneMtx);
+            if (--remaining == 0) doneCv.notify_all();
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(doneMtx);
+    doneCv.wait(lock, [&] { return remaining == 0; });
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
@@ -0,0 +1,155 @@
+#include "Trace.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<bool> Trace::enabledFlag(false);
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    uint64_t startNs;
+    uint64_t durationNs;
+    char detail[64];
+};
+
+// Single-producer (owning thread) / single-consumer (writer thread) ring
+struct TraceRing {
+    static constexpr size_t CAPACITY = 8192;    // power of two
+    TraceEvent events[CAPACITY];
+    std::atomic<size_t> head{0};    // next slot to write (producer)
+    std::atomic<size_t> tail{0};    // next slot to read (consumer)
+    int tid = 0;
+};
+
+std::mutex ringsMutex;
+std::vector<std::unique_ptr<TraceRing>> rings;
+thread_local TraceRing* localRing = nullptr;
+std::atomic<uint64_t> droppedSpans(0);
+
+std::mutex writerMutex;
+std::condition_variable writerCv;
+std::thread writerThread;
+std::ofstream traceFile;
+bool writerStopping = false;
+bool firstEvent = true;
+const auto traceEpoch = std::chrono::steady_clock::now();
+
+TraceRing* ringForThisThread() {
+    if (localRing == nullptr) {
+        std::unique_ptr<TraceRing> ring(new TraceRing());
+        localRing = ring.get();
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        ring->tid = static_cast<int>(rings.size()) + 1;
+        rings.push_back(std::move(ring));
+    }
+    return localRing;
+}
+
+void writeEscaped(std::ostream& out, const char* s) {
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') out << '\\';
+        if (static_cast<unsigned char>(*s) >= 0x20) out << *s;
+    }
+}
+
+// Drain every ring into the file; called by the writer thread only
+void drainRings() {
+    std::vector<TraceRing*> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (auto& ring : rings) snapshot.push_back(ring.get());
+    }
+    for (TraceRing* ring : snapshot) {
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; tail++) {
+            const TraceEvent& e = ring->events[tail & (TraceRing::CAPACITY - 1)];
+            traceFile << (firstEvent ? "\n" : ",\n");
+            firstEvent = false;
+            traceFile << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+                      << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->tid
+                      << ",\"ts\":" << e.startNs / 1000 << "." << (e.startNs % 1000) / 100
+                      << ",\"dur\":" << e.durationNs / 1000 << "." << (e.durationNs % 1000) / 100;
+            if (e.detail[0]) {
+                traceFile << ",\"args\":{\"detail\":\"";
+                writeEscaped(traceFile, e.detail);
+                traceFile << "\"}";
+            }
+            traceFile << "}";
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+    traceFile.flush();
+}
+
+} // namespace
+
+uint64_t Trace::nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - traceEpoch).count());
+}
+
+void Trace::record(const char* name, const char* category, uint64_t startNs,
+                   uint64_t durationNs, const std::string& detail) {
+    TraceRing* ring = ringForThisThread();
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    size_t tail = ring->tail.load(std::memory_order_acquire);
+    if (head - tail >= TraceRing::CAPACITY) {
+        droppedSpans.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceEvent& e = ring->events[head & (TraceRing::CAPACITY - 1)];
+    e.name = name;
+    e.category = category;
+    e.startNs = startNs;
+    e.durationNs = durationNs;
+    size_t n = std::min(detail.size(), sizeof(e.detail) - 1);
+    std::memcpy(e.detail, detail.data(), n);
+    e.detail[n] = '\0';
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool Trace::start(const std::string& path) {
+    stop();
+    traceFile.open(path);
+    if (!traceFile.is_open()) return false;
+    traceFile << "[";
+    firstEvent = true;
+    writerStopping = false;
+
+    writerThread = std::thread([] {
+        std::unique_lock<std::mutex> lock(writerMutex);
+        while (!writerStopping) {
+            writerCv.wait_for(lock, std::chrono::milliseconds(50));
+            drainRings();
+        }
+    });
+    enabledFlag.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void Trace::stop() {
+    if (!writerThread.joinable()) return;
+    enabledFlag.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        writerStopping = true;
+    }
+    writerCv.notify_all();
+    writerThread.join();
+    drainRings();
+    traceFile << "\n]\n";
+    traceFile.close();
+}
+
+uint64_t Trace::dropped() {
+    return droppedSpans.load(std::memory_order_relaxed);
+}
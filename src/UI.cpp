@@ -106,23 +106,31 @@ void UI::displayRoute(const PathInfo& path, const Graph& graph) {
     std::cout << "\n" << std::string(50, '-') << std::endl;
     std::cout << "DETAILED ROUTE:\n" << std::string(50, '-') << std::endl;
     
+    // Line changes come from the edge types along the route
     std::string currentLine;
     for (size_t i = 0; i < path.path.size(); i++) {
         const Station* station = graph.getStation(path.path[i]);
-        if (station) {
-            std::string stationLine = station->getMetroLine();
-            
-            if (i == 0) {
-                std::cout << "  START: " << path.path[i] << " (" << stationLine << ")\n";
-                currentLine = stationLine;
-            } else if (stationLine != currentLine) {
-                std::cout << "  ↓\n  TRANSFER to " << stationLine << "\n";
-                std::cout << "  → " << path.path[i] << "\n";
-                currentLine = stationLine;
-            } else {
-                std::cout << "  → " << path.path[i] << "\n";
-            }
+        if (!station) continue;
+        
+        if (i == 0) {
+            std::cout << "  START: " << path.path[i] << " (" << station->getMetroLine() << ")\n";
+            currentLine = station->getMetroLine();
+            continue;
+        }
+        
+        const Edge* edge = graph.getEdge(path.path[i - 1], path.path[i]);
+        if (edge && edge->type == EdgeType::Walk) {
+            std::cout << "  ↓\n  WALK " << std::fixed << std::setprecision(1)
+                      << edge->weight << " km\n";
+            currentLine.clear();
+        } else if (edge && edge->type == EdgeType::Transfer) {
+            std::cout << "  ↓\n  TRANSFER to " << station->getMetroLine() << "\n";
+            currentLine = station->getMetroLine();
+        } else if (edge && edge->lineName() != currentLine) {
+            if (!currentLine.empty()) std::cout << "  ↓\n  TRANSFER to " << edge->lineName() << "\n";
+            currentLine = edge->lineName();
         }
+        std::cout << "  → " << path.path[i] << "\n";
     }
     
     std::cout << "  END ✓\n";
@@ -0,0 +1,271 @@
+#include "WeightOverlay.h"
+#include "QueryEngine.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sys/stat.h>
+
+namespace {
+
+bool parseNumber(const std::string& s, double& out) {
+    try {
+        size_t used = 0;
+        out = std::stod(s, &used);
+        return used == s.size() && std::isfinite(out) && out >= 0;
+    } catch (...) {
+        return false;
+    }
+}
+
+} // namespace
+
+bool WeightUpdate::parse(const std::string& line, WeightUpdate& update) {
+    std::string text = line;
+    if (!text.empty() && text.back() == '\r') text.pop_back();
+    if (text.empty() || text[0] == '#') return false;
+    std::vector<std::string> f = QueryEngine::splitFields(text);
+    const std::string& cmd = f[0];
+    update = WeightUpdate();
+    if (cmd == "clear" && f.size() == 1) {
+        update.kind = Kind::ClearAll;
+        return true;
+    }
+    if (f.size() < 3 || f[1].empty() || f[2].empty()) return false;
+    update.from = f[1];
+    update.to = f[2];
+    if ((cmd == "delay" || cmd == "slow") && f.size() == 4) {
+        update.kind = (cmd == "delay") ? Kind::Delay : Kind::Slow;
+        return parseNumber(f[3], update.value);
+    }
+    if (f.size() != 3) return false;
+    if (cmd == "close") update.kind = Kind::Close;
+    else if (cmd == "open") update.kind = Kind::Open;
+    else if (cmd == "clear") update.kind = Kind::Clear;
+    else return false;
+    return true;
+}
+
+WeightOverlay::WeightOverlay(const CostModel& costModel) : model(costModel) {}
+
+uint32_t WeightOverlay::edgeWord(const CompactGraph& index, int e, const Condition& condition) const {
+    if (condition.closed) return CLOSED;
+    double seconds = condition.delaySeconds;
+    if (condition.slowKmh > 0) {
+        // Time over the edge at the slow speed, less the time the cost model already counts
+        double km = index.edgeWeight(e);
+        double normalKmh = (index.edgeType(e) == EdgeType::Walk) ? model.walkKmh : model.rideKmh;
+        seconds += std::max(0.0, km * 3600.0 / condition.slowKmh - km * 3600.0 / normalKmh);
+    }
+    return static_cast<uint32_t>(std::min<double>(MAX_SECONDS, std::llround(seconds)));
+}
+
+void WeightOverlay::resolve(Table& target, const std::pair<std::string, std::string>& pair,
+                            const Condition* condition) const {
+    const CompactGraph& index = *target.index;
+    int u = index.idOf(pair.first);
+    int v = index.idOf(pair.second);
+    if (u < 0 || v < 0) return;
+    CompactGraph::EdgeCursor edges;
+    edges.load(index, u);
+    for (int e = edges.begin; e < edges.end; e++) {
+        if (edges.target(e) != v) continue;
+        uint32_t word = condition ? edgeWord(index, e, *condition) : 0;
+        uint32_t old = target.words[e].load(std::memory_order_relaxed);
+        if (word == old) continue;
+        target.words[e].store(word, std::memory_order_relaxed);
+        if (old == CLOSED) target.closedEdges--;
+        if (word == CLOSED) target.closedEdges++;
+    }
+}
+
+std::shared_ptr<WeightOverlay::Table> WeightOverlay::copy(const Table& current) {
+    // The spare is reused once the writer holds the only reference: it is
+    // unpublished, so no query can pick it up again
+    std::shared_ptr<Table> next = std::move(spare);
+    size_t edges = static_cast<size_t>(current.index->getEdgeCount());
+    if (!next || next.use_count() != 1 || next->index != current.index) {
+        next = std::make_shared<Table>();
+        next->index = current.index;
+        next->words.reset(new std::atomic<uint32_t>[edges]);
+    }
+    // Pairs with the release of the last query's reference, so its reads
+    // of the old words come before the stores below
+    std::atomic_thread_fence(std::memory_order_acquire);
+    for (size_t e = 0; e < edges; e++) {
+        next->words[e].store(current.words[e].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    next->closedEdges = current.closedEdges;
+    return next;
+}
+
+void WeightOverlay::bind(std::shared_ptr<const CompactGraph> index) {
+    TraceSpan span("WeightOverlay::bind", "index");
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::shared_ptr<const Table> current = std::atomic_load(&table);
+    if (current && current->index == index) return;
+
+    std::shared_ptr<Table> fresh = std::make_shared<Table>();
+    fresh->index = index;
+    size_t edges = index ? static_cast<size_t>(index->getEdgeCount()) : 0;
+    fresh->words.reset(new std::atomic<uint32_t>[edges]);
+    for (size_t e = 0; e < edges; e++) fresh->words[e].store(0, std::memory_order_relaxed);
+    if (index) {
+        for (const auto& entry : conditions) resolve(*fresh, entry.first, &entry.second);
+    }
+    fresh->active = conditions.size();
+    fresh->sequence = ++sequence;
+    // Published whole; queries on the old index keep the old table
+    spare.reset();
+    std::atomic_store(&table, std::shared_ptr<const Table>(std::move(fresh)));
+}
+
+size_t WeightOverlay::apply(const std::vector<WeightUpdate>& updates) {
+    if (updates.empty()) return 0;
+    TraceSpan span("WeightOverlay::apply", "live", std::to_string(updates.size()) + " updates");
+    std::lock_guard<std::mutex> lock(writeMutex);
+    // Queries keep reading the published table; the batch goes into a copy
+    std::shared_ptr<const Table> published = std::atomic_load(&table);
+    std::shared_ptr<Table> current = published ? copy(*published) : nullptr;
+
+    size_t changed = 0;
+    for (const WeightUpdate& update : updates) {
+        if (update.kind == WeightUpdate::Kind::ClearAll) {
+            if (conditions.empty()) continue;
+            if (current) {
+                for (const auto& entry : conditions) resolve(*current, entry.first, nullptr);
+            }
+            conditions.clear();
+            changed++;
+            continue;
+        }
+
+        std::pair<std::string, std::string> key(update.from, update.to);
+        if (current && (current->index->idOf(update.from) < 0 || current->index->idOf(update.to) < 0)) {
+            continue;
+        }
+        auto it = conditions.find(key);
+        Condition condition = (it != conditions.end()) ? it->second : Condition();
+        switch (update.kind) {
+            case WeightUpdate::Kind::Delay:
+                condition.delaySeconds = static_cast<uint32_t>(
+                    std::min<double>(MAX_SECONDS, std::llround(update.value)));
+                break;
+            case WeightUpdate::Kind::Slow: condition.slowKmh = update.value; break;
+            case WeightUpdate::Kind::Close: condition.closed = true; break;
+            case WeightUpdate::Kind::Open: condition.closed = false; break;
+            default: condition = Condition(); break;
+        }
+
+        bool inForce = condition.closed || condition.delaySeconds > 0 || condition.slowKmh > 0;
+        if (inForce) {
+            conditions[key] = condition;
+        } else if (it != conditions.end()) {
+            conditions.erase(it);
+        } else {
+            continue;
+        }
+        if (current) resolve(*current, key, inForce ? &conditions[key] : nullptr);
+        changed++;
+    }
+
+    active.store(conditions.size());
+    if (current) {
+        current->active = conditions.size();
+        current->sequence = ++sequence;
+        std::atomic_store(&table, std::shared_ptr<const Table>(current));
+        // The table just replaced is the next batch's spare
+        spare = std::const_pointer_cast<Table>(published);
+    }
+    batches++;
+    return changed;
+}
+
+WeightOverlay::View WeightOverlay::view(const CompactGraph& index) const {
+    View result;
+    std::shared_ptr<const Table> current = std::atomic_load(&table);
+    if (current && current->active > 0 && current->index.get() == &index) result.table = std::move(current);
+    return result;
+}
+
+bool WeightOverlay::hasClosures() const {
+    std::shared_ptr<const Table> current = std::atomic_load(&table);
+    return current && current->active > 0 && current->closedEdges > 0;
+}
+
+WeightFeed::WeightFeed(std::shared_ptr<WeightOverlay> target, const std::string& file, unsigned interval)
+    : overlay(std::move(target)), path(file), intervalMs(std::max(1u, interval)) {}
+
+WeightFeed::~WeightFeed() {
+    stop();
+}
+
+void WeightFeed::start() {
+    if (poller.joinable()) return;
+    poll();
+    stopping = false;
+    poller = std::thread(&WeightFeed::run, this);
+}
+
+void WeightFeed::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (poller.joinable()) poller.join();
+}
+
+void WeightFeed::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait_for(lock, std::chrono::milliseconds(intervalMs), [this] { return stopping; });
+        if (stopping) break;
+        lock.unlock();
+        poll();
+        lock.lock();
+    }
+}
+
+void WeightFeed::poll() {
+    struct stat info;
+    if (::stat(path.c_str(), &info) != 0) return;   // not written yet
+    uint64_t size = static_cast<uint64_t>(info.st_size);
+
+    std::vector<WeightUpdate> batch;
+    if (size < offset) {
+        // Rewritten from scratch: its lines describe the whole state
+        WeightUpdate reset;
+        reset.kind = WeightUpdate::Kind::ClearAll;
+        batch.push_back(reset);
+        offset = 0;
+        partial.clear();
+    }
+    if (size == offset && batch.empty()) return;
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return;
+    in.seekg(static_cast<std::streamoff>(offset));
+    std::string chunk(static_cast<size_t>(size - offset), '\0');
+    in.read(&chunk[0], static_cast<std::streamsize>(chunk.size()));
+    chunk.resize(static_cast<size_t>(in.gcount()));
+    offset += chunk.size();
+
+    partial += chunk;
+    size_t start = 0;
+    for (size_t end; (end = partial.find('\n', start)) != std::string::npos; start = end + 1) {
+        std::string line = partial.substr(start, end - start);
+        WeightUpdate update;
+        if (WeightUpdate::parse(line, update)) {
+            batch.push_back(std::move(update));
+        } else if (!line.empty() && line != "\r" && line[0] != '#') {
+            rejected++;
+        }
+    }
+    partial.erase(0, start);
+
+    if (batch.empty()) return;
+    applied += overlay->apply(batch);
+    if (onBatch) onBatch();
+}
@@ -0,0 +1,490 @@
+// Benchmark suite: micro benchmarks for the Graph / SearchEngine APIs and
+// end-to-end load/query benchmarks on synthetic networks.
+//
+// Build:  g++ -std=c++17 -O2 -pthread -o metro_bench tools/benchmark.cpp src/*.cpp -I include
+// Run:    ./metro_bench --topology grid --stations 1000,100000 --queries 2000
+// Output: one JSON object per benchmark on stdout (see Benchmark::writeJson).
+#include <iostream>
+#include <filesystem>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Graph.h"
+#include "SearchEngine.h"
+#include "CompactGraph.h"
+#include "RouteResult.h"
+#include "HubLabels.h"
+#include "HopReachability.h"
+#include "LineIndex.h"
+#include "MultiLevelOverlay.h"
+#include "RouteKernel.h"
+#include "WeightOverlay.h"
+#include "DistanceMatrix.h"
+#include "Isochrone.h"
+#include "DataLoader.h"
+#include "QueryEngine.h"
+#include "NetworkGenerator.h"
+#include "ThreadPool.h"
+#include "Benchmark.h"
+
+using namespace std;
+
+struct Options {
+    Topology topology = Topology::Grid;
+    string topologyName = "grid";
+    vector<int> sizes = {1000, 10000};
+    size_t queries = 1000;
+    size_t heavyIterations = 5;      // for whole-graph operations (bfs, MST, load)
+    int threads = 0;
+    unsigned seed = 42;
+    string filter;
+};
+
+bool parseOptions(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        string value = argv[++i];
+        if (arg == "--topology") {
+            if (!NetworkGenerator::parseTopology(value, opt.topology)) return false;
+            opt.topologyName = value;
+        } else if (arg == "--stations") {
+            opt.sizes.clear();
+            stringstream ss(value);
+            string item;
+            while (getline(ss, item, ',')) opt.sizes.push_back(stoi(item));
+        } else if (arg == "--queries") {
+            opt.queries = stoul(value);
+        } else if (arg == "--heavy-iterations") {
+            opt.heavyIterations = stoul(value);
+        } else if (arg == "--threads") {
+            opt.threads = stoi(value);
+        } else if (arg == "--seed") {
+            opt.seed = static_cast<unsigned>(stoul(value));
+        } else if (arg == "--filter") {
+            opt.filter = value;
+        } else {
+            return false;
+        }
+    }
+    return !opt.sizes.empty();
+}
+
+void runSuite(const Options& opt, int size) {
+    NetworkSpec spec;
+    spec.topology = opt.topology;
+    spec.stations = size;
+    spec.seed = opt.seed;
+
+    Graph graph;
+    NetworkGenerator::generate(graph, spec);
+    SearchEngine search(graph.getStations());
+    CompactGraph compact(graph);
+
+    vector<string> names;
+    for (const auto& pair : graph.getStations()) names.push_back(pair.first);
+    double minLat = 90, maxLat = -90, minLon = 180, maxLon = -180;
+    for (const auto& pair : graph.getStations()) {
+        minLat = min(minLat, pair.second.getLatitude());
+        maxLat = max(maxLat, pair.second.getLatitude());
+        minLon = min(minLon, pair.second.getLongitude());
+        maxLon = max(maxLon, pair.second.getLongitude());
+    }
+
+    // Pre-generate inputs so the timed region only contains the call itself
+    mt19937 rng(opt.seed);
+    uniform_int_distribution<size_t> pick(0, names.size() - 1);
+    uniform_real_distribution<double> latDist(minLat, maxLat), lonDist(minLon, maxLon);
+    vector<pair<string, string>> odPairs;
+    vector<string> keywords, prefixes;
+    vector<pair<double, double>> points;
+    for (size_t i = 0; i < opt.queries; i++) {
+        odPairs.push_back({names[pick(rng)], names[pick(rng)]});
+        const string& name = names[pick(rng)];
+        keywords.push_back(name.substr(name.size() / 2, 3));
+        prefixes.push_back(name.substr(0, 3));
+        points.push_back({latDist(rng), lonDist(rng)});
+    }
+    vector<int> targets;
+    for (int i = 0; i < 100; i++) targets.push_back(static_cast<int>(pick(rng)));
+
+    int threads = opt.threads > 0 ? opt.threads : static_cast<int>(thread::hardware_concurrency());
+    if (threads <= 0) threads = 1;
+
+    auto report = [&](BenchResult r) {
+        r.topology = opt.topologyName;
+        r.stations = graph.getStationCount();
+        Benchmark::writeJson(cout, r);
+    };
+    auto enabled = [&](const string& name) {
+        return opt.filter.empty() || name.find(opt.filter) != string::npos;
+    };
+
+    // Micro benchmarks
+    if (enabled("findShortestPath")) {
+        report(Benchmark::run("findShortestPath", opt.queries, [&](size_t i) {
+            graph.findShortestPath(odPairs[i].first, odPairs[i].second);
+        }));
+    }
+    const std::pair<const char*, RouteCriterion> criteria[] = {
+        {"findRoute.distance", RouteCriterion::Distance},
+        {"findRoute.time", RouteCriterion::Time},
+        {"findRoute.fare", RouteCriterion::Fare},
+        {"findRoute.transfers", RouteCriterion::Transfers},
+        {"findRoute.weighted", RouteCriterion::Weighted}};
+    graph.getRoutingIndex();
+    for (const auto& c : criteria) {
+        if (!enabled(c.first)) continue;
+        report(Benchmark::run(c.first, opt.queries, [&](size_t i) {
+            graph.findRoute(odPairs[i].first, odPairs[i].second, c.second);
+        }));
+    }
+    if (enabled("findRoute.result")) {
+        // Batch-job style: station IDs in, one reused RouteResult, no names
+        std::shared_ptr<const CompactGraph> index = graph.getRoutingIndex();
+        vector<pair<int, int>> idPairs;
+        for (const auto& od : odPairs) idPairs.push_back({index->idOf(od.first), index->idOf(od.second)});
+        RouteResult route;
+        report(Benchmark::run("findRoute.result", opt.queries, [&](size_t i) {
+            graph.findRoute(idPairs[i].first, idPairs[i].second, RouteCriterion::Time, *index, route);
+        }));
+    }
+    if (enabled("hubLabels")) {
+        // Build once (timed as one sample), then distance-only and full-route queries
+        std::shared_ptr<const CompactGraph> index = graph.getRoutingIndex();
+        std::shared_ptr<const HubLabels> labels;
+        report(Benchmark::run("hubLabels.build", 1, [&](size_t) { labels = HubLabels::build(*index); }));
+        vector<pair<int, int>> idPairs;
+        for (const auto& od : odPairs) idPairs.push_back({index->idOf(od.first), index->idOf(od.second)});
+        report(Benchmark::run("hubLabels.distance", opt.queries, [&](size_t i) {
+            labels->distanceMeters(idPairs[i].first, idPairs[i].second);
+        }));
+        graph.setHubLabels(labels);
+        RouteResult route;
+        report(Benchmark::run("hubLabels.route", opt.queries, [&](size_t i) {
+            graph.findRoute(idPairs[i].first, idPairs[i].second, RouteCriterion::Distance, *index, route);
+        }));
+        graph.setHubLabels(nullptr);
+    }
+    if (enabled("lineIndex")) {
+        // Same-line trips: prefix-sum lookups and transfers routes, against
+        // the transfers search they replace
+        std::shared_ptr<const CompactGraph> index = graph.getRoutingIndex();
+        std::shared_ptr<const LineIndex> lines;
+        BenchResult build = Benchmark::run("lineIndex.build", 1, [&](size_t) { lines = make_shared<LineIndex>(index); });
+        build.extra.push_back({"patterns", static_cast<double>(lines->patternCount())});
+        build.extra.push_back({"mb", lines->memoryBytes() / 1e6});
+        report(build);
+        // Two random stations of a random line sequence
+        vector<pair<int, int>> linePairs;
+        for (size_t i = 0; i < opt.queries * 10 && linePairs.size() < opt.queries; i++) {
+            vector<vector<int>> sequences = lines->sequences(static_cast<int>(pick(rng) % index->lineCount()));
+            if (sequences.empty()) continue;
+            const vector<int>& sequence = sequences[pick(rng) % sequences.size()];
+            linePairs.push_back({sequence[pick(rng) % sequence.size()], sequence[pick(rng) % sequence.size()]});
+        }
+        report(Benchmark::run("lineIndex.sameLine", linePairs.size(), [&](size_t i) {
+            lines->sameLine(linePairs[i].first, linePairs[i].second);
+        }));
+        KernelWorkspace<uint64_t> ws;
+        report(Benchmark::run("lineIndex.transfersSearch", linePairs.size(), [&](size_t i) {
+            RouteKernel::run(*index, linePairs[i].first, linePairs[i].second, TransferCost(), ws);
+        }));
+        graph.getLineIndex();
+        RouteResult route;
+        report(Benchmark::run("lineIndex.transfersRoute", linePairs.size(), [&](size_t i) {
+            graph.findRoute(linePairs[i].first, linePairs[i].second, RouteCriterion::Transfers, *index, route);
+        }));
+    }
+    if (enabled("crp")) {
+        // Partition once, customize the distance and time metrics (cells on
+        // the pool), then time routes over the overlays against the plain
+        // kernel searches
+        std::shared_ptr<const CompactGraph> index = graph.getRoutingIndex();
+        std::shared_ptr<const MultiLevelOverlay> cells;
+        BenchResult build = Benchmark::run("crp.partition", 1, [&](size_t) {
+            cells = make_shared<const MultiLevelOverlay>(index);
+        });
+        build.extra.push_back({"levels", static_cast<double>(cells->levelCount())});
+        if (cells->levelCount() > 0) {
+            build.extra.push_back({"cells_level1", static_cast<double>(cells->cellCount(1))});
+            build.extra.push_back({"boundary_level1", static_cast<double>(cells->boundaryCount(1))});
+            build.extra.push_back({"state_boundary_level1", static_cast<double>(cells->stateBoundaryCount(1))});
+        }
+        build.extra.push_back({"mb", cells->memoryBytes() / 1e6});
+        report(build);
+        ThreadPool pool(threads);
+        vector<pair<int, int>> idPairs;
+        for (const auto& od : odPairs) idPairs.push_back({index->idOf(od.first), index->idOf(od.second)});
+        const std::pair<const char*, RouteCriterion> metrics[] = {{"distance", RouteCriterion::Distance},
+                                                                  {"time", RouteCriterion::Time}};
+        for (const auto& entry : metrics) {
+            string prefix = string("crp.") + entry.first;
+            std::shared_ptr<const OverlayMetric> metric;
+            BenchResult customize = Benchmark::run(prefix + ".customize", opt.heavyIterations, [&](size_t) {
+                metric = OverlayMetric::customize(cells, entry.second, graph.getCostModel(), nullptr, &pool);
+            });
+            customize.extra.push_back({"threads", static_cast<double>(pool.size())});
+            customize.extra.push_back({"mb", metric->memoryBytes() / 1e6});
+            report(customize);
+            report(Benchmark::run(prefix + ".cost", opt.queries, [&](size_t i) {
+                metric->cost(idPairs[i].first, idPairs[i].second);
+            }));
+        }
+        KernelWorkspace<uint32_t> ws;
+        report(Benchmark::run("crp.distance.kernelSearch", opt.queries, [&](size_t i) {
+            RouteKernel::run(*index, idPairs[i].first, idPairs[i].second, DistanceCost(), ws);
+        }));
+        KernelWorkspace<TimeCost::Key> timeWs;
+        TimeCost time(graph.getCostModel());
+        report(Benchmark::run("crp.time.kernelSearch", opt.queries, [&](size_t i) {
+            RouteKernel::run(*index, idPairs[i].first, idPairs[i].second, time, timeWs);
+        }));
+        graph.setMultiLevelOverlay(cells);
+        graph.customizeOverlay(&pool);
+        RouteResult route;
+        for (const auto& entry : metrics) {
+            report(Benchmark::run(string("crp.") + entry.first + ".route", opt.queries, [&](size_t i) {
+                graph.findRoute(idPairs[i].first, idPairs[i].second, entry.second, *index, route);
+            }));
+        }
+        graph.setMultiLevelOverlay(nullptr);
+    }
+    if (enabled("reorder")) {
+        // Same time-criterion queries under each station numbering: build
+        // cost, locality score (mean edge span) and query latency/cache misses
+        const StationOrder orders[] = {StationOrder::Name, StationOrder::Bfs, StationOrder::Hilbert,
+                                       StationOrder::Line};
+        for (StationOrder order : orders) {
+            string prefix = string("reorder.") + StationOrdering::name(order);
+            graph.setStationOrder(order);
+            std::shared_ptr<const CompactGraph> index;
+            BenchResult build = Benchmark::run(prefix + ".build", 1, [&](size_t) {
+                index = std::make_shared<const CompactGraph>(graph, order);
+            });
+            graph.setRoutingIndex(index);
+            build.extra.push_back({"edge_span", StationOrdering::averageEdgeSpan(*index)});
+            report(build);
+            vector<pair<int, int>> idPairs;
+            for (const auto& od : odPairs) idPairs.push_back({index->idOf(od.first), index->idOf(od.second)});
+            RouteResult route;
+            report(Benchmark::run(prefix + ".route", opt.queries, [&](size_t i) {
+                graph.findRoute(idPairs[i].first, idPairs[i].second, RouteCriterion::Time, *index, route);
+            }));
+        }
+        graph.setStationOrder(StationOrder::Name);
+        graph.getRoutingIndex();
+    }
+    if (enabled("compressed")) {
+        // Packed edges: encode time and sizes, then the same time-criterion
+        // queries on the flat and the compressed snapshot
+        std::shared_ptr<const CompactGraph> flat = graph.getRoutingIndex();
+        std::shared_ptr<const CompactGraph> packed;
+        BenchResult build = Benchmark::run("compressed.build", 1, [&](size_t) { packed = flat->compressed(); });
+        build.extra.push_back({"flat_adjacency_mb", flat->adjacencyBytes() / 1048576.0});
+        build.extra.push_back({"packed_adjacency_mb", packed->adjacencyBytes() / 1048576.0});
+        build.extra.push_back({"flat_index_mb", flat->memoryBytes() / 1048576.0});
+        build.extra.push_back({"packed_index_mb", packed->memoryBytes() / 1048576.0});
+        report(build);
+        vector<pair<int, int>> idPairs;
+        for (const auto& od : odPairs) idPairs.push_back({flat->idOf(od.first), flat->idOf(od.second)});
+        RouteResult route;
+        report(Benchmark::run("compressed.flatRoute", opt.queries, [&](size_t i) {
+            graph.findRoute(idPairs[i].first, idPairs[i].second, RouteCriterion::Time, *flat, route);
+        }));
+        report(Benchmark::run("compressed.route", opt.queries, [&](size_t i) {
+            graph.findRoute(idPairs[i].first, idPairs[i].second, RouteCriterion::Time, *packed, route);
+        }));
+    }
+    if (enabled("live")) {
+        // Time routes with delays on about 1% of stations' first edges, then
+        // again while a writer publishes a batch of those updates every 50 ms
+        std::shared_ptr<const CompactGraph> index = graph.getRoutingIndex();
+        std::shared_ptr<WeightOverlay> overlay = std::make_shared<WeightOverlay>(graph.getCostModel());
+        graph.setWeightOverlay(overlay);
+        vector<WeightUpdate> updates;
+        for (int u = 0; u < index->size(); u += 100) {
+            if (index->edgeBegin(u) == index->edgeEnd(u)) continue;
+            WeightUpdate update;
+            update.kind = WeightUpdate::Kind::Delay;
+            update.from = index->nameOf(u);
+            update.to = index->nameOf(index->edgeTarget(index->edgeBegin(u)));
+            update.value = 120;
+            updates.push_back(update);
+        }
+        report(Benchmark::run("live.apply", 1, [&](size_t) { overlay->apply(updates); }));
+        vector<pair<int, int>> idPairs;
+        for (const auto& od : odPairs) idPairs.push_back({index->idOf(od.first), index->idOf(od.second)});
+        RouteResult route;
+        report(Benchmark::run("live.route", opt.queries, [&](size_t i) {
+            graph.findRoute(idPairs[i].first, idPairs[i].second, RouteCriterion::Time, *index, route);
+        }));
+
+        std::atomic<bool> done{false};
+        std::thread writer([&] {
+            for (unsigned round = 0; !done.load(); round++) {
+                for (auto& update : updates) update.value = 60 + (round % 2) * 60;
+                overlay->apply(updates);
+                this_thread::sleep_for(chrono::milliseconds(50));
+            }
+        });
+        BenchResult busy = Benchmark::run("live.routeUnderUpdates", opt.queries, [&](size_t i) {
+            graph.findRoute(idPairs[i].first, idPairs[i].second, RouteCriterion::Time, *index, route);
+        });
+        done = true;
+        writer.join();
+        busy.extra.push_back({"batches", static_cast<double>(overlay->batchCount())});
+        report(busy);
+        graph.setWeightOverlay(nullptr);
+    }
+    if (enabled("bfs")) {
+        report(Benchmark::run("bfs", opt.heavyIterations, [&](size_t i) {
+            graph.bfs(odPairs[i % odPairs.size()].first);
+        }));
+    }
+    if (enabled("hops")) {
+        // Whole-network BFS by hop count, then the bounded and many-source forms
+        HopGraph hopGraph(graph.getRoutingIndex());
+        const CompactGraph& index = *hopGraph.getIndex();
+        ThreadPool pool(threads);
+        HopWorkspace ws;
+        HopResult last;
+        BenchResult single = Benchmark::run("hops.full", opt.heavyIterations, [&](size_t i) {
+            last = hopGraph.distances(index.idOf(odPairs[i % odPairs.size()].first), HopGraph::UNLIMITED, ws);
+        });
+        single.extra.push_back({"levels_top_down", static_cast<double>(last.topDownLevels)});
+        single.extra.push_back({"levels_bottom_up", static_cast<double>(last.bottomUpLevels)});
+        report(single);
+        BenchResult parallel = Benchmark::run("hops.fullParallel", opt.heavyIterations, [&](size_t i) {
+            hopGraph.distances(index.idOf(odPairs[i % odPairs.size()].first), HopGraph::UNLIMITED, ws, &pool);
+        });
+        parallel.extra.push_back({"threads", static_cast<double>(pool.size())});
+        report(parallel);
+        report(Benchmark::run("hops.within3", opt.queries, [&](size_t i) {
+            hopGraph.distances(index.idOf(odPairs[i].first), 3, ws);
+        }));
+        vector<int> sources(index.size());
+        for (int v = 0; v < index.size(); v++) sources[v] = v;
+        BenchResult sweep = Benchmark::run("hops.sweep3", opt.heavyIterations, [&](size_t) {
+            hopGraph.reachCounts(sources, 3, pool);
+        });
+        sweep.extra.push_back({"sources", static_cast<double>(sources.size())});
+        sweep.extra.push_back({"threads", static_cast<double>(pool.size())});
+        report(sweep);
+    }
+    if (enabled("minimumSpanningTree")) {
+        report(Benchmark::run("minimumSpanningTree", opt.heavyIterations, [&](size_t) {
+            graph.minimumSpanningTree();
+        }));
+    }
+    if (enabled("searchByName")) {
+        report(Benchmark::run("searchByName", opt.queries, [&](size_t i) {
+            search.searchByName(keywords[i]);
+        }));
+    }
+    if (enabled("getAutocompleteSuggestions")) {
+        report(Benchmark::run("getAutocompleteSuggestions", opt.queries, [&](size_t i) {
+            search.getAutocompleteSuggestions(prefixes[i]);
+        }));
+    }
+    if (enabled("getNearestStation")) {
+        report(Benchmark::run("getNearestStation", opt.queries, [&](size_t i) {
+            search.getNearestStation(points[i].first, points[i].second);
+        }));
+    }
+    if (enabled("snapToStations")) {
+        // Bulk snapping: one sample = all query points in one call
+        vector<double> lats, lons;
+        for (const auto& p : points) {
+            lats.push_back(p.first);
+            lons.push_back(p.second);
+        }
+        vector<int> snapped(points.size());
+        report(Benchmark::run("snapToStations", opt.heavyIterations, [&](size_t) {
+            search.snapToStations(lats.data(), lons.data(), lats.size(), snapped.data());
+        }));
+    }
+    if (enabled("oneToMany")) {
+        SearchWorkspace ws;
+        report(Benchmark::run("oneToMany", opt.queries, [&](size_t i) {
+            DistanceMatrix::oneToMany(compact, compact.idOf(odPairs[i].first), targets, ws);
+        }));
+    }
+    if (enabled("isochrone")) {
+        // One station's bands, then a heatmap sweep: the same bands from 1000 sources
+        const vector<double> bands = {2, 5, 10};
+        const FareCalculator& fares = graph.getFareCalculator();
+        SearchWorkspace ws;
+        size_t reached = 0;
+        BenchResult single = Benchmark::run("isochrone.single", opt.queries, [&](size_t i) {
+            IsochroneResult r = Isochrone::compute(compact, compact.idOf(odPairs[i].first), bands,
+                                                   BudgetKind::Distance, fares, ws);
+            for (const auto& band : r.bands) reached += band.stations.size();
+        });
+        single.extra.push_back({"stations_per_query", static_cast<double>(reached) / single.samples});
+        report(single);
+        vector<int> sources;
+        for (size_t i = 0; i < 1000 && i < odPairs.size(); i++) sources.push_back(compact.idOf(odPairs[i].first));
+        ThreadPool pool(threads);
+        for (BudgetKind kind : {BudgetKind::Distance, BudgetKind::Fare}) {
+            bool fare = (kind == BudgetKind::Fare);
+            const vector<double> limits = fare ? vector<double>{20, 40, 60} : bands;
+            BenchResult sweep = Benchmark::run(fare ? "isochrone.heatmapFare" : "isochrone.heatmap",
+                                               opt.heavyIterations, [&](size_t) {
+                Isochrone::computeMany(compact, sources, limits, kind, fares, pool);
+            });
+            sweep.extra.push_back({"sources", static_cast<double>(sources.size())});
+            sweep.threads = static_cast<int>(pool.size());
+            report(sweep);
+        }
+    }
+    if (enabled("manyToMany")) {
+        // One sample = a 100 x 100 table, sources fanned out over the pool
+        vector<int> sources;
+        for (int i = 0; i < 100; i++) sources.push_back(static_cast<int>(pick(rng)));
+        ThreadPool pool(threads);
+        BenchResult table = Benchmark::run("manyToMany", opt.heavyIterations, [&](size_t) {
+            DistanceMatrix::manyToMany(compact, sources, targets, pool);
+        });
+        table.threads = static_cast<int>(pool.size());
+        report(table);
+    }
+
+    // End-to-end: load from files, then concurrent protocol queries
+    if (enabled("loadNetwork")) {
+        auto dir = filesystem::temp_directory_path() /
+                   ("metro_bench_" + opt.topologyName + "_" + to_string(size));
+        filesystem::create_directories(dir);
+        NetworkGenerator::writeNetwork(graph, dir.string());
+        report(Benchmark::run("loadNetwork", opt.heavyIterations, [&](size_t) {
+            Graph loaded;
+            loadNetwork(loaded, dir.string(), false);
+        }));
+        filesystem::remove_all(dir);
+    }
+    if (enabled("queryEngine")) {
+        QueryEngine engine(graph);
+        vector<string> requests;
+        for (const auto& od : odPairs) requests.push_back("route|" + od.first + "|" + od.second);
+        report(Benchmark::runParallel("queryEngine.route", requests.size(), threads, [&](size_t i) {
+            engine.answer(requests[i], ResponseFormat::Json);
+        }));
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        cerr << "Usage: " << argv[0] << " [--topology grid|radial] [--stations N[,N...]]"
+             << " [--queries Q] [--heavy-iterations K] [--threads T] [--seed S] [--filter NAME]\n";
+        return 1;
+    }
+    for (int size : opt.sizes) {
+        runSuite(opt, size);
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Distance matrix export: shortest distances (km) between every source and
+// every target station, one search per source run on all cores.
+//
+// Build:  g++ -std=c++17 -O2 -pthread -o metro_matrix tools/matrix.cpp src/*.cpp -I include
+// Run:    ./metro_matrix --data data --from "Rajiv Chowk;Kashmere Gate" --to "Yamuna Bank;Dwarka"
+//         ./metro_matrix --data data --all --binary matrix.bin
+// Lists:  --from/--to take ';'-separated names; --from-file/--to-file take one
+//         name per line. Without --to the targets are the sources. Output is CSV
+//         on stdout unless --csv or --binary names a file (layouts in DistanceMatrix.h).
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Graph.h"
+#include "DataLoader.h"
+#include "ArtifactCache.h"
+#include "ChangeJournal.h"
+#include "DistanceMatrix.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+struct Options {
+    string dataDir = "data";
+    vector<string> sources;
+    vector<string> targets;
+    bool all = false;
+    unsigned threads = 0;
+    double walkKm = 0;
+    StationOrder order = StationOrder::Name;
+    string csvFile;
+    string binaryFile;
+};
+
+void splitNames(const string& list, vector<string>& names) {
+    stringstream ss(list);
+    string name;
+    while (getline(ss, name, ';')) {
+        if (!name.empty()) names.push_back(name);
+    }
+}
+
+bool readNames(const string& path, vector<string>& names) {
+    ifstream in(path);
+    if (!in) {
+        cerr << "Could not read " << path << "\n";
+        return false;
+    }
+    string name;
+    while (getline(in, name)) {
+        if (!name.empty() && name.back() == '\r') name.pop_back();
+        if (!name.empty() && name[0] != '#') names.push_back(name);
+    }
+    return true;
+}
+
+bool parseOptions(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--all") {
+            opt.all = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        string value = argv[++i];
+        if (arg == "--data") {
+            opt.dataDir = value;
+        } else if (arg == "--from") {
+            splitNames(value, opt.sources);
+        } else if (arg == "--to") {
+            splitNames(value, opt.targets);
+        } else if (arg == "--from-file") {
+            if (!readNames(value, opt.sources)) return false;
+        } else if (arg == "--to-file") {
+            if (!readNames(value, opt.targets)) return false;
+        } else if (arg == "--threads") {
+            opt.threads = static_cast<unsigned>(stoul(value));
+        } else if (arg == "--walk-km") {
+            opt.walkKm = stod(value);
+        } else if (arg == "--order") {
+            if (!StationOrdering::parse(value, opt.order)) return false;
+        } else if (arg == "--csv") {
+            opt.csvFile = value;
+        } else if (arg == "--binary") {
+            opt.binaryFile = value;
+        } else {
+            return false;
+        }
+    }
+    return opt.all || !opt.sources.empty();
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        cerr << "Usage: " << argv[0] << " [--data DIR] (--all | --from A;B | --from-file FILE)"
+             << " [--to X;Y | --to-file FILE] [--threads T] [--walk-km KM]"
+             << " [--order name|bfs|hilbert|line] [--csv FILE] [--binary FILE]\n";
+        return 1;
+    }
+
+    Graph graph;
+    if (!loadNetwork(graph, opt.dataDir, false)) {
+        cerr << "Failed to load network from " << opt.dataDir << "\n";
+        return 1;
+    }
+    ChangeJournal::replay(opt.dataDir, graph);
+    graph.generateWalkingLinks(opt.walkKm);
+    graph.setStationOrder(opt.order);
+    ArtifactCache cache(opt.dataDir, artifactParams(opt.walkKm, opt.order) + ChangeJournal::cacheKey(opt.dataDir));
+    loadRoutingIndex(graph, cache);
+    shared_ptr<const CompactGraph> index = graph.getRoutingIndex();
+
+    if (opt.all) {
+        opt.sources.clear();
+        for (int id = 0; id < index->size(); id++) opt.sources.push_back(index->nameOf(id));
+    }
+    if (opt.targets.empty()) opt.targets = opt.sources;
+    for (const auto* names : {&opt.sources, &opt.targets}) {
+        for (const auto& name : *names) {
+            if (index->idOf(name) < 0) cerr << "Warning: unknown station " << name << " (distances -1)\n";
+        }
+    }
+
+    ThreadPool pool(opt.threads);
+    DistanceMatrix matrix = DistanceMatrix::manyToMany(*index, opt.sources, opt.targets, pool);
+    cerr << "Computed " << matrix.rows() << " x " << matrix.cols() << " distances on " << pool.size()
+         << " threads\n";
+
+    if (!opt.binaryFile.empty()) {
+        ofstream out(opt.binaryFile, ios::binary);
+        if (!out) {
+            cerr << "Could not write " << opt.binaryFile << "\n";
+            return 1;
+        }
+        matrix.writeBinary(out);
+    }
+    if (!opt.csvFile.empty()) {
+        ofstream out(opt.csvFile);
+        if (!out) {
+            cerr << "Could not write " << opt.csvFile << "\n";
+            return 1;
+        }
+        matrix.writeCSV(out, *index);
+    } else if (opt.binaryFile.empty()) {
+        matrix.writeCSV(cout, *index);
+    }
+    return 0;
+}
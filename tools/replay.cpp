@@ -0,0 +1,236 @@
+// Query log replay: plays back a log recorded with "metro --query-log FILE"
+// against a network loaded in-process (QueryEngine over Graph and
+// SearchEngine) and reports throughput and latency percentiles.
+//
+// Build:  g++ -std=c++17 -O2 -pthread -o metro_replay tools/replay.cpp src/*.cpp -I include
+// Run:    ./metro_replay --data data --log queries.log --speed max --threads 8
+//         ./metro_replay --data data --log queries.log --speed recorded --route-cache 10000 --warm
+// Speed:  "max" answers as fast as the threads can; "recorded" (or a factor,
+//         e.g. 2 for twice as fast) starts each query at its recorded offset
+//         and measures latency from then, so queueing behind slow queries counts.
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Graph.h"
+#include "DataLoader.h"
+#include "ArtifactCache.h"
+#include "Benchmark.h"
+#include "ChangeJournal.h"
+#include "MultiLevelOverlay.h"
+#include "QueryEngine.h"
+#include "QueryLog.h"
+#include "QueryScheduler.h"
+#include "RouteCache.h"
+#include "ThreadPool.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+struct Options {
+    string dataDir = "data";
+    string logFile;
+    string network;                 // replay only "@<network>|" requests
+    double speed = 0;               // 0 = as fast as possible, else recorded speed x factor
+    int threads = 0;
+    double walkKm = 0;
+    StationOrder order = StationOrder::Name;
+    bool hubLabels = false;
+    bool multiLevel = false;
+    size_t routeCache = 0;
+    bool warm = false;
+    bool json = false;
+};
+
+bool parseOptions(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--hub-labels") {
+            opt.hubLabels = true;
+            continue;
+        } else if (arg == "--crp") {
+            opt.multiLevel = true;
+            continue;
+        } else if (arg == "--warm") {
+            opt.warm = true;
+            continue;
+        } else if (arg == "--json") {
+            opt.json = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        string value = argv[++i];
+        if (arg == "--data") {
+            opt.dataDir = value;
+        } else if (arg == "--log") {
+            opt.logFile = value;
+        } else if (arg == "--network") {
+            opt.network = value;
+        } else if (arg == "--speed") {
+            opt.speed = (value == "max") ? 0 : (value == "recorded") ? 1 : stod(value);
+            if (opt.speed < 0) return false;
+        } else if (arg == "--threads") {
+            opt.threads = stoi(value);
+        } else if (arg == "--walk-km") {
+            opt.walkKm = stod(value);
+        } else if (arg == "--order") {
+            if (!StationOrdering::parse(value, opt.order)) return false;
+        } else if (arg == "--route-cache") {
+            opt.routeCache = stoul(value);
+        } else {
+            return false;
+        }
+    }
+    return !opt.logFile.empty();
+}
+
+bool isError(const string& answer, ResponseFormat format) {
+    if (format == ResponseFormat::Json) return answer.compare(0, 11, "{\"ok\":false") == 0;
+    if (format == ResponseFormat::Text) return answer.compare(0, 4, "ERR\t") == 0;
+    return answer.size() >= 8 && answer.compare(4, 4, "ERR\t") == 0;
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        cerr << "Usage: " << argv[0] << " --log FILE [--data DIR] [--speed max|recorded|FACTOR] [--threads N]"
+             << " [--network ID] [--walk-km KM] [--order name|bfs|hilbert|line] [--hub-labels] [--crp]"
+             << " [--route-cache N [--warm]] [--json]\n";
+        return 1;
+    }
+
+    // Requests as the engine sees them: no "batch|" or "@<id>|" prefix
+    vector<LoggedQuery> queries;
+    if (!QueryLog::read(opt.logFile, queries)) return 1;
+    size_t skipped = 0, kept = 0;
+    for (size_t i = 0; i < queries.size(); i++) {
+        LoggedQuery& query = queries[i];
+        string request;
+        QueryScheduler::classify(query.request, request);
+        if (!request.empty() && request[0] == '@') {
+            size_t bar = request.find('|');
+            string id = request.substr(1, bar == string::npos ? string::npos : bar - 1);
+            if ((!opt.network.empty() && id != opt.network) || bar == string::npos) {
+                skipped++;
+                continue;
+            }
+            request.erase(0, bar + 1);
+        }
+        query.request = move(request);
+        if (kept != i) queries[kept] = move(query);
+        kept++;
+    }
+    queries.resize(kept);
+    if (queries.empty()) {
+        cerr << "No queries to replay in " << opt.logFile << "\n";
+        return 1;
+    }
+
+    Graph graph;
+    if (!loadNetwork(graph, opt.dataDir, false)) {
+        cerr << "Failed to load network from " << opt.dataDir << "\n";
+        return 1;
+    }
+    ChangeJournal::replay(opt.dataDir, graph);
+    graph.generateWalkingLinks(opt.walkKm);
+    graph.setStationOrder(opt.order);
+    ArtifactCache cache(opt.dataDir, artifactParams(opt.walkKm, opt.order) + ChangeJournal::cacheKey(opt.dataDir));
+    loadRoutingIndex(graph, cache);
+    if (opt.hubLabels) loadHubLabels(graph, cache);
+    if (opt.multiLevel) {
+        graph.setMultiLevelOverlay(make_shared<const MultiLevelOverlay>(graph.getRoutingIndex()));
+        graph.customizeOverlay(&ThreadPool::shared());
+    }
+    QueryEngine engine(graph, opt.routeCache);
+    if (opt.warm) {
+        size_t warmed = QueryLog::warm(queries, opt.routeCache > 0 ? opt.routeCache : 1000,
+                                       [&engine](const string& request, ResponseFormat format) {
+                                           return engine.answer(request, format);
+                                       }, &ThreadPool::shared());
+        cerr << "Warmed " << warmed << " routes\n";
+    }
+
+    int threads = opt.threads > 0 ? opt.threads : static_cast<int>(thread::hardware_concurrency());
+    if (threads <= 0) threads = 1;
+    const int KINDS = 5;        // indexed by QueryKind (1..4)
+    vector<vector<vector<uint64_t>>> samples(threads, vector<vector<uint64_t>>(KINDS));
+    vector<size_t> errors(threads, 0);
+    atomic<size_t> next(0);
+
+    auto wallStart = Clock::now();
+    vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            for (size_t i = next.fetch_add(1); i < queries.size(); i = next.fetch_add(1)) {
+                const LoggedQuery& query = queries[i];
+                Clock::time_point start = Clock::now();
+                if (opt.speed > 0) {
+                    // Latency counts from the recorded start, queueing included
+                    uint64_t offset = query.micros - queries[0].micros;
+                    start = wallStart + chrono::microseconds(static_cast<int64_t>(offset / opt.speed));
+                    this_thread::sleep_until(start);
+                }
+                string answer = engine.answer(query.request, query.format);
+                uint64_t ns = static_cast<uint64_t>(
+                    chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count());
+                samples[t][static_cast<int>(query.kind)].push_back(ns);
+                if (isError(answer, query.format)) errors[t]++;
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double wall = chrono::duration<double>(Clock::now() - wallStart).count();
+
+    vector<uint64_t> all;
+    vector<BenchResult> results;
+    size_t errorCount = 0;
+    for (int t = 0; t < threads; t++) errorCount += errors[t];
+    for (int kind = 1; kind < KINDS; kind++) {
+        vector<uint64_t> kindSamples;
+        for (int t = 0; t < threads; t++) {
+            kindSamples.insert(kindSamples.end(), samples[t][kind].begin(), samples[t][kind].end());
+        }
+        if (kindSamples.empty()) continue;
+        all.insert(all.end(), kindSamples.begin(), kindSamples.end());
+        BenchResult r;
+        r.name = string("replay.") + QueryLog::kindName(static_cast<QueryKind>(kind));
+        Benchmark::summarize(kindSamples, wall, r);
+        results.push_back(r);
+    }
+    BenchResult total;
+    total.name = "replay.all";
+    Benchmark::summarize(all, wall, total);
+    results.insert(results.begin(), total);
+
+    for (auto& r : results) {
+        r.topology = "log";
+        r.stations = static_cast<int>(graph.getStationCount());
+        r.threads = threads;
+    }
+    if (opt.json) {
+        results[0].extra.push_back({"errors", static_cast<double>(errorCount)});
+        for (const auto& r : results) Benchmark::writeJson(cout, r);
+        return 0;
+    }
+
+    cout << "Replayed " << queries.size() << " queries from " << opt.logFile << " on " << threads
+         << " threads at " << (opt.speed > 0 ? to_string(opt.speed) + "x recorded speed" : string("max speed"));
+    if (skipped > 0) cout << " (" << skipped << " of other networks skipped)";
+    cout << "\n" << fixed << setprecision(1) << "Wall " << wall << " s, " << total.throughputPerSec
+         << " queries/s, " << errorCount << " errors\n";
+    cout << left << setw(10) << "kind" << right << setw(10) << "count" << setw(10) << "p50_us" << setw(10)
+         << "p90_us" << setw(10) << "p99_us" << setw(10) << "p999_us" << setw(12) << "max_us" << "\n";
+    for (const auto& r : results) {
+        cout << left << setw(10) << r.name.substr(7) << right << setw(10) << r.samples << setw(10) << r.p50Us
+             << setw(10) << r.p90Us << setw(10) << r.p99Us << setw(10) << r.p999Us << setw(12) << r.maxUs << "\n";
+    }
+    if (RouteCache* routeCache = engine.getRouteCache()) {
+        cout << "Route cache: " << routeCache->hits() << " hits, " << routeCache->misses() << " misses, "
+             << routeCache->size() << " entries\n";
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+// Network splitter: cuts one network into geographic shards for
+// "metro --shards" (see ShardRouting.h) and prints how to start them.
+//
+// Build:  g++ -std=c++17 -O2 -pthread -o metro_shard tools/shard.cpp src/*.cpp -I include
+// Run:    ./metro_shard --data data --shards 4 --out split
+//         ./metro_shard --topology grid --stations 100000 --shards 8 --out split
+#include <iostream>
+#include <string>
+#include "Graph.h"
+#include "DataLoader.h"
+#include "ChangeJournal.h"
+#include "NetworkGenerator.h"
+#include "ShardRouting.h"
+
+using namespace std;
+
+struct Options {
+    string dataDir;
+    Topology topology = Topology::Grid;
+    int stations = 0;               // > 0: generate a synthetic network instead of --data
+    unsigned seed = 1;
+    int shards = 2;
+    string outDir;
+};
+
+bool parseOptions(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) return false;
+        string value = argv[++i];
+        if (arg == "--data") {
+            opt.dataDir = value;
+        } else if (arg == "--topology") {
+            if (!NetworkGenerator::parseTopology(value, opt.topology)) return false;
+        } else if (arg == "--stations") {
+            opt.stations = stoi(value);
+        } else if (arg == "--seed") {
+            opt.seed = static_cast<unsigned>(stoul(value));
+        } else if (arg == "--shards") {
+            opt.shards = stoi(value);
+        } else if (arg == "--out") {
+            opt.outDir = value;
+        } else {
+            return false;
+        }
+    }
+    if (opt.dataDir.empty() && opt.stations == 0) opt.dataDir = "data";
+    return !opt.outDir.empty() && opt.shards >= 1;
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        cerr << "Usage: " << argv[0] << " [--data DIR | --topology grid|radial --stations N [--seed S]]"
+             << " [--shards K] --out DIR\n";
+        return 1;
+    }
+
+    // Walking links are left out: each shard process adds its own
+    Graph graph;
+    if (opt.stations > 0) {
+        NetworkSpec spec;
+        spec.topology = opt.topology;
+        spec.stations = opt.stations;
+        spec.seed = opt.seed;
+        NetworkGenerator::generate(graph, spec);
+    } else {
+        if (!loadNetwork(graph, opt.dataDir, false)) {
+            cerr << "Failed to load network from " << opt.dataDir << "\n";
+            return 1;
+        }
+        ChangeJournal::replay(opt.dataDir, graph);
+    }
+
+    if (!splitNetwork(graph, opt.shards, opt.outDir)) {
+        cerr << "Failed to split the network into " << opt.outDir << "\n";
+        return 1;
+    }
+    ShardLayout layout;
+    if (!ShardLayout::load(opt.outDir, layout)) return 1;
+
+    vector<size_t> sizes(layout.shards, 0);
+    for (const auto& pair : layout.shardOf) sizes[pair.second]++;
+    cout << "Split " << graph.getStationCount() << " stations into " << layout.shards << " shards ("
+         << layout.cut.size() << " cut links):\n";
+    for (int i = 0; i < layout.shards; i++) {
+        cout << "  shard " << i << ": " << sizes[i] << " stations\n";
+    }
+    cout << "Start each shard, then the coordinator:\n";
+    for (int i = 0; i < layout.shards; i++) {
+        cout << "  metro --serve unix:" << shardSocketPath(opt.outDir, i) << " --data " << opt.outDir
+             << "/shard-" << i << " &\n";
+    }
+    cout << "  metro --shards " << opt.outDir << " --serve unix:" << opt.outDir << "/coordinator.sock\n";
+    return 0;
+}